@@ -143,6 +143,30 @@ typedef struct libvlc_media_stats_t
 } libvlc_media_stats_t;
 /** @}*/
 
+/** defgroup libvlc_media_latency_t LibVLC media decoder latency
+ * \ingroup libvlc_media
+ * @{
+ */
+
+/**
+ * Number of buckets of the latency histograms. Bucket 0 counts durations
+ * below 256 us, bucket n those in [2^(n+7), 2^(n+8)) us, and the last bucket
+ * everything from 2^22 us (about 4 s) up.
+ */
+#define LIBVLC_MEDIA_LATENCY_BUCKETS 16
+
+typedef struct libvlc_media_latency_t
+{
+    int                 i_id;
+    libvlc_track_type_t i_type;
+
+    uint64_t    queue[LIBVLC_MEDIA_LATENCY_BUCKETS];  /**< wait before decoding */
+    uint64_t    decode[LIBVLC_MEDIA_LATENCY_BUCKETS]; /**< decoding time */
+    uint64_t    output[LIBVLC_MEDIA_LATENCY_BUCKETS]; /**< wait for display */
+    uint64_t    late[LIBVLC_MEDIA_LATENCY_BUCKETS];   /**< lateness at output */
+} libvlc_media_latency_t;
+/** @}*/
+
 typedef struct libvlc_media_track_info_t
 {
     /* Codec fourcc */
@@ -440,6 +464,24 @@ LIBVLC_API libvlc_state_t libvlc_media_get_state(
 LIBVLC_API int libvlc_media_get_stats( libvlc_media_t *p_md,
                                            libvlc_media_stats_t *p_stats );
 
+/**
+ * Get the decoder latency histograms of the media tracks
+ *
+ * They are only collected with the "--latency-stats" option, for the audio
+ * and video tracks that were decoded.
+ *
+ * \version LibVLC 2.2.0 and later.
+ *
+ * \param p_md media descriptor object
+ * \param pp_latency address to store an allocated array of histograms,
+ *        one per track (must be freed with libvlc_free() by the caller) [OUT]
+ *
+ * \return the number of tracks (zero on error or without statistics)
+ */
+LIBVLC_API
+unsigned libvlc_media_get_latency( libvlc_media_t *p_md,
+                                   libvlc_media_latency_t **pp_latency );
+
 /* The following method uses libvlc_media_list_t, however, media_list usage is optionnal
  * and this is here for convenience */
 #define VLC_FORWARD_DECLARE_OBJECT(a) struct a
@@ -139,6 +139,19 @@ VLC_API void block_Init( block_t *, void *, size_t );
 VLC_API block_t *block_Alloc( size_t ) VLC_USED VLC_MALLOC;
 VLC_API block_t *block_Realloc( block_t *, ssize_t i_pre, size_t i_body ) VLC_USED;
 
+/**
+ * Statistics of the pool block_Alloc() recycles blocks of common sizes from.
+ */
+typedef struct block_pool_stats_t
+{
+    uint64_t i_hits;   /**< allocations served by recycled blocks */
+    uint64_t i_misses; /**< allocations served by the heap */
+    uint64_t i_drops;  /**< released blocks given back to the heap */
+    size_t   i_cached; /**< bytes of free blocks in all the caches */
+} block_pool_stats_t;
+
+VLC_API void block_PoolStats( block_pool_stats_t * );
+
 static inline void block_CopyProperties( block_t *dst, block_t *src )
 {
     dst->i_flags   = src->i_flags;
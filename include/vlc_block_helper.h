@@ -444,6 +444,8 @@ static inline int block_PeekOffsetBytes( block_bytestream_t *p_bytestream,
     return VLC_SUCCESS;
 }
 
+VLC_API const uint8_t *block_FindAnnexBStartcode( const uint8_t *, const uint8_t * ) VLC_USED;
+
 static inline int block_FindStartcodeFromOffset(
     block_bytestream_t *p_bytestream, size_t *pi_offset,
     const uint8_t *p_startcode, int i_startcode_length )
@@ -452,6 +454,8 @@ static inline int block_FindStartcodeFromOffset(
     int i_size = 0;
     size_t i_offset, i_offset_backup = 0;
     int i_caller_offset_backup = 0, i_match;
+    const bool b_annexb = i_startcode_length >= 3 && p_startcode[0] == 0 &&
+                          p_startcode[1] == 0 && p_startcode[2] == 1;
 
     /* Find the right place */
     i_size = *pi_offset + p_bytestream->i_offset;
@@ -478,6 +482,20 @@ static inline int block_FindStartcodeFromOffset(
     {
         for( i_offset = i_size; i_offset < p_block->i_buffer; i_offset++ )
         {
+            /* Skip to the next 00 00 01 within the block. The last two
+             * bytes may start one across the boundary: they go byte by
+             * byte like any other startcode. */
+            if( b_annexb && !i_match )
+            {
+                const uint8_t *p = block_FindAnnexBStartcode(
+                    &p_block->p_buffer[i_offset],
+                    &p_block->p_buffer[p_block->i_buffer] );
+                if( p != NULL )
+                    i_offset = p - p_block->p_buffer;
+                else if( p_block->i_buffer - i_offset > 2 )
+                    i_offset = p_block->i_buffer - 2;
+            }
+
             if( p_block->p_buffer[i_offset] == p_startcode[i_match] )
             {
                 if( !i_match )
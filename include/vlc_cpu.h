@@ -178,6 +178,8 @@ VLC_API unsigned vlc_CPU(void);
 
 # elif defined (__aarch64__)
 #  define HAVE_FPU 1
+/* Advanced SIMD is mandatory on ARMv8-A */
+#  define vlc_CPU_ARM_NEON() (1)
 
 # elif defined (__sparc__)
 #  define HAVE_FPU 1
@@ -250,6 +250,25 @@ VLC_API int filter_Blend( filter_t *, picture_t *p_dst, int i_dst_x, int i_dst_y
  */
 VLC_API void filter_DeleteBlend( filter_t * );
 
+/**
+ * Callback processing the lines [i_line_start, i_line_end[ of a picture.
+ */
+typedef void (*filter_slice_cb_t)( filter_t *, void *opaque,
+                                   int i_line_start, int i_line_end );
+
+/**
+ * It splits i_lines lines into horizontal slices and runs pf_slice on them
+ * concurrently, using the worker threads shared by the LibVLC instance and
+ * the calling thread.
+ *
+ * Slice boundaries are multiples of i_align lines (use 2 when the callback
+ * also processes vertically subsampled chroma planes). Slices must be
+ * independent: each of them must only write to its own lines.
+ *
+ * It returns once every slice has been processed.
+ */
+VLC_API void filter_RunSlices( filter_t *, filter_slice_cb_t pf_slice, void *opaque, int i_lines, int i_align );
+
 /**
  * Create a picture_t *(*)( filter_t *, picture_t * ) compatible wrapper
  * using a void (*)( filter_t *, picture_t *, picture_t * ) function
@@ -106,8 +106,14 @@ typedef struct httpd_callback_sys_t httpd_callback_sys_t;
 typedef int    (*httpd_callback_t)( httpd_callback_sys_t *, httpd_client_t *, httpd_message_t *answer, const httpd_message_t *query );
 /* register a new url */
 VLC_API httpd_url_t * httpd_UrlNew( httpd_host_t *, const char *psz_url, const char *psz_user, const char *psz_password ) VLC_USED;
-/* register callback on a url */
+/* register callback on a url
+ * A callback returning VLC_SUCCESS without setting the answer type defers
+ * its answer: it is invoked again with the same query after httpd_UrlWake(),
+ * and at least every tenth of a second, until it answers. If the client
+ * goes away first, it is invoked a last time with a NULL answer. */
 VLC_API int httpd_UrlCatch( httpd_url_t *, int i_msg, httpd_callback_t, httpd_callback_sys_t * );
+/* wake up the clients whose answer was deferred */
+VLC_API void httpd_UrlWake( httpd_url_t * );
 /* delete a url */
 VLC_API void httpd_UrlDelete( httpd_url_t * );
 
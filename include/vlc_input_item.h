@@ -280,6 +280,25 @@ VLC_API void input_item_Release(input_item_t *);
 /******************
  * Input stats
  ******************/
+
+/**
+ * Number of buckets of the decoder latency histograms. Bucket 0 counts
+ * durations below 256 us, bucket n those in [2^(n+7), 2^(n+8)) us, and the
+ * last bucket everything from 2^22 us (about 4 s) up.
+ */
+#define INPUT_LATENCY_BUCKETS 16
+
+/** Decoder latency histograms of one elementary stream */
+typedef struct input_es_latency_t
+{
+    int      i_id;  /**< ES id */
+    int      i_cat; /**< ES category */
+    uint64_t queue[INPUT_LATENCY_BUCKETS];  /**< wait in the decoder fifo */
+    uint64_t decode[INPUT_LATENCY_BUCKETS]; /**< decoding time, minus output waits */
+    uint64_t output[INPUT_LATENCY_BUCKETS]; /**< output wait until display */
+    uint64_t late[INPUT_LATENCY_BUCKETS];   /**< lateness when output */
+} input_es_latency_t;
+
 struct input_stats_t
 {
     vlc_mutex_t         lock;
@@ -297,14 +316,21 @@ struct input_stats_t
     float f_average_demux_bitrate;
     int64_t i_demux_corrupted;
     int64_t i_demux_discontinuity;
+    int64_t i_prefetch_fill;  /**< bytes fetched ahead of the demuxer */
+    int64_t i_prefetch_stall; /**< time the demuxer waited for data (us) */
 
     /* Decoders */
     int64_t i_decoded_audio;
     int64_t i_decoded_video;
+    int64_t i_decoder_contention;
 
     /* Vout */
     int64_t i_displayed_pictures;
     int64_t i_lost_pictures;
+    int64_t i_late_pictures; /**< displayed after their date */
+    int64_t i_pool_pictures;  /**< handed out by the decoder picture pool */
+    int64_t i_pool_exhausted; /**< pool requests without a free picture */
+    int64_t i_pool_used_max;  /**< most pool pictures in use at once */
 
     /* Sout */
     int64_t i_sent_packets;
@@ -314,6 +340,10 @@ struct input_stats_t
     /* Aout */
     int64_t i_played_abuffers;
     int64_t i_lost_abuffers;
+
+    /* Per ES decoder latency, only with --latency-stats */
+    int i_es_latency;
+    input_es_latency_t *p_es_latency;
 };
 
 #endif
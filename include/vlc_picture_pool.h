@@ -121,6 +121,25 @@ VLC_API picture_pool_t * picture_pool_Reserve(picture_pool_t *, int picture_coun
  */
 VLC_API int picture_pool_GetSize(picture_pool_t *);
 
+/**
+ * Picture pool usage statistics
+ */
+typedef struct {
+    unsigned get_count;       /* Pictures handed out by picture_pool_Get */
+    unsigned exhausted_count; /* picture_pool_Get calls without free picture */
+    unsigned lock_failures;   /* Free pictures refused by the lock callback */
+    int      used_max;        /* High-water mark of pictures in use */
+} picture_pool_stats_t;
+
+/**
+ * It retrieves the usage statistics of the given pool.
+ *
+ * They are meant to help sizing pools: a pool that got exhausted starved
+ * its users (e.g. decoders waiting for a picture), a pool whose high-water
+ * mark stays well below its size is oversized.
+ */
+VLC_API void picture_pool_GetStats(picture_pool_t *, picture_pool_stats_t *);
+
 
 #endif /* VLC_PICTURE_POOL_H */
 
@@ -584,6 +584,60 @@ int libvlc_media_get_stats( libvlc_media_t *p_md,
     return true;
 }
 
+/**************************************************************************
+ * Getter for decoder latency histograms
+ **************************************************************************/
+unsigned libvlc_media_get_latency( libvlc_media_t *p_md,
+                                   libvlc_media_latency_t **pp_latency )
+{
+    static_assert( LIBVLC_MEDIA_LATENCY_BUCKETS == INPUT_LATENCY_BUCKETS,
+                   "latency histogram size mismatch" );
+
+    *pp_latency = NULL;
+    if( !p_md->p_input_item || !p_md->p_input_item->p_stats )
+        return 0;
+
+    input_stats_t *p_itm_stats = p_md->p_input_item->p_stats;
+    vlc_mutex_lock( &p_itm_stats->lock );
+
+    const int i_count = p_itm_stats->i_es_latency;
+    libvlc_media_latency_t *p_tab = (i_count > 0)
+        ? calloc( i_count, sizeof(*p_tab) ) : NULL;
+    if( !p_tab ) /* no statistics, or OOM */
+    {
+        vlc_mutex_unlock( &p_itm_stats->lock );
+        return 0;
+    }
+
+    for( int i = 0; i < i_count; i++ )
+    {
+        const input_es_latency_t *p_es = &p_itm_stats->p_es_latency[i];
+        libvlc_media_latency_t *p_lat = &p_tab[i];
+
+        p_lat->i_id = p_es->i_id;
+        switch( p_es->i_cat )
+        {
+        case VIDEO_ES:
+            p_lat->i_type = libvlc_track_video;
+            break;
+        case AUDIO_ES:
+            p_lat->i_type = libvlc_track_audio;
+            break;
+        default:
+            p_lat->i_type = libvlc_track_unknown;
+            break;
+        }
+        memcpy( p_lat->queue, p_es->queue, sizeof(p_lat->queue) );
+        memcpy( p_lat->decode, p_es->decode, sizeof(p_lat->decode) );
+        memcpy( p_lat->output, p_es->output, sizeof(p_lat->output) );
+        memcpy( p_lat->late, p_es->late, sizeof(p_lat->late) );
+    }
+    vlc_mutex_unlock( &p_itm_stats->lock );
+
+    *pp_latency = p_tab;
+    return i_count;
+}
+
 /**************************************************************************
  * event_manager
  **************************************************************************/
@@ -37,6 +37,9 @@
 #endif
 
 #include <errno.h>
+#ifdef HAVE_RECVMMSG
+# include <sys/time.h>
+#endif
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_access.h>
@@ -45,6 +48,16 @@
 
 #define MTU 65535
 
+#ifdef HAVE_RECVMMSG
+/* Datagrams fetched per system call */
+# define UDP_BATCH 32
+/* Slot size for the common case (TS over UDP/RTP is 1316 bytes); larger
+ * datagrams spill into an overflow area and get copied */
+# define UDP_SLOT 2048
+/* Room for the tail of the largest datagram */
+# define UDP_OVERFLOW (MTU - UDP_SLOT)
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -75,6 +88,16 @@ struct access_sys_t
     size_t fifo_size;
     block_fifo_t *fifo;
     vlc_thread_t thread;
+#ifdef HAVE_RECVMMSG
+    block_t *slots[UDP_BATCH];
+    /* One UDP_OVERFLOW area shared by all the slots (stride 0), until a
+     * large datagram shows up; then UDP_BATCH of them, one per slot. */
+    uint8_t *overflow;
+    size_t overflow_stride;
+    uint64_t i_datagrams;
+    uint64_t i_batches;
+    uint32_t i_drops; /* kernel receive queue overflows */
+#endif
 };
 
 /*****************************************************************************
@@ -166,9 +189,34 @@ static int Open( vlc_object_t *p_this )
 
     sys->fifo_size = var_InheritInteger( p_access, "udp-buffer");
 
+#ifdef HAVE_RECVMMSG
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+        sys->slots[i] = NULL;
+    sys->overflow = malloc( UDP_OVERFLOW );
+    sys->overflow_stride = 0;
+    sys->i_datagrams = 0;
+    sys->i_batches = 0;
+    sys->i_drops = 0;
+    if( unlikely( sys->overflow == NULL ) )
+    {
+        block_FifoRelease( sys->fifo );
+        net_Close( sys->fd );
+        goto error;
+    }
+
+    const int on = 1;
+    setsockopt( sys->fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof( on ) );
+# ifdef SO_RXQ_OVFL
+    setsockopt( sys->fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof( on ) );
+# endif
+#endif
+
     if( vlc_clone( &sys->thread, ThreadRead, p_access,
                    VLC_THREAD_PRIORITY_INPUT ) )
     {
+#ifdef HAVE_RECVMMSG
+        free( sys->overflow );
+#endif
         block_FifoRelease( sys->fifo );
         net_Close( sys->fd );
 error:
@@ -189,6 +237,15 @@ static void Close( vlc_object_t *p_this )
 
     vlc_cancel( sys->thread );
     vlc_join( sys->thread, NULL );
+#ifdef HAVE_RECVMMSG
+    msg_Dbg( p_access, "received %"PRIu64" datagrams in %"PRIu64" batches, "
+             "%"PRIu32" dropped by the kernel", sys->i_datagrams,
+             sys->i_batches, sys->i_drops );
+    for( unsigned i = 0; i < UDP_BATCH; i++ )
+        if( sys->slots[i] != NULL )
+            block_Release( sys->slots[i] );
+    free( sys->overflow );
+#endif
     block_FifoRelease( sys->fifo );
     net_Close( sys->fd );
     free( sys );
@@ -230,10 +287,203 @@ static int Control( access_t *p_access, int i_query, va_list args )
 static block_t *BlockUDP( access_t *p_access )
 {
     access_sys_t *sys = p_access->p_sys;
+    block_t *p_block = block_FifoGet( sys->fifo );
+#ifdef HAVE_RECVMMSG
+    if( p_block == NULL )
+        return NULL;
+
+    /* Hand whatever is already queued over as one chain, without copying.
+     * We are the only reader so a non-zero count never blocks. */
+    block_t **pp_last = &p_block->p_next;
 
-    return block_FifoGet( sys->fifo );
+    for( unsigned i = 1;
+         i < UDP_BATCH && block_FifoCount( sys->fifo ) > 0; i++ )
+    {
+        *pp_last = block_FifoGet( sys->fifo );
+        pp_last = &(*pp_last)->p_next;
+    }
+#endif
+    return p_block;
 }
 
+#ifdef HAVE_RECVMMSG
+/* Reports SO_RXQ_OVFL increments */
+static void UpdateDrops( access_t *access, uint32_t i_count )
+{
+    access_sys_t *sys = access->p_sys;
+
+    /* The kernel only reports the socket total, once it is non-zero */
+    if( i_count != sys->i_drops )
+    {
+        msg_Warn( access, "%"PRIu32" datagrams dropped (receive buffer "
+                  "overrun)", i_count - sys->i_drops );
+        sys->i_drops = i_count;
+    }
+}
+
+/* Virtual socket receive callback for net_Read(): fetches a whole batch */
+static int RecvBatch( void *data, void *buf, size_t count )
+{
+    access_sys_t *sys = data;
+
+    return recvmmsg( sys->fd, buf, count, MSG_DONTWAIT, NULL );
+}
+
+/*****************************************************************************
+ * ThreadRead: Pull batches of packets from socket as soon as possible.
+ *****************************************************************************/
+static void* ThreadRead( void *data )
+{
+    access_t *access = data;
+    access_sys_t *sys = access->p_sys;
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH][2];
+    union
+    {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof (struct timeval))
+                 + CMSG_SPACE(sizeof (uint32_t))];
+    } control[UDP_BATCH];
+    /* net_Read() waits for the socket or the input kill, then calls this
+     * in place of read() and returns the datagram count. */
+    const v_socket_t batch = { .p_sys = sys, .pf_recv = RecvBatch };
+
+    for( ;; )
+    {
+        block_FifoPace( sys->fifo, SIZE_MAX, sys->fifo_size );
+
+        /* Refill the slots handed over by the previous batch */
+        for( unsigned i = 0; i < UDP_BATCH; i++ )
+        {
+            if( sys->slots[i] == NULL )
+            {
+                sys->slots[i] = block_Alloc( UDP_SLOT );
+                if( unlikely( sys->slots[i] == NULL ) )
+                    goto out;
+            }
+            iov[i][0].iov_base = sys->slots[i]->p_buffer;
+            iov[i][0].iov_len = UDP_SLOT;
+            iov[i][1].iov_base = sys->overflow + i * sys->overflow_stride;
+            iov[i][1].iov_len = UDP_OVERFLOW;
+            msgs[i].msg_hdr.msg_name = NULL;
+            msgs[i].msg_hdr.msg_namelen = 0;
+            msgs[i].msg_hdr.msg_iov = iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 2;
+            msgs[i].msg_hdr.msg_control = control[i].buf;
+            msgs[i].msg_hdr.msg_controllen = sizeof( control[i].buf );
+            msgs[i].msg_hdr.msg_flags = 0;
+        }
+
+        int n = net_Read( access, sys->fd, &batch, msgs, UDP_BATCH, false );
+        if( n <= 0 )
+        {
+            if( n == -1 && errno == EINTR )
+                break;
+            continue;
+        }
+
+        /* With a shared overflow area, only the last large datagram of the
+         * batch still has its tail there */
+        int last_big = -1;
+        for( int i = 0; i < n; i++ )
+            if( msgs[i].msg_len > UDP_SLOT )
+                last_big = i;
+
+        /* Map the kernel wall clock receive dates onto mdate() */
+        struct timeval now;
+        gettimeofday( &now, NULL );
+        const mtime_t i_offset = mdate() - (INT64_C(1000000) * now.tv_sec
+                                            + now.tv_usec);
+
+        block_t *p_chain = NULL, **pp_last = &p_chain;
+
+        for( int i = 0; i < n; i++ )
+        {
+            block_t *pkt = sys->slots[i];
+            size_t len = msgs[i].msg_len;
+            struct cmsghdr *cmsg;
+
+            sys->slots[i] = NULL;
+            for( cmsg = CMSG_FIRSTHDR( &msgs[i].msg_hdr ); cmsg != NULL;
+                 cmsg = CMSG_NXTHDR( &msgs[i].msg_hdr, cmsg ) )
+            {
+                if( cmsg->cmsg_level != SOL_SOCKET )
+                    continue;
+                if( cmsg->cmsg_type == SO_TIMESTAMP )
+                {
+                    struct timeval tv;
+
+                    memcpy( &tv, CMSG_DATA( cmsg ), sizeof( tv ) );
+                    pkt->i_dts = INT64_C(1000000) * tv.tv_sec
+                                   + tv.tv_usec + i_offset;
+                }
+# ifdef SO_RXQ_OVFL
+                else if( cmsg->cmsg_type == SO_RXQ_OVFL )
+                {
+                    uint32_t i_count;
+
+                    memcpy( &i_count, CMSG_DATA( cmsg ), sizeof( i_count ) );
+                    UpdateDrops( access, i_count );
+                }
+# endif
+            }
+
+            if( len > UDP_SLOT )
+            {
+                if( sys->overflow_stride == 0 && i != last_big )
+                {
+                    msg_Warn( access, "large datagram of %zu bytes lost",
+                              len );
+                    block_Release( pkt );
+                    continue;
+                }
+
+                /* Rare large datagram: reassemble it out of line */
+                block_t *big = block_Alloc( len );
+                if( unlikely( big == NULL ) )
+                {
+                    block_Release( pkt );
+                    continue;
+                }
+                memcpy( big->p_buffer, pkt->p_buffer, UDP_SLOT );
+                memcpy( big->p_buffer + UDP_SLOT, iov[i][1].iov_base,
+                        len - UDP_SLOT );
+                big->i_dts = pkt->i_dts;
+                block_Release( pkt );
+                pkt = big;
+            }
+            else
+                pkt->i_buffer = len;
+
+            *pp_last = pkt;
+            pp_last = &pkt->p_next;
+        }
+
+        if( last_big >= 0 && sys->overflow_stride == 0 )
+        {
+            /* This sender does use large datagrams: give each slot its own
+             * overflow area from now on */
+            uint8_t *overflow = realloc( sys->overflow,
+                                         UDP_BATCH * UDP_OVERFLOW );
+            if( overflow != NULL )
+            {
+                msg_Dbg( access, "large datagrams, using %u overflow areas",
+                         UDP_BATCH );
+                sys->overflow = overflow;
+                sys->overflow_stride = UDP_OVERFLOW;
+            }
+        }
+
+        sys->i_datagrams += n;
+        sys->i_batches++;
+        if( p_chain != NULL )
+            block_FifoPut( sys->fifo, p_chain );
+    }
+out:
+    block_FifoWake( sys->fifo );
+    return NULL;
+}
+#else
 /*****************************************************************************
  * ThreadRead: Pull packets from socket as soon as possible.
  *****************************************************************************/
@@ -273,3 +523,4 @@ static void* ThreadRead( void *data )
     block_FifoWake( sys->fifo );
     return NULL;
 }
+#endif
@@ -45,6 +45,7 @@
 #include <vlc_fs.h>
 #include <vlc_strings.h>
 #include <vlc_charset.h>
+#include <vlc_httpd.h>
 
 #include <gcrypt.h>
 #include <vlc_gcrypt.h>
@@ -59,6 +60,9 @@
 
 #define MAX_RENAME_RETRIES        10
 
+/* Complete segments whose parts are still announced in the playlist */
+#define PART_SEGMENTS             2
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -104,6 +108,23 @@ static void Close( vlc_object_t * );
 #define RANDOMIV_TEXT N_("Use randomized IV for encryption")
 #define RANDOMIV_LONGTEXT N_("Generate IV instead using segment-number as IV")
 
+#define PARTLEN_TEXT N_("Partial segment length")
+#define PARTLEN_LONGTEXT N_("Split segments into parts of this length (in "\
+                            "seconds) announced in the playlist as soon as "\
+                            "they are complete, for low latency. Implies "\
+                            "in-memory segments. 0 disables.")
+
+#define MEMORY_TEXT N_("Keep segments in memory")
+#define MEMORY_LONGTEXT N_("Do not write any file: segments are kept in "\
+                           "memory and served with the index by the HTTP "\
+                           "server (see --http-host and --http-port). The "\
+                           "index and the destination are then URL paths.")
+
+#define MEMORYSIZE_TEXT N_("Memory limit for segments")
+#define MEMORYSIZE_LONGTEXT N_("Maximum size (in MiB) of the segments kept "\
+                               "in memory. The oldest are dropped beyond it, "\
+                               "even if still in the index. 0 for no limit.")
+
 vlc_module_begin ()
     set_description( N_("HTTP Live streaming output") )
     set_shortname( N_("LiveHTTP" ))
@@ -133,6 +154,12 @@ vlc_module_begin ()
                 KEYFILE_TEXT, KEYFILE_LONGTEXT, true )
     add_loadfile( SOUT_CFG_PREFIX "key-loadfile", NULL,
                 KEYLOADFILE_TEXT, KEYLOADFILE_LONGTEXT, true )
+    add_float( SOUT_CFG_PREFIX "partlen", 0.,
+               PARTLEN_TEXT, PARTLEN_LONGTEXT, true )
+    add_bool( SOUT_CFG_PREFIX "memory", false,
+              MEMORY_TEXT, MEMORY_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "memory-size", 0,
+                 MEMORYSIZE_TEXT, MEMORYSIZE_LONGTEXT, true )
     set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -153,6 +180,9 @@ static const char *const ppsz_sout_options[] = {
     "key-file",
     "key-loadfile",
     "generate-iv",
+    "partlen",
+    "memory",
+    "memory-size",
     NULL
 };
 
@@ -160,6 +190,12 @@ static ssize_t Write( sout_access_out_t *, block_t * );
 static int Seek ( sout_access_out_t *, off_t  );
 static int Control( sout_access_out_t *, int, va_list );
 
+typedef struct output_part
+{
+    block_t *p_data;
+    float f_length;
+} output_part_t;
+
 typedef struct output_segment
 {
     char *psz_filename;
@@ -169,8 +205,21 @@ typedef struct output_segment
     float f_seglength;
     uint32_t i_segment_number;
     uint8_t aes_ivs[16];
+
+    /* In-memory data, made of the parts (a single one without partial
+     * segments), already encrypted if needed */
+    output_part_t *parts;
+    unsigned i_parts;
+    size_t i_size;
 } output_segment_t;
 
+/* A blocking index request, answered anyway past its deadline */
+typedef struct
+{
+    httpd_client_t *cl;
+    mtime_t i_deadline;
+} index_waiter_t;
+
 struct sout_access_out_sys_t
 {
     char *psz_cursegPath;
@@ -197,6 +246,29 @@ struct sout_access_out_sys_t
     uint8_t stuffing_bytes[16];
     ssize_t stuffing_size;
     vlc_array_t *segments_t;
+
+    /* Memory mode: segments are kept in memory and served, along with
+     * the index, through httpd */
+    bool b_memory;
+    size_t i_memsize;
+    size_t i_stored;
+    uint32_t i_etag;
+    mtime_t i_partlenm;
+    mtime_t i_part_opendts;
+    block_t *part_buffer;
+    output_segment_t *p_openseg;
+    unsigned i_index_offset;
+
+    vlc_mutex_t lock; /* segments_t and psz_index, used by httpd threads */
+    char *psz_index;
+    size_t i_index;
+    bool b_ended;
+    index_waiter_t *waiters;
+    unsigned i_waiters;
+
+    httpd_host_t *p_host;
+    httpd_url_t *p_index_url;
+    httpd_url_t *p_seg_url;
 };
 
 static int LoadCryptFile( sout_access_out_t *p_access);
@@ -204,6 +276,8 @@ static int CryptSetup( sout_access_out_t *p_access, char *keyfile );
 static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer );
 static ssize_t writeSegment( sout_access_out_t *p_access );
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys );
+static int HttpOpen( sout_access_out_t *p_access );
+static void HttpClose( sout_access_out_sys_t *p_sys );
 /*****************************************************************************
  * Open: open the file
  *****************************************************************************/
@@ -241,6 +315,13 @@ static int Open( vlc_object_t *p_this )
     p_sys->stuffing_size = 0;
     p_sys->i_opendts = VLC_TS_INVALID;
 
+    p_sys->i_partlenm = CLOCK_FREQ * var_GetFloat( p_access, SOUT_CFG_PREFIX "partlen" );
+    p_sys->b_memory = p_sys->i_partlenm > 0 ||
+                      var_GetBool( p_access, SOUT_CFG_PREFIX "memory" );
+    p_sys->i_memsize = var_GetInteger( p_access, SOUT_CFG_PREFIX "memory-size" ) << 20;
+    vlc_rand_bytes( &p_sys->i_etag, sizeof( p_sys->i_etag ) );
+    vlc_mutex_init( &p_sys->lock );
+
     p_sys->psz_indexPath = NULL;
     psz_idx = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index" );
     if ( psz_idx )
@@ -253,9 +334,12 @@ static int Open( vlc_object_t *p_this )
             free( p_sys );
             return VLC_ENOMEM;
         }
-        path_sanitize( psz_tmp );
         p_sys->psz_indexPath = psz_tmp;
-        vlc_unlink( p_sys->psz_indexPath );
+        if( !p_sys->b_memory )
+        {
+            path_sanitize( psz_tmp );
+            vlc_unlink( p_sys->psz_indexPath );
+        }
     }
 
     p_sys->psz_indexUrl = var_GetNonEmptyString( p_access, SOUT_CFG_PREFIX "index-url" );
@@ -264,6 +348,30 @@ static int Open( vlc_object_t *p_this )
 
     p_access->p_sys = p_sys;
 
+    if( p_sys->b_memory )
+    {
+        if( p_sys->i_numsegs == 0 )
+        {
+            /* Nothing goes to disk, old segments must go away */
+            p_sys->i_numsegs = 3;
+            msg_Dbg( p_access, "keeping %u segments in the index",
+                     p_sys->i_numsegs );
+        }
+        /* CBC chains across the parts: they could not be decrypted alone */
+        if( p_sys->i_partlenm > 0 && ( p_sys->psz_keyfile || p_sys->key_uri ) )
+        {
+            msg_Err( p_access, "partial segments cannot be encrypted" );
+            free( p_sys->psz_keyfile );
+            free( p_sys->key_uri );
+            vlc_mutex_destroy( &p_sys->lock );
+            vlc_array_destroy( p_sys->segments_t );
+            free( p_sys->psz_indexUrl );
+            free( p_sys->psz_indexPath );
+            free( p_sys );
+            return VLC_EGENERIC;
+        }
+    }
+
     if( p_sys->psz_keyfile && ( LoadCryptFile( p_access ) < 0 ) )
     {
         free( p_sys->psz_indexUrl );
@@ -285,6 +393,23 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_segment = 0;
     p_sys->psz_cursegPath = NULL;
 
+    /* Last, as the callbacks may run as soon as the URLs exist */
+    if( p_sys->b_memory && HttpOpen( p_access ) )
+    {
+        if( p_sys->key_uri )
+        {
+            gcry_cipher_close( p_sys->aes_ctx );
+            free( p_sys->key_uri );
+        }
+        free( p_sys->psz_keyfile );
+        vlc_mutex_destroy( &p_sys->lock );
+        vlc_array_destroy( p_sys->segments_t );
+        free( p_sys->psz_indexUrl );
+        free( p_sys->psz_indexPath );
+        free( p_sys );
+        return VLC_EGENERIC;
+    }
+
     p_access->pf_write = Write;
     p_access->pf_seek  = Seek;
     p_access->pf_control = Control;
@@ -486,6 +611,9 @@ static char *formatSegmentPath( char *psz_path, uint32_t i_seg, bool b_sanitize
 
 static void destroySegment( output_segment_t *segment )
 {
+    for( unsigned i = 0; i < segment->i_parts; i++ )
+        block_Release( segment->parts[i].p_data );
+    free( segment->parts );
     free( segment->psz_filename );
     free( segment->psz_duration );
     free( segment->psz_uri );
@@ -493,6 +621,548 @@ static void destroySegment( output_segment_t *segment )
     free( segment );
 }
 
+static bool segmentIsOpen( const sout_access_out_sys_t *p_sys )
+{
+    return p_sys->b_memory ? p_sys->p_openseg != NULL : p_sys->i_handle >= 0;
+}
+
+/************************************************************************
+ * appendString: printf at the end of a heap string (C locale)
+ ************************************************************************/
+static int appendString( char **ppsz, size_t *pi_len, const char *psz_fmt, ... )
+{
+    char *psz_tmp;
+    va_list args;
+
+    va_start( args, psz_fmt );
+    int i_tmp = us_vasprintf( &psz_tmp, psz_fmt, args );
+    va_end( args );
+    if( i_tmp < 0 )
+        return -1;
+
+    char *psz_new = realloc( *ppsz, *pi_len + i_tmp + 1 );
+    if( unlikely( !psz_new ) )
+    {
+        free( psz_tmp );
+        return -1;
+    }
+    memcpy( psz_new + *pi_len, psz_tmp, i_tmp + 1 );
+    free( psz_tmp );
+    *ppsz = psz_new;
+    *pi_len += i_tmp;
+    return 0;
+}
+
+/************************************************************************
+ * updateMemoryIndex: rebuild the in-memory index with the closed parts
+ * Must be called with p_sys->lock held.
+ ************************************************************************/
+static int updateMemoryIndex( sout_access_out_sys_t *p_sys, bool b_isend )
+{
+    const float f_partlen = (float)p_sys->i_partlenm / CLOCK_FREQ;
+    const bool b_parts = p_sys->i_partlenm > 0;
+    unsigned i_count = vlc_array_count( p_sys->segments_t );
+    const char *psz_key_uri = NULL;
+    char *psz = NULL;
+    size_t i_len = 0;
+
+    if( p_sys->i_index_offset >= i_count )
+        return 0;
+
+    output_segment_t *first = vlc_array_item_at_index( p_sys->segments_t,
+                                                       p_sys->i_index_offset );
+    if( appendString( &psz, &i_len, "#EXTM3U\n#EXT-X-TARGETDURATION:%zu\n"
+                      "#EXT-X-VERSION:%d\n#EXT-X-ALLOW-CACHE:%s\n",
+                      p_sys->i_seglen, b_parts ? 6 : 3,
+                      p_sys->b_caching ? "YES" : "NO" ) )
+        goto error;
+    if( b_parts &&
+        appendString( &psz, &i_len, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,"
+                      "PART-HOLD-BACK=%.3f\n#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+                      3 * f_partlen, f_partlen ) )
+        goto error;
+    if( appendString( &psz, &i_len, "#EXT-X-MEDIA-SEQUENCE:%"PRIu32"\n",
+                      first->i_segment_number ) )
+        goto error;
+
+    for( unsigned index = p_sys->i_index_offset; index < i_count; index++ )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, index );
+        bool b_complete = segment->psz_duration != NULL;
+
+        /* Only the latest segments are worth fetching by parts */
+        if( b_parts && ( !b_complete || index + PART_SEGMENTS + 1 >= i_count ) )
+        {
+            for( unsigned i = 0; i < segment->i_parts; i++ )
+                if( appendString( &psz, &i_len, "#EXT-X-PART:DURATION=%.3f,"
+                                  "URI=\"%s&p=%u\"%s\n",
+                                  segment->parts[i].f_length, segment->psz_uri,
+                                  i, i == 0 ? ",INDEPENDENT=YES" : "" ) )
+                    goto error;
+        }
+
+        if( !b_complete )
+            continue;
+
+        if( segment->psz_key_uri &&
+            ( !psz_key_uri || strcmp( psz_key_uri, segment->psz_key_uri ) ) )
+        {
+            char psz_iv[33] = "";
+
+            psz_key_uri = segment->psz_key_uri;
+            if( p_sys->b_generate_iv )
+                for( unsigned i = 0; i < 16; i++ )
+                    sprintf( &psz_iv[2 * i], "%02X", segment->aes_ivs[i] );
+            if( appendString( &psz, &i_len, "#EXT-X-KEY:METHOD=AES-128,"
+                              "URI=\"%s\"%s%s\n", psz_key_uri,
+                              p_sys->b_generate_iv ? ",IV=0X" : "", psz_iv ) )
+                goto error;
+        }
+
+        if( appendString( &psz, &i_len, "#EXTINF:%s,\n%s\n",
+                          segment->psz_duration, segment->psz_uri ) )
+            goto error;
+    }
+
+    if( b_isend && appendString( &psz, &i_len, STR_ENDLIST ) )
+        goto error;
+
+    free( p_sys->psz_index );
+    p_sys->psz_index = psz;
+    p_sys->i_index = i_len;
+    p_sys->b_ended = b_isend;
+    return 0;
+
+error:
+    free( psz );
+    return -1;
+}
+
+/************************************************************************
+ * closePart: move the buffered data into a new part of the open segment
+ ************************************************************************/
+static void closePart( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys,
+                       mtime_t i_enddts )
+{
+    output_segment_t *segment = p_sys->p_openseg;
+    block_t *p_data = p_sys->part_buffer;
+
+    if( p_data == NULL )
+        return;
+    p_sys->part_buffer = NULL;
+
+    p_data = block_ChainGather( p_data );
+    if( unlikely( p_data == NULL ) )
+        return;
+
+    /* httpd threads read the parts under the lock */
+    vlc_mutex_lock( &p_sys->lock );
+    output_part_t *parts = realloc( segment->parts,
+                                    ( segment->i_parts + 1 ) * sizeof( *parts ) );
+    if( unlikely( parts == NULL ) )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        block_Release( p_data );
+        return;
+    }
+    segment->parts = parts;
+    parts[segment->i_parts].p_data = p_data;
+    parts[segment->i_parts].f_length =
+        (float)( i_enddts - p_sys->i_part_opendts ) / CLOCK_FREQ;
+    segment->i_parts++;
+    segment->i_size += p_data->i_buffer;
+    p_sys->i_stored += p_data->i_buffer;
+    if( p_sys->i_partlenm > 0 )
+        updateMemoryIndex( p_sys, false );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    p_sys->i_part_opendts = i_enddts;
+    if( p_sys->i_partlenm == 0 )
+        return;
+    httpd_UrlWake( p_sys->p_index_url );
+    msg_Dbg( p_access, "LiveHttpPartComplete: %"PRIu32".%u",
+             segment->i_segment_number, segment->i_parts - 1 );
+}
+
+/************************************************************************
+ * getQueryNumber: find an unsigned number argument in a query string
+ ************************************************************************/
+static bool getQueryNumber( const uint8_t *psz_args, const char *psz_name,
+                            unsigned *pi_value )
+{
+    const char *psz = (const char *)psz_args;
+    size_t i_name = strlen( psz_name );
+
+    while( psz != NULL && *psz )
+    {
+        if( !strncmp( psz, psz_name, i_name ) && psz[i_name] == '=' )
+        {
+            char *psz_end;
+            unsigned long i_value = strtoul( psz + i_name + 1, &psz_end, 10 );
+
+            if( psz_end == psz + i_name + 1 )
+                return false;
+            *pi_value = i_value;
+            return true;
+        }
+        psz = strchr( psz, '&' );
+        if( psz != NULL )
+            psz++;
+    }
+    return false;
+}
+
+/* Must be called with p_sys->lock held */
+static output_segment_t *findSegment( sout_access_out_sys_t *p_sys,
+                                      uint32_t i_segment )
+{
+    for( int i = vlc_array_count( p_sys->segments_t ) - 1; i >= 0; i-- )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, i );
+        if( segment->i_segment_number == i_segment )
+            return segment;
+    }
+    return NULL;
+}
+
+/* Returns the deadline of the blocking index request of a client, starting
+ * it on the first call. Must be called with p_sys->lock held. */
+static mtime_t waiterDeadline( sout_access_out_sys_t *p_sys,
+                               httpd_client_t *cl, mtime_t now )
+{
+    /* Entries leave when their client is answered or goes away, so that
+     * a new client at the same address never inherits one */
+    for( unsigned i = 0; i < p_sys->i_waiters; i++ )
+        if( p_sys->waiters[i].cl == cl )
+            return p_sys->waiters[i].i_deadline;
+
+    /* Three part (or segment) durations, as HLS servers should */
+    mtime_t i_target = p_sys->i_partlenm > 0 ? p_sys->i_partlenm
+                                             : p_sys->i_seglenm;
+    mtime_t i_deadline = now + 3 * i_target;
+    index_waiter_t *waiters = realloc( p_sys->waiters, sizeof( *waiters )
+                                       * ( p_sys->i_waiters + 1 ) );
+    if( likely( waiters != NULL ) )
+    {
+        waiters[p_sys->i_waiters].cl = cl;
+        waiters[p_sys->i_waiters].i_deadline = i_deadline;
+        p_sys->waiters = waiters;
+        p_sys->i_waiters++;
+    }
+    return i_deadline;
+}
+
+/* Must be called with p_sys->lock held */
+static void waiterRemove( sout_access_out_sys_t *p_sys, httpd_client_t *cl )
+{
+    for( unsigned i = 0; i < p_sys->i_waiters; i++ )
+        if( p_sys->waiters[i].cl == cl )
+        {
+            p_sys->waiters[i] = p_sys->waiters[--p_sys->i_waiters];
+            return;
+        }
+}
+
+static void answerInit( httpd_message_t *answer, int i_status )
+{
+    answer->i_proto  = HTTPD_PROTO_HTTP;
+    answer->i_version= 1;
+    answer->i_type   = HTTPD_MSG_ANSWER;
+    answer->i_status = i_status;
+}
+
+/*****************************************************************************
+ * IndexCallback: serve the index, blocking until the requested segment
+ * (_HLS_msn) or part (_HLS_part) is in, or answering 503 if it takes more
+ * than three part durations
+ *****************************************************************************/
+static int IndexCallback( httpd_callback_sys_t *p_cb, httpd_client_t *cl,
+                          httpd_message_t *answer, const httpd_message_t *query )
+{
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)p_cb;
+    unsigned i_msn, i_part;
+
+    if( query == NULL )
+        return VLC_SUCCESS;
+    if( answer == NULL )
+    {
+        /* The client went away while its answer was deferred */
+        vlc_mutex_lock( &p_sys->lock );
+        waiterRemove( p_sys, cl );
+        vlc_mutex_unlock( &p_sys->lock );
+        return VLC_SUCCESS;
+    }
+
+    vlc_mutex_lock( &p_sys->lock );
+    if( getQueryNumber( query->psz_args, "_HLS_msn", &i_msn ) && !p_sys->b_ended )
+    {
+        output_segment_t *segment = findSegment( p_sys, i_msn );
+        bool b_part = getQueryNumber( query->psz_args, "_HLS_part", &i_part );
+
+        if( i_msn > p_sys->i_segment + 2 )
+        {
+            vlc_mutex_unlock( &p_sys->lock );
+            answerInit( answer, 400 );
+            httpd_MsgAdd( answer, "Content-Length", "0" );
+            return VLC_SUCCESS;
+        }
+
+        if( i_msn >= p_sys->i_segment && ( segment == NULL ||
+            ( segment->psz_duration == NULL &&
+              ( !b_part || i_part >= segment->i_parts ) ) ) )
+        {
+            mtime_t now = mdate();
+
+            if( now < waiterDeadline( p_sys, cl, now ) )
+            {
+                /* Not there yet: defer the answer until the next part */
+                vlc_mutex_unlock( &p_sys->lock );
+                return VLC_SUCCESS;
+            }
+
+            /* The stream stalled */
+            waiterRemove( p_sys, cl );
+            vlc_mutex_unlock( &p_sys->lock );
+            answerInit( answer, 503 );
+            httpd_MsgAdd( answer, "Content-Length", "0" );
+            return VLC_SUCCESS;
+        }
+    }
+    waiterRemove( p_sys, cl );
+
+    answerInit( answer, p_sys->psz_index ? 200 : 404 );
+    if( p_sys->psz_index && query->i_type != HTTPD_MSG_HEAD )
+    {
+        answer->p_body = malloc( p_sys->i_index );
+        if( likely( answer->p_body != NULL ) )
+        {
+            memcpy( answer->p_body, p_sys->psz_index, p_sys->i_index );
+            answer->i_body = p_sys->i_index;
+        }
+    }
+    httpd_MsgAdd( answer, "Content-Length", "%zu",
+                  p_sys->psz_index ? p_sys->i_index : 0 );
+    vlc_mutex_unlock( &p_sys->lock );
+
+    httpd_MsgAdd( answer, "Content-Type", "application/vnd.apple.mpegurl" );
+    httpd_MsgAdd( answer, "Cache-Control", "no-cache" );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * getRange: parse a single byte range request into [*pi_start, *pi_end)
+ * Returns 1 for a range, 0 to serve everything, -1 if unsatisfiable.
+ *****************************************************************************/
+static int getRange( const char *psz_range, size_t i_size,
+                     size_t *pi_start, size_t *pi_end )
+{
+    unsigned long long i_first, i_last;
+    char *psz_end;
+
+    *pi_start = 0;
+    *pi_end = i_size;
+
+    /* Multiple ranges are not worth it: the whole body is valid too */
+    if( psz_range == NULL || strncasecmp( psz_range, "bytes=", 6 ) ||
+        strchr( psz_range, ',' ) )
+        return 0;
+    psz_range += 6;
+
+    if( *psz_range == '-' )
+    {
+        /* Suffix: the last bytes */
+        i_last = strtoull( psz_range + 1, &psz_end, 10 );
+        if( psz_end == psz_range + 1 || *psz_end )
+            return 0;
+        if( i_last == 0 || i_size == 0 )
+            return -1;
+        if( i_last < i_size )
+            *pi_start = i_size - i_last;
+        return 1;
+    }
+
+    i_first = strtoull( psz_range, &psz_end, 10 );
+    if( psz_end == psz_range || *psz_end != '-' )
+        return 0;
+    psz_range = psz_end + 1;
+    if( *psz_range )
+    {
+        i_last = strtoull( psz_range, &psz_end, 10 );
+        if( psz_end == psz_range || *psz_end || i_last < i_first )
+            return 0;
+        if( i_last < i_size )
+            *pi_end = i_last + 1;
+    }
+    if( i_first >= i_size )
+        return -1;
+    *pi_start = i_first;
+    return 1;
+}
+
+/*****************************************************************************
+ * SegmentCallback: serve a complete segment (n=) or one of its parts (p=)
+ *****************************************************************************/
+static int SegmentCallback( httpd_callback_sys_t *p_cb, httpd_client_t *cl,
+                            httpd_message_t *answer, const httpd_message_t *query )
+{
+    sout_access_out_sys_t *p_sys = (sout_access_out_sys_t *)p_cb;
+    unsigned i_segment, i_part, i_first = 0, i_count = 0;
+    size_t i_size = 0, i_start, i_end;
+    char psz_etag[32];
+    int i_range;
+    VLC_UNUSED( cl );
+
+    if( answer == NULL || query == NULL )
+        return VLC_SUCCESS;
+
+    vlc_mutex_lock( &p_sys->lock );
+    output_segment_t *segment = NULL;
+    if( getQueryNumber( query->psz_args, "n", &i_segment ) )
+        segment = findSegment( p_sys, i_segment );
+
+    /* Closed parts and complete segments never change: the stream
+     * instance and their numbers make a strong validator */
+    if( segment != NULL && getQueryNumber( query->psz_args, "p", &i_part ) )
+    {
+        if( i_part < segment->i_parts )
+        {
+            i_first = i_part;
+            i_count = 1;
+            snprintf( psz_etag, sizeof( psz_etag ), "\"%08"PRIx32"-%u.%u\"",
+                      p_sys->i_etag, i_segment, i_part );
+        }
+    }
+    else if( segment != NULL && segment->psz_duration != NULL )
+    {
+        i_count = segment->i_parts;
+        snprintf( psz_etag, sizeof( psz_etag ), "\"%08"PRIx32"-%u\"",
+                  p_sys->i_etag, i_segment );
+    }
+
+    if( i_count == 0 )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        answerInit( answer, 404 );
+        httpd_MsgAdd( answer, "Content-Length", "0" );
+        return VLC_SUCCESS;
+    }
+
+    for( unsigned i = i_first; i < i_first + i_count; i++ )
+        i_size += segment->parts[i].p_data->i_buffer;
+
+    const char *psz_match = httpd_MsgGet( query, "If-None-Match" );
+    if( psz_match != NULL && strstr( psz_match, psz_etag ) != NULL )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        answerInit( answer, 304 );
+        httpd_MsgAdd( answer, "ETag", "%s", psz_etag );
+        httpd_MsgAdd( answer, "Content-Length", "0" );
+        return VLC_SUCCESS;
+    }
+
+    i_range = getRange( httpd_MsgGet( query, "Range" ), i_size,
+                        &i_start, &i_end );
+    if( i_range < 0 )
+    {
+        vlc_mutex_unlock( &p_sys->lock );
+        answerInit( answer, 416 );
+        httpd_MsgAdd( answer, "Content-Range", "bytes */%zu", i_size );
+        httpd_MsgAdd( answer, "Content-Length", "0" );
+        return VLC_SUCCESS;
+    }
+
+    if( query->i_type != HTTPD_MSG_HEAD && i_end > i_start )
+    {
+        answer->p_body = malloc( i_end - i_start );
+        if( unlikely( answer->p_body == NULL ) )
+        {
+            vlc_mutex_unlock( &p_sys->lock );
+            answerInit( answer, 500 );
+            httpd_MsgAdd( answer, "Content-Length", "0" );
+            return VLC_SUCCESS;
+        }
+        answer->i_body = i_end - i_start;
+
+        /* Copy the requested bytes out of the parts */
+        uint8_t *p = answer->p_body;
+        size_t i_offset = 0;
+        for( unsigned i = i_first; i < i_first + i_count; i++ )
+        {
+            const block_t *p_data = segment->parts[i].p_data;
+            size_t i_from = __MAX( i_start, i_offset );
+            size_t i_to = __MIN( i_end, i_offset + p_data->i_buffer );
+
+            if( i_from < i_to )
+            {
+                memcpy( p, p_data->p_buffer + i_from - i_offset, i_to - i_from );
+                p += i_to - i_from;
+            }
+            i_offset += p_data->i_buffer;
+        }
+    }
+    vlc_mutex_unlock( &p_sys->lock );
+
+    answerInit( answer, i_range ? 206 : 200 );
+    if( i_range )
+        httpd_MsgAdd( answer, "Content-Range", "bytes %zu-%zu/%zu",
+                      i_start, i_end - 1, i_size );
+    httpd_MsgAdd( answer, "Content-Length", "%zu", i_end - i_start );
+    httpd_MsgAdd( answer, "Content-Type", "video/MP2T" );
+    httpd_MsgAdd( answer, "Accept-Ranges", "bytes" );
+    httpd_MsgAdd( answer, "ETag", "%s", psz_etag );
+    httpd_MsgAdd( answer, "Cache-Control", "max-age=%zu", 3 * p_sys->i_seglen );
+    return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * HttpOpen: register the index and segment URLs on the HTTP host
+ *****************************************************************************/
+static int HttpOpen( sout_access_out_t *p_access )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+
+    if( !p_sys->psz_indexPath )
+    {
+        msg_Err( p_access, "in-memory segments need an index URL path" );
+        return VLC_EGENERIC;
+    }
+
+    p_sys->p_host = vlc_http_HostNew( VLC_OBJECT(p_access) );
+    if( p_sys->p_host == NULL )
+        return VLC_EGENERIC;
+
+    p_sys->p_index_url = httpd_UrlNew( p_sys->p_host, p_sys->psz_indexPath,
+                                       NULL, NULL );
+    p_sys->p_seg_url = httpd_UrlNew( p_sys->p_host, p_access->psz_path,
+                                     NULL, NULL );
+    if( p_sys->p_index_url == NULL || p_sys->p_seg_url == NULL )
+    {
+        msg_Err( p_access, "cannot register %s or %s", p_sys->psz_indexPath,
+                 p_access->psz_path );
+        HttpClose( p_sys );
+        return VLC_EGENERIC;
+    }
+
+    httpd_callback_sys_t *p_cb = (httpd_callback_sys_t *)p_sys;
+    httpd_UrlCatch( p_sys->p_index_url, HTTPD_MSG_GET, IndexCallback, p_cb );
+    httpd_UrlCatch( p_sys->p_index_url, HTTPD_MSG_HEAD, IndexCallback, p_cb );
+    httpd_UrlCatch( p_sys->p_seg_url, HTTPD_MSG_GET, SegmentCallback, p_cb );
+    httpd_UrlCatch( p_sys->p_seg_url, HTTPD_MSG_HEAD, SegmentCallback, p_cb );
+
+    msg_Dbg( p_access, "serving index %s and segments %s",
+             p_sys->psz_indexPath, p_access->psz_path );
+    return VLC_SUCCESS;
+}
+
+static void HttpClose( sout_access_out_sys_t *p_sys )
+{
+    if( p_sys->p_index_url )
+        httpd_UrlDelete( p_sys->p_index_url );
+    if( p_sys->p_seg_url )
+        httpd_UrlDelete( p_sys->p_seg_url );
+    httpd_HostDelete( p_sys->p_host );
+}
+
 /************************************************************************
  * segmentAmountNeeded: check that playlist has atleast 3*p_sys->i_seglength of segments
  * return how many segments are needed for that (max of p_sys->i_segment )
@@ -549,12 +1219,15 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
     else
     {
         unsigned numsegs = segmentAmountNeeded( p_sys );
+        /* The memory limit may have dropped segments still listed */
+        if( numsegs > (unsigned)vlc_array_count( p_sys->segments_t ) )
+            numsegs = vlc_array_count( p_sys->segments_t );
         i_firstseg = ( p_sys->i_segment - numsegs ) + 1;
         i_index_offset = vlc_array_count( p_sys->segments_t ) - numsegs;
     }
 
-    // First update index
-    if ( p_sys->psz_indexPath )
+    // First update index, in memory it is done after deletion
+    if ( p_sys->psz_indexPath && !p_sys->b_memory )
     {
         int val;
         FILE *fp;
@@ -656,7 +1329,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
 
     // Then take care of deletion
     // Try to follow pantos draft 11 section 6.2.2
-    while( p_sys->b_delsegs && p_sys->i_numsegs &&
+    while( ( p_sys->b_delsegs || p_sys->b_memory ) && p_sys->i_numsegs &&
            isFirstItemRemovable( p_sys, i_firstseg, i_index_offset )
          )
     {
@@ -669,10 +1342,31 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
              vlc_unlink( segment->psz_filename );
          }
 
+         p_sys->i_stored -= segment->i_size;
          destroySegment( segment );
          i_index_offset -=1;
     }
 
+    /* Beyond the memory limit, even listed segments go, but for the one
+     * just closed */
+    while( p_sys->b_memory && p_sys->i_memsize > 0 &&
+           p_sys->i_stored > p_sys->i_memsize &&
+           vlc_array_count( p_sys->segments_t ) > 1 )
+    {
+        output_segment_t *segment = vlc_array_item_at_index( p_sys->segments_t, 0 );
+        msg_Warn( p_access, "memory limit reached, dropping segment %"PRIu32,
+                  segment->i_segment_number );
+        vlc_array_remove( p_sys->segments_t, 0 );
+        p_sys->i_stored -= segment->i_size;
+        destroySegment( segment );
+        if( i_index_offset > 0 )
+            i_index_offset -= 1;
+    }
+    p_sys->i_index_offset = i_index_offset;
+
+    if ( p_sys->b_memory && updateMemoryIndex( p_sys, b_isend ) )
+        msg_Err( p_access, "cannot update LiveHttp index" );
+
 
     return 0;
 }
@@ -682,7 +1376,7 @@ static int updateIndexAndDel( sout_access_out_t *p_access, sout_access_out_sys_t
  *****************************************************************************/
 static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys, bool b_isend )
 {
-    if ( p_sys->i_handle >= 0 )
+    if ( segmentIsOpen( p_sys ) )
     {
         output_segment_t *segment = (output_segment_t *)vlc_array_item_at_index( p_sys->segments_t, vlc_array_count( p_sys->segments_t ) - 1 );
 
@@ -694,6 +1388,13 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
 
             if( err ) {
                msg_Err( p_access, "Couldn't encrypt 16 bytes: %s", gpg_strerror(err) );
+            } else if( p_sys->b_memory ) {
+                block_t *p_pad = block_Alloc( 16 );
+                if( likely( p_pad != NULL ) )
+                {
+                    memcpy( p_pad->p_buffer, p_sys->stuffing_bytes, 16 );
+                    block_ChainAppend( &p_sys->part_buffer, p_pad );
+                }
             } else {
             int ret = write( p_sys->i_handle, p_sys->stuffing_bytes, 16 );
             if( ret != 16 )
@@ -703,11 +1404,22 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
         }
 
 
-        close( p_sys->i_handle );
-        p_sys->i_handle = -1;
+        if( p_sys->b_memory )
+        {
+            closePart( p_access, p_sys, p_sys->i_opendts +
+                       (mtime_t)( p_sys->f_seglen * CLOCK_FREQ ) );
+            p_sys->p_openseg = NULL;
+        }
+        else
+        {
+            close( p_sys->i_handle );
+            p_sys->i_handle = -1;
+        }
 
+        vlc_mutex_lock( &p_sys->lock );
         if( ! ( us_asprintf( &segment->psz_duration, "%.2f", p_sys->f_seglen ) ) )
         {
+            vlc_mutex_unlock( &p_sys->lock );
             msg_Err( p_access, "Couldn't set duration on closed segment");
             return;
         }
@@ -722,6 +1434,10 @@ static void closeCurrentSegment( sout_access_out_t *p_access, sout_access_out_sy
             p_sys->psz_cursegPath = 0;
             updateIndexAndDel( p_access, p_sys, b_isend );
         }
+        vlc_mutex_unlock( &p_sys->lock );
+
+        if( p_sys->b_memory )
+            httpd_UrlWake( p_sys->p_index_url );
     }
 }
 
@@ -771,6 +1487,9 @@ static void Close( vlc_object_t * p_this )
 
     closeCurrentSegment( p_access, p_sys, true );
 
+    if( p_sys->b_memory )
+        HttpClose( p_sys );
+
     if( p_sys->key_uri )
     {
         gcry_cipher_close( p_sys->aes_ctx );
@@ -791,6 +1510,10 @@ static void Close( vlc_object_t * p_this )
     }
     vlc_array_destroy( p_sys->segments_t );
 
+    block_ChainRelease( p_sys->part_buffer );
+    free( p_sys->psz_index );
+    free( p_sys->waiters );
+    vlc_mutex_destroy( &p_sys->lock );
     free( p_sys->psz_indexUrl );
     free( p_sys->psz_indexPath );
     free( p_sys );
@@ -823,7 +1546,7 @@ static int Control( sout_access_out_t *p_access, int i_query, va_list args )
  *****************************************************************************/
 static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t *p_sys )
 {
-    int fd;
+    int fd = -1;
 
     uint32_t i_newseg = p_sys->i_segment + 1;
 
@@ -833,26 +1556,39 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         return -1;
 
     segment->i_segment_number = i_newseg;
-    segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg, true );
-    char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
-    segment->psz_uri = formatSegmentPath( psz_idxFormat , i_newseg, false );
 
-    if ( unlikely( !segment->psz_filename ) )
+    if( p_sys->b_memory )
     {
-        msg_Err( p_access, "Format segmentpath failed");
-        return -1;
+        /* The segments are served from the URL registered on the access
+         * path, numbered in the query */
+        if( asprintf( &segment->psz_uri, "%s?n=%"PRIu32, p_access->psz_path,
+                      i_newseg ) < 0 )
+        {
+            free( segment );
+            return -1;
+        }
     }
-
-    fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
-                     O_TRUNC, 0666 );
-    if ( fd == -1 )
+    else
     {
-        msg_Err( p_access, "cannot open `%s' (%m)", segment->psz_filename );
-        destroySegment( segment );
-        return -1;
-    }
+        segment->psz_filename = formatSegmentPath( p_access->psz_path, i_newseg, true );
+        char *psz_idxFormat = p_sys->psz_indexUrl ? p_sys->psz_indexUrl : p_access->psz_path;
+        segment->psz_uri = formatSegmentPath( psz_idxFormat , i_newseg, false );
 
-    vlc_array_append( p_sys->segments_t, segment);
+        if ( unlikely( !segment->psz_filename ) )
+        {
+            msg_Err( p_access, "Format segmentpath failed");
+            return -1;
+        }
+
+        fd = vlc_open( segment->psz_filename, O_WRONLY | O_CREAT | O_LARGEFILE |
+                         O_TRUNC, 0666 );
+        if ( fd == -1 )
+        {
+            msg_Err( p_access, "cannot open `%s' (%m)", segment->psz_filename );
+            destroySegment( segment );
+            return -1;
+        }
+    }
 
     if( p_sys->psz_keyfile )
     {
@@ -866,11 +1602,23 @@ static ssize_t openNextFile( sout_access_out_t *p_access, sout_access_out_sys_t
         if( p_sys->b_generate_iv )
             memcpy( segment->aes_ivs, p_sys->aes_ivs, sizeof(uint8_t)*16 );
     }
+
+    vlc_mutex_lock( &p_sys->lock );
+    vlc_array_append( p_sys->segments_t, segment);
+    p_sys->i_segment = i_newseg;
+    vlc_mutex_unlock( &p_sys->lock );
+
+    if( p_sys->b_memory )
+    {
+        msg_Dbg( p_access, "Successfully opened livehttp segment: %s", segment->psz_uri );
+        p_sys->psz_cursegPath = strdup( segment->psz_uri );
+        p_sys->p_openseg = segment;
+        return 0;
+    }
     msg_Dbg( p_access, "Successfully opened livehttp file: %s (%"PRIu32")" , segment->psz_filename, i_newseg );
 
     p_sys->psz_cursegPath = strdup(segment->psz_filename);
     p_sys->i_handle = fd;
-    p_sys->i_segment = i_newseg;
     return fd;
 }
 /*****************************************************************************
@@ -881,7 +1629,7 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     block_t *output = p_sys->block_buffer;
 
-    if( p_sys->i_handle > 0 &&
+    if( segmentIsOpen( p_sys ) &&
         ( ( p_buffer->i_dts - p_sys->i_opendts +
           ( p_buffer->i_length * CLOCK_FREQ / INT64_C(1000000) )
         ) >= p_sys->i_seglenm ) )
@@ -889,13 +1637,14 @@ static int CheckSegmentChange( sout_access_out_t *p_access, block_t *p_buffer )
         closeCurrentSegment( p_access, p_sys, false );
      }
 
-    if ( p_sys->i_handle < 0 )
+    if ( !segmentIsOpen( p_sys ) )
     {
         p_sys->i_opendts = output ? output->i_dts : p_buffer->i_dts;
         //For first segment we can get negative duration otherwise...?
         if( ( p_sys->i_opendts != VLC_TS_INVALID ) &&
             ( p_buffer->i_dts < p_sys->i_opendts ) )
             p_sys->i_opendts = p_buffer->i_dts;
+        p_sys->i_part_opendts = p_sys->i_opendts;
 
         if ( openNextFile( p_access, p_sys ) < 0 )
            return VLC_EGENERIC;
@@ -942,6 +1691,22 @@ static ssize_t writeSegment( sout_access_out_t *p_access )
             crypted=true;
 
         }
+        if( p_sys->b_memory )
+        {
+            /* Kept in memory until Write() or the segment end closes a part */
+            block_t *p_next = output->p_next;
+
+            p_sys->f_seglen =
+                (float)(output->i_length / INT64_C(1000000) ) +
+                (float)(output->i_dts - p_sys->i_opendts) / CLOCK_FREQ;
+            i_write += output->i_buffer;
+            output->p_next = NULL;
+            block_ChainAppend( &p_sys->part_buffer, output );
+            output = p_next;
+            crypted = false;
+            continue;
+        }
+
         ssize_t val = write( p_sys->i_handle, output->p_buffer, output->i_buffer );
         if ( val == -1 )
         {
@@ -981,6 +1746,28 @@ static ssize_t Write( sout_access_out_t *p_access, block_t *p_buffer )
     block_t *p_temp;
     while( p_buffer )
     {
+        if( p_sys->i_partlenm > 0 && p_sys->p_openseg )
+        {
+            /* Parts need not start on a keyframe, only segments do: the
+             * buffered data goes to the open segment before it may close */
+            bool b_partend = p_buffer->i_dts + p_buffer->i_length
+                             - p_sys->i_part_opendts > p_sys->i_partlenm;
+
+            if( b_partend || p_sys->b_splitanywhere ||
+                ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) )
+            {
+                ssize_t writevalue = writeSegment( p_access );
+                if( unlikely( writevalue < 0 ) )
+                {
+                    block_ChainRelease ( p_buffer );
+                    return -1;
+                }
+                i_write += writevalue;
+            }
+            if( b_partend )
+                closePart( p_access, p_sys, p_buffer->i_dts );
+        }
+
         if( ( p_sys->b_splitanywhere  || ( p_buffer->i_flags & BLOCK_FLAG_HEADER ) ) )
         {
             if( unlikely( CheckSegmentChange( p_access, p_buffer ) != VLC_SUCCESS ) )
@@ -52,6 +52,8 @@
 #include <vlc_network.h>
 
 #define MAX_EMPTY_BLOCKS 200
+/* Largest number of packets sent in one go */
+#define MAX_GROUP 64
 
 /*****************************************************************************
  * Module descriptor
@@ -72,6 +74,12 @@ static void Close( vlc_object_t * );
                           "of packets that will be sent at a time. It " \
                           "helps reducing the scheduling load on " \
                           "heavily-loaded systems." )
+#define RATE_TEXT N_("Output rate (bits/s)")
+#define RATE_LONGTEXT N_("Shape the output to this constant rate, spacing " \
+                         "packets evenly instead of sending them in bursts " \
+                         "at their own dates. It must not be lower than " \
+                         "the mux rate. Packets are then not grouped. " \
+                         "0 disables shaping." )
 
 vlc_module_begin ()
     set_description( N_("UDP stream output") )
@@ -81,6 +89,7 @@ vlc_module_begin ()
     add_integer( SOUT_CFG_PREFIX "caching", DEFAULT_PTS_DELAY / 1000, CACHING_TEXT, CACHING_LONGTEXT, true )
     add_integer( SOUT_CFG_PREFIX "group", 1, GROUP_TEXT, GROUP_LONGTEXT,
                                  true )
+    add_integer( SOUT_CFG_PREFIX "rate", 0, RATE_TEXT, RATE_LONGTEXT, true )
 
     set_capability( "sout access", 0 )
     add_shortcut( "udp" )
@@ -94,6 +103,7 @@ vlc_module_end ()
 static const char *const ppsz_sout_options[] = {
     "caching",
     "group",
+    "rate",
     NULL
 };
 
@@ -394,6 +404,51 @@ static block_t *NewUDPPacket( sout_access_out_t *p_access, mtime_t i_dts)
     return p_buffer;
 }
 
+static void ReleaseGroup( void *data )
+{
+    block_ChainRelease( *(block_t **)data );
+}
+
+/*****************************************************************************
+ * SendGroup: send a chain of packets, in a single system call if possible
+ *****************************************************************************/
+static void SendGroup( sout_access_out_t *p_access, block_t *p_group )
+{
+    sout_access_out_sys_t *p_sys = p_access->p_sys;
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[MAX_GROUP];
+    struct iovec iov[MAX_GROUP];
+    unsigned i_count = 0;
+
+    for( block_t *p_pk = p_group; p_pk != NULL; p_pk = p_pk->p_next )
+    {
+        iov[i_count].iov_base = p_pk->p_buffer;
+        iov[i_count].iov_len = p_pk->i_buffer;
+        memset( &msgs[i_count].msg_hdr, 0, sizeof( msgs[i_count].msg_hdr ) );
+        msgs[i_count].msg_hdr.msg_iov = &iov[i_count];
+        msgs[i_count].msg_hdr.msg_iovlen = 1;
+        i_count++;
+    }
+
+    for( unsigned i_sent = 0; i_sent < i_count; )
+    {
+        int val = sendmmsg( p_sys->i_handle, msgs + i_sent, i_count - i_sent,
+                            0 );
+        if( val == -1 )
+        {
+            /* Only the first packet failed: skip it */
+            msg_Warn( p_access, "send error: %m" );
+            val = 1;
+        }
+        i_sent += val;
+    }
+#else
+    for( block_t *p_pk = p_group; p_pk != NULL; p_pk = p_pk->p_next )
+        if( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
+            msg_Warn( p_access, "send error: %m" );
+#endif
+}
+
 /*****************************************************************************
  * ThreadWrite: Write a packet on the network at the good time.
  *****************************************************************************/
@@ -402,68 +457,104 @@ static void* ThreadWrite( void *data )
     sout_access_out_t *p_access = data;
     sout_access_out_sys_t *p_sys = p_access->p_sys;
     mtime_t i_date_last = -1;
-    const unsigned i_group = var_GetInteger( p_access,
-                                             SOUT_CFG_PREFIX "group" );
-    mtime_t i_to_send = i_group;
+    unsigned i_group = var_GetInteger( p_access, SOUT_CFG_PREFIX "group" );
+    const int64_t i_rate = var_GetInteger( p_access, SOUT_CFG_PREFIX "rate" );
     unsigned i_dropped_packets = 0;
+    mtime_t i_shaper = 0; /* earliest date the token bucket allows */
 
-    for (;;)
+    if( i_group < 1 )
+        i_group = 1;
+    if( i_group > MAX_GROUP )
+        i_group = MAX_GROUP;
+    if( i_rate > 0 )
     {
-        block_t *p_pk = block_FifoGet( p_sys->p_fifo );
-        mtime_t       i_date, i_sent;
+        /* Shaping spaces every packet: a group would leave in a burst */
+        msg_Dbg( p_access, "shaping output to %"PRId64" bits/s", i_rate );
+        i_group = 1;
+    }
 
-        i_date = p_sys->i_caching + p_pk->i_dts;
-        if( i_date_last > 0 )
+    for (;;)
+    {
+        block_t *p_group = NULL, **pp_last = &p_group;
+        unsigned i_count = 0;
+        size_t i_size = 0;
+        mtime_t i_date = 0, i_send_date = 0, i_sent;
+
+        vlc_cleanup_push( ReleaseGroup, &p_group );
+        /* Take up to i_group packets, without waiting for more than the
+         * first one, and stop at a clock reference */
+        do
         {
-            if( i_date - i_date_last > 2000000 )
+            block_t *p_pk = block_FifoGet( p_sys->p_fifo );
+            mtime_t i_pk_date = p_sys->i_caching + p_pk->i_dts;
+
+            if( i_date_last > 0 )
             {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
-                             i_date - i_date_last );
+                if( i_pk_date - i_date_last > 2000000 )
+                {
+                    if( !i_dropped_packets )
+                        msg_Dbg( p_access, "mmh, hole (%"PRId64" > 2s) -> drop",
+                                 i_pk_date - i_date_last );
 
-                block_FifoPut( p_sys->p_empty_blocks, p_pk );
+                    block_FifoPut( p_sys->p_empty_blocks, p_pk );
 
-                i_date_last = i_date;
-                i_dropped_packets++;
-                continue;
-            }
-            else if( i_date - i_date_last < -1000 )
-            {
-                if( !i_dropped_packets )
-                    msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
-                             i_date_last - i_date );
+                    i_date_last = i_pk_date;
+                    i_dropped_packets++;
+                    continue;
+                }
+                else if( i_pk_date - i_date_last < -1000 )
+                {
+                    if( !i_dropped_packets )
+                        msg_Dbg( p_access, "mmh, packets in the past (%"PRId64")",
+                                 i_date_last - i_pk_date );
+                }
             }
+
+            *pp_last = p_pk;
+            pp_last = &p_pk->p_next;
+            i_count++;
+            i_size += p_pk->i_buffer;
+            i_date = i_date_last = i_pk_date;
+
+            if( p_pk->i_flags & BLOCK_FLAG_CLOCK )
+                break;
         }
+        while( i_count < i_group && block_FifoCount( p_sys->p_fifo ) > 0 );
 
-        block_cleanup_push( p_pk );
-        i_to_send--;
-        if( !i_to_send || (p_pk->i_flags & BLOCK_FLAG_CLOCK) )
+        if( i_count > 0 )
         {
-            mwait( i_date );
-            i_to_send = i_group;
+            i_send_date = i_date;
+
+            /* Token bucket one packet deep: the packet leaves once the
+             * previous one has drained at the configured rate */
+            if( i_rate > 0 && i_send_date < i_shaper )
+                i_send_date = i_shaper;
+            mwait( i_send_date );
+            SendGroup( p_access, p_group );
+            if( i_rate > 0 )
+                i_shaper = i_send_date
+                         + INT64_C(8) * i_size * CLOCK_FREQ / i_rate;
         }
-        if ( send( p_sys->i_handle, p_pk->p_buffer, p_pk->i_buffer, 0 ) == -1 )
-            msg_Warn( p_access, "send error: %m" );
         vlc_cleanup_pop();
 
+        if( i_count == 0 )
+            continue;
+
         if( i_dropped_packets )
         {
             msg_Dbg( p_access, "dropped %i packets", i_dropped_packets );
             i_dropped_packets = 0;
         }
 
-#if 1
+        /* Late against the date it was due, shaping included */
         i_sent = mdate();
-        if ( i_sent > i_date + 20000 )
+        if ( i_sent > i_send_date + 20000 )
         {
             msg_Dbg( p_access, "packet has been sent too late (%"PRId64 ")",
-                     i_sent - i_date );
+                     i_sent - i_send_date );
         }
-#endif
-
-        block_FifoPut( p_sys->p_empty_blocks, p_pk );
 
-        i_date_last = i_date;
+        block_FifoPut( p_sys->p_empty_blocks, p_group );
     }
     return NULL;
 }
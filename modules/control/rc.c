@@ -1766,6 +1766,12 @@ static int updateStatistics( intf_thread_t *p_intf, input_item_t *p_item )
             p_item->p_stats->i_displayed_pictures );
     msg_rc(_("| frames lost      :    %5"PRIi64),
             p_item->p_stats->i_lost_pictures );
+    msg_rc(_("| pool pictures    :    %5"PRIi64),
+            p_item->p_stats->i_pool_pictures );
+    msg_rc(_("| pool exhausted   :    %5"PRIi64),
+            p_item->p_stats->i_pool_exhausted );
+    msg_rc(_("| pool used at most:    %5"PRIi64),
+            p_item->p_stats->i_pool_used_max );
     msg_rc("|");
     /* Audio*/
     msg_rc("%s", _("+-[Audio Decoding]"));
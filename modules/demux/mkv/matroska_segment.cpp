@@ -28,6 +28,11 @@
 #include "util.hpp"
 #include "Ebml_parser.hpp"
 
+#include <vlc_fs.h>
+
+#include <limits.h>
+#include <sys/stat.h>
+
 matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estream )
     :segment(NULL)
     ,es(estream)
@@ -52,6 +57,8 @@ matroska_segment_c::matroska_segment_c( demux_sys_t & demuxer, EbmlStream & estr
     ,b_cues(false)
     ,i_index(0)
     ,i_index_max(1024)
+    ,psz_index_cache(NULL)
+    ,i_index_cached(0)
     ,psz_muxing_application(NULL)
     ,psz_writing_application(NULL)
     ,psz_segment_filename(NULL)
@@ -83,6 +90,11 @@ matroska_segment_c::~matroska_segment_c()
     free( psz_segment_filename );
     free( psz_title );
     free( psz_date_utc );
+    if( psz_index_cache )
+    {
+        IndexSave();
+        free( psz_index_cache );
+    }
     free( p_indexes );
 
     delete ep;
@@ -592,6 +604,206 @@ void matroska_segment_c::IndexAppendCluster( KaxCluster *cluster )
 #undef idx
 }
 
+/* Index of the last entry at or before i_time, the first entry otherwise */
+int matroska_segment_c::IndexFind( mtime_t i_time ) const
+{
+    int i_low = 0, i_high = i_index;
+
+    /* entries are sorted, be they cues or clusters met while playing */
+    while( i_low < i_high )
+    {
+        int i_mid = ( i_low + i_high ) / 2;
+        if( p_indexes[i_mid].i_time > i_time )
+            i_high = i_mid;
+        else
+            i_low = i_mid + 1;
+    }
+    return i_low > 0 ? i_low - 1 : 0;
+}
+
+/* Index of the first entry at or after i_position, i_index if none */
+int matroska_segment_c::IndexFindPosition( int64_t i_position ) const
+{
+    int i_low = 0, i_high = i_index;
+
+    while( i_low < i_high )
+    {
+        int i_mid = ( i_low + i_high ) / 2;
+        if( p_indexes[i_mid].i_position < i_position )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/*
+ * The cluster index of segments without cues is kept in a side file, so that
+ * the clusters found while playing need not be scanned for again.
+ * Format: magic, entry count, then (position, time) pairs, all big endian.
+ */
+static const char index_cache_magic[8] = { 'V','L','C','M','K','I','0','2' };
+
+/* Side files kept in the cache directory, the oldest written go first */
+#define INDEX_CACHE_MAX 64
+
+void matroska_segment_c::IndexLoad( const char *psz_path )
+{
+    free( psz_index_cache );
+    psz_index_cache = strdup( psz_path );
+
+    FILE *file = vlc_fopen( psz_path, "rb" );
+    if( file == NULL )
+        return;
+
+    uint8_t  header[sizeof(index_cache_magic) + 4];
+    uint32_t i_count = 0;
+
+    if( fread( header, sizeof(header), 1, file ) == 1 &&
+        !memcmp( header, index_cache_magic, sizeof(index_cache_magic) ) )
+        i_count = GetDWBE( &header[sizeof(index_cache_magic)] );
+
+    if( i_count == 0 || i_count > INT_MAX / sizeof(mkv_index_t) - 1024 )
+    {
+        msg_Warn( &sys.demuxer, "invalid index cache %s", psz_path );
+        fclose( file );
+        return;
+    }
+
+    if( (int)i_count >= i_index_max )
+    {
+        i_index_max = i_count + 1024;
+        p_indexes = (mkv_index_t*)xrealloc( p_indexes,
+                                        sizeof( mkv_index_t ) * i_index_max );
+    }
+
+    /* The key does not cover the whole file: never trust a position
+     * beyond its end */
+    int64_t i_size = stream_Size( sys.demuxer.s );
+
+    i_index = 0;
+    for( uint32_t i = 0; i < i_count; i++ )
+    {
+        uint8_t entry[16];
+
+        if( fread( entry, sizeof(entry), 1, file ) != 1 )
+            break;
+
+        int64_t i_position = GetQWBE( &entry[0] );
+        int64_t i_time     = GetQWBE( &entry[8] );
+
+        if( i_position <= ( i_index > 0 ? p_indexes[i_index - 1].i_position : 0 ) ||
+            ( i_size > 0 && i_position >= i_size ) || i_time < 0 )
+            break;
+#define idx p_indexes[i_index]
+        idx.i_track       = -1;
+        idx.i_block_number= -1;
+        idx.i_position    = i_position;
+        idx.i_time        = i_time;
+        idx.b_key         = true;
+#undef idx
+        i_index++;
+    }
+    fclose( file );
+
+    if( (uint32_t)i_index != i_count )
+    {
+        msg_Warn( &sys.demuxer, "invalid index cache %s", psz_path );
+        i_index = 0;
+        return;
+    }
+
+    i_index_cached = i_index;
+    msg_Dbg( &sys.demuxer, "loaded %d index entries from %s", i_index, psz_path );
+}
+
+static void IndexCachePrune( demux_t *p_demux, const char *psz_path )
+{
+    const char *psz_sep = strrchr( psz_path, DIR_SEP_CHAR );
+    if( psz_sep == NULL )
+        return;
+
+    std::string dirname( psz_path, psz_sep - psz_path );
+    DIR *dir = vlc_opendir( dirname.c_str() );
+    if( dir == NULL )
+        return;
+
+    std::vector<std::pair<time_t, std::string> > files;
+    char *psz_name;
+
+    while( ( psz_name = vlc_readdir( dir ) ) != NULL )
+    {
+        size_t      i_len = strlen( psz_name );
+        struct stat st;
+
+        if( i_len > 8 && !strncmp( psz_name, "mkv-", 4 ) &&
+            !strcmp( psz_name + i_len - 4, ".idx" ) )
+        {
+            std::string path = dirname + DIR_SEP + psz_name;
+            if( !vlc_stat( path.c_str(), &st ) )
+                files.push_back( std::make_pair( st.st_mtime, path ) );
+        }
+        free( psz_name );
+    }
+    closedir( dir );
+
+    if( files.size() <= INDEX_CACHE_MAX )
+        return;
+
+    std::sort( files.begin(), files.end() );
+    for( size_t i = 0; i < files.size() - INDEX_CACHE_MAX; i++ )
+    {
+        msg_Dbg( p_demux, "pruning index cache %s", files[i].second.c_str() );
+        vlc_unlink( files[i].second.c_str() );
+    }
+}
+
+void matroska_segment_c::IndexSave()
+{
+    /* Nothing learnt since it was loaded */
+    if( i_index <= i_index_cached )
+        return;
+
+    char *psz_tmp;
+    if( asprintf( &psz_tmp, "%s.tmp", psz_index_cache ) == -1 )
+        return;
+
+    FILE *file = vlc_fopen( psz_tmp, "wb" );
+    if( file == NULL )
+    {
+        msg_Warn( &sys.demuxer, "cannot write index cache %s: %m", psz_tmp );
+        free( psz_tmp );
+        return;
+    }
+
+    uint8_t header[sizeof(index_cache_magic) + 4];
+    memcpy( header, index_cache_magic, sizeof(index_cache_magic) );
+    SetDWBE( &header[sizeof(index_cache_magic)], i_index );
+
+    bool b_error = fwrite( header, sizeof(header), 1, file ) != 1;
+
+    for( int i = 0; i < i_index && !b_error; i++ )
+    {
+        uint8_t entry[16];
+        SetQWBE( &entry[0], p_indexes[i].i_position );
+        SetQWBE( &entry[8], p_indexes[i].i_time );
+        b_error = fwrite( entry, sizeof(entry), 1, file ) != 1;
+    }
+
+    /* Readers must never see a partial file */
+    if( fclose( file ) || b_error || vlc_rename( psz_tmp, psz_index_cache ) )
+    {
+        msg_Warn( &sys.demuxer, "cannot write index cache %s", psz_index_cache );
+        vlc_unlink( psz_tmp );
+    }
+    else
+    {
+        msg_Dbg( &sys.demuxer, "saved %d index entries to %s", i_index, psz_index_cache );
+        IndexCachePrune( &sys.demuxer, psz_index_cache );
+    }
+    free( psz_tmp );
+}
+
 bool matroska_segment_c::PreloadFamily( const matroska_segment_c & of_segment )
 {
     if ( b_preloaded )
@@ -903,13 +1115,7 @@ void matroska_segment_c::Seek( mtime_t i_date, mtime_t i_time_offset, int64_t i_
     int i_idx = 0;
     if ( i_index > 0 )
     {
-
-        for( ; i_idx < i_index; i_idx++ )
-            if( p_indexes[i_idx].i_time + i_time_offset > i_date )
-                break;
-
-        if( i_idx > 0 )
-            i_idx--;
+        i_idx = IndexFind( i_date - i_time_offset );
 
         i_seek_position = p_indexes[i_idx].i_position;
         i_seek_time = p_indexes[i_idx].i_time;
@@ -110,6 +110,8 @@ public:
     int                     i_index;
     int                     i_index_max;
     mkv_index_t             *p_indexes;
+    char                    *psz_index_cache; /* side file of the cluster index */
+    int                     i_index_cached;   /* entries read from or written to it */
 
     /* info */
     char                    *psz_muxing_application;
@@ -142,6 +144,10 @@ public:
     int BlockFindTrackIndex( size_t *pi_track,
                              const KaxBlock *, const KaxSimpleBlock * );
 
+    int IndexFind( mtime_t i_time ) const;
+    int IndexFindPosition( int64_t i_position ) const;
+    void IndexLoad( const char *psz_path );
+
     bool Select( mtime_t i_start_time );
     void UnSelect();
 
@@ -161,6 +167,7 @@ private:
     void ParseCluster( bool b_update_start_time = true );
     SimpleTag * ParseSimpleTags( KaxTagSimple *tag, int level = 50 );
     void IndexAppendCluster( KaxCluster *cluster );
+    void IndexSave();
     int32_t TrackInit( mkv_track_t * p_tk );
     void ComputeTrackPriority();
 };
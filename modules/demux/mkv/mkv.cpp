@@ -35,6 +35,9 @@
 
 #include <vlc_fs.h>
 #include <vlc_url.h>
+#include <vlc_md5.h>
+
+#include <sys/stat.h>
 
 /*****************************************************************************
  * Module descriptor
@@ -70,6 +73,10 @@ vlc_module_begin ()
             N_("Dummy Elements"),
             N_("Read and discard unknown EBML elements (not good for broken files)."), true );
 
+    add_bool( "mkv-index-cache", true,
+            N_("Cache the seek index"),
+            N_("Keep the index built while playing files without cues, to seek faster when they are opened again."), true );
+
     add_shortcut( "mka", "mkv" )
 vlc_module_end ()
 
@@ -79,6 +86,49 @@ static int  Demux  ( demux_t * );
 static int  Control( demux_t *, int, va_list );
 static void Seek   ( demux_t *, mtime_t i_date, double f_percent, virtual_chapter_c *p_chapter );
 
+/*****************************************************************************
+ * IndexCachePath: side file name for the index of a local file, keyed by
+ * its size, date and header so that a modified file is not mistaken
+ *****************************************************************************/
+static char *IndexCachePath( demux_t *p_demux )
+{
+    const uint8_t *p_peek;
+    struct stat   st;
+
+    if( !var_InheritBool( p_demux, "mkv-index-cache" ) ||
+        p_demux->psz_file == NULL || strcmp( p_demux->psz_access, "file" ) ||
+        vlc_stat( p_demux->psz_file, &st ) )
+        return NULL;
+
+    int i_peek = stream_Peek( p_demux->s, &p_peek, 65536 );
+    if( i_peek <= 0 )
+        return NULL;
+
+    struct md5_s md5;
+    uint64_t i_size = st.st_size;
+    int64_t  i_mtime = st.st_mtime;
+
+    InitMD5( &md5 );
+    AddMD5( &md5, &i_size, sizeof(i_size) );
+    AddMD5( &md5, &i_mtime, sizeof(i_mtime) );
+    AddMD5( &md5, p_peek, i_peek );
+    EndMD5( &md5 );
+
+    char *psz_hash = psz_md5_hash( &md5 );
+    char *psz_dir = config_GetUserDir( VLC_CACHE_DIR );
+    char *psz_path = NULL;
+
+    if( psz_hash != NULL && psz_dir != NULL )
+    {
+        vlc_mkdir( psz_dir, 0700 );
+        if( asprintf( &psz_path, "%s" DIR_SEP "mkv-%s", psz_dir, psz_hash ) == -1 )
+            psz_path = NULL;
+    }
+    free( psz_dir );
+    free( psz_hash );
+    return psz_path;
+}
+
 /*****************************************************************************
  * Open: initializes matroska demux structures
  *****************************************************************************/
@@ -93,6 +143,7 @@ static int Open( vlc_object_t * p_this )
     vlc_stream_io_callback *p_io_callback;
     EbmlStream         *p_io_stream;
     bool                b_need_preload = false;
+    char               *psz_index_cache;
 
     /* peek the begining */
     if( stream_Peek( p_demux->s, &p_peek, 4 ) < 4 ) return VLC_EGENERIC;
@@ -101,6 +152,9 @@ static int Open( vlc_object_t * p_this )
     if( p_peek[0] != 0x1a || p_peek[1] != 0x45 ||
         p_peek[2] != 0xdf || p_peek[3] != 0xa3 ) return VLC_EGENERIC;
 
+    /* while the header can still be peeked */
+    psz_index_cache = IndexCachePath( p_demux );
+
     /* Set the demux function */
     p_demux->pf_demux   = Demux;
     p_demux->pf_control = Control;
@@ -114,6 +168,7 @@ static int Open( vlc_object_t * p_this )
         msg_Err( p_demux, "failed to create EbmlStream" );
         delete p_io_callback;
         delete p_sys;
+        free( psz_index_cache );
         return VLC_EGENERIC;
     }
 
@@ -132,7 +187,18 @@ static int Open( vlc_object_t * p_this )
     {
         p_stream->segments[i]->Preload();
         b_need_preload |= p_stream->segments[i]->b_ref_external_segments;
+
+        /* Without cues, reuse the clusters found the last time */
+        char *psz_path;
+        if( psz_index_cache && !p_stream->segments[i]->b_cues &&
+            asprintf( &psz_path, "%s-%zu.idx", psz_index_cache, i ) != -1 )
+        {
+            p_stream->segments[i]->IndexLoad( psz_path );
+            free( psz_path );
+        }
     }
+    free( psz_index_cache );
+    psz_index_cache = NULL;
 
     p_segment = p_stream->segments[0];
     if( p_segment->cluster == NULL )
@@ -254,6 +320,7 @@ static int Open( vlc_object_t * p_this )
     return VLC_SUCCESS;
 
 error:
+    free( psz_index_cache );
     delete p_sys;
     return VLC_EGENERIC;
 }
@@ -457,12 +524,10 @@ static void Seek( demux_t *p_demux, mtime_t i_date, double f_percent, virtual_ch
             int64_t i_pos = int64_t( f_percent * stream_Size( p_demux->s ) );
 
             msg_Dbg( p_demux, "lengthy way of seeking for pos:%"PRId64, i_pos );
-            for( i_index = 0; i_index < p_segment->i_index; i_index++ )
-            {
-                if( p_segment->p_indexes[i_index].i_position >= i_pos &&
-                    p_segment->p_indexes[i_index].i_time > 0 )
-                    break;
-            }
+            i_index = p_segment->IndexFindPosition( i_pos );
+            while( i_index < p_segment->i_index &&
+                   p_segment->p_indexes[i_index].i_time <= 0 )
+                i_index++;
             if( i_index == p_segment->i_index )
                 i_index--;
 
@@ -1284,14 +1284,19 @@ typedef struct
     /* now provide way to calculate pts, dts, and offset without too
         much memory and with fast access */
 
-    /* with this we can calculate dts/pts without waste memory */
+    /* with this we can calculate dts/pts without waste memory:
+     * unless fragmented, the tables point into the stts and ctts boxes,
+     * at the entry covering the first sample of the chunk, of which the
+     * first i_sample_skip_* samples belong to the previous chunks */
     uint64_t     i_first_dts;   /* DTS of the first sample */
     uint64_t     i_last_dts;    /* DTS of the last sample */
     uint32_t     *p_sample_count_dts;
     uint32_t     *p_sample_delta_dts;   /* dts delta */
+    uint32_t     i_sample_skip_dts;
 
     uint32_t     *p_sample_count_pts;
     int32_t      *p_sample_offset_pts;  /* pts-dts */
+    uint32_t     i_sample_skip_pts;
 
     uint8_t      **p_sample_data;     /* set when b_fragmented is true */
     uint32_t     *p_sample_size;
@@ -1337,11 +1342,24 @@ typedef struct
     uint32_t         i_chunk_count;
     uint32_t         i_sample_count;
 
-    mp4_chunk_t    *chunk; /* always defined  for each chunk */
+    mp4_chunk_t    chunk;  /* current chunk if b_fragmented is false */
     mp4_chunk_t    *cchunk; /* current chunk if b_fragmented is true */
 
+    /* The chunks are not expanded: the current one is rebuilt from the
+     * tables below, which point into the boxes, and from the first sample
+     * (and dts) of each of their entries, with one extra entry holding the
+     * totals */
+    MP4_Box_data_co64_t *p_co64;
+    MP4_Box_data_stsc_t *p_stsc;
+    MP4_Box_data_stts_t *p_stts;
+    MP4_Box_data_ctts_t *p_ctts;    /* could be NULL */
+    uint64_t         *p_stsc_sample_first;
+    uint64_t         *p_stts_sample_first;
+    uint64_t         *p_stts_dts_first;
+    uint64_t         *p_ctts_sample_first;
+
     /* sample size, p_sample_size defined only if i_sample_size == 0
-        else i_sample_size is size for all sample */
+        else i_sample_size is size for all sample. It points into stsz */
     uint32_t         i_sample_size;
     uint32_t         *p_sample_size; /* XXX perhaps add file offset if take
                                     too much time to do sumations each time*/
@@ -103,6 +103,7 @@ static uint64_t MP4_TrackGetPos    ( mp4_track_t * );
 static int      MP4_TrackSampleSize( mp4_track_t * );
 static int      MP4_TrackNextSample( demux_t *, mp4_track_t * );
 static void     MP4_TrackSetELST( demux_t *, mp4_track_t *, int64_t );
+static void     TrackLoadChunk( const mp4_track_t *, uint32_t, mp4_chunk_t * );
 
 static void     MP4_UpdateSeekpoint( demux_t * );
 static const char *MP4_ConvertMacCode( uint16_t );
@@ -115,7 +116,7 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
     if( p_sys->b_fragmented )
         chunk = *p_track->cchunk;
     else
-        chunk = p_track->chunk[p_track->i_chunk];
+        chunk = p_track->chunk;
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - chunk.i_sample_first;
@@ -123,11 +124,14 @@ static inline int64_t MP4_TrackGetDTS( demux_t *p_demux, mp4_track_t *p_track )
 
     while( i_sample > 0 )
     {
-        if( i_sample > chunk.p_sample_count_dts[i_index] )
+        uint32_t i_count = chunk.p_sample_count_dts[i_index];
+        if( i_index == 0 )
+            i_count -= chunk.i_sample_skip_dts;
+
+        if( i_sample > i_count )
         {
-            i_dts += chunk.p_sample_count_dts[i_index] *
-                chunk.p_sample_delta_dts[i_index];
-            i_sample -= chunk.p_sample_count_dts[i_index];
+            i_dts += i_count * chunk.p_sample_delta_dts[i_index];
+            i_sample -= i_count;
             i_index++;
         }
         else
@@ -168,7 +172,7 @@ static inline int64_t MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_tra
     if( p_sys->b_fragmented )
         ck = p_track->cchunk;
     else
-        ck = &p_track->chunk[p_track->i_chunk];
+        ck = &p_track->chunk;
 
     unsigned int i_index = 0;
     unsigned int i_sample = p_track->i_sample - ck->i_sample_first;
@@ -178,11 +182,15 @@ static inline int64_t MP4_TrackGetPTSDelta( demux_t *p_demux, mp4_track_t *p_tra
 
     for( i_index = 0;; i_index++ )
     {
-        if( i_sample < ck->p_sample_count_pts[i_index] )
+        uint32_t i_count = ck->p_sample_count_pts[i_index];
+        if( i_index == 0 )
+            i_count -= ck->i_sample_skip_pts;
+
+        if( i_sample < i_count )
             return ck->p_sample_offset_pts[i_index] * INT64_C(1000000) /
                    (int64_t)p_track->i_timescale;
 
-        i_sample -= ck->p_sample_count_pts[i_index];
+        i_sample -= i_count;
     }
 }
 
@@ -1232,9 +1240,10 @@ static void LoadChapterApple( demux_t  *p_demux, mp4_track_t *tk )
                 TAB_APPEND( p_sys->p_title->i_seekpoint, p_sys->p_title->seekpoint, s );
             }
         }
-        if( tk->i_sample+1 >= tk->chunk[tk->i_chunk].i_sample_first +
-                              tk->chunk[tk->i_chunk].i_sample_count )
-            tk->i_chunk++;
+        if( tk->i_sample+1 >= tk->chunk.i_sample_first +
+                              tk->chunk.i_sample_count &&
+            tk->i_chunk+1 < tk->i_chunk_count )
+            TrackLoadChunk( tk, ++tk->i_chunk, &tk->chunk );
     }
 }
 static void LoadChapter( demux_t  *p_demux )
@@ -1277,7 +1286,130 @@ static void LoadChapter( demux_t  *p_demux )
     }
 }
 
-/* now create basic chunk data, the rest will be filled by MP4_CreateSamplesIndex */
+/* Number of entries starting at or before i_value, in a table sorted by
+ * first value */
+static uint32_t FindEntry( const uint64_t *p_first, uint32_t i_count,
+                           uint64_t i_value )
+{
+    uint32_t i_low = 0, i_high = i_count;
+    while( i_low < i_high )
+    {
+        uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( p_first[i_mid] <= i_value )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Number of stsc runs starting at or before i_chunk */
+static uint32_t TrackChunkRun( const mp4_track_t *p_track, uint32_t i_chunk )
+{
+    const MP4_Box_data_stsc_t *stsc = p_track->p_stsc;
+    uint32_t i_low = 0, i_high = stsc->i_entry_count;
+    while( i_low < i_high )
+    {
+        uint32_t i_mid = i_low + ( i_high - i_low ) / 2;
+        if( stsc->i_first_chunk[i_mid] - 1 <= i_chunk )
+            i_low = i_mid + 1;
+        else
+            i_high = i_mid;
+    }
+    return i_low;
+}
+
+/* Chunk holding i_sample */
+static uint32_t TrackSampleChunk( const mp4_track_t *p_track,
+                                  uint64_t i_sample )
+{
+    const MP4_Box_data_stsc_t *stsc = p_track->p_stsc;
+    uint32_t i_run = FindEntry( p_track->p_stsc_sample_first,
+                                stsc->i_entry_count, i_sample );
+    if( i_run == 0 )
+        return 0;
+    i_run--;
+
+    uint64_t i_chunk = stsc->i_first_chunk[i_run] - 1;
+    if( stsc->i_samples_per_chunk[i_run] > 0 )
+        i_chunk += ( i_sample - p_track->p_stsc_sample_first[i_run] ) /
+                   stsc->i_samples_per_chunk[i_run];
+    return __MIN( i_chunk, p_track->i_chunk_count - 1 );
+}
+
+/* DTS of i_sample, in track time scale */
+static uint64_t TrackSampleDTS( const mp4_track_t *p_track, uint64_t i_sample )
+{
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
+
+    if( i_sample >= p_track->p_stts_sample_first[stts->i_entry_count] )
+        return p_track->p_stts_dts_first[stts->i_entry_count];
+
+    uint32_t i_index = FindEntry( p_track->p_stts_sample_first,
+                                  stts->i_entry_count, i_sample ) - 1;
+    return p_track->p_stts_dts_first[i_index] +
+           ( i_sample - p_track->p_stts_sample_first[i_index] ) *
+           (uint32_t)stts->i_sample_delta[i_index];
+}
+
+/* Rebuild the description of a chunk from the sample tables */
+static void TrackLoadChunk( const mp4_track_t *p_track, uint32_t i_chunk,
+                            mp4_chunk_t *ck )
+{
+    const MP4_Box_data_stsc_t *stsc = p_track->p_stsc;
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
+    const MP4_Box_data_ctts_t *ctts = p_track->p_ctts;
+
+    memset( ck, 0, sizeof( mp4_chunk_t ) );
+    ck->i_offset = p_track->p_co64->i_chunk_offset[i_chunk];
+
+    /* chunks before the first run have no sample */
+    uint32_t i_run = TrackChunkRun( p_track, i_chunk );
+    if( i_run > 0 )
+    {
+        i_run--;
+        ck->i_sample_description_index =
+            stsc->i_sample_description_index[i_run];
+        ck->i_sample_count = stsc->i_samples_per_chunk[i_run];
+        ck->i_sample_first = p_track->p_stsc_sample_first[i_run] +
+            (uint64_t)( i_chunk - ( stsc->i_first_chunk[i_run] - 1 ) ) *
+            ck->i_sample_count;
+    }
+
+    ck->i_first_dts = TrackSampleDTS( p_track, ck->i_sample_first );
+    ck->i_last_dts  = ck->i_sample_count > 0 ?
+        TrackSampleDTS( p_track, ck->i_sample_first + ck->i_sample_count - 1 ) :
+        ck->i_first_dts;
+
+    /* point to the stts entry in effect at the first sample */
+    if( ck->i_sample_first < p_track->p_stts_sample_first[stts->i_entry_count] )
+    {
+        uint32_t i_index = FindEntry( p_track->p_stts_sample_first,
+                                      stts->i_entry_count,
+                                      ck->i_sample_first ) - 1;
+        ck->p_sample_count_dts = &stts->i_sample_count[i_index];
+        ck->p_sample_delta_dts = (uint32_t *)&stts->i_sample_delta[i_index];
+        ck->i_sample_skip_dts  = ck->i_sample_first -
+                                 p_track->p_stts_sample_first[i_index];
+    }
+
+    /* and to the ctts one, unless the table ends within the chunk */
+    if( ctts && ck->i_sample_first <
+                p_track->p_ctts_sample_first[ctts->i_entry_count] &&
+        (uint64_t)ck->i_sample_first + ck->i_sample_count <=
+                p_track->p_ctts_sample_first[ctts->i_entry_count] )
+    {
+        uint32_t i_index = FindEntry( p_track->p_ctts_sample_first,
+                                      ctts->i_entry_count,
+                                      ck->i_sample_first ) - 1;
+        ck->p_sample_count_pts  = &ctts->i_sample_count[i_index];
+        ck->p_sample_offset_pts = &ctts->i_sample_offset[i_index];
+        ck->i_sample_skip_pts   = ck->i_sample_first -
+                                  p_track->p_ctts_sample_first[i_index];
+    }
+}
+
+/* Check the chunk tables, and index the first sample of each stsc run */
 static int TrackCreateChunksIndex( demux_t *p_demux,
                                    mp4_track_t *p_demux_track )
 {
@@ -1288,15 +1420,14 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
     MP4_Box_t *p_co64; /* give offset for each chunk, same for stco and co64 */
     MP4_Box_t *p_stsc;
 
-    unsigned int i_chunk;
-    unsigned int i_index, i_last;
-
     if( ( !(p_co64 = MP4_BoxGet( p_demux_track->p_stbl, "stco" ) )&&
           !(p_co64 = MP4_BoxGet( p_demux_track->p_stbl, "co64" ) ) )||
         ( !(p_stsc = MP4_BoxGet( p_demux_track->p_stbl, "stsc" ) ) ))
     {
         return( VLC_EGENERIC );
     }
+    p_demux_track->p_co64 = p_co64->data.p_co64;
+    p_demux_track->p_stsc = p_stsc->data.p_stsc;
 
     p_demux_track->i_chunk_count = p_co64->data.p_co64->i_entry_count;
     if( !p_demux_track->i_chunk_count )
@@ -1304,64 +1435,42 @@ static int TrackCreateChunksIndex( demux_t *p_demux,
         msg_Warn( p_demux, "no chunk defined" );
         return( VLC_EGENERIC );
     }
-    p_demux_track->chunk = calloc( p_demux_track->i_chunk_count,
-                                   sizeof( mp4_chunk_t ) );
-    if( p_demux_track->chunk == NULL )
-    {
-        return VLC_ENOMEM;
-    }
-
-    /* first we read chunk offset */
-    for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-    {
-        mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-
-        ck->i_offset = p_co64->data.p_co64->i_chunk_offset[i_chunk];
-
-        ck->i_first_dts = 0;
-        ck->p_sample_count_dts = NULL;
-        ck->p_sample_delta_dts = NULL;
-        ck->p_sample_count_pts = NULL;
-        ck->p_sample_offset_pts = NULL;
-    }
 
-    /* now we read index for SampleEntry( soun vide mp4a mp4v ...)
-        to be used for the sample XXX begin to 1
-        We construct it begining at the end */
-    i_last = p_demux_track->i_chunk_count; /* last chunk proceded */
-    i_index = p_stsc->data.p_stsc->i_entry_count;
-    if( !i_index )
+    /* each run gives the sample count and SampleEntry( soun vide mp4a mp4v
+     * ...) index of the chunks up to the next one, indexes begin at 1 */
+    const MP4_Box_data_stsc_t *stsc = p_stsc->data.p_stsc;
+    const uint32_t i_runs = stsc->i_entry_count;
+    if( !i_runs )
     {
         msg_Warn( p_demux, "cannot read chunk table or table empty" );
         return( VLC_EGENERIC );
     }
 
-    while( i_index-- )
+    p_demux_track->p_stsc_sample_first =
+        malloc( ( i_runs + 1 ) * sizeof( uint64_t ) );
+    if( p_demux_track->p_stsc_sample_first == NULL )
+        return VLC_ENOMEM;
+
+    uint64_t i_sample = 0;
+    for( uint32_t i = 0; i < i_runs; i++ )
     {
-        for( i_chunk = p_stsc->data.p_stsc->i_first_chunk[i_index] - 1;
-             i_chunk < i_last; i_chunk++ )
+        if( stsc->i_first_chunk[i] == 0 ||
+            stsc->i_first_chunk[i] - 1 > p_demux_track->i_chunk_count ||
+            ( i > 0 && stsc->i_first_chunk[i] < stsc->i_first_chunk[i-1] ) )
         {
-            if( i_chunk >= p_demux_track->i_chunk_count )
-            {
-                msg_Warn( p_demux, "corrupted chunk table" );
-                return VLC_EGENERIC;
-            }
-
-            p_demux_track->chunk[i_chunk].i_sample_description_index =
-                    p_stsc->data.p_stsc->i_sample_description_index[i_index];
-            p_demux_track->chunk[i_chunk].i_sample_count =
-                    p_stsc->data.p_stsc->i_samples_per_chunk[i_index];
+            msg_Warn( p_demux, "corrupted chunk table" );
+            return VLC_EGENERIC;
         }
-        i_last = p_stsc->data.p_stsc->i_first_chunk[i_index] - 1;
-    }
-
-    p_demux_track->chunk[0].i_sample_first = 0;
-    for( i_chunk = 1; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-    {
-        p_demux_track->chunk[i_chunk].i_sample_first =
-            p_demux_track->chunk[i_chunk-1].i_sample_first +
-                p_demux_track->chunk[i_chunk-1].i_sample_count;
+        if( i > 0 )
+            i_sample += (uint64_t)( stsc->i_first_chunk[i] -
+                                    stsc->i_first_chunk[i-1] ) *
+                        stsc->i_samples_per_chunk[i-1];
+        p_demux_track->p_stsc_sample_first[i] = i_sample;
     }
+    i_sample += (uint64_t)( p_demux_track->i_chunk_count -
+                            ( stsc->i_first_chunk[i_runs-1] - 1 ) ) *
+                stsc->i_samples_per_chunk[i_runs-1];
+    p_demux_track->p_stsc_sample_first[i_runs] = i_sample;
 
     msg_Dbg( p_demux, "track[Id 0x%x] read %d chunk",
              p_demux_track->i_track_ID, p_demux_track->i_chunk_count );
@@ -1381,13 +1490,8 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     MP4_Box_data_stts_t *stts;
     /* TODO use also stss and stsh table for seeking */
     /* FIXME use edit table */
-    int64_t i_sample;
-    int64_t i_chunk;
-
-    int64_t i_index;
-    int64_t i_index_sample_used;
-
-    int64_t i_next_dts;
+    uint64_t i_sample;
+    uint64_t i_dts;
 
     /* Find stsz
      *  Gives the sample size for each samples. There is also a stz2 table
@@ -1412,7 +1516,7 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     }
     stts = p_box->data.p_stts;
 
-    /* Use stsz table to create a sample number -> sample size table */
+    /* Use stsz table as sample number -> sample size table */
     p_demux_track->i_sample_count = stsz->i_sample_count;
     if( stsz->i_sample_size )
     {
@@ -1424,83 +1528,40 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
     {
         /* 2: each sample can have a different size */
         p_demux_track->i_sample_size = 0;
-        p_demux_track->p_sample_size =
-            calloc( p_demux_track->i_sample_count, sizeof( uint32_t ) );
-        if( p_demux_track->p_sample_size == NULL )
-            return VLC_ENOMEM;
+        p_demux_track->p_sample_size = stsz->i_entry_size;
+    }
+
+    /* Use stts table as sample number -> dts table.
+     * Nothing is expanded: only the first sample and dts of each entry are
+     * kept, so that memory does not grow with the sample count
+     * (problem with raw stream where a sample is sometime
+     *  just channels*bits_per_sample/8) */
+    p_demux_track->p_stts = stts;
+    p_demux_track->p_stts_sample_first =
+        malloc( ( stts->i_entry_count + 1 ) * sizeof( uint64_t ) );
+    p_demux_track->p_stts_dts_first =
+        malloc( ( stts->i_entry_count + 1 ) * sizeof( uint64_t ) );
+    if( p_demux_track->p_stts_sample_first == NULL ||
+        p_demux_track->p_stts_dts_first == NULL )
+        return VLC_ENOMEM;
 
-        for( i_sample = 0; i_sample < p_demux_track->i_sample_count; i_sample++ )
-        {
-            p_demux_track->p_sample_size[i_sample] =
-                    stsz->i_entry_size[i_sample];
-        }
+    i_sample = 0; i_dts = 0;
+    for( uint32_t i = 0; i < stts->i_entry_count; i++ )
+    {
+        p_demux_track->p_stts_sample_first[i] = i_sample;
+        p_demux_track->p_stts_dts_first[i] = i_dts;
+        i_sample += stts->i_sample_count[i];
+        i_dts += (uint64_t)stts->i_sample_count[i] *
+                 (uint32_t)stts->i_sample_delta[i];
     }
+    p_demux_track->p_stts_sample_first[stts->i_entry_count] = i_sample;
+    p_demux_track->p_stts_dts_first[stts->i_entry_count] = i_dts;
 
-    /* Use stts table to create a sample number -> dts table.
-     * XXX: if we don't want to waste too much memory, we can't expand
-     *  the box! so each chunk will contain an "extract" of this table
-     *  for fast research (problem with raw stream where a sample is sometime
-     *  just channels*bits_per_sample/8 */
-
-    i_next_dts = 0;
-    i_index = 0; i_index_sample_used = 0;
-    for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
+    if( i_sample < p_demux_track->p_stsc_sample_first[
+                                      p_demux_track->p_stsc->i_entry_count] )
     {
-        mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-        int64_t i_entry, i_sample_count, i;
-
-        /* save first dts */
-        ck->i_first_dts = i_next_dts;
-        ck->i_last_dts  = i_next_dts;
-
-        /* count how many entries are needed for this chunk
-         * for p_sample_delta_dts and p_sample_count_dts */
-        i_sample_count = ck->i_sample_count;
-
-        i_entry = 0;
-        while( i_sample_count > 0 )
-        {
-            i_sample_count -= stts->i_sample_count[i_index+i_entry];
-            /* don't count already used sample in this entry */
-            if( i_entry == 0 )
-                i_sample_count += i_index_sample_used;
-
-            i_entry++;
-        }
-
-        /* allocate them */
-        ck->p_sample_count_dts = calloc( i_entry, sizeof( uint32_t ) );
-        ck->p_sample_delta_dts = calloc( i_entry, sizeof( uint32_t ) );
-
-        if( !ck->p_sample_count_dts || !ck->p_sample_delta_dts )
-            return VLC_ENOMEM;
-
-        /* now copy */
-        i_sample_count = ck->i_sample_count;
-        for( i = 0; i < i_entry; i++ )
-        {
-            int64_t i_used;
-            int64_t i_rest;
-
-            i_rest = stts->i_sample_count[i_index] - i_index_sample_used;
-
-            i_used = __MIN( i_rest, i_sample_count );
-
-            i_index_sample_used += i_used;
-            i_sample_count -= i_used;
-            i_next_dts += i_used * stts->i_sample_delta[i_index];
-
-            ck->p_sample_count_dts[i] = i_used;
-            ck->p_sample_delta_dts[i] = stts->i_sample_delta[i_index];
-            if( i_used > 0 )
-                ck->i_last_dts = i_next_dts - ck->p_sample_delta_dts[i];
-
-            if( i_index_sample_used >= stts->i_sample_count[i_index] )
-            {
-                i_index++;
-                i_index_sample_used = 0;
-            }
-        }
+        msg_Warn( p_demux, "STTS table is too short" );
+        return VLC_EGENERIC;
     }
 
     /* Find ctts
@@ -1513,65 +1574,25 @@ static int TrackCreateSamplesIndex( demux_t *p_demux,
 
         msg_Warn( p_demux, "CTTS table" );
 
-        /* Create pts-dts table per chunk */
-        i_index = 0; i_index_sample_used = 0;
-        for( i_chunk = 0; i_chunk < p_demux_track->i_chunk_count; i_chunk++ )
-        {
-            mp4_chunk_t *ck = &p_demux_track->chunk[i_chunk];
-            int64_t i_entry, i_sample_count, i;
-
-            /* count how many entries are needed for this chunk
-             * for p_sample_delta_dts and p_sample_count_dts */
-            i_sample_count = ck->i_sample_count;
-
-            i_entry = 0;
-            while( i_sample_count > 0 )
-            {
-                i_sample_count -= ctts->i_sample_count[i_index+i_entry];
-
-                /* don't count already used sample in this entry */
-                if( i_entry == 0 )
-                    i_sample_count += i_index_sample_used;
-
-                i_entry++;
-            }
-
-            /* allocate them */
-            ck->p_sample_count_pts = calloc( i_entry, sizeof( uint32_t ) );
-            ck->p_sample_offset_pts = calloc( i_entry, sizeof( int32_t ) );
-            if( !ck->p_sample_count_pts || !ck->p_sample_offset_pts )
-                return VLC_ENOMEM;
-
-            /* now copy */
-            i_sample_count = ck->i_sample_count;
-            for( i = 0; i < i_entry; i++ )
-            {
-                int64_t i_used;
-                int64_t i_rest;
-
-                i_rest = ctts->i_sample_count[i_index] -
-                    i_index_sample_used;
-
-                i_used = __MIN( i_rest, i_sample_count );
-
-                i_index_sample_used += i_used;
-                i_sample_count -= i_used;
-
-                ck->p_sample_count_pts[i] = i_used;
-                ck->p_sample_offset_pts[i] = ctts->i_sample_offset[i_index];
+        /* Index the first sample of each pts-dts entry, as for stts */
+        p_demux_track->p_ctts_sample_first =
+            malloc( ( ctts->i_entry_count + 1 ) * sizeof( uint64_t ) );
+        if( p_demux_track->p_ctts_sample_first == NULL )
+            return VLC_ENOMEM;
 
-                if( i_index_sample_used >= ctts->i_sample_count[i_index] )
-                {
-                    i_index++;
-                    i_index_sample_used = 0;
-                }
-            }
+        i_sample = 0;
+        for( uint32_t i = 0; i < ctts->i_entry_count; i++ )
+        {
+            p_demux_track->p_ctts_sample_first[i] = i_sample;
+            i_sample += ctts->i_sample_count[i];
         }
+        p_demux_track->p_ctts_sample_first[ctts->i_entry_count] = i_sample;
+        p_demux_track->p_ctts = ctts;
     }
 
     msg_Dbg( p_demux, "track[Id 0x%x] read %d samples length:%"PRId64"s",
              p_demux_track->i_track_ID, p_demux_track->i_sample_count,
-             i_next_dts / p_demux_track->i_timescale );
+             i_dts / p_demux_track->i_timescale );
 
     return VLC_SUCCESS;
 }
@@ -1591,27 +1612,30 @@ static void TrackGetESSampleRate( unsigned *pi_num, unsigned *pi_den,
     if( p_track->i_chunk_count <= 0 )
         return;
 
-    /* */
-    const mp4_chunk_t *p_chunk = &p_track->chunk[i_chunk];
-    while( p_chunk > &p_track->chunk[0] &&
-           p_chunk[-1].i_sample_description_index == i_sd_index )
-    {
-        p_chunk--;
-    }
+    /* the runs around the chunk using the same sample description */
+    const MP4_Box_data_stsc_t *stsc = p_track->p_stsc;
+    uint32_t i_first = TrackChunkRun( p_track, i_chunk );
+    if( i_first == 0 )
+        return;
+    uint32_t i_last = --i_first;
+
+    while( i_first > 0 &&
+           stsc->i_sample_description_index[i_first - 1] == i_sd_index )
+        i_first--;
+    while( i_last + 1 < stsc->i_entry_count &&
+           stsc->i_sample_description_index[i_last + 1] == i_sd_index )
+        i_last++;
+
+    const uint64_t i_sample_first = p_track->p_stsc_sample_first[i_first];
+    const uint64_t i_sample = p_track->p_stsc_sample_first[i_last + 1] -
+                              i_sample_first;
+    if( i_sample <= 1 )
+        return;
 
-    uint64_t i_sample = 0;
-    uint64_t i_first_dts = p_chunk->i_first_dts;
-    uint64_t i_last_dts;
-    do
-    {
-        i_sample += p_chunk->i_sample_count;
-        i_last_dts = p_chunk->i_last_dts;
-        p_chunk++;
-    }
-    while( p_chunk < &p_track->chunk[p_track->i_chunk_count] &&
-           p_chunk->i_sample_description_index == i_sd_index );
+    uint64_t i_first_dts = TrackSampleDTS( p_track, i_sample_first );
+    uint64_t i_last_dts = TrackSampleDTS( p_track, i_sample_first + i_sample - 1 );
 
-    if( i_sample > 1 && i_first_dts < i_last_dts )
+    if( i_first_dts < i_last_dts )
         vlc_ureduce( pi_num, pi_den,
                      ( i_sample - 1) *  p_track->i_timescale,
                      i_last_dts - i_first_dts,
@@ -1631,8 +1655,11 @@ static int TrackCreateES( demux_t *p_demux, mp4_track_t *p_track,
     if( p_sys->b_fragmented )
         i_sample_description_index = 1; /* XXX */
     else
-        i_sample_description_index =
-                p_track->chunk[i_chunk].i_sample_description_index;
+    {
+        mp4_chunk_t chunk;
+        TrackLoadChunk( p_track, i_chunk, &chunk );
+        i_sample_description_index = chunk.i_sample_description_index;
+    }
 
     MP4_Box_t   *p_sample;
     MP4_Box_t   *p_esds;
@@ -2269,10 +2296,9 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
 {
     demux_sys_t *p_sys = p_demux->p_sys;
     MP4_Box_t   *p_box_stss;
-    uint64_t     i_dts;
     unsigned int i_sample;
     unsigned int i_chunk;
-    int          i_index;
+    uint32_t     i_index;
 
     /* FIXME see if it's needed to check p_track->i_chunk_count */
     if( p_track->i_chunk_count == 0 )
@@ -2316,54 +2342,27 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
         i_start = i_start * p_track->i_timescale / (int64_t)1000000;
     }
 
-    /* we start from sample 0/chunk 0, hope it won't take too much time */
-    /* *** find good chunk *** */
-    for( i_chunk = 0; ; i_chunk++ )
-    {
-        if( i_chunk + 1 >= p_track->i_chunk_count )
-        {
-            /* at the end and can't check if i_start in this chunk,
-               it will be check while searching i_sample */
-            i_chunk = p_track->i_chunk_count - 1;
-            break;
-        }
+    /* *** find sample: the last one starting at or before i_start *** */
+    const MP4_Box_data_stts_t *stts = p_track->p_stts;
+    uint64_t i_found = 0;
 
-        if( (uint64_t)i_start >= p_track->chunk[i_chunk].i_first_dts &&
-            (uint64_t)i_start <  p_track->chunk[i_chunk + 1].i_first_dts )
-        {
-            break;
-        }
-    }
-
-    /* *** find sample in the chunk *** */
-    i_sample = p_track->chunk[i_chunk].i_sample_first;
-    i_dts    = p_track->chunk[i_chunk].i_first_dts;
-    for( i_index = 0; i_sample < p_track->chunk[i_chunk].i_sample_count; )
+    if( i_start < 0 )
+        i_start = 0;
+    i_index = FindEntry( p_track->p_stts_dts_first, stts->i_entry_count,
+                         i_start );
+    if( i_index > 0 )
     {
-        if( i_dts +
-            p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-            p_track->chunk[i_chunk].p_sample_delta_dts[i_index] < (uint64_t)i_start )
-        {
-            i_dts    +=
-                p_track->chunk[i_chunk].p_sample_count_dts[i_index] *
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
+        const uint32_t i_delta = stts->i_sample_delta[--i_index];
 
-            i_sample += p_track->chunk[i_chunk].p_sample_count_dts[i_index];
-            i_index++;
-        }
-        else
-        {
-            if( p_track->chunk[i_chunk].p_sample_delta_dts[i_index] <= 0 )
-            {
-                break;
-            }
-            i_sample += ( i_start - i_dts ) /
-                p_track->chunk[i_chunk].p_sample_delta_dts[i_index];
-            break;
-        }
+        i_found = p_track->p_stts_sample_first[i_index];
+        if( i_delta > 0 )
+            i_found += ( i_start - p_track->p_stts_dts_first[i_index] ) /
+                       i_delta;
     }
+    i_chunk  = TrackSampleChunk( p_track, i_found );
+    i_sample = __MIN( i_found, UINT32_MAX );
 
-    if( i_sample >= p_track->i_sample_count )
+    if( i_found >= p_track->i_sample_count )
     {
         msg_Warn( p_demux, "track[Id 0x%x] will be disabled "
                   "(seeking too far) chunk=%d sample=%d",
@@ -2373,37 +2372,30 @@ static int TrackTimeToSampleChunk( demux_t *p_demux, mp4_track_t *p_track,
 
 
     /* *** Try to find nearest sync points *** */
-    if( ( p_box_stss = MP4_BoxGet( p_track->p_stbl, "stss" ) ) )
+    if( ( p_box_stss = MP4_BoxGet( p_track->p_stbl, "stss" ) ) &&
+        p_box_stss->data.p_stss->i_entry_count > 0 )
     {
         MP4_Box_data_stss_t *p_stss = p_box_stss->data.p_stss;
         msg_Dbg( p_demux, "track[Id 0x%x] using Sync Sample Box (stss)",
                  p_track->i_track_ID );
-        for( unsigned i_index = 0; i_index < p_stss->i_entry_count; i_index++ )
-        {
-            if( i_index >= p_stss->i_entry_count - 1 ||
-                i_sample < p_stss->i_sample_number[i_index+1] )
-            {
-                unsigned i_sync_sample = p_stss->i_sample_number[i_index];
-                msg_Dbg( p_demux, "stts gives %d --> %d (sample number)",
-                         i_sample, i_sync_sample );
 
-                if( i_sync_sample <= i_sample )
-                {
-                    while( i_chunk > 0 &&
-                           i_sync_sample < p_track->chunk[i_chunk].i_sample_first )
-                        i_chunk--;
-                }
-                else
-                {
-                    while( i_chunk < p_track->i_chunk_count - 1 &&
-                           i_sync_sample >= p_track->chunk[i_chunk].i_sample_first +
-                                            p_track->chunk[i_chunk].i_sample_count )
-                        i_chunk++;
-                }
-                i_sample = i_sync_sample;
-                break;
-            }
+        /* the last entry not followed by one at or before i_sample */
+        unsigned int i_low = 0, i_high = p_stss->i_entry_count;
+        while( i_high - i_low > 1 )
+        {
+            unsigned int i_mid = ( i_low + i_high ) / 2;
+            if( p_stss->i_sample_number[i_mid] <= i_sample )
+                i_low = i_mid;
+            else
+                i_high = i_mid;
         }
+
+        unsigned i_sync_sample = p_stss->i_sample_number[i_low];
+        msg_Dbg( p_demux, "stts gives %d --> %d (sample number)",
+                 i_sample, i_sync_sample );
+
+        i_chunk = TrackSampleChunk( p_track, i_sync_sample );
+        i_sample = i_sync_sample;
     }
     else
     {
@@ -2421,11 +2413,16 @@ static int TrackGotoChunkSample( demux_t *p_demux, mp4_track_t *p_track,
                                  unsigned int i_chunk, unsigned int i_sample )
 {
     bool b_reselect = false;
+    mp4_chunk_t chunk;
+
+    if( i_chunk >= p_track->i_chunk_count )
+        return VLC_EGENERIC;
+    TrackLoadChunk( p_track, i_chunk, &chunk );
 
     /* now see if actual es is ok */
     if( p_track->i_chunk >= p_track->i_chunk_count ||
-        p_track->chunk[p_track->i_chunk].i_sample_description_index !=
-            p_track->chunk[i_chunk].i_sample_description_index )
+        p_track->chunk.i_sample_description_index !=
+            chunk.i_sample_description_index )
     {
         msg_Warn( p_demux, "recreate ES for track[Id 0x%x]",
                   p_track->i_track_ID );
@@ -2455,6 +2452,7 @@ static int TrackGotoChunkSample( demux_t *p_demux, mp4_track_t *p_track,
     }
 
     p_track->i_chunk    = i_chunk;
+    p_track->chunk      = chunk;
     p_track->i_sample   = i_sample;
 
     return p_track->b_selected ? VLC_SUCCESS : VLC_EGENERIC;
@@ -2641,6 +2639,8 @@ static void MP4_TrackCreate( demux_t *p_demux, mp4_track_t *p_track,
 
     p_track->i_chunk  = 0;
     p_track->i_sample = 0;
+    if( !p_sys->b_fragmented )
+        TrackLoadChunk( p_track, 0, &p_track->chunk );
 
     /* Mark chapter only track */
     if( p_sys->p_tref_chap )
@@ -2684,9 +2684,10 @@ static void MP4_TrackCreate( demux_t *p_demux, mp4_track_t *p_track,
         int i;
         for( i = 0; i < p_track->i_chunk_count; i++ )
         {
+            mp4_chunk_t chunk;
+            TrackLoadChunk( p_track, i, &chunk );
             fprintf( stderr, "%-5d sample_count=%d pts=%lld\n",
-                     i, p_track->chunk[i].i_sample_count,
-                     p_track->chunk[i].i_first_dts );
+                     i, chunk.i_sample_count, chunk.i_first_dts );
 
         }
     }
@@ -2713,35 +2714,22 @@ static void FreeAndResetChunk( mp4_chunk_t *ck )
  ****************************************************************************/
 static void MP4_TrackDestroy( mp4_track_t *p_track )
 {
-    unsigned int i_chunk;
-
     p_track->b_ok = false;
     p_track->b_enable   = false;
     p_track->b_selected = false;
 
     es_format_Clean( &p_track->fmt );
 
-    for( i_chunk = 0; i_chunk < p_track->i_chunk_count; i_chunk++ )
-    {
-        if( p_track->chunk )
-        {
-           FREENULL(p_track->chunk[i_chunk].p_sample_count_dts);
-           FREENULL(p_track->chunk[i_chunk].p_sample_delta_dts );
-
-           FREENULL(p_track->chunk[i_chunk].p_sample_count_pts);
-           FREENULL(p_track->chunk[i_chunk].p_sample_offset_pts );
-        }
-    }
-    FREENULL( p_track->chunk );
+    /* the chunk and sample tables point into the boxes */
+    FREENULL( p_track->p_stsc_sample_first );
+    FREENULL( p_track->p_stts_sample_first );
+    FREENULL( p_track->p_stts_dts_first );
+    FREENULL( p_track->p_ctts_sample_first );
     if( p_track->cchunk ) {
         FreeAndResetChunk( p_track->cchunk );
         FREENULL( p_track->cchunk );
     }
-
-    if( !p_track->i_sample_size )
-    {
-        FREENULL( p_track->p_sample_size );
-    }
+    p_track->p_sample_size = NULL;
 }
 
 static int MP4_TrackSelect( demux_t *p_demux, mp4_track_t *p_track,
@@ -2836,7 +2824,7 @@ static int MP4_TrackSampleSize( mp4_track_t *p_track )
 
     if( p_soun->i_qt_version == 1 )
     {
-        int i_samples = p_track->chunk[p_track->i_chunk].i_sample_count;
+        int i_samples = p_track->chunk.i_sample_count;
         if( p_track->fmt.audio.i_blockalign > 1 )
             i_samples = p_soun->i_sample_per_packet;
 
@@ -2851,9 +2839,9 @@ static int MP4_TrackSampleSize( mp4_track_t *p_track )
     else
     {
         /* Read a bunch of samples at once */
-        int i_samples = p_track->chunk[p_track->i_chunk].i_sample_count -
+        int i_samples = p_track->chunk.i_sample_count -
             ( p_track->i_sample -
-              p_track->chunk[p_track->i_chunk].i_sample_first );
+              p_track->chunk.i_sample_first );
 
         i_samples = __MIN( QT_V0_MAX_SAMPLES, i_samples );
         i_size = i_samples * p_track->i_sample_size;
@@ -2868,7 +2856,7 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
     unsigned int i_sample;
     uint64_t i_pos;
 
-    i_pos = p_track->chunk[p_track->i_chunk].i_offset;
+    i_pos = p_track->chunk.i_offset;
 
     if( p_track->i_sample_size )
     {
@@ -2878,20 +2866,20 @@ static uint64_t MP4_TrackGetPos( mp4_track_t *p_track )
         if( p_track->fmt.i_cat != AUDIO_ES || p_soun->i_qt_version == 0 )
         {
             i_pos += ( p_track->i_sample -
-                       p_track->chunk[p_track->i_chunk].i_sample_first ) *
+                       p_track->chunk.i_sample_first ) *
                      p_track->i_sample_size;
         }
         else
         {
             /* we read chunk by chunk unless a blockalign is requested */
             if( p_track->fmt.audio.i_blockalign > 1 )
-                i_pos += ( p_track->i_sample - p_track->chunk[p_track->i_chunk].i_sample_first ) /
+                i_pos += ( p_track->i_sample - p_track->chunk.i_sample_first ) /
                                 p_soun->i_sample_per_packet * p_soun->i_bytes_per_frame;
         }
     }
     else
     {
-        for( i_sample = p_track->chunk[p_track->i_chunk].i_sample_first;
+        for( i_sample = p_track->chunk.i_sample_first;
              i_sample < p_track->i_sample; i_sample++ )
         {
             i_pos += p_track->p_sample_size[i_sample];
@@ -2915,7 +2903,7 @@ static int MP4_TrackNextSample( demux_t *p_demux, mp4_track_t *p_track )
             if( p_track->fmt.audio.i_blockalign > 1 )
                 p_track->i_sample += p_soun->i_sample_per_packet;
             else
-                p_track->i_sample += p_track->chunk[p_track->i_chunk].i_sample_count;
+                p_track->i_sample += p_track->chunk.i_sample_count;
         }
         else if( p_track->i_sample_size > 256 )
         {
@@ -2928,12 +2916,12 @@ static int MP4_TrackNextSample( demux_t *p_demux, mp4_track_t *p_track )
             /* FIXME */
             p_track->i_sample += QT_V0_MAX_SAMPLES;
             if( p_track->i_sample >
-                p_track->chunk[p_track->i_chunk].i_sample_first +
-                p_track->chunk[p_track->i_chunk].i_sample_count )
+                p_track->chunk.i_sample_first +
+                p_track->chunk.i_sample_count )
             {
                 p_track->i_sample =
-                    p_track->chunk[p_track->i_chunk].i_sample_first +
-                    p_track->chunk[p_track->i_chunk].i_sample_count;
+                    p_track->chunk.i_sample_first +
+                    p_track->chunk.i_sample_count;
             }
         }
     }
@@ -2947,8 +2935,8 @@ static int MP4_TrackNextSample( demux_t *p_demux, mp4_track_t *p_track )
 
     /* Have we changed chunk ? */
     if( p_track->i_sample >=
-            p_track->chunk[p_track->i_chunk].i_sample_first +
-            p_track->chunk[p_track->i_chunk].i_sample_count )
+            p_track->chunk.i_sample_first +
+            p_track->chunk.i_sample_count )
     {
         if( TrackGotoChunkSample( p_demux, p_track, p_track->i_chunk + 1,
                                   p_track->i_sample ) )
@@ -287,6 +287,8 @@ struct demux_sys_t
 
     /* how many TS packet we read at once */
     int         i_ts_read;
+    /* how many of them are peeked at once */
+    int         i_ts_peek;
 
     /* to determine length and time */
     int         i_pid_ref_pcr;
@@ -315,7 +317,6 @@ struct demux_sys_t
 
     bool        b_udp_out;
     int         fd; /* udp socket */
-    uint8_t     *buffer;
     bool        b_trust_pcr;
 
     /* */
@@ -355,21 +356,22 @@ static void PSINewTableCallBack( demux_t *, dvbpsi_handle,
 
 static int ChangeKeyCallback( vlc_object_t *, char const *, vlc_value_t, vlc_value_t, void * );
 
-static inline int PIDGet( block_t *p )
+static inline int PIDGet( const uint8_t *p )
 {
-    return ( (p->p_buffer[1]&0x1f)<<8 )|p->p_buffer[2];
+    return ( (p[1]&0x1f)<<8 )|p[2];
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk );
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p );
 
 static block_t* ReadTSPacket( demux_t *p_demux );
-static mtime_t GetPCR( block_t *p_pkt );
+static int ResyncTSPacket( const uint8_t *, int, int );
+static mtime_t GetPCR( const uint8_t *p );
 static int SeekToPCR( demux_t *p_demux, int64_t i_pos );
 static int Seek( demux_t *p_demux, double f_percent );
 static void GetFirstPCR( demux_t *p_demux );
 static void GetLastPCR( demux_t *p_demux );
 static void CheckPCR( demux_t *p_demux );
-static void PCRHandle( demux_t *p_demux, ts_pid_t *, block_t * );
+static void PCRHandle( demux_t *p_demux, ts_pid_t *, const uint8_t * );
 
 static void              IODFree( iod_descriptor_t * );
 
@@ -570,7 +572,6 @@ static int Open( vlc_object_t *p_this )
     p_sys->i_packet_size = i_packet_size;
     vlc_mutex_init( &p_sys->csa_lock );
 
-    p_sys->buffer = NULL;
     p_demux->pf_demux = Demux;
     p_demux->pf_control = Control;
 
@@ -599,6 +600,7 @@ static int Open( vlc_object_t *p_this )
     p_sys->b_udp_out = false;
     p_sys->fd = -1;
     p_sys->i_ts_read = 50;
+    p_sys->i_ts_peek = 1;
     p_sys->csa = NULL;
     p_sys->b_start_record = false;
 
@@ -728,7 +730,8 @@ static int Open( vlc_object_t *p_this )
             {
                 p_sys->i_ts_read = 1500 / p_sys->i_packet_size;
             }
-            p_sys->buffer = xmalloc( p_sys->i_packet_size * p_sys->i_ts_read );
+            /* The packets are sent out by whole datagrams */
+            p_sys->i_ts_peek = p_sys->i_ts_read;
         }
     }
     free( psz_string );
@@ -802,6 +805,10 @@ static int Open( vlc_object_t *p_this )
     stream_Control( p_demux->s, STREAM_CAN_FASTSEEK, &can_seek );
     if( can_seek  )
     {
+        /* Local data is always available: walk larger chunks at once */
+        if( !p_sys->b_udp_out )
+            p_sys->i_ts_read = 500;
+        p_sys->i_ts_peek = p_sys->i_ts_read;
         GetFirstPCR( p_demux );
         CheckPCR( p_demux );
         GetLastPCR( p_demux );
@@ -903,8 +910,6 @@ static void Close( vlc_object_t *p_this )
         net_Close( p_sys->fd );
     }
 
-    free( p_sys->buffer );
-
     free( p_sys->p_pcrs );
     free( p_sys->p_pos );
 
@@ -937,33 +942,28 @@ static int ChangeKeyCallback( vlc_object_t *p_this, char const *psz_cmd,
 /*****************************************************************************
  * Demux:
  *****************************************************************************/
-static int Demux( demux_t *p_demux )
+/* Demuxes the packets of a peeked chunk in place: only the payload of the
+ * elementary streams we actually output is copied into blocks.
+ * Returns the number of bytes used. */
+static int DemuxPackets( demux_t *p_demux, const uint8_t *p_peek, int i_peek,
+                         bool b_wait_es, bool *pb_done )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
-    bool b_wait_es = p_sys->i_pmt_es <= 0;
+    const int i_packet_size = p_sys->i_packet_size;
 
-    /* We read at most 100 TS packet or until a frame is completed */
-    for( int i_pkt = 0; i_pkt < p_sys->i_ts_read; i_pkt++ )
+    int i_read = 0;
+    while( i_read + i_packet_size <= i_peek )
     {
-        bool         b_frame = false;
-        block_t     *p_pkt;
-        if( !(p_pkt = ReadTSPacket( p_demux )) )
-        {
-            return 0;
-        }
+        const uint8_t *p_pkt = &p_peek[i_read];
+        bool b_frame = false;
 
-        if( p_sys->b_start_record )
+        /* Stop on lost synchro, it will be handled on the next call */
+        if( p_pkt[0] != 0x47 )
         {
-            /* Enable recording once synchronized */
-            stream_Control( p_demux->s, STREAM_SET_RECORD_STATE, true, "ts" );
-            p_sys->b_start_record = false;
-        }
-
-        if( p_sys->b_udp_out )
-        {
-            memcpy( &p_sys->buffer[i_pkt * p_sys->i_packet_size],
-                    p_pkt->p_buffer, p_sys->i_packet_size );
+            *pb_done = true;
+            break;
         }
+        i_read += i_packet_size;
 
         /* Parse the TS packet */
         ts_pid_t *p_pid = &p_sys->pid[PIDGet( p_pkt )];
@@ -974,17 +974,16 @@ static int Demux( demux_t *p_demux )
             {
                 if( p_pid->i_pid == 0 || ( p_sys->b_dvb_meta && ( p_pid->i_pid == 0x11 || p_pid->i_pid == 0x12 || p_pid->i_pid == 0x14 ) ) )
                 {
-                    dvbpsi_PushPacket( p_pid->psi->handle, p_pkt->p_buffer );
+                    dvbpsi_PushPacket( p_pid->psi->handle, (uint8_t *)p_pkt );
                 }
                 else
                 {
                     for( int i_prg = 0; i_prg < p_pid->psi->i_prg; i_prg++ )
                     {
                         dvbpsi_PushPacket( p_pid->psi->prg[i_prg]->handle,
-                                           p_pkt->p_buffer );
+                                           (uint8_t *)p_pkt );
                     }
                 }
-                block_Release( p_pkt );
             }
             else if( !p_sys->b_udp_out )
             {
@@ -993,7 +992,6 @@ static int Demux( demux_t *p_demux )
             else
             {
                 PCRHandle( p_demux, p_pid, p_pkt );
-                block_Release( p_pkt );
             }
         }
         else
@@ -1004,19 +1002,79 @@ static int Demux( demux_t *p_demux )
             }
             /* We have to handle PCR if present */
             PCRHandle( p_demux, p_pid, p_pkt );
-            block_Release( p_pkt );
         }
         p_pid->b_seen = true;
 
         if( b_frame || ( b_wait_es && p_sys->i_pmt_es > 0 ) )
+        {
+            *pb_done = true;
             break;
+        }
     }
 
-    if( p_sys->b_udp_out )
+    return i_read;
+}
+
+static int Demux( demux_t *p_demux )
+{
+    demux_sys_t *p_sys = p_demux->p_sys;
+    const int i_packet_size = p_sys->i_packet_size;
+    bool b_wait_es = p_sys->i_pmt_es <= 0;
+    bool b_done = false;
+    int i_pkt = 0;
+
+    /* We read at most i_ts_read TS packets or until a frame is completed.
+     * Live inputs are peeked one packet at a time, so that we never wait
+     * for more data than we need at low bitrates. */
+    while( i_pkt < p_sys->i_ts_read && !b_done )
     {
-        /* Send the complete block */
-        net_Write( p_demux, p_sys->fd, NULL, p_sys->buffer,
-                   p_sys->i_ts_read * p_sys->i_packet_size );
+        const int i_chunk = __MIN( p_sys->i_ts_peek, p_sys->i_ts_read - i_pkt );
+        const uint8_t *p_peek;
+        int i_peek;
+
+        for( ;; )
+        {
+            i_peek = stream_Peek( p_demux->s, &p_peek, i_packet_size * i_chunk );
+            if( i_peek >= i_packet_size && p_peek[0] == 0x47 )
+                break;
+
+            /* Resynchronising looks two packets ahead */
+            if( i_peek < 2 * i_packet_size )
+                i_peek = stream_Peek( p_demux->s, &p_peek, 2 * i_packet_size );
+            if( i_peek < i_packet_size + 1 )
+            {
+                msg_Dbg( p_demux, "eof ?" );
+                return i_pkt > 0;
+            }
+
+            /* Check sync byte and re-sync if needed */
+            msg_Warn( p_demux, "lost synchro" );
+            int i_skip = ResyncTSPacket( p_peek, i_peek, i_packet_size );
+            msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
+            if( stream_Read( p_demux->s, NULL, i_skip ) < i_skip )
+                return i_pkt > 0;
+        }
+
+        if( p_sys->b_start_record )
+        {
+            /* Enable recording once synchronized */
+            stream_Control( p_demux->s, STREAM_SET_RECORD_STATE, true, "ts" );
+            p_sys->b_start_record = false;
+        }
+
+        int i_read = DemuxPackets( p_demux, p_peek, i_peek, b_wait_es,
+                                   &b_done );
+
+        if( p_sys->b_udp_out )
+        {
+            /* Send the complete block straight from the stream buffer */
+            net_Write( p_demux, p_sys->fd, NULL, p_peek, i_read );
+        }
+
+        /* Consume what has been demuxed (the peek buffer is invalid past
+         * this) */
+        stream_Read( p_demux->s, NULL, i_read );
+        i_pkt += i_read / i_packet_size;
     }
 
     demux_UpdateTitleFromStream( p_demux );
@@ -1862,6 +1920,24 @@ static void ParseData( demux_t *p_demux, ts_pid_t *pid )
     }
 }
 
+/* Returns the number of bytes to skip to reach the next sync byte
+ * followed by another one a packet further */
+static int ResyncTSPacket( const uint8_t *p_peek, int i_peek, int i_packet_size )
+{
+    int i_skip = 0;
+
+    while( i_skip < i_peek - i_packet_size )
+    {
+        if( p_peek[i_skip] == 0x47 &&
+                p_peek[i_skip + i_packet_size] == 0x47 )
+        {
+            break;
+        }
+        i_skip++;
+    }
+    return i_skip;
+}
+
 static block_t* ReadTSPacket( demux_t *p_demux )
 {
     demux_sys_t *p_sys = p_demux->p_sys;
@@ -1893,15 +1969,7 @@ static block_t* ReadTSPacket( demux_t *p_demux )
                 return NULL;
             }
 
-            while( i_skip < i_peek - p_sys->i_packet_size )
-            {
-                if( p_peek[i_skip] == 0x47 &&
-                        p_peek[i_skip + p_sys->i_packet_size] == 0x47 )
-                {
-                    break;
-                }
-                i_skip++;
-            }
+            i_skip = ResyncTSPacket( p_peek, i_peek, p_sys->i_packet_size );
             msg_Dbg( p_demux, "skipping %d bytes of garbage", i_skip );
             stream_Read( p_demux->s, NULL, i_skip );
 
@@ -1940,10 +2008,8 @@ static mtime_t AdjustPCRWrapAround( demux_t *p_demux, mtime_t i_pcr )
     return i_pcr + i_adjust;
 }
 
-static mtime_t GetPCR( block_t *p_pkt )
+static mtime_t GetPCR( const uint8_t *p )
 {
-    const uint8_t *p = p_pkt->p_buffer;
-
     mtime_t i_pcr = -1;
 
     if( ( p[3]&0x20 ) && /* adaptation */
@@ -1986,9 +2052,9 @@ static int SeekToPCR( demux_t *p_demux, int64_t i_pos )
         {
             break;
         }
-        if( PIDGet( p_pkt ) == p_sys->i_pid_ref_pcr )
+        if( PIDGet( p_pkt->p_buffer ) == p_sys->i_pid_ref_pcr )
         {
-            i_pcr = GetPCR( p_pkt );
+            i_pcr = GetPCR( p_pkt->p_buffer );
         }
         block_Release( p_pkt );
         if( i_pcr >= 0 )
@@ -2092,10 +2158,10 @@ static void GetFirstPCR( demux_t *p_demux )
         {
             break;
         }
-        mtime_t i_pcr = GetPCR( p_pkt );
+        mtime_t i_pcr = GetPCR( p_pkt->p_buffer );
         if( i_pcr >= 0 )
         {
-            p_sys->i_pid_ref_pcr = PIDGet( p_pkt );
+            p_sys->i_pid_ref_pcr = PIDGet( p_pkt->p_buffer );
             p_sys->i_first_pcr = i_pcr;
             p_sys->i_current_pcr = i_pcr;
         }
@@ -2180,14 +2246,14 @@ static void CheckPCR( demux_t *p_demux )
     p_sys->i_current_pcr = i_initial_pcr;
 }
 
-static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
 {
     demux_sys_t   *p_sys = p_demux->p_sys;
 
     if( p_sys->i_pmt_es <= 0 )
         return;
 
-    mtime_t i_pcr = GetPCR( p_bk );
+    mtime_t i_pcr = GetPCR( p );
     if( i_pcr < 0 )
         return;
 
@@ -2207,9 +2273,8 @@ static void PCRHandle( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             }
 }
 
-static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
+static bool GatherData( demux_t *p_demux, ts_pid_t *pid, const uint8_t *p )
 {
-    const uint8_t *p = p_bk->p_buffer;
     const bool b_unit_start = p[1]&0x40;
     const bool b_scrambled  = p[3]&0x80;
     const bool b_adaptation = p[3]&0x20;
@@ -2227,10 +2292,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
              b_payload, i_cc );
 #endif
 
-    /* For now, ignore additional error correction
-     * TODO: handle Reed-Solomon 204,188 error correction */
-    p_bk->i_buffer = TS_PACKET_SIZE_188;
-
     if( p[1]&0x80 )
     {
         msg_Dbg( p_demux, "transport_error_indicator set (pid=%d)",
@@ -2239,13 +2300,6 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
             pid->es->p_data->i_flags |= BLOCK_FLAG_CORRUPTED;
     }
 
-    if( p_demux->p_sys->csa )
-    {
-        vlc_mutex_lock( &p_demux->p_sys->csa_lock );
-        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
-        vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
-    }
-
     if( !b_adaptation )
     {
         /* We don't have any adaptation_field, so payload starts
@@ -2308,12 +2362,24 @@ static bool GatherData( demux_t *p_demux, ts_pid_t *pid, block_t *p_bk )
         }
     }
 
-    PCRHandle( p_demux, pid, p_bk );
+    PCRHandle( p_demux, pid, p );
 
+    /* Packets of unused PIDs are never copied out of the stream buffer */
     if( i_skip >= 188 || pid->es->id == NULL || p_demux->p_sys->b_udp_out )
-    {
-        block_Release( p_bk );
         return i_ret;
+
+    /* For now, ignore additional error correction
+     * TODO: handle Reed-Solomon 204,188 error correction */
+    block_t *p_bk = block_Alloc( TS_PACKET_SIZE_188 );
+    if( unlikely(p_bk == NULL) )
+        return i_ret;
+    memcpy( p_bk->p_buffer, p, TS_PACKET_SIZE_188 );
+
+    if( p_demux->p_sys->csa )
+    {
+        vlc_mutex_lock( &p_demux->p_sys->csa_lock );
+        csa_Decrypt( p_demux->p_sys->csa, p_bk->p_buffer, p_demux->p_sys->i_csa_pkt_size );
+        vlc_mutex_unlock( &p_demux->p_sys->csa_lock );
     }
 
     /* */
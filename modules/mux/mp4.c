@@ -48,6 +48,15 @@
     "Create \"Fast Start\" files. " \
     "\"Fast Start\" files are optimized for downloads and allow the user " \
     "to start previewing the file while it is downloading.")
+#define FRAGMENTED_TEXT N_("Create fragmented files")
+#define FRAGMENTED_LONGTEXT N_(\
+    "Write the movie header first, then the samples as a sequence of " \
+    "movie fragments. The output is playable while it is being written " \
+    "and does not need to be seekable.")
+#define FRAGDURATION_TEXT N_("Fragment duration (ms)")
+#define FRAGDURATION_LONGTEXT N_(\
+    "Fragments are cut at the first key frame after this duration. " \
+    "With 0, every key frame starts a new fragment.")
 
 static int  Open   (vlc_object_t *);
 static void Close  (vlc_object_t *);
@@ -63,6 +72,13 @@ vlc_module_begin ()
     add_bool(SOUT_CFG_PREFIX "faststart", true,
               FASTSTART_TEXT, FASTSTART_LONGTEXT,
               true)
+    add_bool(SOUT_CFG_PREFIX "fragmented", false,
+              FRAGMENTED_TEXT, FRAGMENTED_LONGTEXT,
+              true)
+    add_integer(SOUT_CFG_PREFIX "fragment-duration", 2000,
+                 FRAGDURATION_TEXT, FRAGDURATION_LONGTEXT,
+                 true)
+        change_integer_range(0, 3600000)
     set_capability("sout mux", 5)
     add_shortcut("mp4", "mov", "3gp")
     set_callbacks(Open, Close)
@@ -72,7 +88,7 @@ vlc_module_end ()
  * Exported prototypes
  *****************************************************************************/
 static const char *const ppsz_sout_options[] = {
-    "faststart", NULL
+    "faststart", "fragmented", "fragment-duration", NULL
 };
 
 static int Control(sout_mux_t *, int, va_list);
@@ -116,6 +132,13 @@ typedef struct
     /* for spu */
     int64_t i_last_dts;
 
+    /* for fragmented files */
+    bool     b_started;
+    int64_t  i_frag_time;   /* decode time of the held samples */
+    block_t  *p_held;       /* samples of the current fragment */
+    block_t  **pp_held_last;
+    int      i_trun_pos;    /* for later data offset fix-up */
+
 } mp4_stream_t;
 
 struct sout_mux_sys_t
@@ -132,6 +155,14 @@ struct sout_mux_sys_t
 
     int          i_nb_streams;
     mp4_stream_t **pp_streams;
+
+    /* fragmented files */
+    bool     b_fragmented;
+    bool     b_header_sent;
+    mtime_t  i_frag_duration;
+    mtime_t  i_frag_start;  /* dts of the first sample of the fragment */
+    uint32_t i_frag_seq;
+    mp4_stream_t *p_frag_track; /* fragments start on its key frames */
 };
 
 typedef struct bo_t
@@ -160,6 +191,8 @@ static void  box_gather  (bo_t *box, bo_t *box2);
 static void box_send(sout_mux_t *p_mux,  bo_t *box);
 
 static bo_t *GetMoovBox(sout_mux_t *p_mux);
+static void WriteFragmentedHeader(sout_mux_t *p_mux);
+static void WriteFragment(sout_mux_t *p_mux);
 
 static block_t *ConvertSUBT(block_t *);
 static block_t *ConvertAVC1(block_t *);
@@ -192,7 +225,14 @@ static int Open(vlc_object_t *p_this)
     p_sys->b_mov        = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "mov");
     p_sys->b_3gp        = p_mux->psz_mux && !strcmp(p_mux->psz_mux, "3gp");
     p_sys->i_dts_start  = 0;
-
+    p_sys->b_fragmented = var_GetBool(p_mux, SOUT_CFG_PREFIX "fragmented");
+    p_sys->b_header_sent = false;
+    /* Chain options are not range checked */
+    p_sys->i_frag_duration = __MAX(var_GetInteger(p_mux,
+                                SOUT_CFG_PREFIX "fragment-duration"), 0) * 1000;
+    p_sys->i_frag_start = VLC_TS_INVALID;
+    p_sys->i_frag_seq   = 0;
+    p_sys->p_frag_track = NULL;
 
     if (!p_sys->b_mov) {
         /* Now add ftyp header */
@@ -208,11 +248,17 @@ static int Open(vlc_object_t *p_this)
             bo_add_fourcc(box, "mp41");
         bo_add_fourcc(box, "avc1");
         bo_add_fourcc(box, "qt  ");
+        if (p_sys->b_fragmented && !p_sys->b_3gp) {
+            bo_add_fourcc(box, "iso5");
+            bo_add_fourcc(box, "iso6");
+        }
         box_fix(box);
 
         p_sys->i_pos += box->len;
         p_sys->i_mdat_pos = p_sys->i_pos;
 
+        if (p_sys->b_fragmented)
+            box->b->i_flags |= BLOCK_FLAG_HEADER;
         box_send(p_mux, box);
     }
 
@@ -220,6 +266,10 @@ static int Open(vlc_object_t *p_this)
      * Quicktime actually doesn't like the 64 bits extensions !!! */
     p_sys->b_64_ext = false;
 
+    /* Fragments come with their own mdat */
+    if (p_sys->b_fragmented)
+        return VLC_SUCCESS;
+
     /* Now add mdat header */
     box = box_new("mdat");
     bo_add_64be  (box, 0); // enough to store an extended size
@@ -241,6 +291,14 @@ static void Close(vlc_object_t *p_this)
 
     msg_Dbg(p_mux, "Close");
 
+    if (p_sys->b_fragmented) {
+        /* The moov was sent before the first samples */
+        if (!p_sys->b_header_sent)
+            WriteFragmentedHeader(p_mux);
+        WriteFragment(p_mux);
+        goto cleanup;
+    }
+
     /* Update mdat size */
     bo_t bo;
     bo_init(&bo);
@@ -323,6 +381,7 @@ static void Close(vlc_object_t *p_this)
     sout_AccessOutSeek(p_mux->p_access, i_moov_pos);
     box_send(p_mux, moov);
 
+cleanup:
     /* Clean-up */
     for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
@@ -341,8 +400,8 @@ static void Close(vlc_object_t *p_this)
  *****************************************************************************/
 static int Control(sout_mux_t *p_mux, int i_query, va_list args)
 {
-    VLC_UNUSED(p_mux);
     bool *pb_bool;
+    char **ppsz;
 
     switch(i_query)
     {
@@ -356,7 +415,13 @@ static int Control(sout_mux_t *p_mux, int i_query, va_list args)
         *pb_bool = true;
         return VLC_SUCCESS;
 
-    case MUX_GET_MIME:   /* Not needed, as not streamable */
+    case MUX_GET_MIME:   /* Only fragmented files are streamable */
+        if (!p_mux->p_sys->b_fragmented)
+            return VLC_EGENERIC;
+        ppsz = (char**)va_arg(args, char **);
+        *ppsz = strdup("video/mp4");
+        return VLC_SUCCESS;
+
     default:
         return VLC_EGENERIC;
     }
@@ -370,6 +435,12 @@ static int AddStream(sout_mux_t *p_mux, sout_input_t *p_input)
     sout_mux_sys_t  *p_sys = p_mux->p_sys;
     mp4_stream_t    *p_stream;
 
+    /* The movie header with the track list is already out */
+    if (p_sys->b_header_sent) {
+        msg_Err(p_mux, "cannot add a stream to a started fragmented file");
+        return VLC_EGENERIC;
+    }
+
     switch(p_input->p_fmt->i_codec)
     {
     case VLC_CODEC_MP4A:
@@ -408,6 +479,10 @@ static int AddStream(sout_mux_t *p_mux, sout_input_t *p_input)
         calloc(p_stream->i_entry_max, sizeof(mp4_entry_t));
     p_stream->i_dts_start   = 0;
     p_stream->i_duration    = 0;
+    p_stream->b_started     = false;
+    p_stream->i_frag_time   = 0;
+    p_stream->p_held        = NULL;
+    p_stream->pp_held_last  = &p_stream->p_held;
 
     p_input->p_sys          = p_stream;
 
@@ -427,6 +502,203 @@ static int DelStream(sout_mux_t *p_mux, sout_input_t *p_input)
     return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * Fragments:
+ *****************************************************************************/
+/* trun sample flags */
+#define SAMPLE_FLAGS_SYNC       0x02000000 /* depends on no other sample */
+#define SAMPLE_FLAGS_NON_SYNC   0x01010000 /* depends on others, non sync */
+
+static uint32_t GetTimescale(const mp4_stream_t *p_stream)
+{
+    if (p_stream->fmt.i_cat == AUDIO_ES)
+        return p_stream->fmt.audio.i_rate;
+    return CLOCK_FREQ;
+}
+
+static uint64_t ToTimescale(const mp4_stream_t *p_stream, int64_t i_time)
+{
+    return i_time * (int64_t)GetTimescale(p_stream) / CLOCK_FREQ;
+}
+
+static bool IsSyncSample(const mp4_stream_t *p_stream, unsigned i_flags)
+{
+    return p_stream->fmt.i_cat != VIDEO_ES || (i_flags & BLOCK_FLAG_TYPE_I);
+}
+
+static void WriteFragmentedHeader(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+
+    /* All the streams are known by now: the moov has the sample
+     * descriptions and empty sample tables */
+    bo_t *moov = GetMoovBox(p_mux);
+    moov->b->i_flags |= BLOCK_FLAG_HEADER;
+    box_send(p_mux, moov);
+    p_sys->b_header_sent = true;
+
+    /* Cut on the video key frames, or anywhere in the audio */
+    for (int i = 0; i < p_sys->i_nb_streams; i++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i];
+
+        if (p_stream->fmt.i_cat == VIDEO_ES) {
+            p_sys->p_frag_track = p_stream;
+            break;
+        }
+        if (p_sys->p_frag_track == NULL && p_stream->fmt.i_cat != SPU_ES)
+            p_sys->p_frag_track = p_stream;
+    }
+}
+
+static bool FragmentDue(sout_mux_t *p_mux, mp4_stream_t *p_stream,
+                        const block_t *p_data)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    mtime_t i_elapsed = p_data->i_dts - p_sys->i_frag_start;
+
+    if (p_stream == p_sys->p_frag_track &&
+        IsSyncSample(p_stream, p_data->i_flags) &&
+        i_elapsed >= p_sys->i_frag_duration)
+        return true;
+
+    /* Bound the held samples when the key frames do not come */
+    return i_elapsed >= __MAX(4 * p_sys->i_frag_duration, 10 * CLOCK_FREQ);
+}
+
+static void WriteSample(sout_mux_t *p_mux, mp4_stream_t *p_stream,
+                        block_t *p_data)
+{
+    if (p_mux->p_sys->b_fragmented)
+        block_ChainLastAppend(&p_stream->pp_held_last, p_data);
+    else
+        sout_AccessOutWrite(p_mux->p_access, p_data);
+}
+
+/* Writes the held samples of all the streams as one moof and mdat pair */
+static void WriteFragment(sout_mux_t *p_mux)
+{
+    sout_mux_sys_t *p_sys = p_mux->p_sys;
+    uint64_t i_data = 0;
+    bool b_empty = true;
+
+    p_sys->i_frag_start = VLC_TS_INVALID;
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++)
+        if (p_sys->pp_streams[i_trak]->i_entry_count > 0)
+            b_empty = false;
+    if (b_empty)
+        return;
+
+    bo_t *moof = box_new("moof");
+    bo_t *mfhd = box_full_new("mfhd", 0, 0);
+    bo_add_32be(mfhd, ++p_sys->i_frag_seq);  // sequence number
+    box_gather(moof, mfhd);
+
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        if (p_stream->i_entry_count == 0)
+            continue;
+
+        bo_t *traf = box_new("traf");
+
+        /* default-base-is-moof: data offsets are from the moof start */
+        bo_t *tfhd = box_full_new("tfhd", 0, 0x020000);
+        bo_add_32be(tfhd, p_stream->i_track_id);
+        box_gather(traf, tfhd);
+
+        bo_t *tfdt = box_full_new("tfdt", 1, 0);
+        bo_add_64be(tfdt, ToTimescale(p_stream, p_stream->i_frag_time));
+        box_gather(traf, tfdt);
+
+        bool b_cts = false;
+        for (unsigned i = 0; i < p_stream->i_entry_count; i++)
+            if (p_stream->entry[i].i_pts_dts > 0)
+                b_cts = true;
+
+        /* data offset, sample duration, size, flags and cts offset */
+        bo_t *trun = box_full_new("trun", 0,
+                                  0x000001 | 0x000100 | 0x000200 | 0x000400 |
+                                  (b_cts ? 0x000800 : 0));
+        bo_add_32be(trun, p_stream->i_entry_count); // sample count
+        bo_add_32be(trun, 0);                       // data offset (fixed later)
+
+        /* Convert the ends rather than the lengths, so that the rounding
+         * errors do not add up */
+        int64_t i_time = p_stream->i_frag_time;
+        for (unsigned i = 0; i < p_stream->i_entry_count; i++) {
+            mp4_entry_t *e = &p_stream->entry[i];
+            uint64_t i_start = ToTimescale(p_stream, i_time);
+
+            i_time += e->i_length;
+            bo_add_32be(trun, ToTimescale(p_stream, i_time) - i_start);
+            bo_add_32be(trun, e->i_size);
+            bo_add_32be(trun, IsSyncSample(p_stream, e->i_flags) ?
+                              SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC);
+            if (b_cts)
+                bo_add_32be(trun, ToTimescale(p_stream, i_time - e->i_length
+                                              + e->i_pts_dts) - i_start);
+            i_data += e->i_size;
+        }
+        p_stream->i_frag_time = i_time;
+
+        p_stream->i_trun_pos = traf->len + 16;
+        box_gather(traf, trun);
+
+        p_stream->i_trun_pos += moof->len;
+        box_gather(moof, traf);
+    }
+
+    box_fix(moof);
+
+    bo_t mdat;
+    bo_init(&mdat);
+    if (i_data + 8 >= (((uint64_t)1)<<32)) {
+        /* Extended size */
+        bo_add_32be  (&mdat, 1);
+        bo_add_fourcc(&mdat, "mdat");
+        bo_add_64be  (&mdat, i_data + 16);
+    } else {
+        bo_add_32be  (&mdat, i_data + 8);
+        bo_add_fourcc(&mdat, "mdat");
+    }
+    mdat.b->i_buffer = mdat.len;
+
+    /* Fix-up data offsets, the samples follow the mdat header in the
+     * order of the trafs */
+    uint64_t i_offset = moof->len + mdat.len;
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        if (p_stream->i_entry_count == 0)
+            continue;
+
+        bo_fix_32be(moof, p_stream->i_trun_pos, i_offset);
+        for (unsigned i = 0; i < p_stream->i_entry_count; i++)
+            i_offset += p_stream->entry[i].i_size;
+    }
+
+    /* Late http clients join on a fragment */
+    moof->b->i_flags |= BLOCK_FLAG_TYPE_I;
+    box_send(p_mux, moof);
+    sout_AccessOutWrite(p_mux->p_access, mdat.b);
+
+    for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+        mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
+
+        while (p_stream->p_held != NULL) {
+            block_t *p_data = p_stream->p_held;
+
+            p_stream->p_held = p_data->p_next;
+            p_data->p_next = NULL;
+            /* Only the moof is a place to start from */
+            p_data->i_flags &= ~BLOCK_FLAG_TYPE_MASK;
+            sout_AccessOutWrite(p_mux->p_access, p_data);
+        }
+        p_stream->pp_held_last = &p_stream->p_held;
+        p_stream->i_entry_count = 0;
+    }
+}
+
 /*****************************************************************************
  * Mux:
  *****************************************************************************/
@@ -439,6 +711,9 @@ static int Mux(sout_mux_t *p_mux)
         if (i_stream < 0)
             return(VLC_SUCCESS);
 
+        if (p_sys->b_fragmented && !p_sys->b_header_sent)
+            WriteFragmentedHeader(p_mux);
+
         sout_input_t *p_input  = p_mux->pp_inputs[i_stream];
         mp4_stream_t *p_stream = (mp4_stream_t*)p_input->p_sys;
 
@@ -472,13 +747,27 @@ static int Mux(sout_mux_t *p_mux)
             }
         }
 
+        if (p_sys->b_fragmented) {
+            if (p_sys->i_frag_start > VLC_TS_INVALID &&
+                FragmentDue(p_mux, p_stream, p_data))
+                WriteFragment(p_mux);
+            if (p_sys->i_frag_start <= VLC_TS_INVALID)
+                p_sys->i_frag_start = p_data->i_dts;
+        }
+
         /* Save starting time */
-        if (p_stream->i_entry_count == 0) {
+        if (!p_stream->b_started) {
+            p_stream->b_started = true;
             p_stream->i_dts_start = p_data->i_dts;
 
-            /* Update global dts_start */
-            if (p_sys->i_dts_start <= 0 || p_stream->i_dts_start < p_sys->i_dts_start)
+            /* Update global dts_start, fragments are timed from the first
+             * sample written */
+            if (p_sys->i_dts_start <= 0 || (!p_sys->b_fragmented &&
+                p_stream->i_dts_start < p_sys->i_dts_start))
                 p_sys->i_dts_start = p_stream->i_dts_start;
+
+            if (p_stream->i_dts_start > p_sys->i_dts_start)
+                p_stream->i_frag_time = p_stream->i_dts_start - p_sys->i_dts_start;
         }
 
         if (p_stream->fmt.i_cat == SPU_ES && p_stream->i_entry_count > 0) {
@@ -518,7 +807,7 @@ static int Mux(sout_mux_t *p_mux)
         p_stream->i_last_dts = p_data->i_dts;
 
         /* write data */
-        sout_AccessOutWrite(p_mux->p_access, p_data);
+        WriteSample(p_mux, p_stream, p_data);
 
         if (p_stream->fmt.i_cat == SPU_ES) {
             int64_t i_length = p_stream->entry[p_stream->i_entry_count-1].i_length;
@@ -549,7 +838,7 @@ static int Mux(sout_mux_t *p_mux)
 
                 p_sys->i_pos += p_data->i_buffer;
 
-                sout_AccessOutWrite(p_mux->p_access, p_data);
+                WriteSample(p_mux, p_stream, p_data);
             }
 
             /* Fix duration */
@@ -1143,11 +1432,7 @@ static bo_t *GetStblBox(sout_mux_t *p_mux, mp4_stream_t *p_stream)
     bo_t *stts = box_full_new("stts", 0, 0);
     bo_add_32be(stts, 0);     // entry-count (fixed latter)
 
-    uint32_t i_timescale;
-    if (p_stream->fmt.i_cat == AUDIO_ES)
-        i_timescale = p_stream->fmt.audio.i_rate;
-    else
-        i_timescale = CLOCK_FREQ;
+    uint32_t i_timescale = GetTimescale(p_stream);
 
     unsigned i_index = 0;
     for (unsigned i = 0; i < p_stream->i_entry_count; i_index++) {
@@ -1262,11 +1547,7 @@ static bo_t *GetMoovBox(sout_mux_t *p_mux)
     for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
         mp4_stream_t *p_stream = p_sys->pp_streams[i_trak];
 
-        uint32_t i_timescale;
-        if (p_stream->fmt.i_cat == AUDIO_ES)
-            i_timescale = p_stream->fmt.audio.i_rate;
-        else
-            i_timescale = CLOCK_FREQ;
+        uint32_t i_timescale = GetTimescale(p_stream);
 
         /* *** add /moov/trak *** */
         bo_t *trak = box_new("trak");
@@ -1345,40 +1626,43 @@ static bo_t *GetMoovBox(sout_mux_t *p_mux)
 
         box_gather(trak, tkhd);
 
-        /* *** add /moov/trak/edts and elst */
-        bo_t *edts = box_new("edts");
-        bo_t *elst = box_full_new("elst", p_sys->b_64_ext ? 1 : 0, 0);
-        if (p_stream->i_dts_start > p_sys->i_dts_start) {
-            bo_add_32be(elst, 2);
-
+        /* *** add /moov/trak/edts and elst, fragments are placed by their
+         * decode time */
+        if (!p_sys->b_fragmented) {
+            bo_t *edts = box_new("edts");
+            bo_t *elst = box_full_new("elst", p_sys->b_64_ext ? 1 : 0, 0);
+            if (p_stream->i_dts_start > p_sys->i_dts_start) {
+                bo_add_32be(elst, 2);
+
+                if (p_sys->b_64_ext) {
+                    bo_add_64be(elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                                 i_movie_timescale / CLOCK_FREQ);
+                    bo_add_64be(elst, -1);
+                } else {
+                    bo_add_32be(elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                                 i_movie_timescale / CLOCK_FREQ);
+                    bo_add_32be(elst, -1);
+                }
+                bo_add_16be(elst, 1);
+                bo_add_16be(elst, 0);
+            } else {
+                bo_add_32be(elst, 1);
+            }
             if (p_sys->b_64_ext) {
-                bo_add_64be(elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                bo_add_64be(elst, p_stream->i_duration *
                              i_movie_timescale / CLOCK_FREQ);
-                bo_add_64be(elst, -1);
+                bo_add_64be(elst, 0);
             } else {
-                bo_add_32be(elst, (p_stream->i_dts_start-p_sys->i_dts_start) *
+                bo_add_32be(elst, p_stream->i_duration *
                              i_movie_timescale / CLOCK_FREQ);
-                bo_add_32be(elst, -1);
+                bo_add_32be(elst, 0);
             }
             bo_add_16be(elst, 1);
             bo_add_16be(elst, 0);
-        } else {
-            bo_add_32be(elst, 1);
-        }
-        if (p_sys->b_64_ext) {
-            bo_add_64be(elst, p_stream->i_duration *
-                         i_movie_timescale / CLOCK_FREQ);
-            bo_add_64be(elst, 0);
-        } else {
-            bo_add_32be(elst, p_stream->i_duration *
-                         i_movie_timescale / CLOCK_FREQ);
-            bo_add_32be(elst, 0);
-        }
-        bo_add_16be(elst, 1);
-        bo_add_16be(elst, 0);
 
-        box_gather(edts, elst);
-        box_gather(trak, edts);
+            box_gather(edts, elst);
+            box_gather(trak, edts);
+        }
 
         /* *** add /moov/trak/mdia *** */
         bo_t *mdia = box_new("mdia");
@@ -1525,6 +1809,21 @@ static bo_t *GetMoovBox(sout_mux_t *p_mux)
         box_gather(moov, trak);
     }
 
+    if (p_sys->b_fragmented) {
+        /* *** add /moov/mvex, the samples are in the fragments *** */
+        bo_t *mvex = box_new("mvex");
+        for (int i_trak = 0; i_trak < p_sys->i_nb_streams; i_trak++) {
+            bo_t *trex = box_full_new("trex", 0, 0);
+            bo_add_32be(trex, p_sys->pp_streams[i_trak]->i_track_id);
+            bo_add_32be(trex, 1);   // sample-description-index
+            bo_add_32be(trex, 0);   // default sample duration
+            bo_add_32be(trex, 0);   // default sample size
+            bo_add_32be(trex, 0);   // default sample flags
+            box_gather(mvex, trex);
+        }
+        box_gather(moov, mvex);
+    }
+
     /* Add user data tags */
     box_gather(moov, GetUdtaTag(p_mux));
 
@@ -42,6 +42,7 @@ DASHDownloader::DASHDownloader  (HTTPConnectionManager *conManager, BlockBuffer
 DASHDownloader::~DASHDownloader ()
 {
     this->t_sys->buffer->setEOF(true);
+    this->t_sys->conManager->stop();
     vlc_join(this->dashDLThread, NULL);
     free(this->t_sys);
 }
@@ -0,0 +1,216 @@
+/*
+ * BufferBasedAdaptationLogic.cpp
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "BufferBasedAdaptationLogic.h"
+
+#include <algorithm>
+
+using namespace dash::logic;
+using namespace dash::http;
+using namespace dash::mpd;
+
+static bool compareBandwidth (const Representation *a, const Representation *b)
+{
+    return a->getBandwidth() < b->getBandwidth();
+}
+
+BufferBasedAdaptationLogic::BufferBasedAdaptationLogic  (IMPDManager *mpdManager, stream_t *stream) :
+                            AbstractAdaptationLogic     (mpdManager, stream),
+                            mpdManager                  (mpdManager),
+                            stream                      (stream),
+                            count                       (0),
+                            currentPeriod               (mpdManager->getFirstPeriod()),
+                            currentRep                  (NULL),
+                            sinceSwitch                 (0),
+                            lastSample                  (0),
+                            ewma                        (0)
+{
+}
+
+void                BufferBasedAdaptationLogic::downloadRateChanged     (uint64_t bpsAvg, uint64_t bpsLastChunk)
+{
+    AbstractAdaptationLogic::downloadRateChanged(bpsAvg, bpsLastChunk);
+
+    /* Only completed chunks make a sample */
+    if(bpsLastChunk == 0 || bpsLastChunk == this->lastSample)
+        return;
+    this->lastSample = bpsLastChunk;
+
+    this->samples.push_back(bpsLastChunk);
+    if(this->samples.size() > THROUGHPUTSAMPLES)
+        this->samples.pop_front();
+
+    if(this->ewma == 0)
+        this->ewma = bpsLastChunk;
+    else
+        this->ewma = 0.3 * bpsLastChunk + 0.7 * this->ewma;
+}
+uint64_t            BufferBasedAdaptationLogic::getThroughput           () const
+{
+    if(this->samples.empty())
+        return this->getBpsAvg();
+
+    /* The harmonic mean is dominated by the slow chunks, as it should */
+    double inverse = 0;
+    for(size_t i = 0; i < this->samples.size(); i++)
+        inverse += 1.0 / this->samples.at(i);
+
+    uint64_t harmonic = this->samples.size() / inverse;
+
+    return std::min(harmonic, (uint64_t) this->ewma);
+}
+std::vector<Representation *> BufferBasedAdaptationLogic::getSortedRepresentations () const
+{
+    std::vector<Representation *>   reps;
+    std::vector<AdaptationSet *>    adaptationSets = this->currentPeriod->getAdaptationSets();
+    const Representation            *reference     = this->currentRep;
+
+    /* Other adaptation sets carry another codec, language or view, not
+     * another quality of the same content: never switch to them */
+    if(reference == NULL)
+        reference = this->mpdManager->getRepresentation(this->currentPeriod, this->getBpsAvg());
+
+    for(size_t i = 0; i < adaptationSets.size(); i++)
+    {
+        std::vector<Representation *> set = adaptationSets.at(i)->getRepresentations();
+
+        if(std::find(set.begin(), set.end(), reference) != set.end())
+        {
+            reps = set;
+            break;
+        }
+        if(reps.empty())
+            reps = set;
+    }
+    std::stable_sort(reps.begin(), reps.end(), compareBandwidth);
+
+    return reps;
+}
+Representation*     BufferBasedAdaptationLogic::selectRepresentation    ()
+{
+    std::vector<Representation *> reps = this->getSortedRepresentations();
+
+    if(reps.empty())
+        return NULL;
+
+    int     level       = this->getBufferPercent();
+    double  throughput  = this->getThroughput() * THROUGHPUTSAFETY;
+    size_t  current     = 0;
+    size_t  byRate      = 0;
+    size_t  target;
+
+    for(size_t i = 0; i < reps.size(); i++)
+    {
+        if(reps.at(i) == this->currentRep)
+            current = i;
+        if(reps.at(i)->getBandwidth() <= throughput)
+            byRate = i;
+    }
+
+    if(level < RESERVOIRBUFFER)
+    {
+        /* Rebuffering is worse than any quality drop */
+        target = 0;
+    }
+    else if(level >= CUSHIONBUFFER)
+    {
+        /* Enough buffered to ride out a throughput dip */
+        target = std::max(byRate, current);
+    }
+    else
+    {
+        /* In between, the buffer level maps linearly onto the ladder and
+         * bounds how far throughput alone may move us */
+        size_t byBuffer = (reps.size() - 1) * (level - RESERVOIRBUFFER) /
+                          (CUSHIONBUFFER - RESERVOIRBUFFER);
+
+        if(byRate < current)
+            target = std::max(byRate, std::min(byBuffer, current));
+        else
+            target = std::min(byRate, std::max(byBuffer, current));
+    }
+
+    if(this->currentRep != NULL && target > current)
+    {
+        if(this->sinceSwitch < MINSWITCHINTERVAL)
+            target = current;
+        else
+            target = current + 1;
+    }
+
+    if(reps.at(target) != this->currentRep)
+    {
+        msg_Dbg(this->stream, "switching to %" PRIu64 " bps (throughput %" PRIu64
+                " bps, buffer %d%%)", reps.at(target)->getBandwidth(),
+                this->getThroughput(), level);
+        this->sinceSwitch = 0;
+    }
+
+    return reps.at(target);
+}
+Chunk*              BufferBasedAdaptationLogic::getNextChunk            ()
+{
+    if(this->mpdManager == NULL)
+        return NULL;
+
+    if(this->currentPeriod == NULL)
+        return NULL;
+
+    Representation *rep = this->selectRepresentation();
+
+    if ( rep == NULL )
+        return NULL;
+
+    this->currentRep = rep;
+
+    std::vector<Segment *> segments = this->mpdManager->getSegments(rep);
+
+    if ( this->count == segments.size() )
+    {
+        this->currentPeriod = this->mpdManager->getNextPeriod(this->currentPeriod);
+        this->currentRep    = NULL;
+        this->count = 0;
+        return this->getNextChunk();
+    }
+
+    if ( segments.size() > this->count )
+    {
+        Segment *seg = segments.at( this->count );
+        Chunk *chunk = seg->toChunk();
+        //In case of UrlTemplate, we must stay on the same segment.
+        if ( seg->isSingleShot() == true )
+        {
+            this->count++;
+            this->sinceSwitch++;
+        }
+        seg->done();
+        return chunk;
+    }
+    return NULL;
+}
+const Representation *BufferBasedAdaptationLogic::getCurrentRepresentation() const
+{
+    if(this->currentRep != NULL)
+        return this->currentRep;
+    return this->mpdManager->getRepresentation( this->currentPeriod, this->getBpsAvg() );
+}
@@ -0,0 +1,78 @@
+/*
+ * BufferBasedAdaptationLogic.h
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef BUFFERBASEDADAPTATIONLOGIC_H_
+#define BUFFERBASEDADAPTATIONLOGIC_H_
+
+#include "adaptationlogic/AbstractAdaptationLogic.h"
+#include "mpd/IMPDManager.h"
+#include "http/Chunk.h"
+
+#include <vlc_common.h>
+#include <vlc_stream.h>
+
+#include <deque>
+#include <vector>
+
+#define RESERVOIRBUFFER     20  /* percent, below: lowest representation */
+#define CUSHIONBUFFER       70  /* percent, above: throughput alone decides */
+#define THROUGHPUTSAMPLES   5
+#define THROUGHPUTSAFETY    0.9
+#define MINSWITCHINTERVAL   2   /* segments between two up-switches */
+
+namespace dash
+{
+    namespace logic
+    {
+        /*
+         * Hybrid of a throughput estimate (harmonic mean of the last chunks,
+         * bounded by an EWMA) and the buffer fill level: an empty buffer
+         * forces low representations, a full one lets throughput dips ride.
+         * Up-switches are one step at a time and rate limited.
+         */
+        class BufferBasedAdaptationLogic : public AbstractAdaptationLogic
+        {
+            public:
+                BufferBasedAdaptationLogic          (dash::mpd::IMPDManager *mpdManager, stream_t *stream);
+
+                dash::http::Chunk*      getNextChunk();
+                const dash::mpd::Representation *getCurrentRepresentation() const;
+
+                void                    downloadRateChanged     (uint64_t bpsAvg, uint64_t bpsLastChunk);
+
+            private:
+                dash::mpd::IMPDManager          *mpdManager;
+                stream_t                        *stream;
+                size_t                          count;
+                dash::mpd::Period               *currentPeriod;
+                dash::mpd::Representation       *currentRep;
+                size_t                          sinceSwitch;
+                uint64_t                        lastSample;
+                double                          ewma;
+                std::deque<uint64_t>            samples;
+
+                uint64_t                        getThroughput           () const;
+                dash::mpd::Representation*      selectRepresentation    ();
+                std::vector<dash::mpd::Representation *> getSortedRepresentations () const;
+        };
+    }
+}
+
+#endif /* BUFFERBASEDADAPTATIONLOGIC_H_ */
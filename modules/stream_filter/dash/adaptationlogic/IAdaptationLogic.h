@@ -43,7 +43,8 @@ namespace dash
                     Default,
                     AlwaysBest,
                     AlwaysLowest,
-                    RateBased
+                    RateBased,
+                    BufferBased
                 };
 
                 virtual dash::http::Chunk*                  getNextChunk            ()          = 0;
@@ -0,0 +1,192 @@
+/*
+ * dash-test-logic.cpp: buffer based adaptation logic test
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#undef NDEBUG
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include "adaptationlogic/BufferBasedAdaptationLogic.h"
+#include "mpd/IMPDManager.h"
+#include "mpd/Period.h"
+#include "mpd/Segment.h"
+
+using namespace dash::logic;
+using namespace dash::http;
+using namespace dash::mpd;
+
+#define SEGMENTS 64
+
+/* A single period, the representations of the second adaptation set are
+ * the ones the manager would pick first */
+class TestManager : public IMPDManager
+{
+    public:
+        TestManager                         (Period *period) : period(period)
+        {
+            this->periods.push_back(period);
+        }
+        virtual ~TestManager                ()
+        {
+            std::map<const Representation *, std::vector<Segment *> >::iterator it;
+            for(it = this->segments.begin(); it != this->segments.end(); ++it)
+                vlc_delete_all(it->second);
+        }
+
+        const std::vector<Period *>&    getPeriods              () const
+        {
+            return this->periods;
+        }
+        Period*                         getFirstPeriod          ()
+        {
+            return this->period;
+        }
+        Period*                         getNextPeriod           (Period *)
+        {
+            return NULL;
+        }
+        Representation*                 getBestRepresentation   (Period *period)
+        {
+            return period->getAdaptationSets().at(1)->getRepresentations().back();
+        }
+        std::vector<Segment *>          getSegments             (const Representation *rep)
+        {
+            std::vector<Segment *> &segs = this->segments[rep];
+            while(segs.size() < SEGMENTS)
+                segs.push_back(new Segment(rep));
+            return segs;
+        }
+        Representation*                 getRepresentation       (Period *period, uint64_t) const
+        {
+            return period->getAdaptationSets().at(1)->getRepresentations().front();
+        }
+        const MPD*                      getMPD                  () const
+        {
+            return NULL;
+        }
+        Representation*                 getRepresentation       (Period *period, uint64_t bitrate,
+                                                                 int, int) const
+        {
+            return this->getRepresentation(period, bitrate);
+        }
+
+    private:
+        Period                                                      *period;
+        std::vector<Period *>                                       periods;
+        std::map<const Representation *, std::vector<Segment *> >   segments;
+};
+
+static AdaptationSet *CreateSet (const uint64_t *bandwidths, size_t count)
+{
+    AdaptationSet *set = new AdaptationSet();
+
+    for(size_t i = 0; i < count; i++)
+    {
+        Representation *rep = new Representation();
+        rep->setBandwidth(bandwidths[i]);
+        rep->setParentGroup(set);
+        set->addRepresentation(rep);
+    }
+    return set;
+}
+
+static uint64_t NextBitrate (BufferBasedAdaptationLogic &logic, int buffer,
+                             const AdaptationSet *set)
+{
+    logic.bufferLevelChanged(0, buffer);
+
+    Chunk *chunk = logic.getNextChunk();
+    assert(chunk != NULL);
+
+    uint64_t bitrate = chunk->getBitrate();
+    delete chunk;
+
+    /* Never leaves the adaptation set it started in */
+    const Representation *rep = logic.getCurrentRepresentation();
+    assert(rep->getBandwidth() == bitrate);
+    assert(rep->getParentGroup() == set);
+
+    return bitrate;
+}
+
+int main (void)
+{
+    /* Another codec: cheaper and dearer than anything in the set in use */
+    static const uint64_t other[] = { 300000, 20000000 };
+    static const uint64_t ladder[] = { 4000000, 1000000, 8000000, 2000000 };
+
+    Period *period = new Period();
+    period->addAdaptationSet(CreateSet(other, 2));
+    period->addAdaptationSet(CreateSet(ladder, 4));
+
+    stream_t *stream = (stream_t *)calloc(1, sizeof(*stream));
+    assert(stream != NULL);
+    stream->i_flags = OBJECT_FLAGS_QUIET;
+
+    TestManager                 manager(period);
+    BufferBasedAdaptationLogic  logic(&manager, stream);
+    const AdaptationSet         *set = period->getAdaptationSets().at(1);
+
+    /* Empty buffer: lowest rung of the set */
+    assert(NextBitrate(logic, 0, set) == 1000000);
+
+    /* Full buffer and plenty of throughput: one rung at a time, with at
+     * least MINSWITCHINTERVAL segments between two up-switches */
+    logic.downloadRateChanged(100000000, 100000000);
+
+    uint64_t    bitrate = 1000000;
+    int         since   = 1;
+    for(int i = 0; i < 16; i++)
+    {
+        uint64_t next = NextBitrate(logic, 100, set);
+
+        assert(next == bitrate || next == 2 * bitrate);
+        if(next != bitrate)
+        {
+            assert(since >= MINSWITCHINTERVAL);
+            since = 1;
+        }
+        else
+            since++;
+        bitrate = next;
+    }
+    assert(bitrate == 8000000);
+
+    /* A throughput dip is ridden out while the buffer is full */
+    for(int i = 1; i <= THROUGHPUTSAMPLES; i++)
+    {
+        logic.downloadRateChanged(1000000, 500000 + i);
+        assert(NextBitrate(logic, 100, set) == 8000000);
+    }
+
+    /* Half full: the buffer level bounds how far down we go */
+    assert(NextBitrate(logic, 50, set) == 2000000);
+
+    /* Nearly empty: straight to the lowest rung, not to the other set */
+    assert(NextBitrate(logic, 10, set) == 1000000);
+
+    free(stream);
+    delete period;
+    return 0;
+}
@@ -57,6 +57,28 @@ static void Close   (vlc_object_t *);
 #define DASH_BUFFER_TEXT N_("Buffer Size (Seconds)")
 #define DASH_BUFFER_LONGTEXT N_("Buffer size in seconds")
 
+#define DASH_PREFETCH_TEXT N_("Segments downloaded ahead")
+#define DASH_PREFETCH_LONGTEXT N_("Number of segments requested in " \
+    "advance and downloaded concurrently. They are still read in order.")
+
+#define DASH_CONNECTIONS_TEXT N_("Connections per host")
+#define DASH_CONNECTIONS_LONGTEXT N_("Maximum number of concurrent HTTP " \
+    "connections to a host. Further requests are pipelined.")
+
+#define DASH_LOGIC_TEXT N_("Adaptation logic")
+#define DASH_LOGIC_LONGTEXT N_("Algorithm choosing the representation of " \
+    "the next segment. The buffer based logic also weighs the amount of " \
+    "data buffered, and switches less often.")
+
+static const int pi_logics[] = {
+    dash::logic::IAdaptationLogic::RateBased,
+    dash::logic::IAdaptationLogic::BufferBased,
+    dash::logic::IAdaptationLogic::AlwaysBest,
+};
+static const char *const ppsz_logics[] = {
+    N_("Rate based"), N_("Buffer based"), N_("Always best"),
+};
+
 vlc_module_begin ()
         set_shortname( N_("DASH"))
         set_description( N_("Dynamic Adaptive Streaming over HTTP") )
@@ -66,6 +88,13 @@ vlc_module_begin ()
         add_integer( "dash-prefwidth",  480, DASH_WIDTH_TEXT,  DASH_WIDTH_LONGTEXT,  true )
         add_integer( "dash-prefheight", 360, DASH_HEIGHT_TEXT, DASH_HEIGHT_LONGTEXT, true )
         add_integer( "dash-buffersize", 30, DASH_BUFFER_TEXT, DASH_BUFFER_LONGTEXT, true )
+        add_integer_with_range( "dash-prefetch", 3, 1, 16, DASH_PREFETCH_TEXT,
+                                DASH_PREFETCH_LONGTEXT, true )
+        add_integer_with_range( "dash-connections", 2, 1, 8, DASH_CONNECTIONS_TEXT,
+                                DASH_CONNECTIONS_LONGTEXT, true )
+        add_integer( "dash-logic", dash::logic::IAdaptationLogic::RateBased,
+                     DASH_LOGIC_TEXT, DASH_LOGIC_LONGTEXT, true )
+            change_integer_list( pi_logics, ppsz_logics )
         set_callbacks( Open, Close )
 vlc_module_end ()
 
@@ -78,6 +107,7 @@ struct stream_sys_t
         dash::mpd::MPD      *p_mpd;
         uint64_t                            position;
         bool                                isLive;
+        dash::logic::IAdaptationLogic::LogicType logicType;
 };
 
 static int  Read            (stream_t *p_stream, void *p_ptr, unsigned int i_len);
@@ -113,8 +143,10 @@ static int Open(vlc_object_t *p_obj)
         return VLC_ENOMEM;
 
     p_sys->p_mpd = mpd;
+    p_sys->logicType = (dash::logic::IAdaptationLogic::LogicType)
+                       var_InheritInteger(p_stream, "dash-logic");
     dash::DASHManager*p_dashManager = new dash::DASHManager(p_sys->p_mpd,
-                                          dash::logic::IAdaptationLogic::RateBased,
+                                          p_sys->logicType,
                                           p_stream);
 
     if(!p_dashManager->start())
@@ -201,7 +233,7 @@ static int  Read            (stream_t *p_stream, void *p_ptr, unsigned int i_len
     while( i_len > 0 )
     {
         i_read = p_dashManager->read( p_buffer, i_len );
-        if( i_read < 0 )
+        if( i_read <= 0 ) /* end of stream */
             break;
         p_buffer += i_read;
         i_ret += i_read;
@@ -248,9 +280,14 @@ static int  Control         (stream_t *p_stream, int i_query, va_list args)
             *(va_arg (args, bool *)) = SEEK;
             break;
         case STREAM_CAN_PAUSE:
-        case STREAM_CAN_CONTROL_PACE:
             *(va_arg (args, bool *)) = false; /* TODO */
             break;
+        case STREAM_CAN_CONTROL_PACE:
+            /* Only the buffer based logic measures the lead built up in our
+             * buffer. A live stream cannot be paced by the decoders. */
+            *(va_arg (args, bool *)) = !p_sys->isLive &&
+                p_sys->logicType == dash::logic::IAdaptationLogic::BufferBased;
+            break;
 
         case STREAM_GET_POSITION:
             *(va_arg (args, uint64_t *)) = p_sys->position;
@@ -37,9 +37,17 @@ Chunk::Chunk        () :
        isHostname   (false),
        length       (0),
        bytesRead    (0),
-       connection   (NULL)
+       connection   (NULL),
+       data         (NULL),
+       dataLast     (&data),
+       dataSize     (0),
+       downloaded   (false)
 {
 }
+Chunk::~Chunk       ()
+{
+    block_ChainRelease(this->data);
+}
 
 int                 Chunk::getEndByte           () const
 {
@@ -149,3 +157,50 @@ void                Chunk::setConnection   (IHTTPConnection *connection)
 {
     this->connection = connection;
 }
+void                Chunk::appendData           (block_t *block)
+{
+    this->dataSize += block->i_buffer;
+    block_ChainLastAppend(&this->dataLast, block);
+}
+size_t              Chunk::readData             (void *p_buffer, size_t len)
+{
+    uint8_t *p_data = (uint8_t *)p_buffer;
+    size_t  ret     = 0;
+
+    while(this->data != NULL && ret < len)
+    {
+        block_t *block  = this->data;
+        size_t  copy    = __MIN(block->i_buffer, len - ret);
+
+        memcpy(p_data + ret, block->p_buffer, copy);
+        block->p_buffer += copy;
+        block->i_buffer -= copy;
+        ret             += copy;
+        this->dataSize  -= copy;
+
+        if(block->i_buffer == 0)
+        {
+            this->data = block->p_next;
+            if(this->data == NULL)
+                this->dataLast = &this->data;
+            block_Release(block);
+        }
+    }
+    return ret;
+}
+bool                Chunk::hasData              () const
+{
+    return this->data != NULL;
+}
+size_t              Chunk::getDataSize          () const
+{
+    return this->dataSize;
+}
+bool                Chunk::isDownloaded         () const
+{
+    return this->downloaded;
+}
+void                Chunk::setDownloaded        (bool value)
+{
+    this->downloaded = value;
+}
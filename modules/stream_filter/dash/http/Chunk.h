@@ -27,6 +27,7 @@
 
 #include <vlc_common.h>
 #include <vlc_url.h>
+#include <vlc_block.h>
 
 #include "IHTTPConnection.h"
 
@@ -42,6 +43,7 @@ namespace dash
         {
             public:
                 Chunk           ();
+                virtual ~Chunk  ();
 
                 int                 getEndByte              () const;
                 int                 getStartByte            () const;
@@ -68,6 +70,14 @@ namespace dash
                 void                setBitrate      (uint64_t bitrate);
                 int                 getBitrate      ();
 
+                /* Received data, kept until the chunk is next in line */
+                void                appendData      (block_t *block);
+                size_t              readData        (void *p_buffer, size_t len);
+                bool                hasData         () const;
+                size_t              getDataSize     () const;
+                bool                isDownloaded    () const;
+                void                setDownloaded   (bool value);
+
             private:
                 std::string                 url;
                 std::string                 path;
@@ -82,6 +92,10 @@ namespace dash
                 size_t                      length;
                 uint64_t                    bytesRead;
                 IHTTPConnection             *connection;
+                block_t                     *data;
+                block_t                     **dataLast;
+                size_t                      dataSize;
+                bool                        downloaded;
         };
     }
 }
@@ -30,9 +30,13 @@
 using namespace dash::http;
 
 HTTPConnection::HTTPConnection  (stream_t *stream) :
+                httpSocket      (-1),
                 stream          (stream),
                 peekBufferLen   (0),
-                contentLength   (0)
+                contentLength   (0),
+                hasContentLength(false),
+                isChunked       (false),
+                statusCode      (0)
 {
     this->peekBuffer = new uint8_t[PEEKBUFFER];
 }
@@ -54,10 +58,12 @@ int             HTTPConnection::read            (void *p_buffer, size_t len)
         return size;
     }
 
-    memcpy(p_buffer, this->peekBuffer, this->peekBufferLen);
-    int ret = this->peekBufferLen;
-    this->peekBufferLen = 0;
-    return ret;
+    size_t size = len < this->peekBufferLen ? len : this->peekBufferLen;
+
+    memcpy(p_buffer, this->peekBuffer, size);
+    this->peekBufferLen -= size;
+    memmove(this->peekBuffer, this->peekBuffer + size, this->peekBufferLen);
+    return size;
 }
 int             HTTPConnection::peek            (const uint8_t **pp_peek, size_t i_peek)
 {
@@ -130,6 +136,70 @@ bool            HTTPConnection::parseHeader     ()
 
     return true;
 }
+int             HTTPConnection::fillPeekBuffer  ()
+{
+    /* A single read: the caller only gets here once poll() said readable */
+    int size = net_Read(this->stream, this->httpSocket, NULL, this->peekBuffer + this->peekBufferLen,
+                        PEEKBUFFER - this->peekBufferLen, false);
+
+    if(size <= 0)
+        return -1;
+
+    this->peekBufferLen += size;
+    return size;
+}
+int             HTTPConnection::receiveHeader   ()
+{
+    /* Consumes what has been received so far, never touches the socket */
+    size_t  from = this->header.size() > 3 ? this->header.size() - 3 : 0;
+    size_t  prev = this->header.size();
+
+    this->header.append((const char *)this->peekBuffer, this->peekBufferLen);
+
+    size_t  end = this->header.find("\r\n\r\n", from);
+    if(end == std::string::npos)
+    {
+        this->peekBufferLen = 0;
+        return this->header.size() > 16 * PEEKBUFFER ? -1 : 0;
+    }
+
+    /* Leave the body (and any pipelined response) in the peek buffer */
+    size_t used = end + 4 - prev;
+    this->peekBufferLen -= used;
+    memmove(this->peekBuffer, this->peekBuffer + used, this->peekBufferLen);
+    this->header.resize(end + 2);
+
+    std::istringstream  lines(this->header);
+    std::string         line;
+
+    this->contentLength     = 0;
+    this->hasContentLength  = false;
+    this->isChunked         = false;
+    this->statusCode        = 0;
+
+    /* Status line: HTTP/1.x code reason */
+    if(std::getline(lines, line) && !line.compare(0, 5, "HTTP/"))
+    {
+        size_t code = line.find(' ');
+        if(code != std::string::npos)
+            this->statusCode = atoi(line.substr(code + 1).c_str());
+    }
+
+    while(std::getline(lines, line))
+    {
+        if(!strncasecmp(line.c_str(), "Content-Length:", 15))
+        {
+            this->contentLength     = atoi(line.substr(15).c_str());
+            this->hasContentLength  = true;
+        }
+        else if(!strncasecmp(line.c_str(), "Transfer-Encoding:", 18) &&
+                line.find("chunked") != std::string::npos)
+            this->isChunked = true;
+    }
+
+    this->header.clear();
+    return 1;
+}
 std::string     HTTPConnection::readLine        ()
 {
     std::stringstream ss;
@@ -166,7 +236,20 @@ bool            HTTPConnection::sendData        (const std::string& data)
 }
 void            HTTPConnection::closeSocket     ()
 {
-    net_Close(this->httpSocket);
+    if(this->httpSocket != -1)
+        net_Close(this->httpSocket);
+
+    this->httpSocket    = -1;
+    this->peekBufferLen = 0;
+    this->header.clear();
+}
+int             HTTPConnection::getSocket       () const
+{
+    return this->httpSocket;
+}
+bool            HTTPConnection::hasPendingData  () const
+{
+    return this->peekBufferLen > 0;
 }
 bool            HTTPConnection::setUrlRelative  (Chunk *chunk)
 {
@@ -55,6 +55,8 @@ namespace dash
                 void            closeSocket ();
                 virtual int     read        (void *p_buffer, size_t len);
                 virtual int     peek        (const uint8_t **pp_peek, size_t i_peek);
+                int             getSocket   () const;
+                bool            hasPendingData  () const;
 
             protected:
                 int         httpSocket;
@@ -62,10 +64,16 @@ namespace dash
                 uint8_t     *peekBuffer;
                 size_t      peekBufferLen;
                 int         contentLength;
+                bool        hasContentLength;
+                bool        isChunked;
+                int         statusCode;
+                std::string header;
 
                 bool                sendData        (const std::string& data);
                 bool                parseHeader     ();
                 std::string         readLine        ();
+                int                 fillPeekBuffer  ();
+                int                 receiveHeader   ();
                 virtual std::string prepareRequest  (Chunk *chunk);
                 bool                setUrlRelative  (Chunk *chunk);
         };
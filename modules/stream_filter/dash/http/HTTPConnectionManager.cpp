@@ -28,29 +28,53 @@
 #include "HTTPConnectionManager.h"
 #include "mpd/Segment.h"
 
+#include <vlc_network.h>
+
+#include <errno.h>
+#ifdef HAVE_POLL
+# include <poll.h>
+#endif
+
 using namespace dash::http;
 using namespace dash::logic;
 
-const size_t    HTTPConnectionManager::PIPELINE               = 80;
-const size_t    HTTPConnectionManager::PIPELINELENGTH         = 2;
+const size_t    HTTPConnectionManager::RECEIVESIZE            = 32768;
+const size_t    HTTPConnectionManager::MAXCHUNKDATA           = 8 * 1024 * 1024;
+const int       HTTPConnectionManager::POLLTIMEOUT            = 250;
 const uint64_t  HTTPConnectionManager::CHUNKDEFAULTBITRATE    = 1;
 
 HTTPConnectionManager::HTTPConnectionManager    (logic::IAdaptationLogic *adaptationLogic, stream_t *stream) :
                        adaptationLogic          (adaptationLogic),
                        stream                   (stream),
-                       chunkCount               (0),
+                       prefetchCount            (1),
+                       maxConnections           (1),
+                       isEndOfChunks            (false),
                        bpsAvg                   (0),
                        bpsLastChunk             (0),
                        bpsCurrentChunk          (0),
                        bytesReadSession         (0),
                        bytesReadChunk           (0),
                        timeSession              (0),
-                       timeChunk                (0)
+                       timeChunk                (0),
+                       isStopped                (false),
+                       receiveBlock             (NULL)
 {
+    vlc_mutex_init(&this->lock);
+
+    int64_t prefetch    = var_InheritInteger(stream, "dash-prefetch");
+    int64_t connections = var_InheritInteger(stream, "dash-connections");
+
+    if(prefetch > 1)
+        this->prefetchCount = prefetch;
+    if(connections > 1)
+        this->maxConnections = connections;
 }
 HTTPConnectionManager::~HTTPConnectionManager   ()
 {
     this->closeAllConnections();
+    if(this->receiveBlock)
+        block_Release(this->receiveBlock);
+    vlc_mutex_destroy(&this->lock);
 }
 
 void                                HTTPConnectionManager::closeAllConnections      ()
@@ -60,41 +84,174 @@ void                                HTTPConnectionManager::closeAllConnections
 }
 int                                 HTTPConnectionManager::read                     (block_t *block)
 {
-    if(this->downloadQueue.size() == 0)
-        if(!this->addChunk(this->adaptationLogic->getNextChunk()))
+    this->fillPipeline();
+
+    while(this->downloadQueue.size() > 0)
+    {
+        Chunk *chunk = this->downloadQueue.front();
+
+        /* Segments are handed out in order, whichever finished first */
+        if(chunk->hasData())
+        {
+            int ret = chunk->readData(block->p_buffer, block->i_buffer);
+
+            block->i_length = (mtime_t)((ret * 8) / ((float)chunk->getBitrate() / 1000000));
+            return ret;
+        }
+
+        if(chunk->isDownloaded())
+        {
+            this->bpsLastChunk   = this->bpsCurrentChunk;
+            this->bytesReadChunk = 0;
+            this->timeChunk      = 0;
+
+            delete(chunk);
+            this->downloadQueue.pop_front();
+
+            this->fillPipeline();
+            continue;
+        }
+
+        mtime_t start = mdate();
+        int ret = this->receive();
+        mtime_t end = mdate();
+
+        if(ret < 0 || this->stopped())
             return 0;
 
-    if(this->downloadQueue.front()->getPercentDownloaded() > HTTPConnectionManager::PIPELINE &&
-       this->downloadQueue.size() < HTTPConnectionManager::PIPELINELENGTH)
-        this->addChunk(this->adaptationLogic->getNextChunk());
+        /* Nothing yet: keep waiting, the segment is still coming */
+        if(ret > 0)
+            this->updateStatistics(ret, ((double)(end - start)) / 1000000);
+    }
+
+    return 0;
+}
+void                                HTTPConnectionManager::stop                     ()
+{
+    vlc_mutex_lock(&this->lock);
+    this->isStopped = true;
+    vlc_mutex_unlock(&this->lock);
+}
+bool                                HTTPConnectionManager::stopped                  ()
+{
+    vlc_mutex_lock(&this->lock);
+    bool ret = this->isStopped;
+    vlc_mutex_unlock(&this->lock);
+
+    return ret;
+}
+void                                HTTPConnectionManager::fillPipeline             ()
+{
+    while(!this->isEndOfChunks && this->downloadQueue.size() < this->prefetchCount)
+    {
+        if(!this->addChunk(this->adaptationLogic->getNextChunk()))
+            this->isEndOfChunks = true;
+    }
+}
+int                                 HTTPConnectionManager::receive                  ()
+{
+    std::vector<PersistentConnection *> cons;
+    std::vector<PersistentConnection *> ready;
+    std::vector<struct pollfd>          ufds;
+    bool                                throttled = false;
+
+    for(size_t i = 0; i < this->connectionPool.size(); i++)
+    {
+        PersistentConnection    *con    = this->connectionPool.at(i);
+
+        Chunk                   *chunk  = con->getActiveChunk();
 
-    int ret = 0;
+        if(chunk == NULL)
+            continue;
 
-    mtime_t start = mdate();
-    ret = this->downloadQueue.front()->getConnection()->read(block->p_buffer, block->i_buffer);
-    mtime_t end = mdate();
+        /* Leave the data in the socket until the demuxer catches up: the
+         * chunk being read is drained as it arrives, so never stalls */
+        if(chunk->getDataSize() >= MAXCHUNKDATA)
+        {
+            throttled = true;
+            continue;
+        }
 
-    block->i_length = (mtime_t)((ret * 8) / ((float)this->downloadQueue.front()->getBitrate() / 1000000));
+        /* Already received, no need to wait for the socket */
+        if(con->hasPendingData())
+        {
+            ready.push_back(con);
+            continue;
+        }
 
-    double time = ((double)(end - start)) / 1000000;
+        struct pollfd ufd;
+        ufd.fd      = con->getSocket();
+        ufd.events  = POLLIN;
+        ufd.revents = 0;
 
-    if(ret <= 0)
+        cons.push_back(con);
+        ufds.push_back(ufd);
+    }
+
+    if(cons.size() == 0 && ready.size() == 0)
     {
-        this->bpsLastChunk   = this->bpsCurrentChunk;
-        this->bytesReadChunk = 0;
-        this->timeChunk      = 0;
+        if(throttled)
+            return 0;
 
-        delete(this->downloadQueue.front());
-        this->downloadQueue.pop_front();
+        /* Nothing in flight: the pending chunks will never complete */
+        for(size_t i = 0; i < this->downloadQueue.size(); i++)
+            this->downloadQueue.at(i)->setDownloaded(true);
+        return 0;
+    }
 
-        return this->read(block);
+    if(ready.size() == 0)
+    {
+        int val = poll(&ufds[0], ufds.size(), POLLTIMEOUT);
+        if(val < 0 && errno != EINTR)
+            return -1;
+        if(val <= 0)
+            return 0;
+
+        for(size_t i = 0; i < cons.size(); i++)
+            if(ufds.at(i).revents != 0)
+                ready.push_back(cons.at(i));
     }
-    else
+
+    int bytes = 0;
+
+    for(size_t i = 0; i < ready.size(); i++)
     {
-        this->updateStatistics(ret, time);
+        PersistentConnection    *con    = ready.at(i);
+        Chunk                   *chunk  = con->getActiveChunk();
+
+        /* Reused until some data actually lands in it */
+        if(this->receiveBlock == NULL)
+        {
+            this->receiveBlock = block_Alloc(RECEIVESIZE);
+            if(this->receiveBlock == NULL)
+                return -1;
+        }
+
+        /* The connection flags the chunk once complete or given up */
+        int ret = con->read(this->receiveBlock->p_buffer, RECEIVESIZE);
+        if(ret <= 0)
+            continue;
+
+        block_t *block;
+        if((size_t)ret < RECEIVESIZE / 4)
+        {
+            /* Keep the large block for the next read */
+            block = block_Alloc(ret);
+            if(block == NULL)
+                return -1;
+            memcpy(block->p_buffer, this->receiveBlock->p_buffer, ret);
+        }
+        else
+        {
+            block = this->receiveBlock;
+            block->i_buffer = ret;
+            this->receiveBlock = NULL;
+        }
+        chunk->appendData(block);
+        bytes += ret;
     }
 
-    return ret;
+    return bytes;
 }
 void                                HTTPConnectionManager::attach                   (IDownloadRateObserver *observer)
 {
@@ -117,6 +274,25 @@ std::vector<PersistentConnection *> HTTPConnectionManager::getConnectionsForHost
 
     return cons;
 }
+PersistentConnection*               HTTPConnectionManager::getConnectionForChunk    (Chunk *chunk)
+{
+    std::vector<PersistentConnection *> cons = this->getConnectionsForHost(chunk->getHostname());
+    PersistentConnection                *con = NULL;
+
+    /* Least loaded connection to this host */
+    for(size_t i = 0; i < cons.size(); i++)
+        if(con == NULL || cons.at(i)->getChunkCount() < con->getChunkCount())
+            con = cons.at(i);
+
+    /* Open another one rather than pipelining behind a busy one */
+    if((con == NULL || con->getChunkCount() > 0) && cons.size() < this->maxConnections)
+    {
+        con = new PersistentConnection(this->stream);
+        this->connectionPool.push_back(con);
+    }
+
+    return con;
+}
 void                                HTTPConnectionManager::updateStatistics         (int bytes, double time)
 {
     this->bytesReadSession  += bytes;
@@ -142,25 +318,27 @@ bool                                HTTPConnectionManager::addChunk
 
     this->downloadQueue.push_back(chunk);
 
-    std::vector<PersistentConnection *> cons = this->getConnectionsForHost(chunk->getHostname());
+    if(chunk->getBitrate() <= 0)
+        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
 
-    if(cons.size() == 0)
+    if(!chunk->hasHostname())
     {
-        PersistentConnection *con = new PersistentConnection(this->stream);
-        this->connectionPool.push_back(con);
-        cons.push_back(con);
+        std::stringstream ss;
+        ss << this->stream->psz_access << "://" << Helper::combinePaths(Helper::getDirectoryPath(this->stream->psz_path), chunk->getUrl());
+        chunk->setUrl(ss.str());
     }
 
-    size_t pos = this->chunkCount % cons.size();
-
-    cons.at(pos)->addChunk(chunk);
-
-    chunk->setConnection(cons.at(pos));
+    PersistentConnection *con = this->getConnectionForChunk(chunk);
 
-    this->chunkCount++;
+    /* Requests are pipelined if the connection is already busy */
+    if(!con->addChunk(chunk))
+    {
+        msg_Warn(this->stream, "cannot request %s", chunk->getUrl().c_str());
+        chunk->setDownloaded(true);
+        return true;
+    }
 
-    if(chunk->getBitrate() <= 0)
-        chunk->setBitrate(HTTPConnectionManager::CHUNKDEFAULTBITRATE);
+    chunk->setConnection(con);
 
     return true;
 }
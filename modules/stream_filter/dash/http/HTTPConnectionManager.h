@@ -52,6 +52,7 @@ namespace dash
                 int     read                (block_t *block);
                 void    attach              (dash::logic::IDownloadRateObserver *observer);
                 void    notify              ();
+                void    stop                ();
 
             private:
                 std::vector<dash::logic::IDownloadRateObserver *>   rateObservers;
@@ -59,7 +60,9 @@ namespace dash
                 std::vector<PersistentConnection *>                 connectionPool;
                 logic::IAdaptationLogic                             *adaptationLogic;
                 stream_t                                            *stream;
-                int                                                 chunkCount;
+                size_t                                              prefetchCount;
+                size_t                                              maxConnections;
+                bool                                                isEndOfChunks;
                 int64_t                                             bpsAvg;
                 int64_t                                             bpsLastChunk;
                 int64_t                                             bpsCurrentChunk;
@@ -67,13 +70,21 @@ namespace dash
                 int64_t                                             bytesReadChunk;
                 double                                              timeSession;
                 double                                              timeChunk;
+                vlc_mutex_t                                         lock;
+                bool                                                isStopped;
+                block_t                                             *receiveBlock;
 
-                static const size_t     PIPELINE;
-                static const size_t     PIPELINELENGTH;
+                static const size_t     RECEIVESIZE;
+                static const size_t     MAXCHUNKDATA;
+                static const int        POLLTIMEOUT;
                 static const uint64_t   CHUNKDEFAULTBITRATE;
 
                 std::vector<PersistentConnection *>     getConnectionsForHost   (const std::string &hostname);
+                PersistentConnection*                   getConnectionForChunk   (Chunk *chunk);
+                void                                    fillPipeline            ();
+                int                                     receive                 ();
                 void                                    updateStatistics        (int bytes, double time);
+                bool                                    stopped                 ();
 
         };
     }
@@ -33,7 +33,8 @@ const int PersistentConnection::RETRY = 5;
 
 PersistentConnection::PersistentConnection  (stream_t *stream) :
                       HTTPConnection        (stream),
-                      isInit                (false)
+                      isInit                (false),
+                      isHeaderParsed        (false)
 {
 }
 PersistentConnection::~PersistentConnection ()
@@ -47,18 +48,53 @@ int                 PersistentConnection::read              (void *p_buffer, siz
 
     Chunk *readChunk = this->chunkQueue.front();
 
-    if(readChunk->getBytesRead() == 0)
+    /* At most one socket read per call, the caller polled only once */
+    if(!this->isHeaderParsed)
     {
-        if(!this->initChunk(readChunk))
+        if(!this->hasPendingData() && this->fillPeekBuffer() <= 0)
+            return this->resume(readChunk);
+
+        int ret = this->receiveHeader();
+        if(ret < 0)
+            return this->resume(readChunk);
+        if(ret == 0)
+            return 0;
+
+        if(this->statusCode < 200 || this->statusCode >= 300 || this->isChunked)
+        {
+            /* Never hand an error page (or an undecoded body) out as media */
+            msg_Warn(this->stream, "cannot download %s (HTTP status %d%s)",
+                     readChunk->getUrl().c_str(), this->statusCode,
+                     this->isChunked ? ", chunked" : "");
+            return this->dropChunk();
+        }
+
+        this->isHeaderParsed = true;
+        if(this->hasContentLength)
+            readChunk->setLength(this->contentLength);
+
+        if((!this->hasContentLength || readChunk->getBytesToRead() > 0) &&
+           !this->hasPendingData())
+            return 0;
+    }
+
+    /* Without a length, the body ends with the connection */
+    if(!this->hasContentLength)
+    {
+        int ret = HTTPConnection::read(p_buffer, len);
+        if(ret <= 0)
         {
-            this->chunkQueue.pop_front();
-            return -1;
+            this->finishChunk();
+            return this->endOfStream();
         }
+
+        readChunk->setBytesRead(readChunk->getBytesRead() + ret);
+        return ret;
     }
 
     if(readChunk->getBytesToRead() == 0)
     {
-        this->chunkQueue.pop_front();
+        this->finishChunk();
         return 0;
     }
 
@@ -69,20 +105,13 @@ int                 PersistentConnection::read              (void *p_buffer, siz
         ret = HTTPConnection::read(p_buffer, len);
 
     if(ret <= 0)
-    {
-        readChunk->setStartByte(readChunk->getStartByte() + readChunk->getBytesRead());
-        readChunk->setBytesRead(0);
-        if(!this->reconnect(readChunk))
-        {
-            this->chunkQueue.pop_front();
-            return -1;
-        }
-
-        return this->read(p_buffer, len);
-    }
+        return this->resume(readChunk);
 
     readChunk->setBytesRead(readChunk->getBytesRead() + ret);
 
+    if(readChunk->getBytesToRead() == 0)
+        this->finishChunk();
+
     return ret;
 }
 std::string         PersistentConnection::prepareRequest    (Chunk *chunk)
@@ -98,7 +127,10 @@ std::string         PersistentConnection::prepareRequest    (Chunk *chunk)
         std::stringstream req;
         req << "GET " << chunk->getPath() << " HTTP/1.1\r\n" <<
                "Host: " << chunk->getHostname() << "\r\n" <<
-               "Range: bytes=" << chunk->getStartByte() << "-" << chunk->getEndByte() << "\r\n\r\n";
+               "Range: bytes=" << chunk->getStartByte() << "-";
+        if(chunk->getEndByte() >= chunk->getStartByte())
+            req << chunk->getEndByte();
+        req << "\r\n\r\n";
 
         request = req.str();
     }
@@ -122,9 +154,11 @@ bool                PersistentConnection::init              (Chunk *chunk)
         return false;
 
     if(this->sendData(this->prepareRequest(chunk)))
+    {
         this->isInit = true;
+        this->chunkQueue.push_back(chunk);
+    }
 
-    this->chunkQueue.push_back(chunk);
     this->hostname = chunk->getHostname();
 
     return this->isInit;
@@ -152,30 +186,64 @@ bool                PersistentConnection::addChunk          (Chunk *chunk)
 
     return false;
 }
-bool                PersistentConnection::initChunk         (Chunk *chunk)
+void                PersistentConnection::finishChunk       ()
+{
+    Chunk *chunk = this->chunkQueue.front();
+
+    this->chunkQueue.pop_front();
+    this->isHeaderParsed = false;
+    chunk->setDownloaded(true);
+}
+int                 PersistentConnection::dropChunk         ()
+{
+    /* The rest of the response is unknown: restart the pipeline after it */
+    this->finishChunk();
+    return this->endOfStream();
+}
+int                 PersistentConnection::endOfStream       ()
 {
-    if(this->parseHeader())
+    this->closeSocket();
+    this->isHeaderParsed = false;
+
+    if(this->chunkQueue.size() == 0)
     {
-        chunk->setLength(this->contentLength);
-        return true;
+        this->isInit = false;
+        return 0;
     }
 
-    if(!this->reconnect(chunk))
-        return false;
+    /* Resend what was pipelined behind the closed response */
+    return this->resume(this->chunkQueue.front());
+}
+int                 PersistentConnection::resume            (Chunk *chunk)
+{
+    /* Resume where the connection dropped, not from the beginning */
+    if(this->isHeaderParsed && chunk->getBytesRead() > 0)
+    {
+        chunk->setStartByte(chunk->getStartByte() + chunk->getBytesRead());
+        chunk->setUseByteRange(true);
+    }
+    chunk->setBytesRead(0);
 
-    if(this->parseHeader())
+    if(this->reconnect(chunk))
+        return 0;
+
+    /* Nothing pipelined on this connection will arrive anymore */
+    while(this->chunkQueue.size() > 0)
     {
-        chunk->setLength(this->contentLength);
-        return true;
+        this->chunkQueue.front()->setDownloaded(true);
+        this->chunkQueue.pop_front();
     }
+    this->isInit = false;
 
-    return false;
+    return -1;
 }
 bool                PersistentConnection::reconnect         (Chunk *chunk)
 {
     int         count   = 0;
     std::string request = this->prepareRequest(chunk);
 
+    this->closeSocket();
+    this->isHeaderParsed = false;
     while(count < this->RETRY)
     {
         this->httpSocket = net_ConnectTCP(this->stream, chunk->getHostname().c_str(), chunk->getPort());
@@ -196,6 +264,17 @@ bool                PersistentConnection::isConnected       () const
 {
     return this->isInit;
 }
+Chunk*              PersistentConnection::getActiveChunk    () const
+{
+    if(this->chunkQueue.size() == 0)
+        return NULL;
+
+    return this->chunkQueue.front();
+}
+size_t              PersistentConnection::getChunkCount     () const
+{
+    return this->chunkQueue.size();
+}
 bool                PersistentConnection::resendAllRequests ()
 {
     for(size_t i = 0; i < this->chunkQueue.size(); i++)
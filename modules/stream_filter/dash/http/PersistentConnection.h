@@ -43,18 +43,24 @@ namespace dash
                 bool                addChunk    (Chunk *chunk);
                 const std::string&  getHostname () const;
                 bool                isConnected () const;
+                Chunk*              getActiveChunk  () const;
+                size_t              getChunkCount   () const;
 
             private:
                 std::deque<Chunk *>  chunkQueue;
                 bool                isInit;
+                bool                isHeaderParsed;
                 std::string         hostname;
 
                 static const int RETRY;
 
             protected:
                 virtual std::string prepareRequest      (Chunk *chunk);
-                bool                initChunk           (Chunk *chunk);
                 bool                reconnect           (Chunk *chunk);
+                int                 resume              (Chunk *chunk);
+                int                 dropChunk           ();
+                int                 endOfStream         ();
+                void                finishChunk         ();
                 bool                resendAllRequests   ();
         };
     }
@@ -293,14 +293,36 @@ static int fixAccessMux( sout_stream_t *p_stream, char **ppsz_mux,
     return 0;
 }
 
+static bool isFragmentedMux( sout_stream_t *p_stream, const char *psz_mux )
+{
+    bool b_fragmented = var_InheritBool( p_stream, "sout-mp4-fragmented" );
+    char *psz_name;
+    config_chain_t *p_cfg;
+
+    free( config_ChainCreate( &psz_name, &p_cfg, psz_mux ) );
+    for( config_chain_t *p = p_cfg; p != NULL; p = p->p_next )
+    {
+        if( !strcmp( p->psz_name, "fragmented" ) )
+            b_fragmented = true;
+        else if( !strcmp( p->psz_name, "no-fragmented" ) ||
+                 !strcmp( p->psz_name, "nofragmented" ) )
+            b_fragmented = false;
+    }
+    config_ChainDestroy( p_cfg );
+    free( psz_name );
+    return b_fragmented;
+}
+
 static void checkAccessMux( sout_stream_t *p_stream, char *psz_access,
                             char *psz_mux )
 {
     if( !strncmp( psz_access, "mmsh", 4 ) && strncmp( psz_mux, "asfh", 4 ) )
         msg_Err( p_stream, "mmsh output is only valid with asfh mux" );
     else if( strncmp( psz_access, "file", 4 ) &&
-            ( !strncmp( psz_mux, "mov", 3 ) || !strncmp( psz_mux, "mp4", 3 ) ) )
-        msg_Err( p_stream, "mov and mp4 mux are only valid with file output" );
+            ( !strncmp( psz_mux, "mov", 3 ) || !strncmp( psz_mux, "mp4", 3 ) ) &&
+            !isFragmentedMux( p_stream, psz_mux ) )
+        msg_Err( p_stream, "mov and mp4 mux are only valid with file output, "
+                 "unless fragmented" );
     else if( !strncmp( psz_access, "udp", 3 ) )
     {
         if( !strncmp( psz_mux, "ffmpeg", 6 ) || !strncmp( psz_mux, "avformat", 8 ) )
@@ -0,0 +1,359 @@
+/*****************************************************************************
+ * gop.c: transcoding stream output module (parallel GOP encoding)
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *
+ * The output pictures are cut into segments of a fixed number of frames.
+ * Each segment is encoded from scratch by a fresh encoder instance, opened
+ * and closed by the thread that encodes it, so it starts with a key frame
+ * and references nothing outside of itself, and several segments are
+ * encoded at once. The blocks are handed out in segment order.
+ *
+ * Timestamps come from the pictures, so PTS are continuous across segment
+ * joins. With B-frames, an encoder shifts its DTS back by its reordering
+ * delay from the first frame on, and drains the last frames with DTS up to
+ * that delay before their PTS. As every instance gets the same settings,
+ * hence the same delay, DTS stay monotonic across joins too; an encoder
+ * that would not keep its delay constant is reported when the join is
+ * handed out.
+ *****************************************************************************/
+
+#include "transcode.h"
+
+#include <vlc_modules.h>
+
+typedef struct gop_segment_t gop_segment_t;
+
+struct gop_segment_t
+{
+    gop_segment_t  *p_next;
+    unsigned        i_index;
+
+    /* Encoder formats when the segment was started */
+    es_format_t     fmt_in;
+    es_format_t     fmt_out;
+
+    picture_fifo_t *p_pics;
+    unsigned        i_pics;
+
+    block_t        *p_blocks;
+    bool            b_done;
+};
+
+struct transcode_gop_t
+{
+    sout_stream_t  *p_stream;
+    encoder_t      *p_encoder; /* opened encoder, used as a template */
+
+    unsigned        i_frames;
+    unsigned        i_segments;
+    gop_segment_t  *p_current; /* being filled, not queued yet */
+
+    vlc_mutex_t     lock;
+    vlc_cond_t      wait_work;
+    vlc_cond_t      wait_done;
+    gop_segment_t  *p_first;   /* queued segments, in output order */
+    gop_segment_t **pp_last;
+    gop_segment_t  *p_todo;    /* first segment not taken by a thread */
+    unsigned        i_queued;  /* queued segments, encoded or not */
+    unsigned        i_pending; /* queued segments not encoded yet */
+    bool            b_abort;
+
+    mtime_t         i_last_dts; /* of the blocks handed out */
+
+    unsigned        i_threads;
+    vlc_thread_t    threads[];
+};
+
+static void SegmentDelete( gop_segment_t *p_seg )
+{
+    picture_t *p_pic;
+
+    while( (p_pic = picture_fifo_Pop( p_seg->p_pics )) != NULL )
+        picture_Release( p_pic );
+    picture_fifo_Delete( p_seg->p_pics );
+    block_ChainRelease( p_seg->p_blocks );
+    es_format_Clean( &p_seg->fmt_in );
+    es_format_Clean( &p_seg->fmt_out );
+    free( p_seg );
+}
+
+static gop_segment_t *SegmentNew( transcode_gop_t *p_gop )
+{
+    encoder_t *p_enc = p_gop->p_encoder;
+    gop_segment_t *p_seg = calloc( 1, sizeof( *p_seg ) );
+
+    if( unlikely( p_seg == NULL ) )
+        return NULL;
+
+    p_seg->p_pics = picture_fifo_New();
+    if( unlikely( p_seg->p_pics == NULL ) )
+    {
+        free( p_seg );
+        return NULL;
+    }
+    p_seg->i_index = p_gop->i_segments++;
+
+    es_format_Copy( &p_seg->fmt_in, &p_enc->fmt_in );
+    es_format_Copy( &p_seg->fmt_out, &p_enc->fmt_out );
+    /* Every encoder instance builds its own */
+    free( p_seg->fmt_out.p_extra );
+    p_seg->fmt_out.p_extra = NULL;
+    p_seg->fmt_out.i_extra = 0;
+    return p_seg;
+}
+
+static void SegmentEncode( transcode_gop_t *p_gop, gop_segment_t *p_seg )
+{
+    sout_stream_t *p_stream = p_gop->p_stream;
+    sout_stream_sys_t *p_sys = p_stream->p_sys;
+    encoder_t *p_enc = sout_EncoderCreate( p_stream );
+    picture_t *p_pic;
+    block_t *p_block;
+
+    if( unlikely( p_enc == NULL ) )
+        return;
+
+    p_enc->fmt_in = p_seg->fmt_in;
+    p_enc->fmt_out = p_seg->fmt_out;
+    p_enc->i_threads = p_gop->p_encoder->i_threads;
+    p_enc->p_cfg = p_gop->p_encoder->p_cfg;
+
+    p_enc->p_module = module_need( p_enc, "encoder", p_sys->psz_venc, true );
+    if( p_enc->p_module == NULL )
+    {
+        msg_Err( p_stream, "cannot open encoder for segment %u",
+                 p_seg->i_index );
+        goto out;
+    }
+
+    while( (p_pic = picture_fifo_Pop( p_seg->p_pics )) != NULL )
+    {
+        p_block = p_enc->pf_encode_video( p_enc, p_pic );
+        block_ChainAppend( &p_seg->p_blocks, p_block );
+        picture_Release( p_pic );
+    }
+
+    do {
+        p_block = p_enc->pf_encode_video( p_enc, NULL );
+        block_ChainAppend( &p_seg->p_blocks, p_block );
+    } while( p_block );
+
+    module_unneed( p_enc, p_enc->p_module );
+out:
+    /* The formats are shallow copies, except for what the encoder built */
+    free( p_enc->fmt_out.p_extra );
+    vlc_object_release( p_enc );
+}
+
+static void *SegmentThread( void *data )
+{
+    transcode_gop_t *p_gop = data;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_gop->lock );
+    for( ;; )
+    {
+        while( !p_gop->b_abort && p_gop->p_todo == NULL )
+            vlc_cond_wait( &p_gop->wait_work, &p_gop->lock );
+        if( p_gop->b_abort )
+            break;
+
+        gop_segment_t *p_seg = p_gop->p_todo;
+        p_gop->p_todo = p_seg->p_next;
+        vlc_mutex_unlock( &p_gop->lock );
+
+        SegmentEncode( p_gop, p_seg );
+
+        vlc_mutex_lock( &p_gop->lock );
+        p_seg->b_done = true;
+        p_gop->i_pending--;
+        vlc_cond_broadcast( &p_gop->wait_done );
+    }
+    vlc_mutex_unlock( &p_gop->lock );
+
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+/* Hands the current segment over to the encoding threads */
+static void SegmentQueue( transcode_gop_t *p_gop )
+{
+    gop_segment_t *p_seg = p_gop->p_current;
+
+    if( p_seg == NULL )
+        return;
+    p_gop->p_current = NULL;
+
+    vlc_mutex_lock( &p_gop->lock );
+    *p_gop->pp_last = p_seg;
+    p_gop->pp_last = &p_seg->p_next;
+    if( p_gop->p_todo == NULL )
+        p_gop->p_todo = p_seg;
+    p_gop->i_queued++;
+    p_gop->i_pending++;
+    vlc_cond_signal( &p_gop->wait_work );
+
+    /* Do not decode faster than we can encode: no segment waits for a
+     * thread, and raw pictures are held for at most one segment per
+     * thread plus the current one. Encoded segments at the head are handed
+     * out by transcode_gop_Get(), which the caller runs next. */
+    while( p_gop->i_queued > p_gop->i_threads && !p_gop->p_first->b_done )
+        vlc_cond_wait( &p_gop->wait_done, &p_gop->lock );
+    vlc_mutex_unlock( &p_gop->lock );
+}
+
+transcode_gop_t *transcode_gop_New( sout_stream_t *p_stream,
+                                    encoder_t *p_encoder,
+                                    unsigned i_threads, unsigned i_frames )
+{
+    transcode_gop_t *p_gop = malloc( sizeof( *p_gop )
+                                     + i_threads * sizeof( vlc_thread_t ) );
+    if( unlikely( p_gop == NULL ) )
+        return NULL;
+
+    p_gop->p_stream = p_stream;
+    p_gop->p_encoder = p_encoder;
+    p_gop->i_frames = i_frames;
+    p_gop->i_segments = 0;
+    p_gop->p_current = NULL;
+    vlc_mutex_init( &p_gop->lock );
+    vlc_cond_init( &p_gop->wait_work );
+    vlc_cond_init( &p_gop->wait_done );
+    p_gop->p_first = NULL;
+    p_gop->pp_last = &p_gop->p_first;
+    p_gop->p_todo = NULL;
+    p_gop->i_queued = 0;
+    p_gop->i_pending = 0;
+    p_gop->b_abort = false;
+    p_gop->i_last_dts = VLC_TS_INVALID;
+    p_gop->i_threads = 0;
+
+    for( unsigned i = 0; i < i_threads; i++ )
+    {
+        if( vlc_clone( &p_gop->threads[i], SegmentThread, p_gop,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+            break;
+        p_gop->i_threads++;
+    }
+
+    if( p_gop->i_threads == 0 )
+    {
+        msg_Err( p_stream, "cannot spawn segment encoder threads" );
+        transcode_gop_Delete( p_gop );
+        return NULL;
+    }
+    msg_Dbg( p_stream, "encoding segments of %u frames on %u threads",
+             i_frames, p_gop->i_threads );
+    return p_gop;
+}
+
+void transcode_gop_Delete( transcode_gop_t *p_gop )
+{
+    vlc_mutex_lock( &p_gop->lock );
+    p_gop->b_abort = true;
+    vlc_cond_broadcast( &p_gop->wait_work );
+    vlc_mutex_unlock( &p_gop->lock );
+
+    for( unsigned i = 0; i < p_gop->i_threads; i++ )
+        vlc_join( p_gop->threads[i], NULL );
+
+    while( p_gop->p_first != NULL )
+    {
+        gop_segment_t *p_seg = p_gop->p_first;
+
+        p_gop->p_first = p_seg->p_next;
+        SegmentDelete( p_seg );
+    }
+    if( p_gop->p_current != NULL )
+        SegmentDelete( p_gop->p_current );
+
+    vlc_cond_destroy( &p_gop->wait_done );
+    vlc_cond_destroy( &p_gop->wait_work );
+    vlc_mutex_destroy( &p_gop->lock );
+    free( p_gop );
+}
+
+/**
+ * Adds a picture to the current segment, which is queued for encoding once
+ * full. This may wait for other segments to be encoded.
+ */
+void transcode_gop_Push( transcode_gop_t *p_gop, picture_t *p_pic )
+{
+    if( p_gop->p_current == NULL )
+    {
+        p_gop->p_current = SegmentNew( p_gop );
+        if( unlikely( p_gop->p_current == NULL ) )
+        {
+            picture_Release( p_pic );
+            return;
+        }
+    }
+
+    picture_fifo_Push( p_gop->p_current->p_pics, p_pic );
+    if( ++p_gop->p_current->i_pics >= p_gop->i_frames )
+        SegmentQueue( p_gop );
+}
+
+/**
+ * Returns the blocks of the encoded segments that come next in order.
+ * With b_drain, the current segment is queued even if not full, and
+ * all segments are waited for.
+ */
+block_t *transcode_gop_Get( transcode_gop_t *p_gop, bool b_drain )
+{
+    block_t *p_out = NULL;
+
+    if( b_drain )
+        SegmentQueue( p_gop );
+
+    vlc_mutex_lock( &p_gop->lock );
+    if( b_drain )
+        while( p_gop->i_pending > 0 )
+            vlc_cond_wait( &p_gop->wait_done, &p_gop->lock );
+
+    while( p_gop->p_first != NULL && p_gop->p_first->b_done )
+    {
+        gop_segment_t *p_seg = p_gop->p_first;
+
+        p_gop->p_first = p_seg->p_next;
+        if( p_gop->p_first == NULL )
+            p_gop->pp_last = &p_gop->p_first;
+        p_gop->i_queued--;
+
+        for( block_t *p_block = p_seg->p_blocks; p_block != NULL;
+             p_block = p_block->p_next )
+        {
+            if( p_block->i_dts <= VLC_TS_INVALID )
+                continue;
+            if( p_block->i_dts < p_gop->i_last_dts )
+                msg_Warn( p_gop->p_stream, "segment %u goes back in time "
+                          "by %"PRId64" us", p_seg->i_index,
+                          p_gop->i_last_dts - p_block->i_dts );
+            p_gop->i_last_dts = p_block->i_dts;
+        }
+        block_ChainAppend( &p_out, p_seg->p_blocks );
+        p_seg->p_blocks = NULL;
+        SegmentDelete( p_seg );
+    }
+    vlc_mutex_unlock( &p_gop->lock );
+    return p_out;
+}
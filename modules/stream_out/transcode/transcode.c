@@ -131,6 +131,14 @@
 #define HP_LONGTEXT N_( \
     "Runs the optional encoder thread at the OUTPUT priority instead of " \
     "VIDEO." )
+#define GOP_THREADS_TEXT N_("Parallel GOP encoders")
+#define GOP_THREADS_LONGTEXT N_( \
+    "Number of video segments encoded at the same time, each by its own " \
+    "encoder instance and starting with a key frame. This is meant for " \
+    "file conversions, as it adds a lot of latency. 0 disables it." )
+#define GOP_FRAMES_TEXT N_("Parallel GOP length")
+#define GOP_FRAMES_LONGTEXT N_( \
+    "Number of frames in each segment encoded in parallel." )
 
 #define ASYNC_TEXT N_("Synchronise on audio track")
 #define ASYNC_LONGTEXT N_( \
@@ -226,6 +234,10 @@ vlc_module_begin ()
                  THREADS_LONGTEXT, true )
     add_bool( SOUT_CFG_PREFIX "high-priority", false, HP_TEXT, HP_LONGTEXT,
               true )
+    add_integer( SOUT_CFG_PREFIX "gop-threads", 0, GOP_THREADS_TEXT,
+                 GOP_THREADS_LONGTEXT, true )
+    add_integer( SOUT_CFG_PREFIX "gop-frames", 250, GOP_FRAMES_TEXT,
+                 GOP_FRAMES_LONGTEXT, true )
 
 vlc_module_end ()
 
@@ -235,7 +247,7 @@ static const char *const ppsz_sout_options[] = {
     "deinterlace-module", "threads", "hurry-up", "aenc", "acodec", "ab", "alang",
     "afilter", "samplerate", "channels", "senc", "scodec", "soverlay",
     "sfilter", "osd", "audio-sync", "high-priority", "maxwidth", "maxheight",
-    NULL
+    "gop-threads", "gop-frames", NULL
 };
 
 /*****************************************************************************
@@ -383,6 +395,11 @@ static int Open( vlc_object_t *p_this )
 
     p_sys->i_threads = var_GetInteger( p_stream, SOUT_CFG_PREFIX "threads" );
     p_sys->b_high_priority = var_GetBool( p_stream, SOUT_CFG_PREFIX "high-priority" );
+    p_sys->i_gop_threads = var_GetInteger( p_stream, SOUT_CFG_PREFIX "gop-threads" );
+    p_sys->i_gop_frames = var_GetInteger( p_stream, SOUT_CFG_PREFIX "gop-frames" );
+    if( p_sys->i_gop_frames < 1 )
+        p_sys->i_gop_frames = 1;
+    p_sys->p_gop = NULL;
 
     if( p_sys->i_vcodec )
     {
@@ -14,6 +14,8 @@
 /*100ms is around the limit where people are noticing lipsync issues*/
 #define MASTER_SYNC_MAX_DRIFT 100000
 
+typedef struct transcode_gop_t transcode_gop_t;
+
 struct sout_stream_sys_t
 {
     sout_stream_id_t *id_video;
@@ -51,6 +53,9 @@ struct sout_stream_sys_t
     config_chain_t  *p_deinterlace_cfg;
     int             i_threads;
     bool            b_high_priority;
+    int             i_gop_threads;
+    int             i_gop_frames;
+    transcode_gop_t *p_gop;
     bool            b_hurry_up;
 
     char            *psz_vf2;
@@ -140,3 +145,11 @@ int  transcode_video_process( sout_stream_t *, sout_stream_id_t *,
                                      block_t *, block_t ** );
 bool transcode_video_add    ( sout_stream_t *, es_format_t *,
                                 sout_stream_id_t *);
+
+/* Parallel GOP encoding */
+
+transcode_gop_t *transcode_gop_New( sout_stream_t *, encoder_t *,
+                                    unsigned, unsigned );
+void     transcode_gop_Delete( transcode_gop_t * );
+void     transcode_gop_Push  ( transcode_gop_t *, picture_t * );
+block_t *transcode_gop_Get   ( transcode_gop_t *, bool );
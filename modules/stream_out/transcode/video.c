@@ -262,7 +262,8 @@ int transcode_video_new( sout_stream_t *p_stream, sout_stream_id_t *id )
     }
     id->p_encoder->p_module = NULL;
 
-    if( p_sys->i_threads >= 1 )
+    /* Segments have their own threads, see transcode_video_process() */
+    if( p_sys->i_threads >= 1 && p_sys->i_gop_threads <= 0 )
     {
         int i_priority = p_sys->b_high_priority ? VLC_THREAD_PRIORITY_OUTPUT :
                            VLC_THREAD_PRIORITY_VIDEO;
@@ -619,7 +620,13 @@ static int transcode_video_encoder_open( sout_stream_t *p_stream,
 void transcode_video_close( sout_stream_t *p_stream,
                                    sout_stream_id_t *id )
 {
-    if( p_stream->p_sys->i_threads >= 1 )
+    if( p_stream->p_sys->p_gop )
+    {
+        transcode_gop_Delete( p_stream->p_sys->p_gop );
+        p_stream->p_sys->p_gop = NULL;
+    }
+    else if( p_stream->p_sys->i_threads >= 1 &&
+             p_stream->p_sys->i_gop_threads <= 0 )
     {
         vlc_mutex_lock( &p_stream->p_sys->lock_out );
         p_stream->p_sys->b_abort = true;
@@ -654,11 +661,27 @@ void transcode_video_close( sout_stream_t *p_stream,
         filter_chain_Delete( id->p_uf_chain );
 }
 
+/* Hands a picture over to the encoder thread or to the segment encoders */
+static void PushPicture( sout_stream_sys_t *p_sys, picture_t *p_pic )
+{
+    if( p_sys->p_gop )
+    {
+        transcode_gop_Push( p_sys->p_gop, p_pic );
+        return;
+    }
+
+    vlc_mutex_lock( &p_sys->lock_out );
+    picture_fifo_Push( p_sys->pp_pics, p_pic );
+    vlc_cond_signal( &p_sys->cond );
+    vlc_mutex_unlock( &p_sys->lock_out );
+}
+
 static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream_t *p_stream, sout_stream_id_t *id, block_t **out )
 {
 
     picture_t *p_pic2 = NULL;
     bool b_need_duplicate=false;
+    const bool b_async = p_sys->i_threads >= 1 || p_sys->p_gop != NULL;
     /* If input pts + input_frame_interval is lower than next_output_pts - output_frame_interval
      * Then the future input frame should fit better and we can drop this one 
      *
@@ -717,7 +740,7 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
     /*This pts is handled, increase clock to next one*/
     date_Increment( &id->next_output_pts, id->p_encoder->fmt_in.video.i_frame_rate_base );
 
-    if( p_sys->i_threads == 0 )
+    if( !b_async )
     {
         block_t *p_block;
 
@@ -729,7 +752,7 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
     b_need_duplicate = ( date_Get( &id->next_output_pts ) + id->i_output_frame_interval ) <
                        ( date_Get( &id->interpolated_pts ) );
 
-    if( p_sys->i_threads )
+    if( b_async )
     {
         if( p_sys->b_master_sync )
         {
@@ -737,15 +760,12 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
             if( likely( p_pic2 != NULL ) )
                 picture_Copy( p_pic2, p_pic );
         }
-        vlc_mutex_lock( &p_sys->lock_out );
-        picture_fifo_Push( p_sys->pp_pics, p_pic );
-        vlc_cond_signal( &p_sys->cond );
-        vlc_mutex_unlock( &p_sys->lock_out );
+        PushPicture( p_sys, p_pic );
     }
 
     while( (p_sys->b_master_sync && b_need_duplicate ))
     {
-        if( p_sys->i_threads >= 1 )
+        if( b_async )
         {
             picture_t *p_tmp = NULL;
             /* We can't modify the picture, we need to duplicate it */
@@ -754,10 +774,7 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
             {
                 picture_Copy( p_tmp, p_pic2 );
                 p_tmp->date = date_Get( &id->next_output_pts );
-                vlc_mutex_lock( &p_sys->lock_out );
-                picture_fifo_Push( p_sys->pp_pics, p_tmp );
-                vlc_cond_signal( &p_sys->cond );
-                vlc_mutex_unlock( &p_sys->lock_out );
+                PushPicture( p_sys, p_tmp );
             }
         }
         else
@@ -775,9 +792,9 @@ static void OutputFrame( sout_stream_sys_t *p_sys, picture_t *p_pic, sout_stream
                            ( date_Get( &id->interpolated_pts ) );
     }
 
-    if( p_sys->i_threads && p_pic2 )
+    if( b_async && p_pic2 )
         picture_Release( p_pic2 );
-    else if ( p_sys->i_threads == 0 )
+    else if ( !b_async )
         picture_Release( p_pic );
 }
 
@@ -790,7 +807,12 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_t *id,
 
     if( unlikely( in == NULL ) )
     {
-        if( p_sys->i_threads == 0 )
+        if( p_sys->i_gop_threads > 0 )
+        {
+            if( p_sys->p_gop )
+                *out = transcode_gop_Get( p_sys->p_gop, true );
+        }
+        else if( p_sys->i_threads == 0 )
         {
             block_t *p_block;
             do {
@@ -876,7 +898,11 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_t *id,
             conversion_video_filter_append( id );
             memcpy( &p_sys->fmt_input_video, &id->p_decoder->fmt_out.video, sizeof(video_format_t));
 
-            if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS )
+            if( transcode_video_encoder_open( p_stream, id ) != VLC_SUCCESS
+             || ( p_sys->i_gop_threads > 0 &&
+                  (p_sys->p_gop = transcode_gop_New( p_stream, id->p_encoder,
+                                                     p_sys->i_gop_threads,
+                                                     p_sys->i_gop_frames )) == NULL ) )
             {
                 picture_Release( p_pic );
                 transcode_video_close( p_stream, id );
@@ -973,7 +999,12 @@ int transcode_video_process( sout_stream_t *p_stream, sout_stream_id_t *id,
         }
     }
 
-    if( p_sys->i_threads >= 1 )
+    if( p_sys->p_gop )
+    {
+        /* Pick up the segments done so far, in order */
+        *out = transcode_gop_Get( p_sys->p_gop, false );
+    }
+    else if( p_sys->i_threads >= 1 && p_sys->i_gop_threads <= 0 )
     {
         /* Pick up any return data the encoder thread wants to output. */
         vlc_mutex_lock( &p_sys->lock_out );
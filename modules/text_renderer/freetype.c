@@ -186,6 +186,9 @@ static const char *const ppsz_sizes_text[] = {
 #define YUVP_TEXT N_("Use YUVP renderer")
 #define YUVP_LONGTEXT N_("This renders the font using \"paletized YUV\". " \
   "This option is only needed if you want to encode into DVB subtitles" )
+#define CACHE_SIZE_TEXT N_("Glyph cache size")
+#define CACHE_SIZE_LONGTEXT N_("Memory in KiB used to keep the rendered " \
+  "glyphs from one text to the next. 0 disables the cache." )
 
 static const int pi_color_values[] = {
   0x00000000, 0x00808080, 0x00C0C0C0, 0x00FFFFFF, 0x00800000,
@@ -280,6 +283,9 @@ vlc_module_begin ()
 
     add_bool( "freetype-yuvp", false, YUVP_TEXT,
               YUVP_LONGTEXT, true )
+    add_integer( "freetype-cache-size", 1024, CACHE_SIZE_TEXT,
+                 CACHE_SIZE_LONGTEXT, true )
+        change_integer_range( 0, 65536 )
     set_capability( "text renderer", 100 )
     add_shortcut( "text" )
     set_callbacks( Create, Destroy )
@@ -312,6 +318,60 @@ struct line_desc_t
     line_character_t *p_character;
 };
 
+/* The rendered glyphs are kept from one text to the next, in least recently
+ * used order. They are rendered at the subpixel part of the pen position,
+ * and moved by whole pixels when used. */
+typedef struct
+{
+    FT_Face   p_face;
+    FT_Fixed  i_x_scale;
+    FT_Fixed  i_y_scale;
+    int       i_glyph_index;
+    int       i_style_flags;            /* synthetic bold and italic */
+    int       i_outline_radius;         /* 0 without outline */
+    bool      b_shadow;
+    FT_Vector pen;                      /* subpixel part of the pen */
+    FT_Vector pen_shadow;               /* subpixel part of the shadow pen */
+} glyph_key_t;
+
+typedef struct glyph_entry_t glyph_entry_t;
+struct glyph_entry_t
+{
+    glyph_entry_t *p_next;              /* in the hash bucket */
+    glyph_entry_t *p_lru_prev;
+    glyph_entry_t *p_lru_next;
+    glyph_key_t    key;
+
+    FT_Glyph       p_glyph;
+    FT_Glyph       p_outline;
+    FT_Glyph       p_shadow;
+    FT_Vector      advance;
+    size_t         i_size;
+};
+
+#define GLYPH_CACHE_BUCKETS 1024
+
+typedef struct
+{
+    glyph_entry_t *pp_bucket[GLYPH_CACHE_BUCKETS];
+    glyph_entry_t *p_lru_first;         /* most recently used */
+    glyph_entry_t *p_lru_last;
+    size_t         i_size;
+    size_t         i_size_max;
+    unsigned       i_hits;
+    unsigned       i_misses;
+} glyph_cache_t;
+
+/* Faces loaded for the text styles, kept until the filter is destroyed */
+typedef struct
+{
+    char    *psz_fontname;
+    int      i_style_flags;
+    FT_Face  p_face;                    /* NULL to use the default face */
+} cached_face_t;
+
+#define FACE_CACHE_MAX 32
+
 /*****************************************************************************
  * filter_sys_t: freetype local data
  *****************************************************************************
@@ -337,6 +397,12 @@ struct filter_sys_t
     input_attachment_t **pp_font_attachments;
     int                  i_font_attachments;
 
+    /* Caches */
+    cached_face_t  *p_faces;
+    int             i_faces;
+    glyph_cache_t   glyphs;
+    int             i_outline_radius;   /* current stroker radius */
+
     /* Cache the Win32 font folder */
 #ifdef _WIN32
     char*          psz_win_fonts_path;
@@ -1441,22 +1507,190 @@ static FT_Face LoadFace( filter_t *p_filter,
     return p_face;
 }
 
-static int GetGlyph( filter_t *p_filter,
-                     FT_Glyph *pp_glyph,   FT_BBox *p_glyph_bbox,
-                     FT_Glyph *pp_outline, FT_BBox *p_outline_bbox,
-                     FT_Glyph *pp_shadow,  FT_BBox *p_shadow_bbox,
+static void GlyphEntryDelete( glyph_entry_t *p_entry )
+{
+    FT_Done_Glyph( p_entry->p_glyph );
+    if( p_entry->p_outline )
+        FT_Done_Glyph( p_entry->p_outline );
+    if( p_entry->p_shadow )
+        FT_Done_Glyph( p_entry->p_shadow );
+    free( p_entry );
+}
 
-                     FT_Face  p_face,
-                     int i_glyph_index,
-                     int i_style_flags,
-                     FT_Vector *p_pen,
-                     FT_Vector *p_pen_shadow )
+static void GlyphCacheInit( glyph_cache_t *p_cache, size_t i_size_max )
+{
+    memset( p_cache, 0, sizeof(*p_cache) );
+    p_cache->i_size_max = i_size_max;
+}
+
+static void GlyphCacheClear( glyph_cache_t *p_cache )
+{
+    for( glyph_entry_t *p_entry = p_cache->p_lru_first; p_entry != NULL; )
+    {
+        glyph_entry_t *p_next = p_entry->p_lru_next;
+        GlyphEntryDelete( p_entry );
+        p_entry = p_next;
+    }
+    memset( p_cache->pp_bucket, 0, sizeof(p_cache->pp_bucket) );
+    p_cache->p_lru_first = p_cache->p_lru_last = NULL;
+    p_cache->i_size = 0;
+}
+
+static unsigned GlyphKeyHash( const glyph_key_t *p_key )
+{
+    /* FNV-1a, the keys are zeroed before being filled */
+    const uint8_t *p = (const uint8_t *)p_key;
+    uint32_t i_hash = 2166136261u;
+
+    for( size_t i = 0; i < sizeof(*p_key); i++ )
+        i_hash = (i_hash ^ p[i]) * 16777619u;
+    return i_hash % GLYPH_CACHE_BUCKETS;
+}
+
+static void GlyphCacheUnlinkLRU( glyph_cache_t *p_cache, glyph_entry_t *p_entry )
+{
+    if( p_entry->p_lru_prev )
+        p_entry->p_lru_prev->p_lru_next = p_entry->p_lru_next;
+    else
+        p_cache->p_lru_first = p_entry->p_lru_next;
+    if( p_entry->p_lru_next )
+        p_entry->p_lru_next->p_lru_prev = p_entry->p_lru_prev;
+    else
+        p_cache->p_lru_last = p_entry->p_lru_prev;
+}
+
+static void GlyphCacheLinkLRU( glyph_cache_t *p_cache, glyph_entry_t *p_entry )
+{
+    p_entry->p_lru_prev = NULL;
+    p_entry->p_lru_next = p_cache->p_lru_first;
+    if( p_cache->p_lru_first )
+        p_cache->p_lru_first->p_lru_prev = p_entry;
+    else
+        p_cache->p_lru_last = p_entry;
+    p_cache->p_lru_first = p_entry;
+}
+
+static glyph_entry_t *GlyphCacheGet( glyph_cache_t *p_cache,
+                                     const glyph_key_t *p_key )
+{
+    glyph_entry_t *p_entry = p_cache->pp_bucket[GlyphKeyHash( p_key )];
+
+    while( p_entry && memcmp( &p_entry->key, p_key, sizeof(*p_key) ) )
+        p_entry = p_entry->p_next;
+
+    if( !p_entry )
+    {
+        p_cache->i_misses++;
+        return NULL;
+    }
+    p_cache->i_hits++;
+
+    GlyphCacheUnlinkLRU( p_cache, p_entry );
+    GlyphCacheLinkLRU( p_cache, p_entry );
+    return p_entry;
+}
+
+static void GlyphCacheAdd( glyph_cache_t *p_cache, glyph_entry_t *p_entry )
+{
+    glyph_entry_t **pp_bucket = &p_cache->pp_bucket[GlyphKeyHash( &p_entry->key )];
+
+    p_entry->p_next = *pp_bucket;
+    *pp_bucket = p_entry;
+    GlyphCacheLinkLRU( p_cache, p_entry );
+    p_cache->i_size += p_entry->i_size;
+
+    /* Evict the least recently used glyphs */
+    while( p_cache->i_size > p_cache->i_size_max )
+    {
+        glyph_entry_t *p_old = p_cache->p_lru_last;
+
+        pp_bucket = &p_cache->pp_bucket[GlyphKeyHash( &p_old->key )];
+        while( *pp_bucket != p_old )
+            pp_bucket = &(*pp_bucket)->p_next;
+        *pp_bucket = p_old->p_next;
+
+        GlyphCacheUnlinkLRU( p_cache, p_old );
+        p_cache->i_size -= p_old->i_size;
+        GlyphEntryDelete( p_old );
+    }
+}
+
+static size_t GlyphSize( FT_Glyph glyph )
+{
+    if( !glyph )
+        return 0;
+
+    const FT_Bitmap *p_bitmap = &((FT_BitmapGlyph)glyph)->bitmap;
+    return sizeof(FT_BitmapGlyphRec) + p_bitmap->rows * abs( p_bitmap->pitch );
+}
+
+/* Faces are cached along with the glyphs rendered from them */
+static void ClearFaces( filter_sys_t *p_sys )
+{
+    GlyphCacheClear( &p_sys->glyphs );
+
+    for( int i = 0; i < p_sys->i_faces; i++ )
+    {
+        if( p_sys->p_faces[i].p_face )
+            FT_Done_Face( p_sys->p_faces[i].p_face );
+        free( p_sys->p_faces[i].psz_fontname );
+    }
+    free( p_sys->p_faces );
+    p_sys->p_faces = NULL;
+    p_sys->i_faces = 0;
+}
+
+static FT_Face GetFace( filter_t *p_filter, const text_style_t *p_style )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    const int i_style_flags = p_style->i_style_flags & (STYLE_BOLD | STYLE_ITALIC);
+
+    for( int i = 0; i < p_sys->i_faces; i++ )
+    {
+        const cached_face_t *p_cached = &p_sys->p_faces[i];
+
+        if( p_cached->i_style_flags == i_style_flags &&
+            !strcmp( p_cached->psz_fontname, p_style->psz_fontname ) )
+            return p_cached->p_face;
+    }
+
+    if( p_sys->i_faces >= FACE_CACHE_MAX )
+        ClearFaces( p_sys );
+
+    FT_Face p_face = LoadFace( p_filter, p_style );
+
+    char *psz_fontname = strdup( p_style->psz_fontname );
+    cached_face_t *p_faces = realloc( p_sys->p_faces,
+                                      (p_sys->i_faces + 1) * sizeof(*p_faces) );
+    if( unlikely(!psz_fontname || !p_faces) )
+    {
+        if( p_faces )
+            p_sys->p_faces = p_faces;
+        free( psz_fontname );
+        if( p_face )
+            FT_Done_Face( p_face );
+        return NULL;
+    }
+    p_faces[p_sys->i_faces++] = (cached_face_t){
+        .psz_fontname = psz_fontname,
+        .i_style_flags = i_style_flags,
+        .p_face = p_face,
+    };
+    p_sys->p_faces = p_faces;
+    return p_face;
+}
+
+static glyph_entry_t *RenderGlyph( filter_t *p_filter,
+                                   const glyph_key_t *p_key,
+                                   FT_Face  p_face,
+                                   int i_glyph_index,
+                                   int i_style_flags )
 {
     if( FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_NO_BITMAP | FT_LOAD_DEFAULT ) &&
         FT_Load_Glyph( p_face, i_glyph_index, FT_LOAD_DEFAULT ) )
     {
         msg_Err( p_filter, "unable to render text FT_Load_Glyph failed" );
-        return VLC_EGENERIC;
+        return NULL;
     }
 
     /* Do synthetic styling now that Freetype supports it;
@@ -1472,11 +1706,11 @@ static int GetGlyph( filter_t *p_filter,
     if( FT_Get_Glyph( p_face->glyph, &glyph ) )
     {
         msg_Err( p_filter, "unable to render text FT_Get_Glyph failed" );
-        return VLC_EGENERIC;
+        return NULL;
     }
 
     FT_Glyph outline = NULL;
-    if( p_filter->p_sys->p_stroker )
+    if( p_key->i_outline_radius > 0 )
     {
         outline = glyph;
         if( FT_Glyph_StrokeBorder( &outline, p_filter->p_sys->p_stroker, 0, 0 ) )
@@ -1484,55 +1718,146 @@ static int GetGlyph( filter_t *p_filter,
     }
 
     FT_Glyph shadow = NULL;
-    if( p_filter->p_sys->style.i_shadow_alpha > 0 )
+    if( p_key->b_shadow )
     {
+        FT_Vector pen_shadow = p_key->pen_shadow;
+
         shadow = outline ? outline : glyph;
-        if( FT_Glyph_To_Bitmap( &shadow, FT_RENDER_MODE_NORMAL, p_pen_shadow, 0  ) )
-        {
+        if( FT_Glyph_To_Bitmap( &shadow, FT_RENDER_MODE_NORMAL, &pen_shadow, 0  ) )
             shadow = NULL;
-        }
-        else
-        {
-            FT_Glyph_Get_CBox( shadow, ft_glyph_bbox_pixels, p_shadow_bbox );
-        }
     }
-    *pp_shadow = shadow;
 
-    if( FT_Glyph_To_Bitmap( &glyph, FT_RENDER_MODE_NORMAL, p_pen, 1) )
+    FT_Vector pen = p_key->pen;
+    if( FT_Glyph_To_Bitmap( &glyph, FT_RENDER_MODE_NORMAL, &pen, 1) )
     {
         FT_Done_Glyph( glyph );
         if( outline )
             FT_Done_Glyph( outline );
         if( shadow )
             FT_Done_Glyph( shadow );
-        return VLC_EGENERIC;
+        return NULL;
     }
-    FT_Glyph_Get_CBox( glyph, ft_glyph_bbox_pixels, p_glyph_bbox );
-    *pp_glyph = glyph;
 
-    if( outline )
+    if( outline && FT_Glyph_To_Bitmap( &outline, FT_RENDER_MODE_NORMAL, &pen, 1 ) )
     {
-        FT_Glyph_To_Bitmap( &outline, FT_RENDER_MODE_NORMAL, p_pen, 1 );
-        FT_Glyph_Get_CBox( outline, ft_glyph_bbox_pixels, p_outline_bbox );
+        FT_Done_Glyph( outline );
+        outline = NULL;
     }
-    *pp_outline = outline;
 
+    glyph_entry_t *p_entry = malloc( sizeof(*p_entry) );
+    if( unlikely(!p_entry) )
+    {
+        FT_Done_Glyph( glyph );
+        if( outline )
+            FT_Done_Glyph( outline );
+        if( shadow )
+            FT_Done_Glyph( shadow );
+        return NULL;
+    }
+    p_entry->key = *p_key;
+    p_entry->p_glyph = glyph;
+    p_entry->p_outline = outline;
+    p_entry->p_shadow = shadow;
+    p_entry->advance = p_face->glyph->advance;
+    p_entry->i_size = sizeof(*p_entry) + GlyphSize( glyph ) +
+                      GlyphSize( outline ) + GlyphSize( shadow );
+    return p_entry;
+}
+
+/* Moves a glyph rendered at the subpixel part of the pen to the pen */
+static FT_Glyph PlaceGlyph( FT_Glyph glyph, bool b_copy,
+                            const FT_Vector *p_pen, FT_BBox *p_bbox )
+{
+    if( !glyph )
+        return NULL;
+    if( b_copy && FT_Glyph_Copy( glyph, &glyph ) )
+        return NULL;
+
+    FT_BitmapGlyph glyph_bmp = (FT_BitmapGlyph)glyph;
+    glyph_bmp->left += FT_FLOOR(p_pen->x);
+    glyph_bmp->top  += FT_FLOOR(p_pen->y);
+    FT_Glyph_Get_CBox( glyph, ft_glyph_bbox_pixels, p_bbox );
+    return glyph;
+}
+
+static int GetGlyph( filter_t *p_filter,
+                     FT_Glyph *pp_glyph,   FT_BBox *p_glyph_bbox,
+                     FT_Glyph *pp_outline, FT_BBox *p_outline_bbox,
+                     FT_Glyph *pp_shadow,  FT_BBox *p_shadow_bbox,
+                     FT_Vector *p_advance,
+
+                     FT_Face  p_face,
+                     int i_glyph_index,
+                     int i_style_flags,
+                     FT_Vector *p_pen,
+                     FT_Vector *p_pen_shadow )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+    glyph_key_t key;
+
+    memset( &key, 0, sizeof(key) );
+    key.p_face = p_face;
+    key.i_x_scale = p_face->size->metrics.x_scale;
+    key.i_y_scale = p_face->size->metrics.y_scale;
+    key.i_glyph_index = i_glyph_index;
+    key.i_style_flags = i_style_flags & (STYLE_BOLD | STYLE_ITALIC);
+    key.i_outline_radius = p_sys->p_stroker ? p_sys->i_outline_radius : 0;
+    key.b_shadow = p_sys->style.i_shadow_alpha > 0;
+    key.pen.x = p_pen->x & 63;
+    key.pen.y = p_pen->y & 63;
+    if( key.b_shadow )
+    {
+        key.pen_shadow.x = p_pen_shadow->x & 63;
+        key.pen_shadow.y = p_pen_shadow->y & 63;
+    }
+
+    bool b_new = false;
+    glyph_entry_t *p_entry = GlyphCacheGet( &p_sys->glyphs, &key );
+    if( !p_entry )
+    {
+        p_entry = RenderGlyph( p_filter, &key, p_face,
+                               i_glyph_index, i_style_flags );
+        if( !p_entry )
+            return VLC_EGENERIC;
+        b_new = true;
+    }
+
+    /* Without cache, the rendered glyphs are used as is */
+    const bool b_cached = p_sys->glyphs.i_size_max > 0;
+    *pp_glyph = PlaceGlyph( p_entry->p_glyph, b_cached, p_pen, p_glyph_bbox );
+    if( !*pp_glyph )
+    {
+        if( b_new )
+            GlyphEntryDelete( p_entry );
+        return VLC_EGENERIC;
+    }
+    *pp_outline = PlaceGlyph( p_entry->p_outline, b_cached, p_pen,
+                              p_outline_bbox );
+    *pp_shadow = PlaceGlyph( p_entry->p_shadow, b_cached, p_pen_shadow,
+                             p_shadow_bbox );
+    *p_advance = p_entry->advance;
+
+    if( !b_cached )
+        free( p_entry );
+    else if( b_new )
+        GlyphCacheAdd( &p_sys->glyphs, p_entry );
     return VLC_SUCCESS;
 }
 
-static void FixGlyph( FT_Glyph glyph, FT_BBox *p_bbox, FT_Face face, const FT_Vector *p_pen )
+static void FixGlyph( FT_Glyph glyph, FT_BBox *p_bbox,
+                      const FT_Vector *p_advance, const FT_Vector *p_pen )
 {
     FT_BitmapGlyph glyph_bmp = (FT_BitmapGlyph)glyph;
     if( p_bbox->xMin >= p_bbox->xMax )
     {
         p_bbox->xMin = FT_CEIL(p_pen->x);
-        p_bbox->xMax = FT_CEIL(p_pen->x + face->glyph->advance.x);
+        p_bbox->xMax = FT_CEIL(p_pen->x + p_advance->x);
         glyph_bmp->left = p_bbox->xMin;
     }
     if( p_bbox->yMin >= p_bbox->yMax )
     {
         p_bbox->yMax = FT_CEIL(p_pen->y);
-        p_bbox->yMin = FT_CEIL(p_pen->y + face->glyph->advance.y);
+        p_bbox->yMin = FT_CEIL(p_pen->y + p_advance->y);
         glyph_bmp->top  = p_bbox->yMax;
     }
 }
@@ -1721,11 +2046,9 @@ static int ProcessLines( filter_t *p_filter,
             /* (Re)load/reconfigure the face if needed */
             if( !FaceStyleEquals( p_current_style, p_previous_style ) )
             {
-                if( p_face )
-                    FT_Done_Face( p_face );
                 p_previous_style = NULL;
 
-                p_face = LoadFace( p_filter, p_current_style );
+                p_face = GetFace( p_filter, p_current_style );
             }
             FT_Face p_current_face = p_face ? p_face : p_sys->p_face;
             if( !p_previous_style || p_previous_style->i_font_size != p_current_style->i_font_size )
@@ -1737,6 +2060,7 @@ static int ProcessLines( filter_t *p_filter,
                     double f_outline_thickness = var_InheritInteger( p_filter, "freetype-outline-thickness" ) / 100.0;
                     f_outline_thickness = VLC_CLIP( f_outline_thickness, 0.0, 0.5 );
                     int i_radius = (p_current_style->i_font_size << 6) * f_outline_thickness;
+                    p_sys->i_outline_radius = i_radius;
                     FT_Stroker_Set( p_sys->p_stroker,
                                     i_radius,
                                     FT_STROKER_LINECAP_ROUND,
@@ -1777,20 +2101,22 @@ static int ProcessLines( filter_t *p_filter,
                 FT_BBox  outline_bbox;
                 FT_Glyph shadow;
                 FT_BBox  shadow_bbox;
+                FT_Vector advance;
 
                 if( GetGlyph( p_filter,
                               &glyph, &glyph_bbox,
                               &outline, &outline_bbox,
                               &shadow, &shadow_bbox,
+                              &advance,
                               p_current_face, i_glyph_index, p_glyph_style->i_style_flags,
                               &pen_new, &pen_shadow_new ) )
                     goto next;
 
-                FixGlyph( glyph, &glyph_bbox, p_current_face, &pen_new );
+                FixGlyph( glyph, &glyph_bbox, &advance, &pen_new );
                 if( outline )
-                    FixGlyph( outline, &outline_bbox, p_current_face, &pen_new );
+                    FixGlyph( outline, &outline_bbox, &advance, &pen_new );
                 if( shadow )
-                    FixGlyph( shadow, &shadow_bbox, p_current_face, &pen_shadow_new );
+                    FixGlyph( shadow, &shadow_bbox, &advance, &pen_shadow_new );
 
                 /* FIXME and what about outline */
 
@@ -1889,8 +2215,8 @@ static int ProcessLines( filter_t *p_filter,
                     .i_line_thickness = i_line_thickness,
                 };
 
-                pen.x = pen_new.x + p_current_face->glyph->advance.x;
-                pen.y = pen_new.y + p_current_face->glyph->advance.y;
+                pen.x = pen_new.x + advance.x;
+                pen.y = pen_new.y + advance.y;
                 line_bbox = line_bbox_new;
             next:
                 i_glyph_last = i_glyph_index;
@@ -1955,8 +2281,6 @@ static int ProcessLines( filter_t *p_filter,
             break;
         }
     }
-    if( p_face )
-        FT_Done_Face( p_face );
 
     free( pp_fribidi_styles );
     free( p_fribidi_string );
@@ -2215,6 +2539,11 @@ static int Create( vlc_object_t *p_this )
     p_sys->p_face           = 0;
     p_sys->p_library        = 0;
     p_sys->style.i_font_size      = 0;
+    p_sys->p_faces          = NULL;
+    p_sys->i_faces          = 0;
+    p_sys->i_outline_radius = 0;
+    GlyphCacheInit( &p_sys->glyphs,
+                    var_InheritInteger( p_filter, "freetype-cache-size" ) << 10 );
 
     /*
      * The following variables should not be cached, as they might be changed on-the-fly:
@@ -2413,6 +2742,10 @@ static void Destroy( vlc_object_t *p_this )
      * even if no other library functions have been made since FcInit(),
      * so don't call it. */
 
+    msg_Dbg( p_filter, "glyph cache: %u hits, %u misses",
+             p_sys->glyphs.i_hits, p_sys->glyphs.i_misses );
+    ClearFaces( p_sys );
+
     if( p_sys->p_stroker )
         FT_Stroker_Done( p_sys->p_stroker );
     FT_Done_Face( p_sys->p_face );
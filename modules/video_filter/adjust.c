@@ -220,6 +220,58 @@ static void Destroy( vlc_object_t *p_this )
     free( p_sys );
 }
 
+/*****************************************************************************
+ * Run the luma lookup table on the [i_start, i_end[ lines of the Y plane
+ *****************************************************************************/
+typedef struct
+{
+    const picture_t *p_pic;
+    picture_t *p_outpic;
+    const int *pi_luma;
+} adjust_luma_slice_t;
+
+static void FilterPlanarLuma( filter_t *p_filter, void *opaque,
+                              int i_start, int i_end )
+{
+    const adjust_luma_slice_t *p_slice = opaque;
+    const plane_t *p_in_plane = &p_slice->p_pic->p[Y_PLANE];
+    const plane_t *p_out_plane = &p_slice->p_outpic->p[Y_PLANE];
+    const int *pi_luma = p_slice->pi_luma;
+    const uint8_t *p_in, *p_in_end, *p_line_end;
+    uint8_t *p_out;
+
+    VLC_UNUSED( p_filter );
+
+    p_in = p_in_plane->p_pixels + i_start * p_in_plane->i_pitch;
+    p_in_end = p_in_plane->p_pixels + i_end * p_in_plane->i_pitch - 8;
+
+    p_out = p_out_plane->p_pixels + i_start * p_out_plane->i_pitch;
+
+    for( ; p_in < p_in_end ; )
+    {
+        p_line_end = p_in + p_in_plane->i_visible_pitch - 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            /* Do 8 pixels at a time */
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_line_end += 8;
+
+        for( ; p_in < p_line_end ; )
+        {
+            *p_out++ = pi_luma[ *p_in++ ];
+        }
+
+        p_in += p_in_plane->i_pitch - p_in_plane->i_visible_pitch;
+        p_out += p_out_plane->i_pitch - p_out_plane->i_visible_pitch;
+    }
+}
+
 /*****************************************************************************
  * Run the filter on a Planar YUV picture
  *****************************************************************************/
@@ -229,8 +281,6 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
     int pi_gamma[256];
 
     picture_t *p_outpic;
-    uint8_t *p_in, *p_in_end, *p_line_end;
-    uint8_t *p_out;
 
     bool b_thres;
     double  f_hue;
@@ -303,37 +353,12 @@ static picture_t *FilterPlanar( filter_t *p_filter, picture_t *p_pic )
      * Do the Y plane
      */
 
-    p_in = p_pic->p[Y_PLANE].p_pixels;
-    p_in_end = p_in + p_pic->p[Y_PLANE].i_visible_lines
-                      * p_pic->p[Y_PLANE].i_pitch - 8;
-
-    p_out = p_outpic->p[Y_PLANE].p_pixels;
-
-    for( ; p_in < p_in_end ; )
-    {
-        p_line_end = p_in + p_pic->p[Y_PLANE].i_visible_pitch - 8;
-
-        for( ; p_in < p_line_end ; )
-        {
-            /* Do 8 pixels at a time */
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-            *p_out++ = pi_luma[ *p_in++ ]; *p_out++ = pi_luma[ *p_in++ ];
-        }
-
-        p_line_end += 8;
+    adjust_luma_slice_t slice = {
+        .p_pic = p_pic, .p_outpic = p_outpic, .pi_luma = pi_luma
+    };
 
-        for( ; p_in < p_line_end ; )
-        {
-            *p_out++ = pi_luma[ *p_in++ ];
-        }
-
-        p_in += p_pic->p[Y_PLANE].i_pitch
-              - p_pic->p[Y_PLANE].i_visible_pitch;
-        p_out += p_outpic->p[Y_PLANE].i_pitch
-               - p_outpic->p[Y_PLANE].i_visible_pitch;
-    }
+    filter_RunSlices( p_filter, FilterPlanarLuma, &slice,
+                      p_pic->p[Y_PLANE].i_visible_lines, 1 );
 
     /*
      * Do the U and V planes
@@ -0,0 +1,194 @@
+/*****************************************************************************
+ * blend-test.cpp: blend row kernels against the generic blending code
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#undef NDEBUG
+/* The kernel tables are private to the module */
+#include "blend.cpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RUNS 200
+
+static const vlc_fourcc_t dst_chromas[] = {
+    VLC_CODEC_I420, VLC_CODEC_J420, VLC_CODEC_YV12,
+    VLC_CODEC_NV12, VLC_CODEC_NV21, VLC_CODEC_RGB32,
+};
+static const vlc_fourcc_t src_chromas[] = {
+    VLC_CODEC_YUVA, VLC_CODEC_RGBA, VLC_CODEC_YUVP,
+};
+
+/* RV32 channel orders: the four the kernels handle, and one they do not */
+static const uint32_t rgb32_masks[][3] = {
+    { 0x00ff0000, 0x0000ff00, 0x000000ff },
+    { 0x000000ff, 0x0000ff00, 0x00ff0000 },
+    { 0xff000000, 0x00ff0000, 0x0000ff00 },
+    { 0x0000ff00, 0x00ff0000, 0xff000000 },
+    { 0x0000ff00, 0x000000ff, 0x00ff0000 },
+};
+
+static video_palette_t palette;
+
+static unsigned Random(unsigned max)
+{
+    return rand() % max;
+}
+
+static picture_t *NewPicture(video_format_t *fmt, vlc_fourcc_t chroma,
+                             unsigned width, unsigned height)
+{
+    video_format_Init(fmt, chroma);
+    fmt->i_width  = fmt->i_visible_width  = width;
+    fmt->i_height = fmt->i_visible_height = height;
+    fmt->i_sar_num = fmt->i_sar_den = 1;
+
+    if (chroma == VLC_CODEC_YUVP) {
+        palette.i_entries = 256;
+        for (int i = 0; i < 256; i++)
+            for (int j = 0; j < 4; j++)
+                palette.palette[i][j] = rand();
+        fmt->p_palette = &palette;
+    }
+    if (chroma == VLC_CODEC_RGB32) {
+        const uint32_t *masks = rgb32_masks[Random(ARRAY_SIZE(rgb32_masks))];
+
+        fmt->i_rmask = masks[0];
+        fmt->i_gmask = masks[1];
+        fmt->i_bmask = masks[2];
+    }
+    video_format_FixRgb(fmt);
+
+    picture_t *picture = picture_NewFromFormat(fmt);
+    assert(picture != NULL);
+
+    for (int i = 0; i < picture->i_planes; i++) {
+        plane_t *plane = &picture->p[i];
+
+        for (int j = 0; j < plane->i_pitch * plane->i_lines; j++)
+            plane->p_pixels[j] = rand();
+    }
+    /* Fully transparent and opaque runs, as in real subpictures */
+    if (chroma == VLC_CODEC_YUVA) {
+        plane_t *plane = &picture->p[A_PLANE];
+
+        memset(plane->p_pixels, 0x00, plane->i_pitch * plane->i_lines / 3);
+        memset(plane->p_pixels + plane->i_pitch * plane->i_lines / 3, 0xff,
+               plane->i_pitch * plane->i_lines / 3);
+    }
+    return picture;
+}
+
+static bool Compare(const picture_t *a, const picture_t *b)
+{
+    assert(a->i_planes == b->i_planes);
+    for (int i = 0; i < a->i_planes; i++) {
+        const plane_t *pa = &a->p[i], *pb = &b->p[i];
+
+        for (int y = 0; y < pa->i_visible_lines; y++)
+            if (memcmp(&pa->p_pixels[y * pa->i_pitch],
+                       &pb->p_pixels[y * pb->i_pitch],
+                       pa->i_visible_pitch))
+                return false;
+    }
+    return true;
+}
+
+static unsigned Test(const char *name, const blend_entry_t *table, size_t count)
+{
+    unsigned tested = 0;
+
+    for (size_t d = 0; d < ARRAY_SIZE(dst_chromas); d++)
+    for (size_t s = 0; s < ARRAY_SIZE(src_chromas); s++) {
+        const vlc_fourcc_t dst_chroma = dst_chromas[d];
+        const vlc_fourcc_t src_chroma = src_chromas[s];
+        blend_function_t fast = FindBlend(table, count, dst_chroma, src_chroma);
+        blend_function_t generic = FindBlend(blends, ARRAY_SIZE(blends),
+                                             dst_chroma, src_chroma);
+        if (fast == NULL)
+            continue;
+        assert(generic != NULL);
+
+        for (unsigned run = 0; run < RUNS; run++) {
+            /* Any size, at any (odd) position, with the odd alpha */
+            const unsigned dst_width  = 2 + Random(200);
+            const unsigned dst_height = 2 + Random(40);
+            const unsigned src_width  = 1 + Random(200);
+            const unsigned src_height = 1 + Random(40);
+            const unsigned dst_x = Random(dst_width);
+            const unsigned dst_y = Random(dst_height);
+            const unsigned src_x = Random(src_width);
+            const unsigned src_y = Random(src_height);
+            const int alpha = Random(4) ? 1 + Random(255) : 255;
+
+            video_format_t dst_fmt, src_fmt;
+            picture_t *dst = NewPicture(&dst_fmt, dst_chroma, dst_width, dst_height);
+            picture_t *src = NewPicture(&src_fmt, src_chroma, src_width, src_height);
+            picture_t *ref = picture_NewFromFormat(&dst_fmt);
+            assert(ref != NULL);
+            picture_Copy(ref, dst);
+
+            const unsigned width  = __MIN(dst_width - dst_x, src_width - src_x);
+            const unsigned height = __MIN(dst_height - dst_y, src_height - src_y);
+
+            fast(CPicture(dst, &dst_fmt, dst_x, dst_y),
+                 CPicture(src, &src_fmt, src_x, src_y), width, height, alpha);
+            generic(CPicture(ref, &dst_fmt, dst_x, dst_y),
+                    CPicture(src, &src_fmt, src_x, src_y), width, height, alpha);
+
+            if (!Compare(dst, ref)) {
+                fprintf(stderr, "%s: %4.4s <- %4.4s differs: %ux%u at %u,%u "
+                        "from %ux%u at %u,%u, alpha %d\n", name,
+                        (const char *)&dst_chroma, (const char *)&src_chroma,
+                        width, height, dst_x, dst_y,
+                        src_width, src_height, src_x, src_y, alpha);
+                abort();
+            }
+
+            picture_Release(ref);
+            picture_Release(src);
+            picture_Release(dst);
+        }
+        tested++;
+    }
+    printf("%s: %u combinations\n", name, tested);
+    return tested;
+}
+
+int main(void)
+{
+    unsigned tested = 0;
+
+    srand(0);
+#ifdef VLC_AVX2
+    if (vlc_CPU_AVX2())
+        tested += Test("AVX2", blends_avx2, ARRAY_SIZE(blends_avx2));
+#endif
+#ifdef BLEND_SSE2
+    if (vlc_CPU_SSE2())
+        tested += Test("SSE2", blends_sse2, ARRAY_SIZE(blends_sse2));
+#endif
+#ifdef BLEND_NEON
+    if (vlc_CPU_ARM_NEON())
+        tested += Test("NEON", blends_neon, ARRAY_SIZE(blends_neon));
+#endif
+    /* No kernel for this CPU */
+    return tested > 0 ? 0 : 77;
+}
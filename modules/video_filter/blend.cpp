@@ -32,8 +32,23 @@
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_filter.h>
+#include <vlc_cpu.h>
 #include "filter_picture.h"
 
+#if defined(__i386__) || defined(__x86_64__)
+# ifdef __SSE2__
+#  include <emmintrin.h>
+#  define BLEND_SSE2 1
+# endif
+# if VLC_GCC_VERSION(4, 9) || defined(__clang__)
+#  include <immintrin.h>
+#  define VLC_AVX2 __attribute__ ((__target__ ("avx2")))
+# endif
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+# include <arm_neon.h>
+# define BLEND_NEON 1
+#endif
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -79,6 +94,18 @@ public:
     {
         return fmt;
     }
+    unsigned getX() const
+    {
+        return x;
+    }
+    unsigned getY() const
+    {
+        return y;
+    }
+    uint8_t *getPixels(unsigned plane, unsigned px, unsigned py) const
+    {
+        return &picture->p[plane].p_pixels[py * picture->p[plane].i_pitch + px];
+    }
     bool isFull(unsigned) const
     {
         return true;
@@ -523,11 +550,807 @@ void Blend(const CPicture &dst_data, const CPicture &src_data,
 typedef void (*blend_function_t)(const CPicture &dst_data, const CPicture &src_data,
                                  unsigned width, unsigned height, int alpha);
 
-static const struct {
+/*****************************************************************************
+ * Row kernels
+ *
+ * The most used combinations are blended a row at a time, from 8 bits planar
+ * YUVA rows, with SIMD kernels. They give the same results as the generic
+ * code. The vector loops never read past the last pixel they are given, the
+ * scalar code deals with the tails.
+ *****************************************************************************/
+struct kernelC {
+    /* d[i] over s[i], with coverage a[i] */
+    static void merge(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                      unsigned alpha, unsigned n)
+    {
+        for (unsigned i = 0; i < n; i++)
+            ::merge(&d[i], s[i], div255(alpha * a[i]));
+    }
+    /* d[i] over s[2i], with coverage a[2i] */
+    static void mergeSub(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         unsigned alpha, unsigned n)
+    {
+        for (unsigned i = 0; i < n; i++) {
+            unsigned f = div255(alpha * a[2 * i]);
+            ::merge(&d[i], s[2 * i], f);
+        }
+    }
+    /* d[2i] and d[2i+1] over s0[2i] and s1[2i], with coverage a[2i] */
+    static void mergeSubInterleaved(uint8_t *d, const uint8_t *s0,
+                                    const uint8_t *s1, const uint8_t *a,
+                                    unsigned alpha, unsigned n)
+    {
+        for (unsigned i = 0; i < n; i++) {
+            unsigned f = div255(alpha * a[2 * i]);
+            ::merge(&d[2 * i + 0], s0[2 * i], f);
+            ::merge(&d[2 * i + 1], s1[2 * i], f);
+        }
+    }
+    /* RGBA over 32 bits RGB, with the given byte offsets */
+    template <unsigned r, unsigned g, unsigned b>
+    static void mergeRGBX(uint8_t *d, const uint8_t *s, unsigned alpha,
+                          unsigned n)
+    {
+        for (unsigned i = 0; i < n; i++, d += 4, s += 4) {
+            unsigned f = div255(alpha * s[3]);
+            ::merge(&d[r], s[0], f);
+            ::merge(&d[g], s[1], f);
+            ::merge(&d[b], s[2], f);
+        }
+    }
+    static void convertRGBA(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                            const uint8_t *s, unsigned n)
+    {
+        for (unsigned i = 0; i < n; i++, s += 4) {
+            rgb_to_yuv(&y[i], &u[i], &v[i], s[0], s[1], s[2]);
+            a[i] = s[3];
+        }
+    }
+};
+
+#ifdef BLEND_SSE2
+/* 16 bits lanes: div255() is exact in 16 bits for products of 8 bits values */
+static inline __m128i Div255SSE2(__m128i v)
+{
+    v = _mm_add_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)),
+                      _mm_set1_epi16(1));
+    return _mm_srli_epi16(v, 8);
+}
+
+static inline __m128i MergeSSE2(__m128i d, __m128i s, __m128i f)
+{
+    __m128i v = _mm_add_epi16(_mm_mullo_epi16(_mm_sub_epi16(_mm_set1_epi16(255), f), d),
+                              _mm_mullo_epi16(s, f));
+    return Div255SSE2(v);
+}
+
+/* 16 pixels of 8 bits */
+static inline __m128i Merge16SSE2(__m128i d, __m128i s, __m128i a, __m128i alpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = MergeSSE2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero),
+                           Div255SSE2(_mm_mullo_epi16(_mm_unpacklo_epi8(a, zero), alpha)));
+    __m128i hi = MergeSSE2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero),
+                           Div255SSE2(_mm_mullo_epi16(_mm_unpackhi_epi8(a, zero), alpha)));
+    return _mm_packus_epi16(lo, hi);
+}
+
+static inline bool IsTransparentSSE2(__m128i a)
+{
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(a, _mm_setzero_si128())) == 0xffff;
+}
+
+struct kernelSSE2 {
+    static void merge(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                      unsigned alpha, unsigned n)
+    {
+        const __m128i valpha = _mm_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; n - i >= 16; i += 16) {
+            __m128i va = _mm_loadu_si128((const __m128i *)&a[i]);
+            if (IsTransparentSSE2(va))
+                continue;
+            __m128i vd = _mm_loadu_si128((const __m128i *)&d[i]);
+            __m128i vs = _mm_loadu_si128((const __m128i *)&s[i]);
+            _mm_storeu_si128((__m128i *)&d[i], Merge16SSE2(vd, vs, va, valpha));
+        }
+        kernelC::merge(&d[i], &s[i], &a[i], alpha, n - i);
+    }
+    static void mergeSub(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         unsigned alpha, unsigned n)
+    {
+        const __m128i valpha = _mm_set1_epi16(alpha);
+        const __m128i even = _mm_set1_epi16(0xff);
+        unsigned i = 0;
+
+        for (; n - i > 16; i += 16) {
+            __m128i va = _mm_packus_epi16(
+                _mm_and_si128(_mm_loadu_si128((const __m128i *)&a[2 * i]), even),
+                _mm_and_si128(_mm_loadu_si128((const __m128i *)&a[2 * i + 16]), even));
+            if (IsTransparentSSE2(va))
+                continue;
+            __m128i vs = _mm_packus_epi16(
+                _mm_and_si128(_mm_loadu_si128((const __m128i *)&s[2 * i]), even),
+                _mm_and_si128(_mm_loadu_si128((const __m128i *)&s[2 * i + 16]), even));
+            __m128i vd = _mm_loadu_si128((const __m128i *)&d[i]);
+            _mm_storeu_si128((__m128i *)&d[i], Merge16SSE2(vd, vs, va, valpha));
+        }
+        kernelC::mergeSub(&d[i], &s[2 * i], &a[2 * i], alpha, n - i);
+    }
+    static void mergeSubInterleaved(uint8_t *d, const uint8_t *s0,
+                                    const uint8_t *s1, const uint8_t *a,
+                                    unsigned alpha, unsigned n)
+    {
+        const __m128i valpha = _mm_set1_epi16(alpha);
+        const __m128i even = _mm_set1_epi16(0xff);
+        unsigned i = 0;
+
+        for (; n - i > 8; i += 8) {
+            __m128i va = _mm_and_si128(_mm_loadu_si128((const __m128i *)&a[2 * i]), even);
+            if (IsTransparentSSE2(va))
+                continue;
+            va = _mm_or_si128(va, _mm_slli_epi16(va, 8));
+            __m128i vs = _mm_or_si128(
+                _mm_and_si128(_mm_loadu_si128((const __m128i *)&s0[2 * i]), even),
+                _mm_slli_epi16(_mm_loadu_si128((const __m128i *)&s1[2 * i]), 8));
+            __m128i vd = _mm_loadu_si128((const __m128i *)&d[2 * i]);
+            _mm_storeu_si128((__m128i *)&d[2 * i], Merge16SSE2(vd, vs, va, valpha));
+        }
+        kernelC::mergeSubInterleaved(&d[2 * i], &s0[2 * i], &s1[2 * i],
+                                     &a[2 * i], alpha, n - i);
+    }
+    template <unsigned r, unsigned g, unsigned b>
+    static void mergeRGBX(uint8_t *d, const uint8_t *s, unsigned alpha,
+                          unsigned n)
+    {
+        /* Source channel of each destination byte, the unused one gets
+         * a zero coverage */
+        enum {
+            x = 6 - r - g - b,
+            order = (0 << (2 * r)) | (1 << (2 * g)) | (2 << (2 * b)) | (3 << (2 * x)),
+        };
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i valpha = _mm_set1_epi16(alpha);
+        const __m128i mask = _mm_set_epi16(x == 3 ? 0 : -1, x == 2 ? 0 : -1,
+                                           x == 1 ? 0 : -1, x == 0 ? 0 : -1,
+                                           x == 3 ? 0 : -1, x == 2 ? 0 : -1,
+                                           x == 1 ? 0 : -1, x == 0 ? 0 : -1);
+        unsigned i = 0;
+
+        for (; n - i >= 4; i += 4) {
+            __m128i vs = _mm_loadu_si128((const __m128i *)&s[4 * i]);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_srli_epi32(vs, 24), zero)) == 0xffff)
+                continue;
+            __m128i vd = _mm_loadu_si128((const __m128i *)&d[4 * i]);
+            __m128i out[2];
+
+            for (int h = 0; h < 2; h++) {
+                __m128i s16 = h ? _mm_unpackhi_epi8(vs, zero) : _mm_unpacklo_epi8(vs, zero);
+                __m128i d16 = h ? _mm_unpackhi_epi8(vd, zero) : _mm_unpacklo_epi8(vd, zero);
+                __m128i a16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, 0xff), 0xff);
+                __m128i f = _mm_and_si128(Div255SSE2(_mm_mullo_epi16(a16, valpha)), mask);
+
+                s16 = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s16, order), order);
+                out[h] = MergeSSE2(d16, s16, f);
+            }
+            _mm_storeu_si128((__m128i *)&d[4 * i], _mm_packus_epi16(out[0], out[1]));
+        }
+        kernelC::mergeRGBX<r, g, b>(&d[4 * i], &s[4 * i], alpha, n - i);
+    }
+    static void convertRGBA(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                            const uint8_t *s, unsigned n)
+    {
+        const __m128i byte = _mm_set1_epi32(0xff);
+        unsigned i = 0;
+
+        for (; n - i >= 16; i += 16) {
+            __m128i r16[2], g16[2], b16[2], a16[2];
+
+            for (int h = 0; h < 2; h++) {
+                __m128i p0 = _mm_loadu_si128((const __m128i *)&s[4 * (i + 8 * h)]);
+                __m128i p1 = _mm_loadu_si128((const __m128i *)&s[4 * (i + 8 * h + 4)]);
+
+                r16[h] = _mm_packs_epi32(_mm_and_si128(p0, byte),
+                                         _mm_and_si128(p1, byte));
+                g16[h] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), byte),
+                                         _mm_and_si128(_mm_srli_epi32(p1, 8), byte));
+                b16[h] = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), byte),
+                                         _mm_and_si128(_mm_srli_epi32(p1, 16), byte));
+                a16[h] = _mm_packs_epi32(_mm_srli_epi32(p0, 24),
+                                         _mm_srli_epi32(p1, 24));
+            }
+
+            __m128i vy[2], vu[2], vv[2];
+            for (int h = 0; h < 2; h++) {
+                /* Same arithmetic as rgb_to_yuv(), Y in unsigned 16 bits,
+                 * U and V in signed 16 bits */
+                __m128i t;
+                t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r16[h], _mm_set1_epi16(66)),
+                                                _mm_mullo_epi16(g16[h], _mm_set1_epi16(129))),
+                                  _mm_add_epi16(_mm_mullo_epi16(b16[h], _mm_set1_epi16(25)),
+                                                _mm_set1_epi16(128)));
+                vy[h] = _mm_add_epi16(_mm_srli_epi16(t, 8), _mm_set1_epi16(16));
+                t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r16[h], _mm_set1_epi16(-38)),
+                                                _mm_mullo_epi16(g16[h], _mm_set1_epi16(-74))),
+                                  _mm_add_epi16(_mm_mullo_epi16(b16[h], _mm_set1_epi16(112)),
+                                                _mm_set1_epi16(128)));
+                vu[h] = _mm_add_epi16(_mm_srai_epi16(t, 8), _mm_set1_epi16(128));
+                t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r16[h], _mm_set1_epi16(112)),
+                                                _mm_mullo_epi16(g16[h], _mm_set1_epi16(-94))),
+                                  _mm_add_epi16(_mm_mullo_epi16(b16[h], _mm_set1_epi16(-18)),
+                                                _mm_set1_epi16(128)));
+                vv[h] = _mm_add_epi16(_mm_srai_epi16(t, 8), _mm_set1_epi16(128));
+            }
+            _mm_storeu_si128((__m128i *)&y[i], _mm_packus_epi16(vy[0], vy[1]));
+            _mm_storeu_si128((__m128i *)&u[i], _mm_packus_epi16(vu[0], vu[1]));
+            _mm_storeu_si128((__m128i *)&v[i], _mm_packus_epi16(vv[0], vv[1]));
+            _mm_storeu_si128((__m128i *)&a[i], _mm_packus_epi16(a16[0], a16[1]));
+        }
+        kernelC::convertRGBA(&y[i], &u[i], &v[i], &a[i], &s[4 * i], n - i);
+    }
+};
+#endif
+
+#ifdef VLC_AVX2
+VLC_AVX2
+static inline __m256i Div255AVX2(__m256i v)
+{
+    v = _mm256_add_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)),
+                         _mm256_set1_epi16(1));
+    return _mm256_srli_epi16(v, 8);
+}
+
+VLC_AVX2
+static inline __m256i MergeAVX2(__m256i d, __m256i s, __m256i f)
+{
+    __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(255), f), d),
+                                 _mm256_mullo_epi16(s, f));
+    return Div255AVX2(v);
+}
+
+/* 32 pixels of 8 bits, the unpacking and packing are done per 128 bits lane */
+VLC_AVX2
+static inline __m256i Merge32AVX2(__m256i d, __m256i s, __m256i a, __m256i alpha)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = MergeAVX2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero),
+                           Div255AVX2(_mm256_mullo_epi16(_mm256_unpacklo_epi8(a, zero), alpha)));
+    __m256i hi = MergeAVX2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero),
+                           Div255AVX2(_mm256_mullo_epi16(_mm256_unpackhi_epi8(a, zero), alpha)));
+    return _mm256_packus_epi16(lo, hi);
+}
+
+/* Packs 16 bits lanes in order */
+VLC_AVX2
+static inline __m256i PackAVX2(__m256i lo, __m256i hi)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+struct kernelAVX2 {
+    VLC_AVX2
+    static void merge(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                      unsigned alpha, unsigned n)
+    {
+        const __m256i valpha = _mm256_set1_epi16(alpha);
+        unsigned i = 0;
+
+        for (; n - i >= 32; i += 32) {
+            __m256i va = _mm256_loadu_si256((const __m256i *)&a[i]);
+            if (_mm256_testz_si256(va, va))
+                continue;
+            __m256i vd = _mm256_loadu_si256((const __m256i *)&d[i]);
+            __m256i vs = _mm256_loadu_si256((const __m256i *)&s[i]);
+            _mm256_storeu_si256((__m256i *)&d[i], Merge32AVX2(vd, vs, va, valpha));
+        }
+        kernelC::merge(&d[i], &s[i], &a[i], alpha, n - i);
+    }
+    VLC_AVX2
+    static void mergeSub(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         unsigned alpha, unsigned n)
+    {
+        const __m256i valpha = _mm256_set1_epi16(alpha);
+        const __m256i even = _mm256_set1_epi16(0xff);
+        unsigned i = 0;
+
+        for (; n - i > 32; i += 32) {
+            __m256i va = PackAVX2(
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&a[2 * i]), even),
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&a[2 * i + 32]), even));
+            if (_mm256_testz_si256(va, va))
+                continue;
+            __m256i vs = PackAVX2(
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&s[2 * i]), even),
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&s[2 * i + 32]), even));
+            __m256i vd = _mm256_loadu_si256((const __m256i *)&d[i]);
+            _mm256_storeu_si256((__m256i *)&d[i], Merge32AVX2(vd, vs, va, valpha));
+        }
+        kernelC::mergeSub(&d[i], &s[2 * i], &a[2 * i], alpha, n - i);
+    }
+    VLC_AVX2
+    static void mergeSubInterleaved(uint8_t *d, const uint8_t *s0,
+                                    const uint8_t *s1, const uint8_t *a,
+                                    unsigned alpha, unsigned n)
+    {
+        const __m256i valpha = _mm256_set1_epi16(alpha);
+        const __m256i even = _mm256_set1_epi16(0xff);
+        unsigned i = 0;
+
+        for (; n - i > 16; i += 16) {
+            __m256i va = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&a[2 * i]), even);
+            if (_mm256_testz_si256(va, va))
+                continue;
+            va = _mm256_or_si256(va, _mm256_slli_epi16(va, 8));
+            __m256i vs = _mm256_or_si256(
+                _mm256_and_si256(_mm256_loadu_si256((const __m256i *)&s0[2 * i]), even),
+                _mm256_slli_epi16(_mm256_loadu_si256((const __m256i *)&s1[2 * i]), 8));
+            __m256i vd = _mm256_loadu_si256((const __m256i *)&d[2 * i]);
+            _mm256_storeu_si256((__m256i *)&d[2 * i], Merge32AVX2(vd, vs, va, valpha));
+        }
+        kernelC::mergeSubInterleaved(&d[2 * i], &s0[2 * i], &s1[2 * i],
+                                     &a[2 * i], alpha, n - i);
+    }
+    template <unsigned r, unsigned g, unsigned b>
+    VLC_AVX2
+    static void mergeRGBX(uint8_t *d, const uint8_t *s, unsigned alpha,
+                          unsigned n)
+    {
+        enum {
+            x = 6 - r - g - b,
+            order = (0 << (2 * r)) | (1 << (2 * g)) | (2 << (2 * b)) | (3 << (2 * x)),
+        };
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i valpha = _mm256_set1_epi16(alpha);
+        const __m256i mask = _mm256_set1_epi64x(~(INT64_C(0xffff) << (16 * x)));
+        const __m256i alphas = _mm256_set1_epi32(0xff000000);
+        unsigned i = 0;
+
+        for (; n - i >= 8; i += 8) {
+            __m256i vs = _mm256_loadu_si256((const __m256i *)&s[4 * i]);
+            if (_mm256_testz_si256(vs, alphas))
+                continue;
+            __m256i vd = _mm256_loadu_si256((const __m256i *)&d[4 * i]);
+            __m256i out[2];
+
+            for (int h = 0; h < 2; h++) {
+                __m256i s16 = h ? _mm256_unpackhi_epi8(vs, zero) : _mm256_unpacklo_epi8(vs, zero);
+                __m256i d16 = h ? _mm256_unpackhi_epi8(vd, zero) : _mm256_unpacklo_epi8(vd, zero);
+                __m256i a16 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, 0xff), 0xff);
+                __m256i f = _mm256_and_si256(Div255AVX2(_mm256_mullo_epi16(a16, valpha)), mask);
+
+                s16 = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s16, order), order);
+                out[h] = MergeAVX2(d16, s16, f);
+            }
+            _mm256_storeu_si256((__m256i *)&d[4 * i], _mm256_packus_epi16(out[0], out[1]));
+        }
+        kernelC::mergeRGBX<r, g, b>(&d[4 * i], &s[4 * i], alpha, n - i);
+    }
+    VLC_AVX2
+    static void convertRGBA(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                            const uint8_t *s, unsigned n)
+    {
+        const __m256i byte = _mm256_set1_epi32(0xff);
+        unsigned i = 0;
+
+        for (; n - i >= 32; i += 32) {
+            __m256i r16[2], g16[2], b16[2], a16[2];
+
+            /* The 32 to 16 bits packing is done per lane, the pixels end
+             * up in the same order in all channels */
+            for (int h = 0; h < 2; h++) {
+                __m256i p0 = _mm256_loadu_si256((const __m256i *)&s[4 * (i + 16 * h)]);
+                __m256i p1 = _mm256_loadu_si256((const __m256i *)&s[4 * (i + 16 * h + 8)]);
+
+                r16[h] = _mm256_packs_epi32(_mm256_and_si256(p0, byte),
+                                            _mm256_and_si256(p1, byte));
+                g16[h] = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), byte),
+                                            _mm256_and_si256(_mm256_srli_epi32(p1, 8), byte));
+                b16[h] = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), byte),
+                                            _mm256_and_si256(_mm256_srli_epi32(p1, 16), byte));
+                a16[h] = _mm256_packs_epi32(_mm256_srli_epi32(p0, 24),
+                                            _mm256_srli_epi32(p1, 24));
+            }
+
+            __m256i vy[2], vu[2], vv[2];
+            for (int h = 0; h < 2; h++) {
+                __m256i t;
+                t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r16[h], _mm256_set1_epi16(66)),
+                                                      _mm256_mullo_epi16(g16[h], _mm256_set1_epi16(129))),
+                                     _mm256_add_epi16(_mm256_mullo_epi16(b16[h], _mm256_set1_epi16(25)),
+                                                      _mm256_set1_epi16(128)));
+                vy[h] = _mm256_add_epi16(_mm256_srli_epi16(t, 8), _mm256_set1_epi16(16));
+                t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r16[h], _mm256_set1_epi16(-38)),
+                                                      _mm256_mullo_epi16(g16[h], _mm256_set1_epi16(-74))),
+                                     _mm256_add_epi16(_mm256_mullo_epi16(b16[h], _mm256_set1_epi16(112)),
+                                                      _mm256_set1_epi16(128)));
+                vu[h] = _mm256_add_epi16(_mm256_srai_epi16(t, 8), _mm256_set1_epi16(128));
+                t = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(r16[h], _mm256_set1_epi16(112)),
+                                                      _mm256_mullo_epi16(g16[h], _mm256_set1_epi16(-94))),
+                                     _mm256_add_epi16(_mm256_mullo_epi16(b16[h], _mm256_set1_epi16(-18)),
+                                                      _mm256_set1_epi16(128)));
+                vv[h] = _mm256_add_epi16(_mm256_srai_epi16(t, 8), _mm256_set1_epi16(128));
+            }
+
+            /* Both packings are undone by the same 64 bits permutation */
+            const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            _mm256_storeu_si256((__m256i *)&y[i],
+                _mm256_permutevar8x32_epi32(_mm256_packus_epi16(vy[0], vy[1]), order));
+            _mm256_storeu_si256((__m256i *)&u[i],
+                _mm256_permutevar8x32_epi32(_mm256_packus_epi16(vu[0], vu[1]), order));
+            _mm256_storeu_si256((__m256i *)&v[i],
+                _mm256_permutevar8x32_epi32(_mm256_packus_epi16(vv[0], vv[1]), order));
+            _mm256_storeu_si256((__m256i *)&a[i],
+                _mm256_permutevar8x32_epi32(_mm256_packus_epi16(a16[0], a16[1]), order));
+        }
+        kernelC::convertRGBA(&y[i], &u[i], &v[i], &a[i], &s[4 * i], n - i);
+    }
+};
+#endif
+
+#ifdef BLEND_NEON
+static inline uint16x8_t Div255NEON(uint16x8_t v)
+{
+    return vshrq_n_u16(vaddq_u16(vaddq_u16(v, vshrq_n_u16(v, 8)), vdupq_n_u16(1)), 8);
+}
+
+static inline uint8x8_t MergeNEON(uint8x8_t d, uint8x8_t s, uint8x8_t f)
+{
+    uint16x8_t v = vmlal_u8(vmull_u8(vsub_u8(vdup_n_u8(255), f), d), s, f);
+    return vmovn_u16(Div255NEON(v));
+}
+
+static inline uint8x8_t CoverageNEON(uint8x8_t a, uint8x8_t alpha)
+{
+    return vmovn_u16(Div255NEON(vmull_u8(a, alpha)));
+}
+
+/* 16 pixels of 8 bits */
+static inline uint8x16_t Merge16NEON(uint8x16_t d, uint8x16_t s, uint8x16_t a, uint8x8_t alpha)
+{
+    uint8x8_t lo = MergeNEON(vget_low_u8(d), vget_low_u8(s),
+                             CoverageNEON(vget_low_u8(a), alpha));
+    uint8x8_t hi = MergeNEON(vget_high_u8(d), vget_high_u8(s),
+                             CoverageNEON(vget_high_u8(a), alpha));
+    return vcombine_u8(lo, hi);
+}
+
+static inline bool IsTransparentNEON(uint8x16_t a)
+{
+    uint64x2_t a64 = vreinterpretq_u64_u8(a);
+    return (vgetq_lane_u64(a64, 0) | vgetq_lane_u64(a64, 1)) == 0;
+}
+
+struct kernelNEON {
+    static void merge(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                      unsigned alpha, unsigned n)
+    {
+        const uint8x8_t valpha = vdup_n_u8(alpha);
+        unsigned i = 0;
+
+        for (; n - i >= 16; i += 16) {
+            uint8x16_t va = vld1q_u8(&a[i]);
+            if (IsTransparentNEON(va))
+                continue;
+            vst1q_u8(&d[i], Merge16NEON(vld1q_u8(&d[i]), vld1q_u8(&s[i]), va, valpha));
+        }
+        kernelC::merge(&d[i], &s[i], &a[i], alpha, n - i);
+    }
+    static void mergeSub(uint8_t *d, const uint8_t *s, const uint8_t *a,
+                         unsigned alpha, unsigned n)
+    {
+        const uint8x8_t valpha = vdup_n_u8(alpha);
+        unsigned i = 0;
+
+        for (; n - i > 16; i += 16) {
+            uint8x16_t va = vld2q_u8(&a[2 * i]).val[0];
+            if (IsTransparentNEON(va))
+                continue;
+            uint8x16_t vs = vld2q_u8(&s[2 * i]).val[0];
+            vst1q_u8(&d[i], Merge16NEON(vld1q_u8(&d[i]), vs, va, valpha));
+        }
+        kernelC::mergeSub(&d[i], &s[2 * i], &a[2 * i], alpha, n - i);
+    }
+    static void mergeSubInterleaved(uint8_t *d, const uint8_t *s0,
+                                    const uint8_t *s1, const uint8_t *a,
+                                    unsigned alpha, unsigned n)
+    {
+        const uint8x8_t valpha = vdup_n_u8(alpha);
+        unsigned i = 0;
+
+        for (; n - i > 16; i += 16) {
+            uint8x16_t va = vld2q_u8(&a[2 * i]).val[0];
+            if (IsTransparentNEON(va))
+                continue;
+            uint8x16x2_t vd = vld2q_u8(&d[2 * i]);
+            vd.val[0] = Merge16NEON(vd.val[0], vld2q_u8(&s0[2 * i]).val[0], va, valpha);
+            vd.val[1] = Merge16NEON(vd.val[1], vld2q_u8(&s1[2 * i]).val[0], va, valpha);
+            vst2q_u8(&d[2 * i], vd);
+        }
+        kernelC::mergeSubInterleaved(&d[2 * i], &s0[2 * i], &s1[2 * i],
+                                     &a[2 * i], alpha, n - i);
+    }
+    template <unsigned r, unsigned g, unsigned b>
+    static void mergeRGBX(uint8_t *d, const uint8_t *s, unsigned alpha,
+                          unsigned n)
+    {
+        const uint8x8_t valpha = vdup_n_u8(alpha);
+        unsigned i = 0;
+
+        for (; n - i >= 8; i += 8) {
+            uint8x8x4_t vs = vld4_u8(&s[4 * i]);
+            if (vget_lane_u64(vreinterpret_u64_u8(vs.val[3]), 0) == 0)
+                continue;
+            uint8x8x4_t vd = vld4_u8(&d[4 * i]);
+            uint8x8_t f = CoverageNEON(vs.val[3], valpha);
+
+            vd.val[r] = MergeNEON(vd.val[r], vs.val[0], f);
+            vd.val[g] = MergeNEON(vd.val[g], vs.val[1], f);
+            vd.val[b] = MergeNEON(vd.val[b], vs.val[2], f);
+            vst4_u8(&d[4 * i], vd);
+        }
+        kernelC::mergeRGBX<r, g, b>(&d[4 * i], &s[4 * i], alpha, n - i);
+    }
+    static void convertRGBA(uint8_t *y, uint8_t *u, uint8_t *v, uint8_t *a,
+                            const uint8_t *s, unsigned n)
+    {
+        unsigned i = 0;
+
+        for (; n - i >= 8; i += 8) {
+            uint8x8x4_t p = vld4_u8(&s[4 * i]);
+            uint16x8_t t;
+
+            t = vmlal_u8(vmlal_u8(vmull_u8(p.val[0], vdup_n_u8(66)),
+                                  p.val[1], vdup_n_u8(129)),
+                         p.val[2], vdup_n_u8(25));
+            vst1_u8(&y[i], vadd_u8(vshrn_n_u16(vaddq_u16(t, vdupq_n_u16(128)), 8),
+                                   vdup_n_u8(16)));
+
+            int16x8_t r16 = vreinterpretq_s16_u16(vmovl_u8(p.val[0]));
+            int16x8_t g16 = vreinterpretq_s16_u16(vmovl_u8(p.val[1]));
+            int16x8_t b16 = vreinterpretq_s16_u16(vmovl_u8(p.val[2]));
+            int16x8_t c;
+
+            c = vmlaq_n_s16(vmlaq_n_s16(vmlaq_n_s16(vdupq_n_s16(128), r16, -38),
+                                        g16, -74), b16, 112);
+            vst1_u8(&u[i], vmovn_u16(vreinterpretq_u16_s16(
+                vaddq_s16(vshrq_n_s16(c, 8), vdupq_n_s16(128)))));
+            c = vmlaq_n_s16(vmlaq_n_s16(vmlaq_n_s16(vdupq_n_s16(128), r16, 112),
+                                        g16, -94), b16, -18);
+            vst1_u8(&v[i], vmovn_u16(vreinterpretq_u16_s16(
+                vaddq_s16(vshrq_n_s16(c, 8), vdupq_n_s16(128)))));
+            vst1_u8(&a[i], p.val[3]);
+        }
+        kernelC::convertRGBA(&y[i], &u[i], &v[i], &a[i], &s[4 * i], n - i);
+    }
+};
+#endif
+
+/* Sources, read as 8 bits planar YUVA rows of at most BLEND_CHUNK pixels */
+#define BLEND_CHUNK 1024
+
+class CRowYUVA {
+public:
+    CRowYUVA(const CPicture &src, int alpha) : src(src), y(src.getY()), alpha(alpha)
+    {
+    }
+    void get(const uint8_t *row[4], unsigned dx, unsigned)
+    {
+        for (unsigned plane = 0; plane < 4; plane++)
+            row[plane] = src.getPixels(plane, src.getX() + dx, y);
+    }
+    void nextLine()
+    {
+        y++;
+    }
+    unsigned getAlpha() const
+    {
+        return alpha;
+    }
+private:
+    const CPicture &src;
+    unsigned y;
+    unsigned alpha;
+};
+
+template <class K>
+class CRowRGBA {
+public:
+    CRowRGBA(const CPicture &src, int alpha) : src(src), y(src.getY()), alpha(alpha)
+    {
+    }
+    void get(const uint8_t *row[4], unsigned dx, unsigned count)
+    {
+        K::convertRGBA(buffer[0], buffer[1], buffer[2], buffer[3],
+                       src.getPixels(0, (src.getX() + dx) * 4, y), count);
+        for (unsigned plane = 0; plane < 4; plane++)
+            row[plane] = buffer[plane];
+    }
+    void nextLine()
+    {
+        y++;
+    }
+    unsigned getAlpha() const
+    {
+        return alpha;
+    }
+private:
+    const CPicture &src;
+    unsigned y;
+    unsigned alpha;
+    uint8_t buffer[4][BLEND_CHUNK];
+};
+
+/* The global alpha is applied to the palette once */
+class CRowYUVP {
+public:
+    CRowYUVP(const CPicture &src, int alpha) : src(src), y(src.getY())
+    {
+        const video_palette_t *p = src.getFormat()->p_palette;
+
+        memset(palette, 0, sizeof(palette));
+        for (int i = 0; i < p->i_entries; i++) {
+            for (unsigned c = 0; c < 3; c++)
+                palette[c][i] = p->palette[i][c];
+            palette[3][i] = div255(alpha * p->palette[i][3]);
+        }
+    }
+    void get(const uint8_t *row[4], unsigned dx, unsigned count)
+    {
+        const uint8_t *index = src.getPixels(0, src.getX() + dx, y);
+
+        for (unsigned i = 0; i < count; i++)
+            for (unsigned plane = 0; plane < 4; plane++)
+                buffer[plane][i] = palette[plane][index[i]];
+        for (unsigned plane = 0; plane < 4; plane++)
+            row[plane] = buffer[plane];
+    }
+    void nextLine()
+    {
+        y++;
+    }
+    unsigned getAlpha() const
+    {
+        return 255;
+    }
+private:
+    const CPicture &src;
+    unsigned y;
+    uint8_t palette[4][256];
+    uint8_t buffer[4][BLEND_CHUNK];
+};
+
+template <class K, class TSrc, bool swap_uv>
+void BlendI420(const CPicture &dst, const CPicture &src_data,
+               unsigned width, unsigned height, int alpha)
+{
+    TSrc src(src_data, alpha);
+    const unsigned x0 = dst.getX();
+
+    for (unsigned y = dst.getY(); y < dst.getY() + height; y++) {
+        uint8_t *luma = dst.getPixels(0, x0, y);
+
+        for (unsigned x = 0; x < width; x += BLEND_CHUNK) {
+            const unsigned count = __MIN(BLEND_CHUNK, width - x);
+            const uint8_t *row[4];
+
+            src.get(row, x, count);
+            K::merge(&luma[x], row[0], row[3], src.getAlpha(), count);
+
+            /* Only the pixels on a chroma sample contribute to it */
+            const unsigned first = (x0 + x) % 2;
+            if ((y % 2) != 0 || count <= first)
+                continue;
+            const unsigned n = (count - first + 1) / 2;
+            const unsigned cx = (x0 + x + first) / 2;
+
+            K::mergeSub(dst.getPixels(swap_uv ? 2 : 1, cx, y / 2),
+                        row[1] + first, row[3] + first, src.getAlpha(), n);
+            K::mergeSub(dst.getPixels(swap_uv ? 1 : 2, cx, y / 2),
+                        row[2] + first, row[3] + first, src.getAlpha(), n);
+        }
+        src.nextLine();
+    }
+}
+
+template <class K, class TSrc, bool swap_uv>
+void BlendNV12(const CPicture &dst, const CPicture &src_data,
+               unsigned width, unsigned height, int alpha)
+{
+    TSrc src(src_data, alpha);
+    const unsigned x0 = dst.getX();
+
+    for (unsigned y = dst.getY(); y < dst.getY() + height; y++) {
+        uint8_t *luma = dst.getPixels(0, x0, y);
+
+        for (unsigned x = 0; x < width; x += BLEND_CHUNK) {
+            const unsigned count = __MIN(BLEND_CHUNK, width - x);
+            const uint8_t *row[4];
+
+            src.get(row, x, count);
+            K::merge(&luma[x], row[0], row[3], src.getAlpha(), count);
+
+            const unsigned first = (x0 + x) % 2;
+            if ((y % 2) != 0 || count <= first)
+                continue;
+            const unsigned n = (count - first + 1) / 2;
+
+            K::mergeSubInterleaved(dst.getPixels(1, x0 + x + first, y / 2),
+                                   row[swap_uv ? 2 : 1] + first,
+                                   row[swap_uv ? 1 : 2] + first,
+                                   row[3] + first, src.getAlpha(), n);
+        }
+        src.nextLine();
+    }
+}
+
+template <class K>
+void BlendRGB32(const CPicture &dst, const CPicture &src,
+                unsigned width, unsigned height, int alpha)
+{
+    const video_format_t *fmt = dst.getFormat();
+    void (*merge)(uint8_t *, const uint8_t *, unsigned, unsigned);
+
+    /* Same byte offsets as CPictureRGBX */
+#ifdef WORDS_BIGENDIAN
+    const unsigned r = (32 - fmt->i_lrshift) / 8;
+    const unsigned g = (32 - fmt->i_lgshift) / 8;
+    const unsigned b = (32 - fmt->i_lbshift) / 8;
+#else
+    const unsigned r = fmt->i_lrshift / 8;
+    const unsigned g = fmt->i_lgshift / 8;
+    const unsigned b = fmt->i_lbshift / 8;
+#endif
+    if (r == 0 && g == 1 && b == 2)
+        merge = K::template mergeRGBX<0, 1, 2>;
+    else if (r == 2 && g == 1 && b == 0)
+        merge = K::template mergeRGBX<2, 1, 0>;
+    else if (r == 1 && g == 2 && b == 3)
+        merge = K::template mergeRGBX<1, 2, 3>;
+    else if (r == 3 && g == 2 && b == 1)
+        merge = K::template mergeRGBX<3, 2, 1>;
+    else {
+        Blend<CPictureRGB32, CPictureRGBA, compose<convertNone, convertNone> >(dst, src, width, height, alpha);
+        return;
+    }
+
+    for (unsigned y = 0; y < height; y++)
+        merge(dst.getPixels(0, dst.getX() * 4, dst.getY() + y),
+              src.getPixels(0, src.getX() * 4, src.getY() + y),
+              alpha, width);
+}
+
+struct blend_entry_t {
     vlc_fourcc_t     dst;
     vlc_fourcc_t     src;
     blend_function_t blend;
-} blends[] = {
+};
+
+#define FAST(K) \
+    FAST_YUV(K, VLC_CODEC_I420, BlendI420, false), \
+    FAST_YUV(K, VLC_CODEC_J420, BlendI420, false), \
+    FAST_YUV(K, VLC_CODEC_YV12, BlendI420, true), \
+    FAST_YUV(K, VLC_CODEC_NV12, BlendNV12, false), \
+    FAST_YUV(K, VLC_CODEC_NV21, BlendNV12, true), \
+    { VLC_CODEC_RGB32, VLC_CODEC_RGBA, BlendRGB32<K> }
+#define FAST_YUV(K, csp, blend, swap_uv) \
+    { csp, VLC_CODEC_YUVA, blend<K, CRowYUVA, swap_uv> }, \
+    { csp, VLC_CODEC_RGBA, blend<K, CRowRGBA<K>, swap_uv> }, \
+    { csp, VLC_CODEC_YUVP, blend<K, CRowYUVP, swap_uv> }
+
+#ifdef VLC_AVX2
+static const blend_entry_t blends_avx2[] = { FAST(kernelAVX2) };
+#endif
+#ifdef BLEND_SSE2
+static const blend_entry_t blends_sse2[] = { FAST(kernelSSE2) };
+#endif
+#ifdef BLEND_NEON
+static const blend_entry_t blends_neon[] = { FAST(kernelNEON) };
+#endif
+#undef FAST_YUV
+#undef FAST
+
+static const blend_entry_t blends[] = {
 #undef RGB
 #undef YUV
 #define RGB(csp, picture, cvt) \
@@ -591,6 +1414,16 @@ static const struct {
 #undef YUV
 };
 
+static blend_function_t FindBlend(const blend_entry_t *table, size_t count,
+                                  vlc_fourcc_t dst, vlc_fourcc_t src)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (table[i].src == src && table[i].dst == dst)
+            return table[i].blend;
+    }
+    return NULL;
+}
+
 struct filter_sys_t {
     filter_sys_t() : blend(NULL)
     {
@@ -639,10 +1472,20 @@ static int Open(vlc_object_t *object)
     const vlc_fourcc_t dst = filter->fmt_out.video.i_chroma;
 
     filter_sys_t *sys = new filter_sys_t();
-    for (size_t i = 0; i < sizeof(blends) / sizeof(*blends); i++) {
-        if (blends[i].src == src && blends[i].dst == dst)
-            sys->blend = blends[i].blend;
-    }
+#ifdef VLC_AVX2
+    if (vlc_CPU_AVX2())
+        sys->blend = FindBlend(blends_avx2, sizeof(blends_avx2) / sizeof(*blends_avx2), dst, src);
+#endif
+#ifdef BLEND_SSE2
+    if (!sys->blend && vlc_CPU_SSE2())
+        sys->blend = FindBlend(blends_sse2, sizeof(blends_sse2) / sizeof(*blends_sse2), dst, src);
+#endif
+#ifdef BLEND_NEON
+    if (!sys->blend && vlc_CPU_ARM_NEON())
+        sys->blend = FindBlend(blends_neon, sizeof(blends_neon) / sizeof(*blends_neon), dst, src);
+#endif
+    if (!sys->blend)
+        sys->blend = FindBlend(blends, sizeof(blends) / sizeof(*blends), dst, src);
 
     if (!sys->blend) {
        msg_Err(filter, "no matching alpha blending routine (chroma: %4.4s -> %4.4s)",
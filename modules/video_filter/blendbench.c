@@ -23,6 +23,14 @@
 
 /*****************************************************************************
  * Preamble
+ *
+ * As a video filter, blends the blend image onto the base image once, when
+ * the first picture goes through.
+ *
+ * As an interface (vlc -I blendbench), blends every combination of the base
+ * and blend chromas, prints the speeds on the standard output and quits.
+ * Without images, synthetic pictures fully covered with random pixels are
+ * used.
  *****************************************************************************/
 
 #ifdef HAVE_CONFIG_H
@@ -36,12 +44,15 @@
 
 #include <vlc_filter.h>
 #include <vlc_image.h>
+#include <vlc_interface.h>
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
 static int Create( vlc_object_t * );
 static void Destroy( vlc_object_t * );
+static int OpenInterface( vlc_object_t * );
+static void CloseInterface( vlc_object_t * );
 
 static picture_t *Filter( filter_t *, picture_t * );
 
@@ -59,14 +70,25 @@ static picture_t *Filter( filter_t *, picture_t * );
 #define BASE_IMAGE_LONGTEXT N_("The image which will be used to blend onto")
 
 #define BASE_CHROMA_TEXT N_("Chroma for the base image")
-#define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded in")
+#define BASE_CHROMA_LONGTEXT N_("Chroma which the base image will be loaded " \
+                                "in. The interface accepts a comma " \
+                                "separated list.")
 
 #define BLEND_IMAGE_TEXT N_("Image which will be blended")
 #define BLEND_IMAGE_LONGTEXT N_("The image blended onto the base image")
 
 #define BLEND_CHROMA_TEXT N_("Chroma for the blend image")
 #define BLEND_CHROMA_LONGTEXT N_("Chroma which the blend image will be loaded" \
-                                 " in")
+                                 " in. The interface accepts a comma " \
+                                 "separated list.")
+
+#define WIDTH_TEXT N_("Width of the synthetic images")
+#define WIDTH_LONGTEXT N_("Width of the images used by the interface when " \
+                          "no image file is given")
+
+#define HEIGHT_TEXT N_("Height of the synthetic images")
+#define HEIGHT_LONGTEXT N_("Height of the images used by the interface when " \
+                           "no image file is given")
 
 #define CFG_PREFIX "blendbench-"
 
@@ -95,7 +117,18 @@ vlc_module_begin ()
     add_string( CFG_PREFIX "blend-chroma", "YUVA", BLEND_CHROMA_TEXT,
               BLEND_CHROMA_LONGTEXT, false )
 
+    set_section( N_("Synthetic images"), NULL )
+    add_integer_with_range( CFG_PREFIX "width", 1920, 2, 8192, WIDTH_TEXT,
+              WIDTH_LONGTEXT, false )
+    add_integer_with_range( CFG_PREFIX "height", 1080, 2, 8192, HEIGHT_TEXT,
+              HEIGHT_LONGTEXT, false )
+
     set_callbacks( Create, Destroy )
+
+    add_submodule ()
+    set_description( N_("Blending benchmark") )
+    set_capability( "interface", 0 )
+    set_callbacks( OpenInterface, CloseInterface )
 vlc_module_end ()
 
 static const char *const ppsz_filter_options[] = {
@@ -215,41 +248,60 @@ static void Destroy( vlc_object_t *p_this )
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
+ * blendbench_Run: blends i_loops times, returns the duration or -1
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+static mtime_t blendbench_Run( vlc_object_t *p_this, picture_t *p_base,
+                               picture_t *p_blend_image, int i_loops,
+                               int i_alpha )
 {
-    filter_sys_t *p_sys = p_filter->p_sys;
     filter_t *p_blend;
 
-    if( p_sys->b_done )
-        return p_pic;
-
-    p_blend = vlc_object_create( p_filter, sizeof(filter_t) );
+    p_blend = vlc_object_create( p_this, sizeof(filter_t) );
     if( !p_blend )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-    p_blend->fmt_out.video = p_sys->p_base_image->format;
-    p_blend->fmt_in.video = p_sys->p_blend_image->format;
+        return -1;
+    p_blend->fmt_out.video = p_base->format;
+    p_blend->fmt_in.video = p_blend_image->format;
     p_blend->p_module = module_need( p_blend, "video blending", NULL, false );
     if( !p_blend->p_module )
     {
-        picture_Release( p_pic );
         vlc_object_release( p_blend );
-        return NULL;
+        return -1;
     }
 
     mtime_t time = mdate();
-    for( int i_iter = 0; i_iter < p_sys->i_loops; ++i_iter )
+    for( int i_iter = 0; i_iter < i_loops; ++i_iter )
     {
-        p_blend->pf_video_blend( p_blend,
-                                 p_sys->p_base_image, p_sys->p_blend_image,
-                                 0, 0, p_sys->i_alpha );
+        p_blend->pf_video_blend( p_blend, p_base, p_blend_image,
+                                 0, 0, i_alpha );
     }
     time = mdate() - time;
 
+    module_unneed( p_blend, p_blend->p_module );
+
+    vlc_object_release( p_blend );
+
+    return time > 0 ? time : 1;
+}
+
+/*****************************************************************************
+ * Render: displays previously rendered output
+ *****************************************************************************/
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    filter_sys_t *p_sys = p_filter->p_sys;
+
+    if( p_sys->b_done )
+        return p_pic;
+
+    mtime_t time = blendbench_Run( VLC_OBJECT(p_filter), p_sys->p_base_image,
+                                   p_sys->p_blend_image, p_sys->i_loops,
+                                   p_sys->i_alpha );
+    if( time < 0 )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
     msg_Info( p_filter, "Blended %d images in %f sec", p_sys->i_loops,
               time / 1000000.0f );
     msg_Info( p_filter, "Speed is: %f images/second, %f pixels/second",
@@ -258,10 +310,172 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
                   p_sys->p_blend_image->p[Y_PLANE].i_visible_pitch *
                   p_sys->p_blend_image->p[Y_PLANE].i_visible_lines );
 
-    module_unneed( p_blend, p_blend->p_module );
+    p_sys->b_done = true;
+    return p_pic;
+}
 
-    vlc_object_release( p_blend );
+/*****************************************************************************
+ * Interface
+ *****************************************************************************/
+struct intf_sys_t
+{
+    vlc_thread_t thread;
+};
 
-    p_sys->b_done = true;
+/* Random pixels, with a random palette for YUVP */
+static picture_t *blendbench_NewImage( vlc_fourcc_t i_chroma,
+                                       unsigned i_width, unsigned i_height,
+                                       video_palette_t *p_palette )
+{
+    video_format_t fmt;
+
+    video_format_Init( &fmt, i_chroma );
+    fmt.i_width = fmt.i_visible_width = i_width;
+    fmt.i_height = fmt.i_visible_height = i_height;
+    fmt.i_sar_num = fmt.i_sar_den = 1;
+    if( i_chroma == VLC_CODEC_YUVP )
+    {
+        p_palette->i_entries = 256;
+        for( int i = 0; i < 256; i++ )
+            for( int j = 0; j < 4; j++ )
+                p_palette->palette[i][j] = rand();
+        fmt.p_palette = p_palette;
+    }
+    video_format_FixRgb( &fmt );
+
+    picture_t *p_pic = picture_NewFromFormat( &fmt );
+    if( !p_pic )
+        return NULL;
+
+    for( int i = 0; i < p_pic->i_planes; i++ )
+        for( int j = 0; j < p_pic->p[i].i_pitch * p_pic->p[i].i_lines; j++ )
+            p_pic->p[i].p_pixels[j] = rand();
+    return p_pic;
+}
+
+static picture_t *blendbench_GetImage( intf_thread_t *p_intf,
+                                       const char *psz_prefix,
+                                       vlc_fourcc_t i_chroma,
+                                       video_palette_t *p_palette )
+{
+    char psz_name[32];
+    picture_t *p_pic = NULL;
+
+    snprintf( psz_name, sizeof(psz_name), CFG_PREFIX "%s-image", psz_prefix );
+    char *psz_file = var_InheritString( p_intf, psz_name );
+    if( psz_file )
+        blendbench_LoadImage( VLC_OBJECT(p_intf), &p_pic, i_chroma, psz_file,
+                              psz_prefix );
+    else
+        p_pic = blendbench_NewImage( i_chroma,
+                          var_InheritInteger( p_intf, CFG_PREFIX "width" ),
+                          var_InheritInteger( p_intf, CFG_PREFIX "height" ),
+                          p_palette );
+    free( psz_file );
     return p_pic;
 }
+
+static void blendbench_Combination( intf_thread_t *p_intf,
+                                    vlc_fourcc_t i_base_chroma,
+                                    vlc_fourcc_t i_blend_chroma,
+                                    int i_loops, int i_alpha )
+{
+    video_palette_t palette;
+    picture_t *p_base, *p_blend;
+    mtime_t time = -1;
+
+    p_base = blendbench_GetImage( p_intf, "base", i_base_chroma, NULL );
+    p_blend = blendbench_GetImage( p_intf, "blend", i_blend_chroma, &palette );
+    if( p_base && p_blend )
+        time = blendbench_Run( VLC_OBJECT(p_intf), p_base, p_blend, i_loops,
+                               i_alpha );
+
+    if( time < 0 )
+        printf( "%4.4s <- %4.4s: unsupported\n",
+                (const char *)&i_base_chroma, (const char *)&i_blend_chroma );
+    else
+    {
+        unsigned i_width = __MIN( p_base->format.i_visible_width,
+                                  p_blend->format.i_visible_width );
+        unsigned i_height = __MIN( p_base->format.i_visible_height,
+                                   p_blend->format.i_visible_height );
+
+        printf( "%4.4s <- %4.4s: %ux%u, %8.1f Mpixel/s\n",
+                (const char *)&i_base_chroma, (const char *)&i_blend_chroma,
+                i_width, i_height,
+                (double)i_width * i_height * i_loops / time );
+    }
+    fflush( stdout );
+
+    if( p_base )
+        picture_Release( p_base );
+    if( p_blend )
+        picture_Release( p_blend );
+}
+
+static void *Run( void *data )
+{
+    intf_thread_t *p_intf = data;
+    int canc = vlc_savecancel();
+    int i_loops = var_InheritInteger( p_intf, CFG_PREFIX "loops" );
+    int i_alpha = var_InheritInteger( p_intf, CFG_PREFIX "alpha" );
+    char *psz_bases = var_InheritString( p_intf, CFG_PREFIX "base-chroma" );
+    char *psz_blends = var_InheritString( p_intf, CFG_PREFIX "blend-chroma" );
+
+    srand( 0 );
+    for( char *psz_base = psz_bases, *psz_next_base; psz_base != NULL;
+         psz_base = psz_next_base )
+    {
+        psz_next_base = strchr( psz_base, ',' );
+        if( psz_next_base )
+            *psz_next_base++ = '\0';
+        if( strlen( psz_base ) != 4 )
+            continue;
+
+        for( const char *psz_blend = psz_blends; psz_blend != NULL;
+             psz_blend = strchr( psz_blend, ',' ) ? strchr( psz_blend, ',' ) + 1
+                                                  : NULL )
+        {
+            if( strcspn( psz_blend, "," ) != 4 )
+                continue;
+            blendbench_Combination( p_intf,
+                    VLC_FOURCC( psz_base[0], psz_base[1],
+                                psz_base[2], psz_base[3] ),
+                    VLC_FOURCC( psz_blend[0], psz_blend[1],
+                                psz_blend[2], psz_blend[3] ),
+                    i_loops, i_alpha );
+        }
+    }
+    free( psz_bases );
+    free( psz_blends );
+
+    libvlc_Quit( p_intf->p_libvlc );
+    vlc_restorecancel( canc );
+    return NULL;
+}
+
+static int OpenInterface( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+    intf_sys_t *p_sys = malloc( sizeof( *p_sys ) );
+
+    if( !p_sys )
+        return VLC_ENOMEM;
+
+    p_intf->p_sys = p_sys;
+    if( vlc_clone( &p_sys->thread, Run, p_intf, VLC_THREAD_PRIORITY_LOW ) )
+    {
+        free( p_sys );
+        return VLC_ENOMEM;
+    }
+    return VLC_SUCCESS;
+}
+
+static void CloseInterface( vlc_object_t *p_this )
+{
+    intf_thread_t *p_intf = (intf_thread_t *)p_this;
+    intf_sys_t *p_sys = p_intf->p_sys;
+
+    vlc_join( p_sys->thread, NULL );
+    free( p_sys );
+}
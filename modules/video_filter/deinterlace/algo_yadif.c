@@ -47,6 +47,94 @@
    Necessary preprocessor macros are defined in common.h. */
 #include "yadif.h"
 
+typedef void (*yadif_filter_t)(uint8_t *dst, uint8_t *prev, uint8_t *cur,
+                               uint8_t *next, int w, int prefs, int mrefs,
+                               int parity, int mode);
+
+/* The 16-bit C filter, with the prototype of the others */
+static void yadif_filter_line_c_16bit_8( uint8_t *dst, uint8_t *prev,
+                                         uint8_t *cur, uint8_t *next, int w,
+                                         int prefs, int mrefs, int parity,
+                                         int mode )
+{
+    yadif_filter_line_c_16bit( (uint16_t *)dst, (uint16_t *)prev,
+                               (uint16_t *)cur, (uint16_t *)next, w,
+                               prefs, mrefs, parity, mode );
+}
+
+typedef struct
+{
+    yadif_filter_t filter;
+    const plane_t *prevp;
+    const plane_t *curp;
+    const plane_t *nextp;
+    plane_t       *dstp;
+    int           i_field;
+    int           yadif_parity;
+} yadif_slice_t;
+
+/* Renders the [i_start, i_end[ lines of one plane. Each line only depends on
+ * the source pictures, so the slices are independent. */
+static void RenderYadifLines( filter_t *p_filter, void *opaque,
+                              int i_start, int i_end )
+{
+    const yadif_slice_t *p_slice = opaque;
+    const plane_t *prevp = p_slice->prevp;
+    const plane_t *curp  = p_slice->curp;
+    const plane_t *nextp = p_slice->nextp;
+    plane_t *dstp        = p_slice->dstp;
+    const int i_field      = p_slice->i_field;
+    const int yadif_parity = p_slice->yadif_parity;
+
+    VLC_UNUSED(p_filter);
+    if( i_start < 1 )
+        i_start = 1;
+    if( i_end > dstp->i_visible_lines - 1 )
+        i_end = dstp->i_visible_lines - 1;
+
+    for( int y = i_start; y < i_end; y++ )
+    {
+        if( (y % 2) == i_field  ||  yadif_parity == 2 )
+        {
+            memcpy( &dstp->p_pixels[y * dstp->i_pitch],
+                        &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
+        }
+        else
+        {
+            int mode;
+            /* Spatial checks only when enough data */
+            mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
+
+            assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
+            p_slice->filter( &dstp->p_pixels[y * dstp->i_pitch],
+                    &prevp->p_pixels[y * prevp->i_pitch],
+                    &curp->p_pixels[y * curp->i_pitch],
+                    &nextp->p_pixels[y * nextp->i_pitch],
+                    dstp->i_visible_pitch,
+                    y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
+                    y  - 1  ?  -curp->i_pitch : curp->i_pitch,
+                    yadif_parity,
+                    mode );
+        }
+
+        /* We duplicate the first and last lines */
+        if( y == 1 )
+            memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
+                       &dstp->p_pixels[ y    * dstp->i_pitch],
+                       dstp->i_pitch);
+        else if( y == dstp->i_visible_lines - 2 )
+            memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
+                       &dstp->p_pixels[ y    * dstp->i_pitch],
+                       dstp->i_pitch);
+    }
+
+#if defined(HAVE_YADIF_MMX)
+    /* Slices may run on worker threads shared with other filters */
+    if( p_slice->filter == yadif_filter_line_mmx )
+        __asm__ __volatile__( "emms" :: );
+#endif
+}
+
 int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
                  int i_order, int i_field )
 {
@@ -105,8 +193,7 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
     if( p_prev && p_cur && p_next )
     {
         /* */
-        void (*filter)(uint8_t *dst, uint8_t *prev, uint8_t *cur, uint8_t *next,
-                       int w, int prefs, int mrefs, int parity, int mode);
+        yadif_filter_t filter;
 
 #if defined(HAVE_YADIF_SSSE3)
         if( vlc_CPU_SSSE3() )
@@ -126,50 +213,23 @@ int RenderYadif( filter_t *p_filter, picture_t *p_dst, picture_t *p_src,
             filter = yadif_filter_line_c;
 
         if( p_sys->chroma->pixel_size == 2 )
-            filter = yadif_filter_line_c_16bit;
+            filter = yadif_filter_line_c_16bit_8;
 
+        /* Lines are rendered in parallel slices, one plane after the other */
         for( int n = 0; n < p_dst->i_planes; n++ )
         {
-            const plane_t *prevp = &p_prev->p[n];
-            const plane_t *curp  = &p_cur->p[n];
-            const plane_t *nextp = &p_next->p[n];
-            plane_t *dstp        = &p_dst->p[n];
-
-            for( int y = 1; y < dstp->i_visible_lines - 1; y++ )
-            {
-                if( (y % 2) == i_field  ||  yadif_parity == 2 )
-                {
-                    memcpy( &dstp->p_pixels[y * dstp->i_pitch],
-                                &curp->p_pixels[y * curp->i_pitch], dstp->i_visible_pitch );
-                }
-                else
-                {
-                    int mode;
-                    /* Spatial checks only when enough data */
-                    mode = (y >= 2 && y < dstp->i_visible_lines - 2) ? 0 : 2;
-
-                    assert( prevp->i_pitch == curp->i_pitch && curp->i_pitch == nextp->i_pitch );
-                    filter( &dstp->p_pixels[y * dstp->i_pitch],
-                            &prevp->p_pixels[y * prevp->i_pitch],
-                            &curp->p_pixels[y * curp->i_pitch],
-                            &nextp->p_pixels[y * nextp->i_pitch],
-                            dstp->i_visible_pitch,
-                            y < dstp->i_visible_lines - 2  ? curp->i_pitch : -curp->i_pitch,
-                            y  - 1  ?  -curp->i_pitch : curp->i_pitch,
-                            yadif_parity,
-                            mode );
-                }
-
-                /* We duplicate the first and last lines */
-                if( y == 1 )
-                    memcpy(&dstp->p_pixels[(y-1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-                else if( y == dstp->i_visible_lines - 2 )
-                    memcpy(&dstp->p_pixels[(y+1) * dstp->i_pitch],
-                               &dstp->p_pixels[ y    * dstp->i_pitch],
-                               dstp->i_pitch);
-            }
+            yadif_slice_t slice = {
+                .filter       = filter,
+                .prevp        = &p_prev->p[n],
+                .curp         = &p_cur->p[n],
+                .nextp        = &p_next->p[n],
+                .dstp         = &p_dst->p[n],
+                .i_field      = i_field,
+                .yadif_parity = yadif_parity,
+            };
+
+            filter_RunSlices( p_filter, RenderYadifLines, &slice,
+                              p_dst->p[n].i_visible_lines, 2 );
         }
 
         p_sys->i_frame_offset = 1; /* p_cur will be rendered at next frame, too */
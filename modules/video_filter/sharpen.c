@@ -161,52 +161,42 @@ static void Destroy( vlc_object_t *p_this )
 }
 
 /*****************************************************************************
- * Render: displays previously rendered output
- *****************************************************************************
- * This function send the currently rendered image to Invert image, waits
- * until it is displayed and switch the two rendering buffers, preparing next
- * frame.
+ * FilterLines: sharpen the [i_start, i_end[ lines of the Y plane
  *****************************************************************************/
-static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+typedef struct
 {
+    const picture_t *p_pic;
     picture_t *p_outpic;
+} sharpen_slice_t;
+
+static void FilterLines( filter_t *p_filter, void *opaque,
+                         int i_start, int i_end )
+{
+    const sharpen_slice_t *p_slice = opaque;
     int i, j;
-    uint8_t *p_src = NULL;
-    uint8_t *p_out = NULL;
-    int i_src_pitch;
-    int i_out_pitch;
+    const uint8_t *p_src = p_slice->p_pic->p[Y_PLANE].p_pixels;
+    uint8_t *p_out = p_slice->p_outpic->p[Y_PLANE].p_pixels;
+    const int i_src_pitch = p_slice->p_pic->p[Y_PLANE].i_pitch;
+    const int i_out_pitch = p_slice->p_outpic->p[Y_PLANE].i_pitch;
+    const int i_lines = p_slice->p_pic->p[Y_PLANE].i_visible_lines;
+    const int i_visible_pitch = p_slice->p_pic->p[Y_PLANE].i_visible_pitch;
+    const int *tab_precalc = p_filter->p_sys->tab_precalc;
     int pix;
     const int v1 = -1;
     const int v2 = 3; /* 2^3 = 8 */
 
-    if( !p_pic ) return NULL;
-
-    p_outpic = filter_NewPicture( p_filter );
-    if( !p_outpic )
-    {
-        picture_Release( p_pic );
-        return NULL;
-    }
-
-    /* process the Y plane */
-    p_src = p_pic->p[Y_PLANE].p_pixels;
-    p_out = p_outpic->p[Y_PLANE].p_pixels;
-    i_src_pitch = p_pic->p[Y_PLANE].i_pitch;
-    i_out_pitch = p_outpic->p[Y_PLANE].i_pitch;
-
     /* perform convolution only on Y plane. Avoid border line. */
-    vlc_mutex_lock( &p_filter->p_sys->lock );
-    for( i = 0; i < p_pic->p[Y_PLANE].i_visible_lines; i++ )
+    for( i = i_start; i < i_end; i++ )
     {
-        if( (i == 0) || (i == p_pic->p[Y_PLANE].i_visible_lines - 1) )
+        if( (i == 0) || (i == i_lines - 1) )
         {
-            for( j = 0; j < p_pic->p[Y_PLANE].i_visible_pitch; j++ )
+            for( j = 0; j < i_visible_pitch; j++ )
                 p_out[i * i_out_pitch + j] = clip( p_src[i * i_src_pitch + j] );
             continue ;
         }
-        for( j = 0; j < p_pic->p[Y_PLANE].i_visible_pitch; j++ )
+        for( j = 0; j < i_visible_pitch; j++ )
         {
-            if( (j == 0) || (j == p_pic->p[Y_PLANE].i_visible_pitch - 1) )
+            if( (j == 0) || (j == i_visible_pitch - 1) )
             {
                 p_out[i * i_out_pitch + j] = p_src[i * i_src_pitch + j];
                 continue ;
@@ -224,9 +214,30 @@ static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
 
            pix = pix >= 0 ? clip(pix) : -clip(pix * -1);
            p_out[i * i_out_pitch + j] = clip( p_src[i * i_src_pitch + j] +
-               p_filter->p_sys->tab_precalc[pix + 256] );
+               tab_precalc[pix + 256] );
         }
     }
+}
+
+static picture_t *Filter( filter_t *p_filter, picture_t *p_pic )
+{
+    picture_t *p_outpic;
+
+    if( !p_pic ) return NULL;
+
+    p_outpic = filter_NewPicture( p_filter );
+    if( !p_outpic )
+    {
+        picture_Release( p_pic );
+        return NULL;
+    }
+
+    /* process the Y plane, in slices */
+    sharpen_slice_t slice = { .p_pic = p_pic, .p_outpic = p_outpic };
+
+    vlc_mutex_lock( &p_filter->p_sys->lock );
+    filter_RunSlices( p_filter, FilterLines, &slice,
+                      p_pic->p[Y_PLANE].i_visible_lines, 1 );
     vlc_mutex_unlock( &p_filter->p_sys->lock );
 
     plane_CopyPixels( &p_outpic->p[U_PLANE], &p_pic->p[U_PLANE] );
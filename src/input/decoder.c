@@ -32,6 +32,7 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_atomic.h>
 
 #include <vlc_block.h>
 #include <vlc_vout.h>
@@ -52,6 +53,7 @@
 #include "resource.h"
 
 #include "../video_output/vout_control.h"
+#include "../libvlc.h"
 
 static decoder_t *CreateDecoder( vlc_object_t *, input_thread_t *,
                                  es_format_t *, bool, input_resource_t *,
@@ -76,6 +78,26 @@ static int aout_update_format( decoder_t * );
 static subpicture_t *spu_new_buffer( decoder_t *, const subpicture_updater_t * );
 static void spu_del_buffer( decoder_t *, subpicture_t * );
 
+/* Arrival dates of the blocks in the fifo, indexed by a hash of the block
+ * address. Colliding blocks simply lose their sample. */
+#define DECODER_LATENCY_STAMPS (1024)
+
+typedef struct
+{
+    vlc_mutex_t lock; /* protects the stamps */
+    struct
+    {
+        const block_t *p_block;
+        mtime_t        i_date;
+    } stamps[DECODER_LATENCY_STAMPS];
+
+    mtime_t            i_decode; /* time spent decoding the current block */
+    /* total time spent waiting for the video output, from any thread */
+    atomic_int_least64_t i_stall;
+    bool               b_dirty;
+    input_es_latency_t hist;     /* not reported to the input yet */
+} decoder_latency_t;
+
 struct decoder_owner_sys_t
 {
     int64_t         i_preroll_end;
@@ -110,6 +132,7 @@ struct decoder_owner_sys_t
 
     /* fifo */
     block_fifo_t *p_fifo;
+    size_t       i_fifo_contention; /* last value reported to the stats */
 
     /* Lock for communication with decoder thread */
     vlc_mutex_t lock;
@@ -166,6 +189,9 @@ struct decoder_owner_sys_t
 
     /* Delay */
     mtime_t i_ts_delay;
+
+    /* Latency statistics, NULL unless enabled */
+    decoder_latency_t *p_latency;
 };
 
 #define DECODER_MAX_BUFFERING_COUNT (4)
@@ -179,6 +205,84 @@ struct decoder_owner_sys_t
 /* */
 #define DECODER_SPU_VOUT_WAIT_DURATION ((int)(0.200*CLOCK_FREQ))
 
+/*****************************************************************************
+ * Latency statistics
+ *****************************************************************************/
+static void DecoderLatencyAdd( decoder_latency_t *p_latency,
+                               uint64_t *p_hist, mtime_t i_duration )
+{
+    unsigned i_bucket;
+
+    if( i_duration < 256 )
+        i_bucket = 0;
+    else if( i_duration >= (1 << 22) )
+        i_bucket = INPUT_LATENCY_BUCKETS - 1;
+    else
+        i_bucket = (31 - clz( i_duration )) - 7;
+
+    p_hist[i_bucket]++;
+    p_latency->b_dirty = true;
+}
+
+static unsigned DecoderLatencyHash( const block_t *p_block )
+{
+    return ((uint32_t)((uintptr_t)p_block >> 4) * 2654435761u) >> 22;
+}
+
+/* Records when a block entered the fifo, from the input thread */
+static void DecoderLatencyStamp( decoder_latency_t *p_latency,
+                                 const block_t *p_block )
+{
+    unsigned i = DecoderLatencyHash( p_block );
+
+    vlc_mutex_lock( &p_latency->lock );
+    p_latency->stamps[i].p_block = p_block;
+    p_latency->stamps[i].i_date = mdate();
+    vlc_mutex_unlock( &p_latency->lock );
+}
+
+/* Samples how long a block waited in the fifo, from the decoder thread */
+static void DecoderLatencyQueued( decoder_latency_t *p_latency,
+                                  const block_t *p_block )
+{
+    unsigned i = DecoderLatencyHash( p_block );
+    mtime_t i_date = VLC_TS_INVALID;
+
+    vlc_mutex_lock( &p_latency->lock );
+    if( p_latency->stamps[i].p_block == p_block )
+    {
+        i_date = p_latency->stamps[i].i_date;
+        p_latency->stamps[i].p_block = NULL;
+    }
+    vlc_mutex_unlock( &p_latency->lock );
+
+    if( i_date > VLC_TS_INVALID )
+        DecoderLatencyAdd( p_latency, p_latency->hist.queue, mdate() - i_date );
+}
+
+/* Samples how long ahead of (or late for) its date an output frame is */
+static void DecoderLatencyOutput( decoder_latency_t *p_latency, mtime_t i_date )
+{
+    if( p_latency == NULL || i_date <= VLC_TS_INVALID )
+        return;
+
+    const mtime_t i_wait = i_date - mdate();
+    if( i_wait >= 0 )
+        DecoderLatencyAdd( p_latency, p_latency->hist.output, i_wait );
+    else
+        DecoderLatencyAdd( p_latency, p_latency->hist.late, -i_wait );
+}
+
+/* Samples the time spent decoding the last block */
+static void DecoderLatencyDecoded( decoder_latency_t *p_latency )
+{
+    if( p_latency == NULL )
+        return;
+
+    DecoderLatencyAdd( p_latency, p_latency->hist.decode, p_latency->i_decode );
+    p_latency->i_decode = 0;
+}
+
 
 /*****************************************************************************
  * Public functions
@@ -412,6 +516,8 @@ void input_DecoderDecode( decoder_t *p_dec, block_t *p_block, bool b_do_pace )
         block_FifoEmpty( p_owner->p_fifo );
     }
 
+    if( p_owner->p_latency != NULL )
+        DecoderLatencyStamp( p_owner->p_latency, p_block );
     block_FifoPut( p_owner->p_fifo, p_block );
 }
 
@@ -905,9 +1011,105 @@ static decoder_t * CreateDecoder( vlc_object_t *p_parent,
         p_owner->cc.pp_decoder[i] = NULL;
     }
     p_owner->i_ts_delay = 0;
+    p_owner->i_fifo_contention = 0;
+
+    p_owner->p_latency = NULL;
+    if( p_input != NULL && !b_packetizer
+     && ( fmt->i_cat == VIDEO_ES || fmt->i_cat == AUDIO_ES )
+     && libvlc_stats( p_dec ) && var_InheritBool( p_dec, "latency-stats" ) )
+    {
+        p_owner->p_latency = calloc( 1, sizeof( *p_owner->p_latency ) );
+        if( p_owner->p_latency != NULL )
+        {
+            vlc_mutex_init( &p_owner->p_latency->lock );
+            atomic_init( &p_owner->p_latency->i_stall, 0 );
+            p_owner->p_latency->hist.i_id = fmt->i_id;
+            p_owner->p_latency->hist.i_cat = fmt->i_cat;
+        }
+    }
     return p_dec;
 }
 
+/* Reports the contention on the decoder fifo lock to the input stats */
+static void DecoderUpdateStatFifo( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    input_thread_t *p_input = p_owner->p_input;
+
+    if( p_input == NULL || !libvlc_stats( p_dec ) )
+        return;
+
+    const size_t i_contention = block_FifoContention( p_owner->p_fifo );
+    if( i_contention == p_owner->i_fifo_contention )
+        return;
+
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    stats_Update( p_input->p->counters.p_decoder_contention,
+                  i_contention - p_owner->i_fifo_contention, NULL );
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+    p_owner->i_fifo_contention = i_contention;
+}
+
+/* Adds the latency histograms collected since the last call to the input
+ * stats of the ES */
+static void DecoderUpdateStatLatency( decoder_t *p_dec )
+{
+    decoder_owner_sys_t *p_owner = p_dec->p_owner;
+    decoder_latency_t *p_latency = p_owner->p_latency;
+    input_thread_t *p_input = p_owner->p_input;
+
+    if( p_latency == NULL || !p_latency->b_dirty )
+        return;
+
+    input_es_latency_t *p_hist = &p_latency->hist;
+    input_es_latency_t *p_es = NULL;
+
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    for( int i = 0; i < p_input->p->counters.i_es_latency; i++ )
+    {
+        input_es_latency_t *p_cur = &p_input->p->counters.p_es_latency[i];
+
+        if( p_cur->i_id == p_hist->i_id && p_cur->i_cat == p_hist->i_cat )
+        {
+            p_es = p_cur;
+            break;
+        }
+    }
+    if( p_es == NULL )
+    {
+        const int i_count = p_input->p->counters.i_es_latency;
+        input_es_latency_t *p_tab =
+            realloc( p_input->p->counters.p_es_latency,
+                     (i_count + 1) * sizeof( *p_tab ) );
+        if( p_tab != NULL )
+        {
+            p_es = &p_tab[i_count];
+            memset( p_es, 0, sizeof( *p_es ) );
+            p_es->i_id = p_hist->i_id;
+            p_es->i_cat = p_hist->i_cat;
+            p_input->p->counters.p_es_latency = p_tab;
+            p_input->p->counters.i_es_latency = i_count + 1;
+        }
+    }
+    if( p_es != NULL )
+    {
+        for( int i = 0; i < INPUT_LATENCY_BUCKETS; i++ )
+        {
+            p_es->queue[i] += p_hist->queue[i];
+            p_es->decode[i] += p_hist->decode[i];
+            p_es->output[i] += p_hist->output[i];
+            p_es->late[i] += p_hist->late[i];
+        }
+    }
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+
+    memset( p_hist->queue, 0, sizeof( p_hist->queue ) );
+    memset( p_hist->decode, 0, sizeof( p_hist->decode ) );
+    memset( p_hist->output, 0, sizeof( p_hist->output ) );
+    memset( p_hist->late, 0, sizeof( p_hist->late ) );
+    p_latency->b_dirty = false;
+}
+
 /**
  * The decoding main loop
  *
@@ -942,7 +1144,12 @@ static void *DecoderThread( void *p_data )
                 p_block = NULL;
             }
 
+            if( p_owner->p_latency != NULL && p_block != NULL )
+                DecoderLatencyQueued( p_owner->p_latency, p_block );
+
             DecoderProcess( p_dec, p_block );
+            DecoderUpdateStatFifo( p_dec );
+            DecoderUpdateStatLatency( p_dec );
 
             vlc_restorecancel( canc );
         }
@@ -1240,6 +1447,7 @@ static void DecoderPlayAudio( decoder_t *p_dec, block_t *p_audio,
         if( !b_reject )
         {
             assert( !p_owner->b_paused );
+            DecoderLatencyOutput( p_owner->p_latency, p_audio->i_pts );
             if( !aout_DecPlay( p_aout, p_audio, i_rate ) )
                 *pi_played_sum += 1;
             *pi_lost_sum += aout_DecGetResetLost( p_aout );
@@ -1259,6 +1467,20 @@ static void DecoderPlayAudio( decoder_t *p_dec, block_t *p_audio,
     vlc_mutex_unlock( &p_owner->lock );
 }
 
+/* Runs the audio decoder, timing it if latency statistics are enabled */
+static block_t *DecoderDecodeAudioBlock( decoder_t *p_dec, block_t **pp_block )
+{
+    decoder_latency_t *p_latency = p_dec->p_owner->p_latency;
+
+    if( p_latency == NULL )
+        return p_dec->pf_decode_audio( p_dec, pp_block );
+
+    const mtime_t i_start = mdate();
+    block_t *p_aout_buf = p_dec->pf_decode_audio( p_dec, pp_block );
+    p_latency->i_decode += mdate() - i_start;
+    return p_aout_buf;
+}
+
 static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
@@ -1266,12 +1488,13 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
     int i_decoded = 0;
     int i_lost = 0;
     int i_played = 0;
+    const bool b_block = p_block != NULL;
 
     if (!p_block) {
         /* Play a NULL block to output buffered frames */
         DecoderPlayAudio( p_dec, NULL, &i_played, &i_lost );
     }
-    else while( (p_aout_buf = p_dec->pf_decode_audio( p_dec, &p_block )) )
+    else while( (p_aout_buf = DecoderDecodeAudioBlock( p_dec, &p_block )) )
     {
         if( DecoderIsExitRequested( p_dec ) )
         {
@@ -1301,6 +1524,8 @@ static void DecoderDecodeAudio( decoder_t *p_dec, block_t *p_block )
 
         DecoderPlayAudio( p_dec, p_aout_buf, &i_played, &i_lost );
     }
+    if( b_block )
+        DecoderLatencyDecoded( p_owner->p_latency );
 
     /* Update ugly stat */
     input_thread_t  *p_input = p_owner->p_input;
@@ -1359,7 +1584,8 @@ static void DecoderGetCc( decoder_t *p_dec, decoder_t *p_dec_cc )
 }
 
 static void DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
-                              int *pi_played_sum, int *pi_lost_sum )
+                              int *pi_played_sum, int *pi_lost_sum,
+                              int *pi_late_sum )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
     vout_thread_t  *p_vout = p_owner->p_vout;
@@ -1448,6 +1674,7 @@ static void DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
                 vout_Flush( p_vout, p_picture->date );
                 p_owner->i_last_rate = i_rate;
             }
+            DecoderLatencyOutput( p_owner->p_latency, p_picture->date );
             vout_PutPicture( p_vout, p_picture );
         }
         else
@@ -1462,10 +1689,13 @@ static void DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
         }
         int i_tmp_display;
         int i_tmp_lost;
-        vout_GetResetStatistic( p_vout, &i_tmp_display, &i_tmp_lost );
+        int i_tmp_late;
+        vout_GetResetStatistic( p_vout, &i_tmp_display, &i_tmp_lost,
+                                &i_tmp_late );
 
         *pi_played_sum += i_tmp_display;
         *pi_lost_sum += i_tmp_lost;
+        *pi_late_sum += i_tmp_late;
 
         if( !b_has_more || b_buffering_first )
             break;
@@ -1479,6 +1709,27 @@ static void DecoderPlayVideo( decoder_t *p_dec, picture_t *p_picture,
     }
 }
 
+/* Runs the video decoder, timing it if latency statistics are enabled */
+static picture_t *DecoderDecodeVideoBlock( decoder_t *p_dec, block_t **pp_block )
+{
+    decoder_latency_t *p_latency = p_dec->p_owner->p_latency;
+
+    if( p_latency == NULL )
+        return p_dec->pf_decode_video( p_dec, pp_block );
+
+    const mtime_t i_stall = atomic_load( &p_latency->i_stall );
+    const mtime_t i_start = mdate();
+    picture_t *p_pic = p_dec->pf_decode_video( p_dec, pp_block );
+
+    /* Waiting for a free picture is display backpressure, not decoding.
+     * Decoder threads may wait at the same time, hence the clamp. */
+    mtime_t i_busy = mdate() - i_start
+                   - ( atomic_load( &p_latency->i_stall ) - i_stall );
+    if( i_busy > 0 )
+        p_latency->i_decode += i_busy;
+    return p_pic;
+}
+
 static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
@@ -1486,8 +1737,11 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
     int i_lost = 0;
     int i_decoded = 0;
     int i_displayed = 0;
+    int i_late = 0;
+    int i_pool_gets = 0, i_pool_exhausted = 0, i_pool_used_max = -1;
+    const bool b_block = p_block != NULL;
 
-    while( (p_pic = p_dec->pf_decode_video( p_dec, &p_block )) )
+    while( (p_pic = DecoderDecodeVideoBlock( p_dec, &p_block )) )
     {
         vout_thread_t  *p_vout = p_owner->p_vout;
         if( DecoderIsExitRequested( p_dec ) )
@@ -1520,8 +1774,13 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
             ( !p_owner->p_packetizer || !p_owner->p_packetizer->pf_get_cc ) )
             DecoderGetCc( p_dec, p_dec );
 
-        DecoderPlayVideo( p_dec, p_pic, &i_displayed, &i_lost );
+        DecoderPlayVideo( p_dec, p_pic, &i_displayed, &i_lost, &i_late );
     }
+    if( b_block )
+        DecoderLatencyDecoded( p_owner->p_latency );
+    if( i_decoded > 0 && p_owner->p_vout != NULL )
+        vout_GetResetPoolStatistic( p_owner->p_vout, &i_pool_gets,
+                                    &i_pool_exhausted, &i_pool_used_max );
 
     /* Update ugly stat */
     input_thread_t *p_input = p_owner->p_input;
@@ -1533,6 +1792,16 @@ static void DecoderDecodeVideo( decoder_t *p_dec, block_t *p_block )
         stats_Update( p_input->p->counters.p_lost_pictures, i_lost , NULL);
         stats_Update( p_input->p->counters.p_displayed_pictures,
                       i_displayed, NULL);
+        stats_Update( p_input->p->counters.p_late_pictures, i_late, NULL );
+        if( i_pool_used_max >= 0 )
+        {
+            stats_Update( p_input->p->counters.p_pool_pictures,
+                          i_pool_gets, NULL );
+            stats_Update( p_input->p->counters.p_pool_exhausted,
+                          i_pool_exhausted, NULL );
+            stats_Update( p_input->p->counters.p_pool_used_max,
+                          i_pool_used_max, NULL );
+        }
         vlc_mutex_unlock( &p_input->p->counters.counters_lock );
     }
 }
@@ -2130,6 +2399,13 @@ static void DeleteDecoder( decoder_t * p_dec )
         vlc_object_release( p_owner->p_packetizer );
     }
 
+    if( p_owner->p_latency != NULL )
+    {
+        DecoderUpdateStatLatency( p_dec );
+        vlc_mutex_destroy( &p_owner->p_latency->lock );
+        free( p_owner->p_latency );
+    }
+
     vlc_cond_destroy( &p_owner->wait_acknowledge );
     vlc_cond_destroy( &p_owner->wait_request );
     vlc_mutex_destroy( &p_owner->lock );
@@ -2265,7 +2541,7 @@ static int aout_update_format( decoder_t *p_dec )
     return 0;
 }
 
-static picture_t *vout_new_buffer( decoder_t *p_dec )
+static picture_t *VoutNewPicture( decoder_t *p_dec )
 {
     decoder_owner_sys_t *p_owner = p_dec->p_owner;
 
@@ -2419,6 +2695,20 @@ static picture_t *vout_new_buffer( decoder_t *p_dec )
     }
 }
 
+/* Gets a picture, timing the wait if latency statistics are enabled */
+static picture_t *vout_new_buffer( decoder_t *p_dec )
+{
+    decoder_latency_t *p_latency = p_dec->p_owner->p_latency;
+
+    if( p_latency == NULL )
+        return VoutNewPicture( p_dec );
+
+    const mtime_t i_start = mdate();
+    picture_t *p_picture = VoutNewPicture( p_dec );
+    atomic_fetch_add( &p_latency->i_stall, mdate() - i_start );
+    return p_picture;
+}
+
 static void vout_del_buffer( decoder_t *p_dec, picture_t *p_pic )
 {
     vout_ReleasePicture( p_dec->p_owner->p_vout, p_pic );
@@ -47,6 +47,7 @@
 #include <vlc_input.h>
 #include <vlc_es_out.h>
 #include <vlc_block.h>
+#include <vlc_arrays.h>
 #include "input_internal.h"
 #include "es_out.h"
 #include "es_out_timeshift.h"
@@ -55,6 +56,13 @@
  * Local prototypes
  *****************************************************************************/
 
+/* Index points are added at least that often */
+#define TS_INDEX_INTERVAL (CLOCK_FREQ)
+/* A key frame up to that far before a seek point is preferred to it */
+#define TS_INDEX_KEY_SPAN (10*CLOCK_FREQ)
+/* Stdio buffer of the file being written */
+#define TS_WRITE_BUFFER (1024*1024)
+
 /* XXX attribute_packed is (and MUST be) used ONLY to reduce memory usage */
 #ifdef HAVE_ATTRIBUTE_PACKED
 #   define attribute_packed __attribute__((__packed__))
@@ -152,6 +160,13 @@ typedef struct attribute_packed
     } u;
 } ts_cmd_t;
 
+typedef struct
+{
+    mtime_t i_date;
+    int     i_cmd;
+    bool    b_key;
+} ts_index_t;
+
 typedef struct ts_storage_t ts_storage_t;
 struct ts_storage_t
 {
@@ -161,14 +176,21 @@ struct ts_storage_t
     char    *psz_file;  /* Filename */
     size_t  i_file_max; /* Max size in bytes */
     int64_t i_file_size;/* Current size in bytes */
-    FILE    *p_filew;   /* FILE handle for data writing */
+    int64_t i_file_flushed; /* Size in bytes known to be readable */
+    FILE    *p_filew;   /* FILE handle for data writing, until full */
     FILE    *p_filer;   /* FILE handle for data reading */
+    char    *p_bufferw; /* Buffer of p_filew */
 
     /* */
+    int64_t  i_cmd_base; /* Serial number of the first command */
     int      i_cmd_r;
     int      i_cmd_w;
     int      i_cmd_max;
+    int      i_cmd_done; /* Commands before it have been executed once */
     ts_cmd_t *p_cmd;
+
+    /* Seek points, in command order */
+    DECL_ARRAY(ts_index_t) index;
 };
 
 typedef struct
@@ -178,6 +200,12 @@ typedef struct
     es_out_t       *p_out;
     int64_t        i_tmp_size_max;
     const char     *psz_tmp_path;
+    mtime_t        i_window;
+    int64_t        i_size_max;
+
+    /* Only used by the thread */
+    int            i_es_del;
+    es_out_id_t    **pp_es_del;
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
@@ -197,10 +225,18 @@ typedef struct
     mtime_t        i_buffering_delay;
 
     /* */
+    ts_storage_t   *p_storage_first;
     ts_storage_t   *p_storage_r;
     ts_storage_t   *p_storage_w;
 
     mtime_t        i_cmd_delay;
+    mtime_t        i_cmd_date;  /* Date of the last command read */
+    int64_t        i_cmd_skip;  /* Serial number of the seek point */
+    unsigned       i_seek;
+
+    /* Last stream time given by the input, and when */
+    mtime_t        i_time;
+    mtime_t        i_time_date;
 
 } ts_thread_t;
 
@@ -217,12 +253,15 @@ struct es_out_sys_t
     /* Configuration */
     int64_t        i_tmp_size_max;    /* Maximal temporary file size in byte */
     char           *psz_tmp_path;     /* Path for temporary files */
+    mtime_t        i_window;          /* Played duration kept for seeking */
+    int64_t        i_size_max;        /* Maximal size of all temporary files */
 
     /* Lock for all following fields */
     vlc_mutex_t    lock;
 
     /* */
     bool           b_delayed;
+    bool           b_window_failed;   /* Recording for the window failed */
     ts_thread_t   *p_ts;
 
     /* */
@@ -247,24 +286,26 @@ static void         TsAutoStop( es_out_t * );
 
 static void         TsStop( ts_thread_t * );
 static void         TsPushCmd( ts_thread_t *, ts_cmd_t * );
-static int          TsPopCmdLocked( ts_thread_t *, ts_cmd_t *, bool b_flush );
+static int          TsPopCmdLocked( ts_thread_t *, ts_cmd_t *, bool *pb_skip );
 static bool         TsHasCmd( ts_thread_t * );
 static bool         TsIsUnused( ts_thread_t * );
 static int          TsChangePause( ts_thread_t *, bool b_source_paused, bool b_paused, mtime_t i_date );
 static int          TsChangeRate( ts_thread_t *, int i_src_rate, int i_rate );
+static int          TsSeek( ts_thread_t *, mtime_t i_time );
 
 static void         *TsRun( void * );
 
-static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max );
+static ts_storage_t *TsStorageNew( const char *psz_path, int64_t i_tmp_size_max, int64_t i_cmd_base );
 static void         TsStorageDelete( ts_storage_t * );
 static void         TsStoragePack( ts_storage_t *p_storage );
 static bool         TsStorageIsFull( ts_storage_t *, const ts_cmd_t *p_cmd );
 static bool         TsStorageIsEmpty( ts_storage_t * );
-static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd, bool b_flush );
+static void         TsStoragePushCmd( ts_storage_t *, const ts_cmd_t *p_cmd );
 static void         TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush );
 
 static void CmdClean( ts_cmd_t * );
 static void cmd_cleanup_routine( void *p ) { CmdClean( p ); }
+static bool CmdIsReplayable( const ts_cmd_t * );
 
 static int  CmdInitAdd    ( ts_cmd_t *, es_out_id_t *, const es_format_t *, bool b_copy );
 static void CmdInitSend   ( ts_cmd_t *, es_out_id_t *, block_t * );
@@ -321,6 +362,7 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     vlc_mutex_init_recursive( &p_sys->lock );
 
     p_sys->b_delayed = false;
+    p_sys->b_window_failed = false;
     p_sys->p_ts = NULL;
 
     TAB_INIT( p_sys->i_es, p_sys->pp_es );
@@ -335,8 +377,24 @@ es_out_t *input_EsOutTimeshiftNew( input_thread_t *p_input, es_out_t *p_next_out
     char *psz_tmp_path = var_CreateGetNonEmptyString( p_input, "input-timeshift-path" );
     p_sys->psz_tmp_path = GetTmpPath( psz_tmp_path );
 
+    const int i_window = var_CreateGetInteger( p_input, "input-timeshift-window" );
+    p_sys->i_window = (mtime_t)__MAX( i_window, 0 ) * CLOCK_FREQ;
+
+    /* At least two files, the one written and the one read */
+    const int i_size_max = var_CreateGetInteger( p_input, "input-timeshift-size" );
+    if( i_size_max <= 0 )
+        p_sys->i_size_max = 0;
+    else
+        p_sys->i_size_max = __MAX( (int64_t)i_size_max*1024*1024,
+                                   2 * p_sys->i_tmp_size_max );
+
     msg_Dbg( p_input, "using timeshift granularity of %d MiB, in path '%s'",
              (int)p_sys->i_tmp_size_max/(1024*1024), p_sys->psz_tmp_path );
+    if( p_sys->i_window > 0 && p_sys->i_size_max > 0 )
+        msg_Dbg( p_input, "keeping %d s of timeshift history, up to %"PRId64" MiB",
+                 i_window, p_sys->i_size_max/(1024*1024) );
+    else if( p_sys->i_window > 0 )
+        msg_Dbg( p_input, "keeping %d s of timeshift history", i_window );
 
 #if 0
 #define S(t) msg_Err( p_input, "SIZEOF("#t")=%d", sizeof(t) )
@@ -415,6 +473,13 @@ static int Send( es_out_t *p_out, es_out_id_t *p_es, block_t *p_block )
 
     TsAutoStop( p_out );
 
+    /* With a window, the stream is recorded from the start to be seekable.
+     * If that fails, it is not retried on every block. */
+    if( !p_sys->b_delayed && p_sys->i_window > 0 && !p_sys->b_window_failed &&
+        !p_sys->p_input->p->b_can_pace_control &&
+        TsStart( p_out ) != VLC_SUCCESS )
+        p_sys->b_window_failed = true;
+
     CmdInitSend( &cmd, p_es, p_block );
     if( p_sys->b_delayed )
         TsPushCmd( p_sys->p_ts, &cmd );
@@ -436,9 +501,14 @@ static void Del( es_out_t *p_out, es_out_id_t *p_es )
 
     CmdInitDel( &cmd, p_es );
     if( p_sys->b_delayed )
+    {
         TsPushCmd( p_sys->p_ts, &cmd );
+    }
     else
+    {
         CmdExecuteDel( p_sys->p_out, &cmd );
+        free( p_es );
+    }
 
     TAB_REMOVE( p_sys->i_es, p_sys->pp_es, p_es );
 
@@ -476,10 +546,8 @@ static int ControlLockedGetBuffering( es_out_t *p_out, bool *pb_buffering )
 {
     es_out_sys_t *p_sys = p_out->p_sys;
 
-    if( p_sys->b_delayed )
-        *pb_buffering = true;
-    else
-        *pb_buffering = es_out_GetBuffering( p_sys->p_out );
+    /* Delayed or not, the ES are buffered by the real es_out */
+    *pb_buffering = es_out_GetBuffering( p_sys->p_out );
 
     return VLC_SUCCESS;
 }
@@ -558,8 +626,12 @@ static int ControlLockedSetTime( es_out_t *p_out, mtime_t i_date )
 {
     es_out_sys_t *p_sys = p_out->p_sys;
 
+    /* A time can only be set within the timeshifted stream */
     if( !p_sys->b_delayed )
-        return es_out_SetTime( p_sys->p_out, i_date );
+        return i_date < 0 ? es_out_SetTime( p_sys->p_out, i_date ) : VLC_EGENERIC;
+
+    if( i_date >= 0 )
+        return TsSeek( p_sys->p_ts, i_date );
 
     /* TODO */
     msg_Err( p_sys->p_input, "EsOutTimeshift does not yet support time change" );
@@ -674,6 +746,7 @@ static int ControlLocked( es_out_t *p_out, int i_query, va_list args )
     {
         return ControlLockedSetFrameNext( p_out );
     }
+
     case ES_OUT_GET_PCR_SYSTEM:
     {
         if( p_sys->b_delayed )
@@ -744,6 +817,9 @@ static int TsStart( es_out_t *p_out )
 
     p_ts->i_tmp_size_max = p_sys->i_tmp_size_max;
     p_ts->psz_tmp_path = p_sys->psz_tmp_path;
+    p_ts->i_window = p_sys->i_window;
+    p_ts->i_size_max = p_sys->i_size_max;
+    TAB_INIT( p_ts->i_es_del, p_ts->pp_es_del );
     p_ts->p_input = p_sys->p_input;
     p_ts->p_out = p_sys->p_out;
     vlc_mutex_init( &p_ts->lock );
@@ -756,6 +832,12 @@ static int TsStart( es_out_t *p_out )
     p_ts->i_rate_delay = 0;
     p_ts->i_buffering_delay = 0;
     p_ts->i_cmd_delay = 0;
+    p_ts->i_cmd_date = -1;
+    p_ts->i_cmd_skip = 0;
+    p_ts->i_seek = 0;
+    p_ts->i_time = -1;
+    p_ts->i_time_date = -1;
+    p_ts->p_storage_first = NULL;
     p_ts->p_storage_r = NULL;
     p_ts->p_storage_w = NULL;
 
@@ -790,29 +872,105 @@ static void TsStop( ts_thread_t *p_ts )
     vlc_join( p_ts->thread, NULL );
 
     vlc_mutex_lock( &p_ts->lock );
-    for( ;; )
+    while( p_ts->p_storage_first )
     {
-        ts_cmd_t cmd;
-
-        if( TsPopCmdLocked( p_ts, &cmd, true ) )
-            break;
+        ts_storage_t *p_next = p_ts->p_storage_first->p_next;
 
-        CmdClean( &cmd );
+        TsStorageDelete( p_ts->p_storage_first );
+        p_ts->p_storage_first = p_next;
     }
-    assert( !p_ts->p_storage_r || !p_ts->p_storage_r->p_next );
-    if( p_ts->p_storage_r )
-        TsStorageDelete( p_ts->p_storage_r );
     vlc_mutex_unlock( &p_ts->lock );
 
+    for( int i = 0; i < p_ts->i_es_del; i++ )
+        free( p_ts->pp_es_del[i] );
+    TAB_CLEAN( p_ts->i_es_del, p_ts->pp_es_del );
+
     TsDestroy( p_ts );
 }
+static mtime_t TsStorageGetDate( ts_storage_t *p_storage )
+{
+    return p_storage->i_cmd_w > 0 ? p_storage->p_cmd[p_storage->i_cmd_w-1].i_date : -1;
+}
+static void TsSeekLocked( ts_thread_t *p_ts, ts_storage_t *p_target, int i_cmd, mtime_t i_date )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    /* Commands never executed cannot be jumped over: read them from the
+     * first one, skipping the data up to the target */
+    ts_storage_t *p_storage = p_ts->p_storage_first;
+    while( p_storage != p_target && p_storage->i_cmd_done >= p_storage->i_cmd_w )
+        p_storage = p_storage->p_next;
+
+    if( p_storage == p_target && i_cmd <= p_target->i_cmd_done )
+    {
+        p_ts->p_storage_r = p_target;
+        p_target->i_cmd_r = i_cmd;
+    }
+    else
+    {
+        p_ts->p_storage_r = p_storage;
+        p_storage->i_cmd_r = p_storage->i_cmd_done;
+    }
+    p_ts->i_cmd_skip = p_target->i_cmd_base + i_cmd;
+    p_ts->i_cmd_date = i_date;
+
+    /* The target is played now, or at unpause */
+    p_ts->i_cmd_delay = ( p_ts->b_paused ? p_ts->i_pause_date : mdate() ) - i_date;
+    p_ts->i_rate_date = -1;
+    p_ts->i_rate_delay = 0;
+    p_ts->i_buffering_delay = 0;
+
+    p_ts->i_seek++;
+    vlc_cond_signal( &p_ts->wait );
+}
+static void TsPurgeLocked( ts_thread_t *p_ts )
+{
+    vlc_assert_locked( &p_ts->lock );
+
+    const mtime_t i_live = TsStorageGetDate( p_ts->p_storage_w );
+    int64_t i_size = 0;
+
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+        i_size += p->i_file_size;
+
+    while( p_ts->p_storage_first != p_ts->p_storage_w )
+    {
+        ts_storage_t *p_storage = p_ts->p_storage_first;
+        const bool b_old = p_ts->i_window > 0 &&
+                           TsStorageGetDate( p_storage ) < i_live - p_ts->i_window;
+        const bool b_big = p_ts->i_size_max > 0 && i_size > p_ts->i_size_max;
+
+        if( p_storage == p_ts->p_storage_r )
+        {
+            /* Playback is lagging too much, jump to the next file */
+            if( b_old || b_big )
+            {
+                ts_storage_t *p_next = p_storage->p_next;
+                const int i_cmd = p_next->index.i_size > 0 ? p_next->index.p_elems[0].i_cmd : 0;
+
+                msg_Warn( p_ts->p_input, "es out timeshift: dropping data not played yet" );
+                TsSeekLocked( p_ts, p_next, i_cmd, p_next->p_cmd[i_cmd].i_date );
+            }
+            break;
+        }
+        if( p_ts->i_window > 0 && !b_old && !b_big )
+            break;
+
+        i_size -= p_storage->i_file_size;
+        p_ts->p_storage_first = p_storage->p_next;
+        TsStorageDelete( p_storage );
+    }
+}
 static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 {
     vlc_mutex_lock( &p_ts->lock );
 
     if( !p_ts->p_storage_w || TsStorageIsFull( p_ts->p_storage_w, p_cmd ) )
     {
-        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max );
+        const int64_t i_cmd_base = p_ts->p_storage_w ?
+            p_ts->p_storage_w->i_cmd_base + p_ts->p_storage_w->i_cmd_w : 0;
+        ts_storage_t *p_storage = TsStorageNew( p_ts->psz_tmp_path, p_ts->i_tmp_size_max,
+                                                i_cmd_base );
 
         if( !p_storage )
         {
@@ -824,7 +982,7 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
 
         if( !p_ts->p_storage_w )
         {
-            p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
+            p_ts->p_storage_first = p_ts->p_storage_r = p_ts->p_storage_w = p_storage;
         }
         else
         {
@@ -834,40 +992,73 @@ static void TsPushCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd )
         }
     }
 
+    /* The stream time follows the date for live streams */
+    if( p_cmd->i_type == C_CONTROL && p_cmd->u.control.i_query == ES_OUT_SET_TIMES &&
+        p_cmd->u.control.u.times.i_time > 0 )
+    {
+        p_ts->i_time = p_cmd->u.control.u.times.i_time;
+        p_ts->i_time_date = p_cmd->i_date;
+    }
+
     /* TODO return error and warn the user (but only once) */
-    TsStoragePushCmd( p_ts->p_storage_w, p_cmd, p_ts->p_storage_r == p_ts->p_storage_w );
+    TsStoragePushCmd( p_ts->p_storage_w, p_cmd );
+
+    if( p_ts->p_storage_w->i_cmd_w == 1 && p_ts->p_storage_first != p_ts->p_storage_w )
+        TsPurgeLocked( p_ts );
 
     vlc_cond_signal( &p_ts->wait );
 
     vlc_mutex_unlock( &p_ts->lock );
 }
-static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_flush )
+static int TsPopCmdLocked( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool *pb_skip )
 {
     vlc_assert_locked( &p_ts->lock );
 
-    if( TsStorageIsEmpty( p_ts->p_storage_r ) )
-        return VLC_EGENERIC;
+    for( ;; )
+    {
+        ts_storage_t *p_storage = p_ts->p_storage_r;
 
-    TsStoragePopCmd( p_ts->p_storage_r, p_cmd, b_flush );
+        while( p_storage && TsStorageIsEmpty( p_storage ) && p_storage->p_next )
+        {
+            p_storage = p_ts->p_storage_r = p_storage->p_next;
+            p_storage->i_cmd_r = 0;
+        }
+        if( TsStorageIsEmpty( p_storage ) )
+            return VLC_EGENERIC;
 
-    while( p_ts->p_storage_r && TsStorageIsEmpty( p_ts->p_storage_r ) )
-    {
-        ts_storage_t *p_next = p_ts->p_storage_r->p_next;
-        if( !p_next )
-            break;
+        const ts_cmd_t *p_next = &p_storage->p_cmd[p_storage->i_cmd_r];
+        const bool b_done = p_storage->i_cmd_r < p_storage->i_cmd_done;
+        const bool b_skip = p_storage->i_cmd_base + p_storage->i_cmd_r < p_ts->i_cmd_skip;
 
-        TsStorageDelete( p_ts->p_storage_r );
-        p_ts->p_storage_r = p_next;
+        /* Data before a seek point is dropped, and only data can be
+         * executed more than once */
+        if( CmdIsReplayable( p_next ) ? b_skip : b_done )
+        {
+            p_storage->i_cmd_r++;
+            p_storage->i_cmd_done = __MAX( p_storage->i_cmd_done, p_storage->i_cmd_r );
+            continue;
+        }
+
+        TsStoragePopCmd( p_storage, p_cmd, false );
+        p_storage->i_cmd_done = __MAX( p_storage->i_cmd_done, p_storage->i_cmd_r );
+        if( !b_skip )
+            p_ts->i_cmd_date = p_cmd->i_date;
+        *pb_skip = b_skip;
+        return VLC_SUCCESS;
     }
+}
+static bool TsHasCmdLocked( ts_thread_t *p_ts )
+{
+    ts_storage_t *p_storage = p_ts->p_storage_r;
 
-    return VLC_SUCCESS;
+    return !TsStorageIsEmpty( p_storage ) || ( p_storage && p_storage->p_next );
 }
 static bool TsHasCmd( ts_thread_t *p_ts )
 {
     bool b_cmd;
 
     vlc_mutex_lock( &p_ts->lock );
-    b_cmd =  TsStorageIsEmpty( p_ts->p_storage_r );
+    b_cmd = TsHasCmdLocked( p_ts );
     vlc_mutex_unlock( &p_ts->lock );
 
     return b_cmd;
@@ -876,10 +1067,12 @@ static bool TsIsUnused( ts_thread_t *p_ts )
 {
     bool b_unused;
 
+    /* The history is kept as long as there is a window */
     vlc_mutex_lock( &p_ts->lock );
-    b_unused = !p_ts->b_paused &&
+    b_unused = p_ts->i_window <= 0 &&
+               !p_ts->b_paused &&
                p_ts->i_rate == p_ts->i_rate_source &&
-               TsStorageIsEmpty( p_ts->p_storage_r );
+               !TsHasCmdLocked( p_ts );
     vlc_mutex_unlock( &p_ts->lock );
 
     return b_unused;
@@ -934,16 +1127,101 @@ static int TsChangeRate( ts_thread_t *p_ts, int i_src_rate, int i_rate )
     return i_ret;
 }
 
+static int TsSeek( ts_thread_t *p_ts, mtime_t i_time )
+{
+    ts_storage_t *p_any = NULL, *p_key = NULL;
+    const ts_index_t *p_any_idx = NULL, *p_key_idx = NULL;
+
+    vlc_mutex_lock( &p_ts->lock );
+    if( p_ts->i_time_date < 0 )
+    {
+        vlc_mutex_unlock( &p_ts->lock );
+        return VLC_EGENERIC;
+    }
+    const mtime_t i_date = p_ts->i_time_date + i_time - p_ts->i_time;
+
+    /* Find the last seek point before the date (or the first one), and
+     * the last key frame before it */
+    for( ts_storage_t *p = p_ts->p_storage_first; p; p = p->p_next )
+    {
+        for( int i = 0; i < p->index.i_size; i++ )
+        {
+            const ts_index_t *p_idx = &p->index.p_elems[i];
+
+            if( p_any && p_idx->i_date > i_date )
+                goto found;
+
+            p_any = p;
+            p_any_idx = p_idx;
+            if( p_idx->b_key )
+            {
+                p_key = p;
+                p_key_idx = p_idx;
+            }
+        }
+    }
+found:
+    if( p_key && p_key_idx->i_date + TS_INDEX_KEY_SPAN >= p_any_idx->i_date )
+    {
+        p_any = p_key;
+        p_any_idx = p_key_idx;
+    }
+    if( !p_any )
+    {
+        vlc_mutex_unlock( &p_ts->lock );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( p_ts->p_input, "es out timeshift: seeking %"PRId64" ms, to %"PRId64" ms from live",
+             ( p_any_idx->i_date - p_ts->i_cmd_date ) / 1000,
+             ( p_any_idx->i_date - TsStorageGetDate( p_ts->p_storage_w ) ) / 1000 );
+    TsSeekLocked( p_ts, p_any, p_any_idx->i_cmd, p_any_idx->i_date );
+
+    vlc_mutex_unlock( &p_ts->lock );
+    return VLC_SUCCESS;
+}
+
+static void TsExecuteCmd( ts_thread_t *p_ts, ts_cmd_t *p_cmd, bool b_drop )
+{
+    switch( p_cmd->i_type )
+    {
+    case C_ADD:
+        CmdExecuteAdd( p_ts->p_out, p_cmd );
+        CmdCleanAdd( p_cmd );
+        break;
+    case C_SEND:
+        if( !b_drop )
+            CmdExecuteSend( p_ts->p_out, p_cmd );
+        CmdCleanSend( p_cmd );
+        break;
+    case C_CONTROL:
+        CmdExecuteControl( p_ts->p_out, p_cmd );
+        CmdCleanControl( p_cmd );
+        break;
+    case C_DEL:
+        CmdExecuteDel( p_ts->p_out, p_cmd );
+        /* The history may still refer to it */
+        TAB_APPEND( p_ts->i_es_del, p_ts->pp_es_del, p_cmd->u.del.p_es );
+        break;
+    default:
+        assert(0);
+        break;
+    }
+}
+
 static void *TsRun( void *p_data )
 {
     ts_thread_t *p_ts = p_data;
     mtime_t i_buffering_date = -1;
+    volatile unsigned i_seek = 0; /* written under vlc_cleanup_push() */
 
     for( ;; )
     {
         ts_cmd_t cmd;
         mtime_t  i_deadline;
         bool b_buffering;
+        bool b_skip;
+        bool b_drop;
 
         /* Pop a command to execute */
         vlc_mutex_lock( &p_ts->lock );
@@ -952,10 +1230,24 @@ static void *TsRun( void *p_data )
         for( ;; )
         {
             const int canc = vlc_savecancel();
+            if( i_seek != p_ts->i_seek )
+            {
+                /* Reset the decoders, the data will restart from a seek point */
+                es_out_SetTime( p_ts->p_out, -1 );
+                i_seek = p_ts->i_seek;
+                i_buffering_date = -1;
+            }
             b_buffering = es_out_GetBuffering( p_ts->p_out );
 
-            if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd, false ) )
+            if( ( !p_ts->b_paused || b_buffering ) && !TsPopCmdLocked( p_ts, &cmd, &b_skip ) )
             {
+                if( b_skip )
+                {
+                    /* Commands before the seek point are executed at once */
+                    TsExecuteCmd( p_ts, &cmd, false );
+                    vlc_restorecancel( canc );
+                    continue;
+                }
                 vlc_restorecancel( canc );
                 break;
             }
@@ -1011,41 +1303,24 @@ static void *TsRun( void *p_data )
 
             vlc_restorecancel( canc );
         }
-        i_deadline = cmd.i_date + p_ts->i_cmd_delay + p_ts->i_rate_delay + p_ts->i_buffering_delay;
-
-        vlc_cleanup_run();
 
         /* Regulate the speed of command processing to the same one than
-         * reading  */
+         * reading, until a seek makes the command obsolete */
         vlc_cleanup_push( cmd_cleanup_routine, &cmd );
 
-        mwait( i_deadline );
+        do
+            i_deadline = cmd.i_date + p_ts->i_cmd_delay + p_ts->i_rate_delay + p_ts->i_buffering_delay;
+        while( i_seek == p_ts->i_seek &&
+               !vlc_cond_timedwait( &p_ts->wait, &p_ts->lock, i_deadline ) );
+
+        b_drop = i_seek != p_ts->i_seek && cmd.i_type == C_SEND;
 
         vlc_cleanup_pop();
+        vlc_cleanup_run();
 
         /* Execute the command  */
         const int canc = vlc_savecancel();
-        switch( cmd.i_type )
-        {
-        case C_ADD:
-            CmdExecuteAdd( p_ts->p_out, &cmd );
-            CmdCleanAdd( &cmd );
-            break;
-        case C_SEND:
-            CmdExecuteSend( p_ts->p_out, &cmd );
-            CmdCleanSend( &cmd );
-            break;
-        case C_CONTROL:
-            CmdExecuteControl( p_ts->p_out, &cmd );
-            CmdCleanControl( &cmd );
-            break;
-        case C_DEL:
-            CmdExecuteDel( p_ts->p_out, &cmd );
-            break;
-        default:
-            assert(0);
-            break;
-        }
+        TsExecuteCmd( p_ts, &cmd, b_drop );
         vlc_restorecancel( canc );
     }
 
@@ -1055,7 +1330,7 @@ static void *TsRun( void *p_data )
 /*****************************************************************************
  *
  *****************************************************************************/
-static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_max )
+static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_max, int64_t i_cmd_base )
 {
     ts_storage_t *p_storage = calloc( 1, sizeof(ts_storage_t) );
     if( !p_storage )
@@ -1067,18 +1342,29 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
     /* */
     p_storage->i_file_max = i_tmp_size_max;
     p_storage->i_file_size = 0;
+    p_storage->i_file_flushed = 0;
     p_storage->p_filew = GetTmpFile( &p_storage->psz_file, psz_tmp_path );
     if( p_storage->psz_file )
         p_storage->p_filer = vlc_fopen( p_storage->psz_file, "rb" );
 
+    /* The data is written in large chunks, and flushed only when read */
+    p_storage->p_bufferw = malloc( TS_WRITE_BUFFER );
+    if( p_storage->p_filew && p_storage->p_bufferw )
+        setvbuf( p_storage->p_filew, p_storage->p_bufferw, _IOFBF, TS_WRITE_BUFFER );
+
     /* */
+    p_storage->i_cmd_base = i_cmd_base;
     p_storage->i_cmd_w = 0;
     p_storage->i_cmd_r = 0;
+    p_storage->i_cmd_done = 0;
     p_storage->i_cmd_max = 30000;
     p_storage->p_cmd = malloc( p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) );
     //fprintf( stderr, "\nSTORAGE name=%s size=%d KiB\n", p_storage->psz_file, p_storage->i_cmd_max * sizeof(*p_storage->p_cmd) /1024 );
 
-    if( !p_storage->p_cmd || !p_storage->p_filew || !p_storage->p_filer )
+    ARRAY_INIT( p_storage->index );
+
+    if( !p_storage->p_cmd || !p_storage->p_filew || !p_storage->p_filer ||
+        !p_storage->p_bufferw )
     {
         TsStorageDelete( p_storage );
         return NULL;
@@ -1087,6 +1373,8 @@ static ts_storage_t *TsStorageNew( const char *psz_tmp_path, int64_t i_tmp_size_
 }
 static void TsStorageDelete( ts_storage_t *p_storage )
 {
+    /* Clean the commands never executed */
+    p_storage->i_cmd_r = p_storage->i_cmd_done;
     while( p_storage->i_cmd_r < p_storage->i_cmd_w )
     {
         ts_cmd_t cmd;
@@ -1096,11 +1384,13 @@ static void TsStorageDelete( ts_storage_t *p_storage )
         CmdClean( &cmd );
     }
     free( p_storage->p_cmd );
+    ARRAY_RESET( p_storage->index );
 
     if( p_storage->p_filer )
         fclose( p_storage->p_filer );
     if( p_storage->p_filew )
         fclose( p_storage->p_filew );
+    free( p_storage->p_bufferw );
 
     if( p_storage->psz_file )
     {
@@ -1112,6 +1402,13 @@ static void TsStorageDelete( ts_storage_t *p_storage )
 }
 static void TsStoragePack( ts_storage_t *p_storage )
 {
+    /* Nothing more will be written */
+    fclose( p_storage->p_filew );
+    p_storage->p_filew = NULL;
+    free( p_storage->p_bufferw );
+    p_storage->p_bufferw = NULL;
+    p_storage->i_file_flushed = p_storage->i_file_size;
+
     /* Try to release a bit of memory */
     if( p_storage->i_cmd_w >= p_storage->i_cmd_max )
         return;
@@ -1137,9 +1434,11 @@ static bool TsStorageIsEmpty( ts_storage_t *p_storage )
 {
     return !p_storage || p_storage->i_cmd_r >= p_storage->i_cmd_w;
 }
-static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bool b_flush )
+static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd )
 {
     ts_cmd_t cmd = *p_cmd;
+    bool b_key = false;
+    bool b_index = false;
 
     assert( !TsStorageIsFull( p_storage, p_cmd ) );
 
@@ -1147,8 +1446,16 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
     {
         block_t *p_block = cmd.u.send.p_block;
 
+        /* Seek points: key frames when the demuxer knows them, and at
+         * regular intervals for the others */
+        const int i_index = p_storage->index.i_size;
+
+        b_key = p_block->i_flags & BLOCK_FLAG_TYPE_I;
+        b_index = b_key || i_index <= 0 ||
+            p_storage->index.p_elems[i_index-1].i_date + TS_INDEX_INTERVAL <= cmd.i_date;
+
         cmd.u.send.p_block = NULL;
-        cmd.u.send.i_offset = ftell( p_storage->p_filew );
+        cmd.u.send.i_offset = p_storage->i_file_size;
 
         if( fwrite( p_block, sizeof(*p_block), 1, p_storage->p_filew ) != 1 )
         {
@@ -1166,11 +1473,20 @@ static void TsStoragePushCmd( ts_storage_t *p_storage, const ts_cmd_t *p_cmd, bo
         }
         p_storage->i_file_size += p_block->i_buffer;
         block_Release( p_block );
+    }
+    p_storage->p_cmd[p_storage->i_cmd_w] = cmd;
 
-        if( b_flush )
-            fflush( p_storage->p_filew );
+    /* Only index a command that was stored */
+    if( b_index )
+    {
+        ts_index_t idx = {
+            .i_date = cmd.i_date,
+            .i_cmd = p_storage->i_cmd_w,
+            .b_key = b_key,
+        };
+        ARRAY_APPEND( p_storage->index, idx );
     }
-    p_storage->p_cmd[p_storage->i_cmd_w++] = cmd;
+    p_storage->i_cmd_w++;
 }
 static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_flush )
 {
@@ -1181,8 +1497,20 @@ static void TsStoragePopCmd( ts_storage_t *p_storage, ts_cmd_t *p_cmd, bool b_fl
     {
         block_t block;
 
-        if( !b_flush &&
-            !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
+        if( b_flush )
+        {
+            p_cmd->u.send.p_block = NULL;
+            return;
+        }
+
+        /* The flushed size is always at a block boundary */
+        if( p_storage->p_filew && p_cmd->u.send.i_offset >= p_storage->i_file_flushed )
+        {
+            fflush( p_storage->p_filew );
+            p_storage->i_file_flushed = p_storage->i_file_size;
+        }
+
+        if( !fseek( p_storage->p_filer, p_cmd->u.send.i_offset, SEEK_SET ) &&
             fread( &block, sizeof(block), 1, p_storage->p_filer ) == 1 )
         {
             block_t *p_block = block_Alloc( block.i_buffer );
@@ -1222,6 +1550,7 @@ static void CmdClean( ts_cmd_t *p_cmd )
         CmdCleanControl( p_cmd );
         break;
     case C_DEL:
+        free( p_cmd->u.del.p_es );
         break;
     default:
         assert(0);
@@ -1229,6 +1558,28 @@ static void CmdClean( ts_cmd_t *p_cmd )
     }
 }
 
+/* Data and clock commands, which own nothing and can be executed again */
+static bool CmdIsReplayable( const ts_cmd_t *p_cmd )
+{
+    if( p_cmd->i_type == C_SEND )
+        return true;
+    if( p_cmd->i_type != C_CONTROL )
+        return false;
+
+    switch( p_cmd->u.control.i_query )
+    {
+    case ES_OUT_SET_PCR:
+    case ES_OUT_SET_GROUP_PCR:
+    case ES_OUT_RESET_PCR:
+    case ES_OUT_SET_NEXT_DISPLAY_TIME:
+    case ES_OUT_SET_TIMES:
+    case ES_OUT_SET_JITTER:
+        return true;
+    default:
+        return false;
+    }
+}
+
 static int CmdInitAdd( ts_cmd_t *p_cmd, es_out_id_t *p_es, const es_format_t *p_fmt, bool b_copy )
 {
     p_cmd->i_type = C_ADD;
@@ -1295,7 +1646,7 @@ static void CmdExecuteDel( es_out_t *p_out, ts_cmd_t *p_cmd )
 {
     if( p_cmd->u.del.p_es->p_es )
         es_out_Del( p_out, p_cmd->u.del.p_es->p_es );
-    free( p_cmd->u.del.p_es );
+    p_cmd->u.del.p_es->p_es = NULL;
 }
 
 static int CmdInitControl( ts_cmd_t *p_cmd, int i_query, va_list args, bool b_copy )
@@ -489,6 +489,7 @@ static void Destructor( input_thread_t * p_input )
 
     vlc_gc_decref( p_input->p->p_item );
 
+    free( p_input->p->counters.p_es_latency );
     vlc_mutex_destroy( &p_input->p->counters.counters_lock );
 
     for( int i = 0; i < p_input->p->i_control; i++ )
@@ -829,13 +830,20 @@ static void InitStatistics( input_thread_t * p_input )
         INIT_COUNTER( demux_bitrate, DERIVATIVE );
         INIT_COUNTER( demux_corrupted, COUNTER );
         INIT_COUNTER( demux_discontinuity, COUNTER );
+        INIT_COUNTER( prefetch_fill, LAST );
+        INIT_COUNTER( prefetch_stall, COUNTER );
         INIT_COUNTER( played_abuffers, COUNTER );
         INIT_COUNTER( lost_abuffers, COUNTER );
         INIT_COUNTER( displayed_pictures, COUNTER );
         INIT_COUNTER( lost_pictures, COUNTER );
+        INIT_COUNTER( late_pictures, COUNTER );
+        INIT_COUNTER( pool_pictures, COUNTER );
+        INIT_COUNTER( pool_exhausted, COUNTER );
+        INIT_COUNTER( pool_used_max, LAST );
         INIT_COUNTER( decoded_audio, COUNTER );
         INIT_COUNTER( decoded_video, COUNTER );
         INIT_COUNTER( decoded_sub, COUNTER );
+        INIT_COUNTER( decoder_contention, COUNTER );
         p_input->p->counters.p_sout_send_bitrate = NULL;
         p_input->p->counters.p_sout_sent_packets = NULL;
         p_input->p->counters.p_sout_sent_bytes = NULL;
@@ -1308,13 +1316,20 @@ error:
         EXIT_COUNTER( demux_bitrate );
         EXIT_COUNTER( demux_corrupted );
         EXIT_COUNTER( demux_discontinuity );
+        EXIT_COUNTER( prefetch_fill );
+        EXIT_COUNTER( prefetch_stall );
         EXIT_COUNTER( played_abuffers );
         EXIT_COUNTER( lost_abuffers );
         EXIT_COUNTER( displayed_pictures );
         EXIT_COUNTER( lost_pictures );
+        EXIT_COUNTER( late_pictures );
+        EXIT_COUNTER( pool_pictures );
+        EXIT_COUNTER( pool_exhausted );
+        EXIT_COUNTER( pool_used_max );
         EXIT_COUNTER( decoded_audio );
         EXIT_COUNTER( decoded_video );
         EXIT_COUNTER( decoded_sub );
+        EXIT_COUNTER( decoder_contention );
 
         if( p_input->p->p_sout )
         {
@@ -1379,13 +1394,20 @@ static void End( input_thread_t * p_input )
             CL_CO( demux_bitrate );
             CL_CO( demux_corrupted );
             CL_CO( demux_discontinuity );
+            CL_CO( prefetch_fill );
+            CL_CO( prefetch_stall );
             CL_CO( played_abuffers );
             CL_CO( lost_abuffers );
             CL_CO( displayed_pictures );
             CL_CO( lost_pictures );
+            CL_CO( late_pictures );
+            CL_CO( pool_pictures );
+            CL_CO( pool_exhausted );
+            CL_CO( pool_used_max );
             CL_CO( decoded_audio) ;
             CL_CO( decoded_video );
             CL_CO( decoded_sub) ;
+            CL_CO( decoder_contention );
         }
 
         /* Close optional stream output instance */
@@ -1703,6 +1725,13 @@ static bool Control( input_thread_t *p_input,
             if( i_time < 0 )
                 i_time = 0;
 
+            /* While timeshifting, move within the recorded stream */
+            if( !es_out_SetTime( p_input->p->p_es_out, i_time ) )
+            {
+                b_force_update = true;
+                break;
+            }
+
             /* Reset the decoders states and clock sync (before calling the demuxer */
             es_out_SetTime( p_input->p->p_es_out, -1 );
 
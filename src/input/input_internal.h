@@ -141,9 +141,12 @@ struct input_thread_private_t
         counter_t *p_demux_bitrate;
         counter_t *p_demux_corrupted;
         counter_t *p_demux_discontinuity;
+        counter_t *p_prefetch_fill;
+        counter_t *p_prefetch_stall;
         counter_t *p_decoded_audio;
         counter_t *p_decoded_video;
         counter_t *p_decoded_sub;
+        counter_t *p_decoder_contention;
         counter_t *p_sout_sent_packets;
         counter_t *p_sout_sent_bytes;
         counter_t *p_sout_send_bitrate;
@@ -151,6 +154,12 @@ struct input_thread_private_t
         counter_t *p_lost_abuffers;
         counter_t *p_displayed_pictures;
         counter_t *p_lost_pictures;
+        counter_t *p_late_pictures;
+        counter_t *p_pool_pictures;
+        counter_t *p_pool_exhausted;
+        counter_t *p_pool_used_max;
+        int i_es_latency;
+        input_es_latency_t *p_es_latency; /* filled by the decoders */
         vlc_mutex_t counters_lock;
     } counters;
 
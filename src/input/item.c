@@ -427,6 +427,7 @@ void input_item_Release( input_item_t *p_item )
     if( p_item->p_stats != NULL )
     {
         vlc_mutex_destroy( &p_item->p_stats->lock );
+        free( p_item->p_stats->p_es_latency );
         free( p_item->p_stats );
     }
 
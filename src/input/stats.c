@@ -94,10 +94,13 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     st->f_demux_bitrate = stats_GetRate(input->p->counters.p_demux_bitrate);
     st->i_demux_corrupted = stats_GetTotal(input->p->counters.p_demux_corrupted);
     st->i_demux_discontinuity = stats_GetTotal(input->p->counters.p_demux_discontinuity);
+    st->i_prefetch_fill = stats_GetTotal(input->p->counters.p_prefetch_fill);
+    st->i_prefetch_stall = stats_GetTotal(input->p->counters.p_prefetch_stall);
 
     /* Decoders */
     st->i_decoded_video = stats_GetTotal(input->p->counters.p_decoded_video);
     st->i_decoded_audio = stats_GetTotal(input->p->counters.p_decoded_audio);
+    st->i_decoder_contention = stats_GetTotal(input->p->counters.p_decoder_contention);
 
     /* Sout */
     if (input->p->counters.p_sout_send_bitrate)
@@ -114,6 +117,24 @@ void stats_ComputeInputStats(input_thread_t *input, input_stats_t *st)
     /* Vouts */
     st->i_displayed_pictures = stats_GetTotal(input->p->counters.p_displayed_pictures);
     st->i_lost_pictures = stats_GetTotal(input->p->counters.p_lost_pictures);
+    st->i_late_pictures = stats_GetTotal(input->p->counters.p_late_pictures);
+    st->i_pool_pictures = stats_GetTotal(input->p->counters.p_pool_pictures);
+    st->i_pool_exhausted = stats_GetTotal(input->p->counters.p_pool_exhausted);
+    st->i_pool_used_max = stats_GetTotal(input->p->counters.p_pool_used_max);
+
+    /* Decoder latency */
+    int count = input->p->counters.i_es_latency;
+    if (count > 0)
+    {
+        input_es_latency_t *tab = realloc(st->p_es_latency,
+                                          count * sizeof (*tab));
+        if (likely(tab != NULL))
+        {
+            memcpy(tab, input->p->counters.p_es_latency, count * sizeof (*tab));
+            st->p_es_latency = tab;
+            st->i_es_latency = count;
+        }
+    }
 
     vlc_mutex_unlock(&st->lock);
     vlc_mutex_unlock(&input->p->counters.counters_lock);
@@ -127,11 +148,19 @@ void stats_ReinitInputStats( input_stats_t *p_stats )
     p_stats->i_demux_read_packets = p_stats->i_demux_read_bytes =
     p_stats->f_demux_bitrate = p_stats->f_average_demux_bitrate =
     p_stats->i_demux_corrupted = p_stats->i_demux_discontinuity =
+    p_stats->i_prefetch_fill = p_stats->i_prefetch_stall =
     p_stats->i_displayed_pictures = p_stats->i_lost_pictures =
+    p_stats->i_late_pictures =
+    p_stats->i_pool_pictures = p_stats->i_pool_exhausted =
+    p_stats->i_pool_used_max =
     p_stats->i_played_abuffers = p_stats->i_lost_abuffers =
     p_stats->i_decoded_video = p_stats->i_decoded_audio =
+    p_stats->i_decoder_contention =
     p_stats->i_sent_bytes = p_stats->i_sent_packets = p_stats->f_send_bitrate
      = 0;
+    free( p_stats->p_es_latency );
+    p_stats->p_es_latency = NULL;
+    p_stats->i_es_latency = 0;
     vlc_mutex_unlock( &p_stats->lock );
 }
 
@@ -187,6 +216,7 @@ void stats_Update( counter_t *p_counter, uint64_t val, uint64_t *new_val )
         }
         break;
     }
+    case STATS_LAST:
     case STATS_COUNTER:
         if( p_counter->i_samples == 0 )
         {
@@ -199,7 +229,10 @@ void stats_Update( counter_t *p_counter, uint64_t val, uint64_t *new_val )
         }
         if( p_counter->i_samples == 1 )
         {
-            p_counter->pp_samples[0]->value += val;
+            if( p_counter->i_compute_type == STATS_LAST )
+                p_counter->pp_samples[0]->value = val;
+            else
+                p_counter->pp_samples[0]->value += val;
             if( new_val )
                 *new_val = p_counter->pp_samples[0]->value;
         }
@@ -95,6 +95,21 @@
 #define STREAM_READ_ATONCE 1024
 #define STREAM_CACHE_TRACK_SIZE (STREAM_CACHE_SIZE/STREAM_CACHE_TRACK)
 
+/* Method3: Prefetch, for pf_read when --stream-prefetch is set
+ *  - A reader thread fills one large ring buffer ahead of i_pos, so that
+ *    access stalls are absorbed instead of stalling the demuxer.
+ *  - A quarter of the ring keeps data behind i_pos: seeking back into it,
+ *    or forward into already fetched data, does not touch the access.
+ *  - Other seeks drop the ring and are forwarded to the reader thread.
+ *  - All access calls that could race with pf_read go through the reader
+ *    thread, or wait for it to be idle (see AStreamPrefetchHold).
+ */
+#define STREAM_PREFETCH_MIN_SIZE (1024*1024)
+#define STREAM_PREFETCH_READ     (64*1024)
+#define STREAM_PREFETCH_RETRY    50 /* Read errors before giving up */
+
+#define STREAM_DATA_WAIT 40000 /* Time between two read retries */
+
 typedef struct
 {
     int64_t i_date;
@@ -116,7 +131,8 @@ typedef struct
 typedef enum
 {
     STREAM_METHOD_BLOCK,
-    STREAM_METHOD_STREAM
+    STREAM_METHOD_STREAM,
+    STREAM_METHOD_PREFETCH
 } stream_read_method_t;
 
 struct stream_sys_t
@@ -156,6 +172,39 @@ struct stream_sys_t
 
     } stream;
 
+    /* Method 3: for pf_read, from a reader thread */
+    struct
+    {
+        vlc_thread_t thread;
+        vlc_mutex_t  lock;
+        vlc_cond_t   wait_data;  /* signaled by the reader thread */
+        vlc_cond_t   wait_space; /* signaled by the stream user */
+
+        uint8_t  *p_buffer;  /* Ring buffer */
+        size_t    i_size;
+        size_t    i_history; /* Space kept for data behind i_pos */
+        uint64_t  i_start;   /* Offset of the oldest valid data */
+        uint64_t  i_end;     /* Offset of the next data to fetch */
+
+        uint64_t  i_seek;    /* Pending access seek (if b_seek) */
+        uint64_t  i_stream_size; /* Access size after the last read */
+        int       i_pause;   /* Pending pause state, or -1 */
+        bool      b_seek;
+        bool      b_paused;
+        bool      b_starving; /* The stream user waits for data */
+        bool      b_hold;     /* The access is reserved by the stream user */
+        bool      b_busy;     /* The reader thread is using the access */
+        bool      b_eof;
+        bool      b_exit;
+        int       i_error;    /* Read errors in a row */
+
+        /* Access capabilities, queried once the thread runs */
+        bool      b_can_seek;
+        bool      b_can_pause;
+        bool      b_can_pace;
+
+    } prefetch;
+
     /* Peek temporary buffer */
     unsigned int i_peek;
     uint8_t *p_peek;
@@ -197,6 +246,15 @@ static int  AStreamSeekStream( stream_t *s, uint64_t i_pos );
 static void AStreamPrebufferStream( stream_t *s );
 static int  AReadStream( stream_t *s, void *p_read, unsigned int i_read );
 
+/* Method 3 */
+static int  AStreamReadPrefetch( stream_t *s, void *p_read, unsigned int i_read );
+static int  AStreamPeekPrefetch( stream_t *s, const uint8_t **pp_peek, unsigned int i_read );
+static int  AStreamSeekPrefetch( stream_t *s, uint64_t i_pos );
+static int  AStreamStartPrefetch( stream_t *s, size_t i_size );
+static void AStreamStopPrefetch( stream_t *s );
+static void AStreamPrefetchHold( stream_t *s );
+static void AStreamPrefetchRelease( stream_t *s );
+
 /* Common */
 static int AStreamControl( stream_t *s, int i_query, va_list );
 static void AStreamDestroy( stream_t *s );
@@ -292,8 +350,11 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
 
     /* Common field */
     p_sys->p_access = p_access;
+    int64_t i_prefetch = var_InheritInteger( p_access, "stream-prefetch" );
     if( p_access->pf_block )
         p_sys->method = STREAM_METHOD_BLOCK;
+    else if( i_prefetch > 0 )
+        p_sys->method = STREAM_METHOD_PREFETCH;
     else
         p_sys->method = STREAM_METHOD_STREAM;
 
@@ -382,6 +443,20 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
             goto error;
         }
     }
+    else if( p_sys->method == STREAM_METHOD_PREFETCH )
+    {
+        msg_Dbg( s, "Using prefetch method for AStream*" );
+
+        s->pf_read = AStreamReadPrefetch;
+        s->pf_peek = AStreamPeekPrefetch;
+
+        /* Start the reader thread and do the prebuffering */
+        if( AStreamStartPrefetch( s, i_prefetch * 1024 ) )
+        {
+            msg_Err( s, "cannot pre fill buffer" );
+            goto error;
+        }
+    }
     else
     {
         int i;
@@ -427,11 +502,7 @@ stream_t *stream_AccessNew( access_t *p_access, char **ppsz_list )
     return s;
 
 error:
-    if( p_sys->method == STREAM_METHOD_BLOCK )
-    {
-        /* Nothing yet */
-    }
-    else
+    if( p_sys->method == STREAM_METHOD_STREAM )
     {
         free( p_sys->stream.p_buffer );
     }
@@ -453,6 +524,8 @@ static void AStreamDestroy( stream_t *s )
 
     if( p_sys->method == STREAM_METHOD_BLOCK )
         block_ChainRelease( p_sys->block.p_first );
+    else if( p_sys->method == STREAM_METHOD_PREFETCH )
+        AStreamStopPrefetch( s );
     else
         free( p_sys->stream.p_buffer );
 
@@ -497,6 +570,17 @@ static void AStreamControlReset( stream_t *s )
         /* Do the prebuffering */
         AStreamPrebufferBlock( s );
     }
+    else if( p_sys->method == STREAM_METHOD_PREFETCH )
+    {
+        /* The reader thread is held: restart from the new access position */
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        p_sys->prefetch.i_start = p_sys->i_pos;
+        p_sys->prefetch.i_end   = p_sys->i_pos;
+        p_sys->prefetch.b_seek  = false;
+        p_sys->prefetch.b_eof   = false;
+        p_sys->prefetch.i_error = 0;
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+    }
     else
     {
         int i;
@@ -568,6 +652,82 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
     static_control_match(SET_PRIVATE_ID_CA);
     static_control_match(GET_PRIVATE_ID_STATE);
 
+    if( p_sys->method == STREAM_METHOD_PREFETCH )
+    {
+        /* Keep the access out of reach of the reader thread */
+        switch( i_query )
+        {
+            case STREAM_CAN_SEEK:
+                *va_arg( args, bool * ) = p_sys->prefetch.b_can_seek;
+                return VLC_SUCCESS;
+            case STREAM_CAN_FASTSEEK:
+                *va_arg( args, bool * ) = p_sys->stat.b_fastseek;
+                return VLC_SUCCESS;
+            case STREAM_CAN_PAUSE:
+                *va_arg( args, bool * ) = p_sys->prefetch.b_can_pause;
+                return VLC_SUCCESS;
+            case STREAM_CAN_CONTROL_PACE:
+                *va_arg( args, bool * ) = p_sys->prefetch.b_can_pace;
+                return VLC_SUCCESS;
+
+            case STREAM_SET_PAUSE_STATE:
+            {
+                bool b_pause = (bool)va_arg( args, int );
+
+                if( !p_sys->prefetch.b_can_pause )
+                    return VLC_EGENERIC;
+                /* Applied by the reader thread in between two reads */
+                vlc_mutex_lock( &p_sys->prefetch.lock );
+                p_sys->prefetch.i_pause = b_pause;
+                vlc_cond_signal( &p_sys->prefetch.wait_space );
+                vlc_mutex_unlock( &p_sys->prefetch.lock );
+                return VLC_SUCCESS;
+            }
+
+            case STREAM_GET_PTS_DELAY:
+            case STREAM_GET_TITLE_INFO:
+            case STREAM_GET_TITLE:
+            case STREAM_GET_SEEKPOINT:
+            case STREAM_GET_META:
+            case STREAM_GET_CONTENT_TYPE:
+            case STREAM_GET_SIGNAL:
+            case STREAM_SET_PRIVATE_ID_STATE:
+            case STREAM_SET_PRIVATE_ID_CA:
+            case STREAM_GET_PRIVATE_ID_STATE:
+            {
+                AStreamPrefetchHold( s );
+                int ret = access_vaControl( p_access, i_query, args );
+                AStreamPrefetchRelease( s );
+                return ret;
+            }
+
+            case STREAM_SET_TITLE:
+            case STREAM_SET_SEEKPOINT:
+            {
+                AStreamPrefetchHold( s );
+                int ret = access_vaControl( p_access, i_query, args );
+                if( ret == VLC_SUCCESS )
+                    AStreamControlReset( s );
+                AStreamPrefetchRelease( s );
+                return ret;
+            }
+
+            case STREAM_GET_SIZE:
+                /* The access updates its size while the thread reads */
+                vlc_mutex_lock( &p_sys->prefetch.lock );
+                *va_arg( args, uint64_t * ) = p_sys->prefetch.i_stream_size;
+                vlc_mutex_unlock( &p_sys->prefetch.lock );
+                return VLC_SUCCESS;
+
+            case STREAM_UPDATE_SIZE:
+                /* The access position is ahead of the stream position */
+                return VLC_SUCCESS;
+
+            default:
+                break;
+        }
+    }
+
     switch( i_query )
     {
         case STREAM_CAN_SEEK:
@@ -615,6 +775,8 @@ static int AStreamControl( stream_t *s, int i_query, va_list args )
                 return AStreamSeekBlock( s, offset );
             case STREAM_METHOD_STREAM:
                 return AStreamSeekStream( s, offset );
+            case STREAM_METHOD_PREFETCH:
+                return AStreamSeekPrefetch( s, offset );
             default:
                 assert(0);
                 return VLC_EGENERIC;
@@ -1455,6 +1617,455 @@ static void AStreamPrebufferStream( stream_t *s )
     }
 }
 
+/****************************************************************************
+ * Method 3:
+ ****************************************************************************/
+static void AStreamPrefetchStats( stream_t *s, uint64_t i_fill,
+                                  mtime_t i_stall )
+{
+    input_thread_t *p_input = s->p_input;
+
+    if( !p_input )
+        return;
+
+    vlc_mutex_lock( &p_input->p->counters.counters_lock );
+    stats_Update( p_input->p->counters.p_prefetch_fill, i_fill, NULL );
+    if( i_stall > 0 )
+        stats_Update( p_input->p->counters.p_prefetch_stall, i_stall, NULL );
+    vlc_mutex_unlock( &p_input->p->counters.counters_lock );
+}
+
+/* Must be called with the lock held */
+static uint64_t AStreamPrefetchAhead( stream_sys_t *p_sys )
+{
+    if( p_sys->prefetch.b_seek || p_sys->i_pos >= p_sys->prefetch.i_end )
+        return 0;
+    return p_sys->prefetch.i_end - p_sys->i_pos;
+}
+
+/* Must be called by the reader thread with the lock held, or before it runs */
+static void AStreamPrefetchUpdateSize( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    if( p_sys->i_list )
+    {
+        p_sys->prefetch.i_stream_size = 0;
+        for( int i = 0; i < p_sys->i_list; i++ )
+            p_sys->prefetch.i_stream_size += p_sys->list[i]->i_size;
+    }
+    else
+        p_sys->prefetch.i_stream_size = access_GetSize( p_sys->p_access );
+}
+
+static void *AStreamPrefetchThread( void *data )
+{
+    stream_t *s = data;
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    while( !p_sys->prefetch.b_exit )
+    {
+        if( p_sys->prefetch.b_hold )
+        {
+            vlc_cond_wait( &p_sys->prefetch.wait_space, &p_sys->prefetch.lock );
+            continue;
+        }
+
+        if( p_sys->prefetch.i_pause >= 0 )
+        {
+            bool b_pause = p_sys->prefetch.i_pause;
+
+            p_sys->prefetch.i_pause = -1;
+            p_sys->prefetch.b_busy = true;
+            vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+            access_Control( p_sys->p_access, ACCESS_SET_PAUSE_STATE, b_pause );
+
+            vlc_mutex_lock( &p_sys->prefetch.lock );
+            p_sys->prefetch.b_busy = false;
+            p_sys->prefetch.b_paused = b_pause;
+            vlc_cond_broadcast( &p_sys->prefetch.wait_data );
+            continue;
+        }
+
+        if( p_sys->prefetch.b_seek )
+        {
+            const uint64_t i_pos = p_sys->prefetch.i_seek;
+
+            p_sys->prefetch.b_seek = false;
+            p_sys->prefetch.b_busy = true;
+            vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+            const mtime_t i_start = mdate();
+            int i_ret = ASeek( s, i_pos );
+            const mtime_t i_stop = mdate();
+
+            vlc_mutex_lock( &p_sys->prefetch.lock );
+            p_sys->prefetch.b_busy = false;
+            AStreamPrefetchUpdateSize( s );
+            p_sys->stat.i_seek_count++;
+            p_sys->stat.i_seek_time += i_stop - i_start;
+            if( i_ret && !p_sys->prefetch.b_seek )
+            {
+                /* Reported as EOF: the stream user has already moved on */
+                msg_Err( s, "cannot seek to %"PRIu64, i_pos );
+                p_sys->prefetch.b_eof = true;
+            }
+            vlc_cond_broadcast( &p_sys->prefetch.wait_data );
+            continue;
+        }
+
+        const uint64_t i_ahead = AStreamPrefetchAhead( p_sys );
+        const size_t i_max = p_sys->prefetch.i_size - p_sys->prefetch.i_history;
+
+        if( p_sys->prefetch.b_eof || i_ahead >= i_max ||
+            ( p_sys->prefetch.b_paused && !p_sys->prefetch.b_starving ) )
+        {
+            vlc_cond_wait( &p_sys->prefetch.wait_space, &p_sys->prefetch.lock );
+            continue;
+        }
+
+        if( !vlc_object_alive( s ) )
+        {
+            /* Reported as EOF, so that the stream user stops waiting */
+            p_sys->prefetch.b_eof = true;
+            vlc_cond_broadcast( &p_sys->prefetch.wait_data );
+            continue;
+        }
+
+        const size_t i_off = p_sys->prefetch.i_end % p_sys->prefetch.i_size;
+        size_t i_len = __MIN( STREAM_PREFETCH_READ, i_max - i_ahead );
+        i_len = __MIN( i_len, p_sys->prefetch.i_size - i_off );
+
+        /* Drop the oldest data before it gets overwritten */
+        if( p_sys->prefetch.i_end + i_len >
+            p_sys->prefetch.i_start + p_sys->prefetch.i_size )
+            p_sys->prefetch.i_start =
+                p_sys->prefetch.i_end + i_len - p_sys->prefetch.i_size;
+
+        p_sys->prefetch.b_busy = true;
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        const mtime_t i_start = mdate();
+        int i_read = AReadStream( s, &p_sys->prefetch.p_buffer[i_off], i_len );
+        const mtime_t i_stop = mdate();
+
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        p_sys->prefetch.b_busy = false;
+        AStreamPrefetchUpdateSize( s );
+        vlc_cond_broadcast( &p_sys->prefetch.wait_data );
+
+        if( p_sys->prefetch.b_seek )
+            continue; /* The data belong to the previous position */
+
+        if( i_read > 0 )
+        {
+            p_sys->prefetch.i_end += i_read;
+            p_sys->stat.i_bytes += i_read;
+            p_sys->stat.i_read_count++;
+            p_sys->stat.i_read_time += i_stop - i_start;
+
+            p_sys->prefetch.i_error = 0;
+
+            AStreamPrefetchStats( s, AStreamPrefetchAhead( p_sys ), 0 );
+        }
+        else if( i_read == 0 || p_sys->prefetch.b_exit ||
+                 !vlc_object_alive( s ) ||
+                 ++p_sys->prefetch.i_error >= STREAM_PREFETCH_RETRY )
+        {
+            if( i_read < 0 )
+                msg_Err( s, "cannot read from the access" );
+            p_sys->prefetch.b_eof = true;
+            vlc_cond_broadcast( &p_sys->prefetch.wait_data );
+        }
+        else
+        {
+            /* Do not spin on a transient error */
+            vlc_cond_timedwait( &p_sys->prefetch.wait_space,
+                                &p_sys->prefetch.lock,
+                                mdate() + STREAM_DATA_WAIT );
+        }
+    }
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+    return NULL;
+}
+
+/* Waits until i_want bytes are available at i_pos, or the end of the stream.
+ * Must be called with the lock held. Returns the number of bytes available */
+static size_t AStreamPrefetchWait( stream_t *s, size_t i_want )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    uint64_t i_ahead = AStreamPrefetchAhead( p_sys );
+    mtime_t i_start = 0;
+
+    while( i_ahead < i_want &&
+           ( p_sys->prefetch.b_seek || !p_sys->prefetch.b_eof ) )
+    {
+        if( i_start == 0 )
+        {
+            i_start = mdate();
+            p_sys->prefetch.b_starving = true;
+            vlc_cond_signal( &p_sys->prefetch.wait_space );
+        }
+        /* The reader thread may be stuck in a killed access */
+        if( !vlc_object_alive( s ) )
+            break;
+        vlc_cond_timedwait( &p_sys->prefetch.wait_data, &p_sys->prefetch.lock,
+                            mdate() + STREAM_DATA_WAIT );
+        i_ahead = AStreamPrefetchAhead( p_sys );
+    }
+
+    if( i_start != 0 )
+    {
+        p_sys->prefetch.b_starving = false;
+        AStreamPrefetchStats( s, i_ahead, mdate() - i_start );
+    }
+    return i_ahead;
+}
+
+static int AStreamReadPrefetch( stream_t *s, void *p_read, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    uint8_t *p_data = p_read;
+    unsigned int i_data = 0;
+
+    if( !p_read )
+    {
+        uint64_t i_pos_wanted = p_sys->i_pos + i_read;
+
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+        if( p_sys->prefetch.b_eof && !p_sys->prefetch.b_seek &&
+            i_pos_wanted > p_sys->prefetch.i_end )
+        {
+            /* Do not skip past the known end of the stream */
+            i_pos_wanted = __MAX( p_sys->i_pos, p_sys->prefetch.i_end );
+            i_read = i_pos_wanted - p_sys->i_pos;
+        }
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        if( AStreamSeekPrefetch( s, i_pos_wanted ) )
+            return 0;
+        return i_read;
+    }
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    while( i_data < i_read )
+    {
+        size_t i_ahead = AStreamPrefetchWait( s, 1 );
+        if( i_ahead == 0 )
+            break; /* EOF */
+
+        const size_t i_off = p_sys->i_pos % p_sys->prefetch.i_size;
+        size_t i_copy = __MIN( i_ahead, i_read - i_data );
+        i_copy = __MIN( i_copy, p_sys->prefetch.i_size - i_off );
+
+        /* The reader thread never overwrites data at or after i_pos */
+        vlc_mutex_unlock( &p_sys->prefetch.lock );
+        memcpy( p_data, &p_sys->prefetch.p_buffer[i_off], i_copy );
+        vlc_mutex_lock( &p_sys->prefetch.lock );
+
+        p_data += i_copy;
+        i_data += i_copy;
+        p_sys->i_pos += i_copy;
+    }
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    return i_data;
+}
+
+static int AStreamPeekPrefetch( stream_t *s, const uint8_t **pp_peek, unsigned int i_read )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    const size_t i_max = p_sys->prefetch.i_size - p_sys->prefetch.i_history;
+
+    if( i_read > i_max )
+        i_read = i_max;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    size_t i_ahead = AStreamPrefetchWait( s, i_read );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    if( i_read > i_ahead )
+        i_read = i_ahead;
+    if( i_read == 0 )
+        return 0; /* EOF */
+
+    /* Now, direct pointer or a copy ? */
+    const size_t i_off = p_sys->i_pos % p_sys->prefetch.i_size;
+    if( i_off + i_read <= p_sys->prefetch.i_size )
+    {
+        *pp_peek = &p_sys->prefetch.p_buffer[i_off];
+        return i_read;
+    }
+
+    if( p_sys->i_peek < i_read )
+    {
+        p_sys->p_peek = realloc_or_free( p_sys->p_peek, i_read );
+        if( !p_sys->p_peek )
+        {
+            p_sys->i_peek = 0;
+            return 0;
+        }
+        p_sys->i_peek = i_read;
+    }
+
+    const size_t i_first = p_sys->prefetch.i_size - i_off;
+    memcpy( p_sys->p_peek, &p_sys->prefetch.p_buffer[i_off], i_first );
+    memcpy( &p_sys->p_peek[i_first], p_sys->prefetch.p_buffer,
+            i_read - i_first );
+
+    *pp_peek = p_sys->p_peek;
+    return i_read;
+}
+
+static int AStreamSeekPrefetch( stream_t *s, uint64_t i_pos )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    /* Reading through is cheaper than seeking a slow access */
+    const uint64_t i_skip_threshold =
+        p_sys->stat.b_fastseek ? 0 : STREAM_PREFETCH_READ;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    if( !p_sys->prefetch.b_seek && p_sys->prefetch.i_start <= i_pos &&
+        i_pos <= p_sys->prefetch.i_end + i_skip_threshold )
+    {
+        /* Already fetched, or about to be */
+    }
+    else if( !p_sys->prefetch.b_can_seek )
+    {
+        if( i_pos < p_sys->prefetch.i_start )
+        {
+            vlc_mutex_unlock( &p_sys->prefetch.lock );
+            msg_Warn( s, "AStreamSeekPrefetch: can't seek" );
+            return VLC_EGENERIC;
+        }
+        /* The reader thread will read through */
+    }
+    else
+    {
+        /* Drop everything and let the reader thread seek the access */
+        p_sys->prefetch.i_seek  = i_pos;
+        p_sys->prefetch.b_seek  = true;
+        p_sys->prefetch.i_start = i_pos;
+        p_sys->prefetch.i_end   = i_pos;
+        p_sys->prefetch.b_eof   = false;
+        p_sys->prefetch.i_error = 0;
+    }
+    p_sys->i_pos = i_pos;
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    return VLC_SUCCESS;
+}
+
+/* Waits for the reader thread to leave the access alone */
+static void AStreamPrefetchHold( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    p_sys->prefetch.b_hold = true;
+    while( p_sys->prefetch.b_busy )
+        vlc_cond_wait( &p_sys->prefetch.wait_data, &p_sys->prefetch.lock );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+}
+
+static void AStreamPrefetchRelease( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    p_sys->prefetch.b_hold = false;
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+}
+
+static int AStreamStartPrefetch( stream_t *s, size_t i_size )
+{
+    stream_sys_t *p_sys = s->p_sys;
+    access_t *p_access = p_sys->p_access;
+
+    if( i_size < STREAM_PREFETCH_MIN_SIZE )
+        i_size = STREAM_PREFETCH_MIN_SIZE;
+
+    p_sys->prefetch.p_buffer = malloc( i_size );
+    if( p_sys->prefetch.p_buffer == NULL )
+        return VLC_ENOMEM;
+    p_sys->prefetch.i_size    = i_size;
+    p_sys->prefetch.i_history = i_size / 4;
+    p_sys->prefetch.i_start   = p_sys->i_pos;
+    p_sys->prefetch.i_end     = p_sys->i_pos;
+    p_sys->prefetch.i_seek    = 0;
+    p_sys->prefetch.i_pause   = -1;
+    p_sys->prefetch.b_seek    = false;
+    p_sys->prefetch.b_paused  = false;
+    p_sys->prefetch.b_starving = false;
+    p_sys->prefetch.b_hold    = false;
+    p_sys->prefetch.b_busy    = false;
+    p_sys->prefetch.b_eof     = false;
+    p_sys->prefetch.i_error   = 0;
+    p_sys->prefetch.b_exit    = false;
+    AStreamPrefetchUpdateSize( s );
+
+    access_Control( p_access, ACCESS_CAN_SEEK, &p_sys->prefetch.b_can_seek );
+    access_Control( p_access, ACCESS_CAN_PAUSE, &p_sys->prefetch.b_can_pause );
+    access_Control( p_access, ACCESS_CAN_CONTROL_PACE,
+                    &p_sys->prefetch.b_can_pace );
+
+    vlc_mutex_init( &p_sys->prefetch.lock );
+    vlc_cond_init( &p_sys->prefetch.wait_data );
+    vlc_cond_init( &p_sys->prefetch.wait_space );
+
+    if( vlc_clone( &p_sys->prefetch.thread, AStreamPrefetchThread, s,
+                   VLC_THREAD_PRIORITY_INPUT ) )
+    {
+        vlc_cond_destroy( &p_sys->prefetch.wait_space );
+        vlc_cond_destroy( &p_sys->prefetch.wait_data );
+        vlc_mutex_destroy( &p_sys->prefetch.lock );
+        free( p_sys->prefetch.p_buffer );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( s, "starting pre-buffering (%zu KiB prefetch)", i_size / 1024 );
+    const mtime_t i_start = mdate();
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    size_t i_buffered = AStreamPrefetchWait( s, STREAM_CACHE_PREBUFFER_SIZE );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    if( i_buffered == 0 )
+    {
+        AStreamStopPrefetch( s );
+        return VLC_EGENERIC;
+    }
+
+    msg_Dbg( s, "pre-buffering done %zu bytes in %"PRId64" ms",
+             i_buffered, (mdate() - i_start) / 1000 );
+    return VLC_SUCCESS;
+}
+
+static void AStreamStopPrefetch( stream_t *s )
+{
+    stream_sys_t *p_sys = s->p_sys;
+
+    vlc_mutex_lock( &p_sys->prefetch.lock );
+    p_sys->prefetch.b_exit = true;
+    vlc_cond_signal( &p_sys->prefetch.wait_space );
+    vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+    /* Interrupt a blocking read, the access is going away anyway */
+    ObjectKillChildrens( VLC_OBJECT(p_sys->p_access) );
+    vlc_join( p_sys->prefetch.thread, NULL );
+
+    vlc_cond_destroy( &p_sys->prefetch.wait_space );
+    vlc_cond_destroy( &p_sys->prefetch.wait_data );
+    vlc_mutex_destroy( &p_sys->prefetch.lock );
+    free( p_sys->prefetch.p_buffer );
+}
+
 /****************************************************************************
  * stream_ReadLine:
  ****************************************************************************/
@@ -1678,7 +2289,16 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
     /* If we reached an EOF then switch to the next stream in the list */
     if( i_read == 0 && p_sys->i_list_index + 1 < p_sys->i_list )
     {
+        /* With prefetching, this runs on the reader thread: the current
+         * access of the list only changes under the prefetch lock */
+        const bool b_lock = p_sys->method == STREAM_METHOD_PREFETCH;
+
+        if( b_lock )
+            vlc_mutex_lock( &p_sys->prefetch.lock );
         char *psz_name = p_sys->list[++p_sys->i_list_index]->psz_path;
+        if( b_lock )
+            vlc_mutex_unlock( &p_sys->prefetch.lock );
+
         access_t *p_list_access;
 
         msg_Dbg( s, "opening input `%s'", psz_name );
@@ -1687,10 +2307,15 @@ static int AReadStream( stream_t *s, void *p_read, unsigned int i_read )
 
         if( !p_list_access ) return 0;
 
-        if( p_sys->p_list_access != p_access )
-            access_Delete( p_sys->p_list_access );
-
+        if( b_lock )
+            vlc_mutex_lock( &p_sys->prefetch.lock );
+        access_t *p_old = p_sys->p_list_access;
         p_sys->p_list_access = p_list_access;
+        if( b_lock )
+            vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        if( p_old != p_access )
+            access_Delete( p_old );
 
         /* We have to read some data */
         return AReadStream( s, p_read, i_read_orig );
@@ -1725,13 +2350,16 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         if( p_input && p_block && libvlc_stats (p_access) )
         {
             uint64_t total;
+            size_t i_size;
+            int i_count;
 
+            /* Accesses may return a chain of packets */
+            block_ChainProperties( p_block, &i_count, &i_size, NULL );
             vlc_mutex_lock( &p_input->p->counters.counters_lock );
-            stats_Update( p_input->p->counters.p_read_bytes,
-                          p_block->i_buffer, &total );
+            stats_Update( p_input->p->counters.p_read_bytes, i_size, &total );
             stats_Update( p_input->p->counters.p_input_bitrate,
                           total, NULL );
-            stats_Update( p_input->p->counters.p_read_packets, 1, NULL );
+            stats_Update( p_input->p->counters.p_read_packets, i_count, NULL );
             vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
         return p_block;
@@ -1766,12 +2394,14 @@ static block_t *AReadBlock( stream_t *s, bool *pb_eof )
         if( p_input )
         {
             uint64_t total;
+            size_t i_size;
+            int i_count;
 
+            block_ChainProperties( p_block, &i_count, &i_size, NULL );
             vlc_mutex_lock( &p_input->p->counters.counters_lock );
-            stats_Update( p_input->p->counters.p_read_bytes,
-                          p_block->i_buffer, &total );
+            stats_Update( p_input->p->counters.p_read_bytes, i_size, &total );
             stats_Update( p_input->p->counters.p_input_bitrate, total, NULL );
-            stats_Update( p_input->p->counters.p_read_packets, 1 , NULL);
+            stats_Update( p_input->p->counters.p_read_packets, i_count, NULL );
             vlc_mutex_unlock( &p_input->p->counters.counters_lock );
         }
     }
@@ -1811,15 +2441,24 @@ static int ASeek( stream_t *s, uint64_t i_pos )
             p_list_access = p_access;
         }
 
+        /* See AReadStream() */
+        const bool b_lock = p_sys->method == STREAM_METHOD_PREFETCH;
+        access_t *p_old = NULL;
+
+        if( b_lock )
+            vlc_mutex_lock( &p_sys->prefetch.lock );
         if( p_list_access )
         {
-            if( p_sys->p_list_access != p_access )
-                access_Delete( p_sys->p_list_access );
-
+            p_old = p_sys->p_list_access;
             p_sys->p_list_access = p_list_access;
         }
-
         p_sys->i_list_index = i;
+        if( b_lock )
+            vlc_mutex_unlock( &p_sys->prefetch.lock );
+
+        if( p_old != NULL && p_old != p_access )
+            access_Delete( p_old );
+
         return p_sys->p_list_access->pf_seek( p_sys->p_list_access,
                                               i_pos - i_size );
     }
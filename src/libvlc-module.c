@@ -386,6 +386,11 @@ static const char *const ppsz_pos_descriptions[] =
     "picture quality, for instance deinterlacing, or distort " \
     "the video.")
 
+#define FILTER_THREADS_TEXT N_("Video filter threads")
+#define FILTER_THREADS_LONGTEXT N_( \
+    "Number of threads sharing the work of video filters that can process " \
+    "a picture in slices (0 = number of CPU cores, 1 = no threading).")
+
 #define SNAP_PATH_TEXT N_("Video snapshot directory (or filename)")
 #define SNAP_PATH_LONGTEXT N_( \
     "Directory where the video snapshots will be stored.")
@@ -475,6 +480,12 @@ static const char *const ppsz_pos_descriptions[] =
     "This drops frames that are late (arrive to the video output after " \
     "their intended display date)." )
 
+#define LOOKAHEAD_TEXT N_("Video filtering lookahead")
+#define LOOKAHEAD_LONGTEXT N_( \
+    "Number of pictures run through the deinterlacing and post-processing " \
+    "filters ahead of their display date, on a separate thread " \
+    "(0 disables it).")
+
 #define QUIET_SYNCHRO_TEXT N_("Quiet synchro")
 #define QUIET_SYNCHRO_LONGTEXT N_( \
     "This avoids flooding the message log with debug output from the " \
@@ -514,6 +525,12 @@ static const char *const ppsz_pos_descriptions[] =
 #define NETWORK_CACHING_LONGTEXT N_( \
     "Caching value for network resources, in milliseconds." )
 
+#define PREFETCH_TEXT N_("Stream prefetch buffer size (KiB)")
+#define PREFETCH_LONGTEXT N_( \
+    "Size of the buffer filled ahead of the demuxer by a separate reader " \
+    "thread, in kibibytes. This hides the stalls of slow or jittery " \
+    "accesses such as network shares. 0 reads synchronously." )
+
 #define CR_AVERAGE_TEXT N_("Clock reference average counter")
 #define CR_AVERAGE_LONGTEXT N_( \
     "When using the PVR input (or a very irregular source), you should " \
@@ -682,6 +699,19 @@ static const char *const ppsz_prefres[] = {
     "This is the maximum size in bytes of the temporary files " \
     "that will be used to store the timeshifted streams." )
 
+#define INPUT_TIMESHIFT_WINDOW_TEXT N_("Timeshift window")
+#define INPUT_TIMESHIFT_WINDOW_LONGTEXT N_( \
+    "Duration in seconds of already played stream kept to seek back in " \
+    "live streams. When set, the streams are recorded from the start " \
+    "instead of from the first pause. Old data is dropped a whole " \
+    "temporary file at a time. 0 keeps nothing once played." )
+
+#define INPUT_TIMESHIFT_SIZE_TEXT N_("Timeshift maximum size")
+#define INPUT_TIMESHIFT_SIZE_LONGTEXT N_( \
+    "Maximum size in MiB of all the timeshift temporary files. When it " \
+    "is reached, the oldest data is dropped, even if not played yet. " \
+    "0 means no limit." )
+
 #define INPUT_TITLE_FORMAT_TEXT N_( "Change title according to current media" )
 #define INPUT_TITLE_FORMAT_LONGTEXT N_( "This option allows you to set the title according to what's being played<br>"  \
     "$a: Artist<br>$b: Album<br>$c: Copyright<br>$t: Title<br>$g: Genre<br>"  \
@@ -829,6 +859,16 @@ static const char *const ppsz_prefres[] = {
     "However allocation of port numbers below 1025 is usually restricted " \
     "by the operating system." )
 
+#define HTTP_DROP_SLOW_TEXT N_("Disconnect slow HTTP stream clients")
+#define HTTP_DROP_SLOW_LONGTEXT N_( \
+    "Clients that fall behind the HTTP server stream buffer are normally " \
+    "skipped ahead to live data. Disconnect them instead." )
+
+#define HTTP_THREADS_TEXT N_("HTTP server threads")
+#define HTTP_THREADS_LONGTEXT N_( \
+    "Number of threads serving the clients of each HTTP host. " \
+    "0 means one per CPU core." )
+
 #define HTTP_CERT_TEXT N_("HTTP/TLS server certificate")
 #define CERT_LONGTEXT N_( \
    "This X.509 certicate file (PEM format) is used for server-side TLS." )
@@ -1047,6 +1087,11 @@ static const char *const ppsz_prefres[] = {
 #define STATS_LONGTEXT N_( \
      "Collect miscellaneous local statistics about the playing media.")
 
+#define LATENCY_STATS_TEXT N_("Collect decoder latency statistics")
+#define LATENCY_STATS_LONGTEXT N_( \
+     "Collect per track histograms of the time spent by the data in the " \
+     "decoder queue, in the decoder and waiting for display.")
+
 #define DAEMON_TEXT N_("Run as daemon process")
 #define DAEMON_LONGTEXT N_( \
      "Runs VLC as a background daemon process.")
@@ -1526,6 +1571,8 @@ vlc_module_begin ()
         change_private ()
     add_bool( "drop-late-frames", 1, DROP_LATE_FRAMES_TEXT,
               DROP_LATE_FRAMES_LONGTEXT, true )
+    add_integer_with_range( "video-lookahead", 0, 0, 8,
+                            LOOKAHEAD_TEXT, LOOKAHEAD_LONGTEXT, true )
     /* Used in vout_synchro */
     add_bool( "skip-frames", 1, SKIP_FRAMES_TEXT,
               SKIP_FRAMES_LONGTEXT, true )
@@ -1628,6 +1675,8 @@ vlc_module_begin ()
                 VIDEO_FILTER_TEXT, VIDEO_FILTER_LONGTEXT, false )
     add_module_list( "video-splitter", "video splitter", NULL,
                      VIDEO_SPLITTER_TEXT, VIDEO_SPLITTER_LONGTEXT, false )
+    add_integer_with_range( "filter-threads", 0, 0, 32,
+                            FILTER_THREADS_TEXT, FILTER_THREADS_LONGTEXT, true )
     add_obsolete_string( "vout-filter" ) /* since 2.0.0 */
 #if 0
     add_string( "pixel-ratio", "1", PIXEL_RATIO_TEXT, PIXEL_RATIO_TEXT )
@@ -1760,6 +1809,11 @@ vlc_module_begin ()
     add_string( "rtsp-host", NULL, RTSP_HOST_TEXT, RTSP_HOST_LONGTEXT, true )
     add_integer( "rtsp-port", 554, RTSP_PORT_TEXT, RTSP_PORT_LONGTEXT, true )
         change_integer_range( 1, 65535 )
+    add_bool( "http-drop-slow", false, HTTP_DROP_SLOW_TEXT,
+              HTTP_DROP_SLOW_LONGTEXT, true )
+    add_integer( "http-threads", 1, HTTP_THREADS_TEXT,
+                 HTTP_THREADS_LONGTEXT, true )
+        change_integer_range( 0, 64 )
     add_loadfile( "http-cert", NULL, HTTP_CERT_TEXT, CERT_LONGTEXT, true )
     add_obsolete_string( "sout-http-cert" ) /* since 2.0.0 */
     add_loadfile( "http-key", NULL, HTTP_KEY_TEXT, KEY_LONGTEXT, true )
@@ -1851,6 +1905,9 @@ vlc_module_begin ()
     add_obsolete_integer( "smb-caching" ) /* 2.0.0 */
     add_obsolete_integer( "tcp-caching" ) /* 2.0.0 */
     add_obsolete_integer( "udp-caching" ) /* 2.0.0 */
+    add_integer( "stream-prefetch", 0, PREFETCH_TEXT, PREFETCH_LONGTEXT, true )
+        change_integer_range( 0, 1024 * 1024 )
+        change_safe()
 
     add_integer( "cr-average", 40, CR_AVERAGE_TEXT,
                  CR_AVERAGE_LONGTEXT, true )
@@ -1873,6 +1930,10 @@ vlc_module_begin ()
                 INPUT_TIMESHIFT_PATH_LONGTEXT, true )
     add_integer( "input-timeshift-granularity", -1, INPUT_TIMESHIFT_GRANULARITY_TEXT,
                  INPUT_TIMESHIFT_GRANULARITY_LONGTEXT, true )
+    add_integer( "input-timeshift-window", 0, INPUT_TIMESHIFT_WINDOW_TEXT,
+                 INPUT_TIMESHIFT_WINDOW_LONGTEXT, true )
+    add_integer( "input-timeshift-size", 0, INPUT_TIMESHIFT_SIZE_TEXT,
+                 INPUT_TIMESHIFT_SIZE_LONGTEXT, true )
 
     add_string( "input-title-format", "$Z", INPUT_TITLE_FORMAT_TEXT, INPUT_TITLE_FORMAT_LONGTEXT, false );
 
@@ -2094,6 +2155,8 @@ vlc_module_begin ()
               INTERACTION_LONGTEXT, false )
 
     add_bool ( "stats", true, STATS_TEXT, STATS_LONGTEXT, true )
+    add_bool ( "latency-stats", false, LATENCY_STATS_TEXT,
+               LATENCY_STATS_LONGTEXT, true )
 
     set_subcategory( SUBCAT_INTERFACE_MAIN )
     add_module_cat( "intf", SUBCAT_INTERFACE_MAIN, NULL, INTF_TEXT,
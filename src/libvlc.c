@@ -110,8 +110,10 @@ libvlc_int_t * libvlc_InternalCreate( void )
     priv->p_playlist = NULL;
     priv->p_dialog_provider = NULL;
     priv->p_vlm = NULL;
+    priv->p_slices = NULL;
 
     vlc_ExitInit( &priv->exit );
+    block_PoolInit();
 
     return p_libvlc;
 }
@@ -549,6 +551,9 @@ void libvlc_InternalCleanup( libvlc_int_t *p_libvlc )
     if( p_playlist != NULL )
         playlist_Destroy( p_playlist );
 
+    /* No video filters can be running anymore */
+    filter_SlicesDestroy( p_libvlc );
+
     msg_Dbg( p_libvlc, "removing stats" );
 
 #if !defined( _WIN32 ) && !defined( __OS2__ )
@@ -596,6 +601,8 @@ void libvlc_InternalDestroy( libvlc_int_t *p_libvlc )
     libvlc_priv_t *priv = libvlc_priv( p_libvlc );
 
     vlc_ExitDestroy( &priv->exit );
+    /* All threads are gone, the calling one owns the last block cache */
+    block_PoolDeinit();
 
     assert( atomic_load(&(vlc_internals(p_libvlc)->refs)) == 1 );
     vlc_object_release( p_libvlc );
@@ -138,6 +138,7 @@ module_t *module_find_by_shortcut (const char *psz_shortcut);
 #define ZOOM_DOUBLE_KEY_TEXT N_("2:1 Double")
 
 typedef struct sap_handler_t sap_handler_t;
+typedef struct filter_slices_t filter_slices_t;
 
 /**
  * Private LibVLC instance data.
@@ -164,6 +165,7 @@ typedef struct libvlc_priv_t
     sap_handler_t     *p_sap; ///< SAP SDP advertiser
 #endif
     struct vlc_actions *actions; ///< Hotkeys handler
+    filter_slices_t   *p_slices; ///< video filter slice workers (or NULL)
 
     /* Interfaces */
     struct intf_thread_t *p_intf; ///< Interfaces linked-list
@@ -183,6 +185,22 @@ static inline libvlc_priv_t *libvlc_priv (libvlc_int_t *libvlc)
 void playlist_ServicesDiscoveryKillAll( playlist_t *p_playlist );
 void intf_DestroyAll( libvlc_int_t * );
 
+/*
+ * Video filter slice workers
+ */
+void filter_SlicesDestroy( libvlc_int_t * );
+
+/*
+ * Block pool
+ */
+void block_PoolInit( void );
+void block_PoolDeinit( void );
+
+/*
+ * Block FIFO statistics
+ */
+size_t block_FifoContention( block_fifo_t * ) VLC_USED;
+
 #define libvlc_stats( o ) (libvlc_priv((VLC_OBJECT(o))->p_libvlc)->b_stats)
 
 /*
@@ -197,6 +215,7 @@ enum
 {
     STATS_COUNTER,
     STATS_DERIVATIVE,
+    STATS_LAST,
 };
 
 typedef struct counter_sample_t
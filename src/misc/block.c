@@ -39,6 +39,8 @@
 #include <vlc_common.h>
 #include <vlc_block.h>
 #include <vlc_fs.h>
+#include <vlc_atomic.h>
+#include "libvlc.h"
 
 /**
  * @section Block handling functions.
@@ -128,17 +130,400 @@ static void BlockMetaCopy( block_t *restrict out, const block_t *in )
 /* Maximum size of reserved footer before shrinking with realloc(). */
 #define BLOCK_WASTE_SIZE   2048
 
+/* Header, alignment and padding overhead of a block_Alloc() allocation */
+#define BLOCK_OVERHEAD (sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING))
+
+/**
+ * @section Block pool.
+ *
+ * Blocks of common payload sizes are recycled rather than given back to the
+ * heap. Each thread caches free blocks per size class; a cache that grows
+ * too large spills half of its blocks into a shared depot, and an empty
+ * cache refills from the depot. Only the depot is locked, and only once
+ * per batch. The depot and the thread caches are bounded, excess blocks are
+ * freed.
+ */
+
+/** Payload capacity of the size classes: four classes per doubling, from
+ * 256 bytes up to 128 KiB, so that a pooled block payload is rounded up by
+ * at most a quarter (256 bytes below that). */
+#define BLOCK_POOL_MIN_SHIFT 8
+#define BLOCK_POOL_MAX_SHIFT 17
+#define BLOCK_POOL_CLASSES (4 * (BLOCK_POOL_MAX_SHIFT - BLOCK_POOL_MIN_SHIFT) + 1)
+
+/** Maximum bytes cached per thread, all size classes together */
+#define BLOCK_POOL_THREAD_MAX (1024 * 1024)
+/** Maximum bytes cached by all the threads together */
+#define BLOCK_POOL_THREADS_MAX (32 * 1024 * 1024)
+/** Maximum bytes cached in the shared depot */
+#define BLOCK_POOL_DEPOT_MAX  (16 * 1024 * 1024)
+
+typedef struct
+{
+    block_t *p_first;
+    unsigned i_count;
+} block_pool_list_t;
+
+typedef struct
+{
+    block_pool_list_t list[BLOCK_POOL_CLASSES];
+    size_t i_size; /* bytes of the cached blocks */
+    /* Statistics not yet merged into the global ones */
+    uint64_t i_hits;
+    uint64_t i_misses;
+    uint64_t i_drops;
+} block_pool_cache_t;
+
+static struct
+{
+    vlc_mutex_t lock;
+    atomic_bool initialized;
+    vlc_threadvar_t key;
+    block_pool_list_t depot[BLOCK_POOL_CLASSES];
+    size_t i_depot_size;
+    block_pool_stats_t stats;
+    unsigned i_users;
+    atomic_size_t i_threads_size; /* bytes cached by all the threads */
+} block_pool = {
+    .lock = VLC_STATIC_MUTEX,
+    .initialized = ATOMIC_VAR_INIT(false),
+    .i_threads_size = ATOMIC_VAR_INIT(0),
+};
+
+static inline size_t block_pool_AllocSize (unsigned i_class)
+{
+    size_t capacity = (size_t)(4 + (i_class & 3))
+                      << (BLOCK_POOL_MIN_SHIFT - 2 + i_class / 4);
+    return BLOCK_OVERHEAD + capacity;
+}
+
+/* Returns the smallest class fitting size bytes of payload, or
+ * BLOCK_POOL_CLASSES if the size is not pooled */
+static unsigned block_pool_Class (size_t size)
+{
+    if (size <= ((size_t)1 << BLOCK_POOL_MIN_SHIFT))
+        return 0;
+    if (size > ((size_t)1 << BLOCK_POOL_MAX_SHIFT))
+        return BLOCK_POOL_CLASSES;
+
+    /* Keep the three most significant bits of size - 1 */
+    unsigned last = size - 1;
+    unsigned shift = (sizeof (last) * 8 - 3) - clz (last);
+
+    return 4 * (shift - (BLOCK_POOL_MIN_SHIFT - 2)) + (last >> shift) - 3;
+}
+
+static void block_pool_ListAppend (block_pool_list_t *list,
+                                   block_t *first, unsigned count)
+{
+    block_t *last = first;
+
+    while (last->p_next != NULL)
+        last = last->p_next;
+    last->p_next = list->p_first;
+    list->p_first = first;
+    list->i_count += count;
+}
+
+/* Detaches the first count blocks of the list */
+static block_t *block_pool_ListSplit (block_pool_list_t *list, unsigned count)
+{
+    block_t *first = list->p_first, **pp = &list->p_first;
+
+    assert (count <= list->i_count);
+    for (unsigned i = 0; i < count; i++)
+        pp = &(*pp)->p_next;
+    list->p_first = *pp;
+    list->i_count -= count;
+    *pp = NULL;
+    return first;
+}
+
+static void block_pool_ListFree (block_pool_list_t *list)
+{
+    block_t *block = list->p_first;
+
+    while (block != NULL)
+    {
+        block_t *next = block->p_next;
+        free (block);
+        block = next;
+    }
+    list->p_first = NULL;
+    list->i_count = 0;
+}
+
+/* Accounts for blocks entering (size > 0) or leaving a thread cache */
+static void block_pool_CacheResize (block_pool_cache_t *cache, ssize_t size)
+{
+    cache->i_size += size;
+    atomic_fetch_add_explicit (&block_pool.i_threads_size, size,
+                               memory_order_relaxed);
+}
+
+/* Merges the thread statistics into the global ones, with the lock held */
+static void block_pool_MergeStats (block_pool_cache_t *cache)
+{
+    block_pool.stats.i_hits += cache->i_hits;
+    block_pool.stats.i_misses += cache->i_misses;
+    block_pool.stats.i_drops += cache->i_drops;
+    cache->i_hits = cache->i_misses = cache->i_drops = 0;
+}
+
+/* Moves count blocks of the thread cache to the depot (or to the heap) */
+static void block_pool_Spill (block_pool_cache_t *cache, unsigned i_class,
+                              unsigned count)
+{
+    block_t *list = block_pool_ListSplit (&cache->list[i_class], count);
+    const size_t size = count * block_pool_AllocSize (i_class);
+    bool drop;
+
+    block_pool_CacheResize (cache, -(ssize_t)size);
+
+    vlc_mutex_lock (&block_pool.lock);
+    drop = block_pool.i_depot_size + size > BLOCK_POOL_DEPOT_MAX;
+    if (!drop)
+    {
+        block_pool_ListAppend (&block_pool.depot[i_class], list, count);
+        block_pool.i_depot_size += size;
+    }
+    else
+        block_pool.stats.i_drops += count;
+    block_pool_MergeStats (cache);
+    vlc_mutex_unlock (&block_pool.lock);
+
+    if (drop)
+        while (list != NULL)
+        {
+            block_t *next = list->p_next;
+            free (list);
+            list = next;
+        }
+}
+
+/* Moves up to a quarter of a thread cache worth of blocks from the depot */
+static void block_pool_Refill (block_pool_cache_t *cache, unsigned i_class)
+{
+    const size_t alloc = block_pool_AllocSize (i_class);
+    block_pool_list_t *depot = &block_pool.depot[i_class];
+    unsigned count = BLOCK_POOL_THREAD_MAX / alloc / 4;
+
+    if (count == 0)
+        count = 1;
+
+    vlc_mutex_lock (&block_pool.lock);
+    if (count > depot->i_count)
+        count = depot->i_count;
+    if (count > 0)
+    {
+        block_pool_ListAppend (&cache->list[i_class],
+                               block_pool_ListSplit (depot, count), count);
+        block_pool.i_depot_size -= count * alloc;
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+    block_pool_CacheResize (cache, count * alloc);
+}
+
+static void block_pool_CacheDestroy (void *data)
+{
+    block_pool_cache_t *cache = data;
+
+    for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+        if (cache->list[i].i_count > 0)
+            block_pool_Spill (cache, i, cache->list[i].i_count);
+
+    vlc_mutex_lock (&block_pool.lock);
+    block_pool_MergeStats (cache);
+    vlc_mutex_unlock (&block_pool.lock);
+    free (cache);
+}
+
+/* Returns the calling thread cache, NULL on error */
+static block_pool_cache_t *block_pool_GetCache (void)
+{
+    if (unlikely(!atomic_load_explicit (&block_pool.initialized,
+                                        memory_order_acquire)))
+    {
+        bool ok = true;
+
+        vlc_mutex_lock (&block_pool.lock);
+        if (!atomic_load_explicit (&block_pool.initialized,
+                                   memory_order_relaxed))
+        {
+            ok = !vlc_threadvar_create (&block_pool.key,
+                                        block_pool_CacheDestroy);
+            if (ok)
+                atomic_store_explicit (&block_pool.initialized, true,
+                                       memory_order_release);
+        }
+        vlc_mutex_unlock (&block_pool.lock);
+        if (!ok)
+            return NULL;
+    }
+
+    block_pool_cache_t *cache = vlc_threadvar_get (block_pool.key);
+    if (unlikely(cache == NULL))
+    {
+        cache = calloc (1, sizeof (*cache));
+        if (cache != NULL && vlc_threadvar_set (block_pool.key, cache))
+        {
+            free (cache);
+            cache = NULL;
+        }
+    }
+    return cache;
+}
+
+static void block_pool_Release (block_t *block)
+{
+    const size_t alloc = sizeof (*block) + block->i_size;
+    const unsigned i_class = block_pool_Class (alloc - BLOCK_OVERHEAD);
+
+    assert (block->p_start == (unsigned char *)(block + 1));
+    assert (i_class < BLOCK_POOL_CLASSES);
+    assert (block_pool_AllocSize (i_class) == alloc);
+    block_Invalidate (block);
+
+    block_pool_cache_t *cache = block_pool_GetCache ();
+    if (unlikely(cache == NULL))
+    {
+        free (block);
+        return;
+    }
+
+    /* Too much memory is idle in the thread caches already */
+    if (atomic_load_explicit (&block_pool.i_threads_size,
+                              memory_order_relaxed) + alloc
+                                                    > BLOCK_POOL_THREADS_MAX)
+    {
+        cache->i_drops++;
+        free (block);
+        return;
+    }
+
+    block_pool_list_t *list = &cache->list[i_class];
+    block->p_next = list->p_first;
+    list->p_first = block;
+    list->i_count++;
+    block_pool_CacheResize (cache, alloc);
+    if (cache->i_size > BLOCK_POOL_THREAD_MAX)
+        block_pool_Spill (cache, i_class, (list->i_count + 1) / 2);
+}
+
+/* Returns uninitialized memory for a block of the smallest class fitting
+ * size bytes of payload, or NULL if the size is not pooled */
+static block_t *block_pool_Get (size_t size, size_t *restrict alloc)
+{
+    const unsigned i_class = block_pool_Class (size);
+
+    if (i_class >= BLOCK_POOL_CLASSES)
+        return NULL;
+
+    block_pool_cache_t *cache = block_pool_GetCache ();
+    if (unlikely(cache == NULL))
+        return NULL;
+
+    block_pool_list_t *list = &cache->list[i_class];
+    if (list->p_first == NULL)
+        block_pool_Refill (cache, i_class);
+
+    block_t *b = list->p_first;
+    if (b != NULL)
+    {
+        list->p_first = b->p_next;
+        list->i_count--;
+        block_pool_CacheResize (cache,
+                                -(ssize_t)block_pool_AllocSize (i_class));
+        cache->i_hits++;
+    }
+    else
+    {
+        b = malloc (block_pool_AllocSize (i_class));
+        if (unlikely(b == NULL))
+            return NULL;
+        cache->i_misses++;
+    }
+    *alloc = block_pool_AllocSize (i_class);
+    return b;
+}
+
+/**
+ * Registers a user of the block pool (i.e. a LibVLC instance).
+ */
+void block_PoolInit (void)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    block_pool.i_users++;
+    vlc_mutex_unlock (&block_pool.lock);
+}
+
+/**
+ * Unregisters a user of the block pool. When the last one goes away, the
+ * calling thread cache and the depot are given back to the heap and the
+ * thread-specific key is deleted; it is recreated on demand afterwards.
+ * Other threads using blocks must have exited by then, so that their own
+ * caches were already spilled.
+ */
+void block_PoolDeinit (void)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    assert (block_pool.i_users > 0);
+    if (--block_pool.i_users == 0
+     && atomic_load_explicit (&block_pool.initialized, memory_order_relaxed))
+    {
+        block_pool_cache_t *cache = vlc_threadvar_get (block_pool.key);
+        if (cache != NULL)
+        {
+            vlc_threadvar_set (block_pool.key, NULL);
+            for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+                block_pool_ListFree (&cache->list[i]);
+            block_pool_CacheResize (cache, -(ssize_t)cache->i_size);
+            block_pool_MergeStats (cache);
+            free (cache);
+        }
+
+        for (unsigned i = 0; i < BLOCK_POOL_CLASSES; i++)
+            block_pool_ListFree (&block_pool.depot[i]);
+        block_pool.i_depot_size = 0;
+
+        vlc_threadvar_delete (&block_pool.key);
+        atomic_store_explicit (&block_pool.initialized, false,
+                               memory_order_relaxed);
+    }
+    vlc_mutex_unlock (&block_pool.lock);
+}
+
+/**
+ * Retrieves the block pool statistics. Allocations counters of each thread
+ * are only merged when it exchanges blocks with the shared depot, so the
+ * values lag slightly behind.
+ */
+void block_PoolStats (block_pool_stats_t *stats)
+{
+    vlc_mutex_lock (&block_pool.lock);
+    *stats = block_pool.stats;
+    stats->i_cached = block_pool.i_depot_size
+                    + atomic_load_explicit (&block_pool.i_threads_size,
+                                            memory_order_relaxed);
+    vlc_mutex_unlock (&block_pool.lock);
+}
+
 block_t *block_Alloc (size_t size)
 {
     /* 2 * BLOCK_PADDING: pre + post padding */
-    const size_t alloc = sizeof (block_t) + BLOCK_ALIGN + (2 * BLOCK_PADDING)
-                       + size;
+    size_t alloc = BLOCK_OVERHEAD + size;
     if (unlikely(alloc <= size))
         return NULL;
 
-    block_t *b = malloc (alloc);
-    if (unlikely(b == NULL))
-        return NULL;
+    block_free_t pf_release = block_pool_Release;
+    block_t *b = block_pool_Get (size, &alloc);
+    if (b == NULL)
+    {
+        b = malloc (alloc);
+        if (unlikely(b == NULL))
+            return NULL;
+        pf_release = block_generic_Release;
+    }
 
     block_Init (b, b + 1, alloc - sizeof (*b));
     static_assert ((BLOCK_PADDING % BLOCK_ALIGN) == 0,
@@ -146,7 +531,7 @@ block_t *block_Alloc (size_t size)
     b->p_buffer += BLOCK_PADDING + BLOCK_ALIGN - 1;
     b->p_buffer = (void *)(((uintptr_t)b->p_buffer) & ~(BLOCK_ALIGN - 1));
     b->i_buffer = size;
-    b->pf_release = block_generic_Release;
+    b->pf_release = pf_release;
     return b;
 }
 
@@ -210,8 +595,30 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
     /* Second, reallocate the buffer if we lack space. This is done now to
      * minimize the payload size for memory copy. */
     assert( i_prebody >= 0 );
-    if( (size_t)(p_block->p_buffer - p_start) < (size_t)i_prebody
-     || (size_t)(p_end - p_block->p_buffer) < i_body )
+    bool b_lack = (size_t)(p_block->p_buffer - p_start) < (size_t)i_prebody
+               || (size_t)(p_end - p_block->p_buffer) < i_body;
+    uint8_t *p_room = NULL;
+
+    if( b_lack && p_block->pf_release == block_pool_Release
+     && p_block->i_size >= requested )
+    {
+        /* Pooled blocks usually have spare room: move the payload within,
+         * if the expanded payload can still start on an aligned address */
+        uintptr_t room = (uintptr_t)p_start
+                       + (p_block->i_size - requested) / 2;
+
+        room = (room + BLOCK_ALIGN - 1) & ~(uintptr_t)(BLOCK_ALIGN - 1);
+        if( room + requested <= (uintptr_t)p_end )
+            p_room = (uint8_t *)room;
+    }
+
+    if( p_room != NULL )
+    {
+        memmove( p_room + i_prebody, p_block->p_buffer, p_block->i_buffer );
+        p_block->p_buffer = p_room + i_prebody;
+    }
+    else
+    if( b_lack )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -228,8 +635,10 @@ block_t *block_Realloc( block_t *p_block, ssize_t i_prebody, size_t i_body )
     }
     else
     /* We have a very large reserved footer now? Release some of it.
-     * XXX it might not preserve the alignment of p_buffer */
-    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE )
+     * XXX it might not preserve the alignment of p_buffer
+     * Pooled blocks are bounded by their size class and are kept as is. */
+    if( p_end - (p_block->p_buffer + i_body) > BLOCK_WASTE_SIZE
+     && p_block->pf_release != block_pool_Release )
     {
         block_t *p_rea = block_Alloc( requested );
         if( p_rea )
@@ -522,8 +931,54 @@ struct block_fifo_t
     size_t              i_depth;
     size_t              i_size;
     bool          b_force_wake;
+
+    /* Threads sleeping on the condition variables: nobody is signaled
+     * (and thus no futex is woken up) unless someone actually waits */
+    unsigned            i_data_waiters;
+    unsigned            i_room_waiters;
+    size_t              i_room_depth; /**< Largest depth a pacer waits for */
+    size_t              i_room_size;  /**< Largest size a pacer waits for */
+
+    atomic_size_t       i_contention; /**< Times the lock was contended */
 };
 
+/* Takes the FIFO lock, accounting for contention with the other side */
+static void block_FifoLock( block_fifo_t *p_fifo )
+{
+    if( vlc_mutex_trylock( &p_fifo->lock ) != 0 )
+    {
+        vlc_mutex_lock( &p_fifo->lock );
+        atomic_fetch_add_explicit( &p_fifo->i_contention, 1,
+                                   memory_order_relaxed );
+    }
+}
+
+/* Wakes the pacing threads up, if the queue drained enough for any of them */
+static void block_FifoSignalRoom( block_fifo_t *p_fifo )
+{
+    if( p_fifo->i_room_waiters > 0
+     && p_fifo->i_depth <= p_fifo->i_room_depth
+     && p_fifo->i_size <= p_fifo->i_room_size )
+        vlc_cond_broadcast( &p_fifo->wait_room );
+}
+
+static void block_FifoCleanupData( void *data )
+{
+    block_fifo_t *p_fifo = data;
+
+    p_fifo->i_data_waiters--;
+    vlc_mutex_unlock( &p_fifo->lock );
+}
+
+static void block_FifoCleanupRoom( void *data )
+{
+    block_fifo_t *p_fifo = data;
+
+    if( --p_fifo->i_room_waiters == 0 )
+        p_fifo->i_room_depth = p_fifo->i_room_size = 0;
+    vlc_mutex_unlock( &p_fifo->lock );
+}
+
 block_fifo_t *block_FifoNew( void )
 {
     block_fifo_t *p_fifo = malloc( sizeof( block_fifo_t ) );
@@ -537,6 +992,9 @@ block_fifo_t *block_FifoNew( void )
     p_fifo->pp_last = &p_fifo->p_first;
     p_fifo->i_depth = p_fifo->i_size = 0;
     p_fifo->b_force_wake = false;
+    p_fifo->i_data_waiters = p_fifo->i_room_waiters = 0;
+    p_fifo->i_room_depth = p_fifo->i_room_size = 0;
+    atomic_init( &p_fifo->i_contention, 0 );
 
     return p_fifo;
 }
@@ -554,7 +1012,7 @@ void block_FifoEmpty( block_fifo_t *p_fifo )
 {
     block_t *block;
 
-    vlc_mutex_lock( &p_fifo->lock );
+    block_FifoLock( p_fifo );
     block = p_fifo->p_first;
     if (block != NULL)
     {
@@ -562,7 +1020,7 @@ void block_FifoEmpty( block_fifo_t *p_fifo )
         p_fifo->p_first = NULL;
         p_fifo->pp_last = &p_fifo->p_first;
     }
-    vlc_cond_broadcast( &p_fifo->wait_room );
+    block_FifoSignalRoom( p_fifo );
     vlc_mutex_unlock( &p_fifo->lock );
 
     while (block != NULL)
@@ -583,6 +1041,9 @@ void block_FifoEmpty( block_fifo_t *p_fifo )
  * thread could have refilled it already). This is typically not an issue, as
  * this function is meant for (relaxed) congestion control.
  *
+ * The draining thread only wakes pacing threads up once the queue is below
+ * their thresholds, not on every dequeued block.
+ *
  * This function may be a cancellation point and it is cancel-safe.
  *
  * @param fifo queue to wait on
@@ -596,14 +1057,23 @@ void block_FifoPace (block_fifo_t *fifo, size_t max_depth, size_t max_size)
 {
     vlc_testcancel ();
 
-    vlc_mutex_lock (&fifo->lock);
-    while ((fifo->i_depth > max_depth) || (fifo->i_size > max_size))
+    block_FifoLock (fifo);
+    if ((fifo->i_depth <= max_depth) && (fifo->i_size <= max_size))
     {
-         mutex_cleanup_push (&fifo->lock);
-         vlc_cond_wait (&fifo->wait_room, &fifo->lock);
-         vlc_cleanup_pop ();
+        vlc_mutex_unlock (&fifo->lock);
+        return;
     }
-    vlc_mutex_unlock (&fifo->lock);
+
+    fifo->i_room_waiters++;
+    if (fifo->i_room_depth < max_depth)
+        fifo->i_room_depth = max_depth;
+    if (fifo->i_room_size < max_size)
+        fifo->i_room_size = max_size;
+
+    vlc_cleanup_push (block_FifoCleanupRoom, fifo);
+    while ((fifo->i_depth > max_depth) || (fifo->i_size > max_size))
+        vlc_cond_wait (&fifo->wait_room, &fifo->lock);
+    vlc_cleanup_run ();
 }
 
 /**
@@ -627,13 +1097,14 @@ size_t block_FifoPut( block_fifo_t *p_fifo, block_t *p_block )
             break;
     }
 
-    vlc_mutex_lock (&p_fifo->lock);
+    block_FifoLock (p_fifo);
     *p_fifo->pp_last = p_block;
     p_fifo->pp_last = &p_last->p_next;
     p_fifo->i_depth += i_depth;
     p_fifo->i_size += i_size;
     /* We queued at least one block: wake up one read-waiting thread */
-    vlc_cond_signal( &p_fifo->wait );
+    if( p_fifo->i_data_waiters > 0 )
+        vlc_cond_signal( &p_fifo->wait );
     vlc_mutex_unlock( &p_fifo->lock );
 
     return i_size;
@@ -660,15 +1131,20 @@ block_t *block_FifoGet( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
-    vlc_mutex_lock( &p_fifo->lock );
-    mutex_cleanup_push( &p_fifo->lock );
+    block_FifoLock( p_fifo );
+    if( ( p_fifo->p_first == NULL ) && !p_fifo->b_force_wake )
+    {
+        p_fifo->i_data_waiters++;
+        vlc_cleanup_push( block_FifoCleanupData, p_fifo );
 
-    /* Remember vlc_cond_wait() may cause spurious wakeups
-     * (on both Win32 and POSIX) */
-    while( ( p_fifo->p_first == NULL ) && !p_fifo->b_force_wake )
-        vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+        /* Remember vlc_cond_wait() may cause spurious wakeups
+         * (on both Win32 and POSIX) */
+        while( ( p_fifo->p_first == NULL ) && !p_fifo->b_force_wake )
+            vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
 
-    vlc_cleanup_pop();
+        vlc_cleanup_pop();
+        p_fifo->i_data_waiters--;
+    }
     b = p_fifo->p_first;
 
     p_fifo->b_force_wake = false;
@@ -689,7 +1165,7 @@ block_t *block_FifoGet( block_fifo_t *p_fifo )
     }
 
     /* We don't know how many threads can queue new packets now. */
-    vlc_cond_broadcast( &p_fifo->wait_room );
+    block_FifoSignalRoom( p_fifo );
     vlc_mutex_unlock( &p_fifo->lock );
 
     b->p_next = NULL;
@@ -713,15 +1189,21 @@ block_t *block_FifoShow( block_fifo_t *p_fifo )
 
     vlc_testcancel( );
 
-    vlc_mutex_lock( &p_fifo->lock );
-    mutex_cleanup_push( &p_fifo->lock );
+    block_FifoLock( p_fifo );
+    if( p_fifo->p_first == NULL )
+    {
+        p_fifo->i_data_waiters++;
+        vlc_cleanup_push( block_FifoCleanupData, p_fifo );
 
-    while( p_fifo->p_first == NULL )
-        vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
+        while( p_fifo->p_first == NULL )
+            vlc_cond_wait( &p_fifo->wait, &p_fifo->lock );
 
+        vlc_cleanup_pop();
+        p_fifo->i_data_waiters--;
+    }
     b = p_fifo->p_first;
 
-    vlc_cleanup_run ();
+    vlc_mutex_unlock( &p_fifo->lock );
     return b;
 }
 
@@ -736,3 +1218,14 @@ size_t block_FifoCount( const block_fifo_t *p_fifo )
 {
     return p_fifo->i_depth;
 }
+
+/**
+ * Number of times a thread had to wait for the FIFO lock held by another
+ * thread (i.e. producer/consumer contention) since the FIFO was created.
+ * It does not take the lock, so as not to add to the contention.
+ */
+size_t block_FifoContention( block_fifo_t *p_fifo )
+{
+    return atomic_load_explicit( &p_fifo->i_contention,
+                                 memory_order_relaxed );
+}
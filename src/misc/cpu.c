@@ -127,7 +127,7 @@ void vlc_CPU_init (void)
     uint32_t i_capabilities = 0;
 
 #if defined( __i386__ ) || defined( __x86_64__ )
-     unsigned int i_eax, i_ebx, i_ecx, i_edx;
+     unsigned int i_eax, i_ebx, i_ecx, i_edx, i_level;
      bool b_amd;
 
     /* Needed for x86 CPU capabilities detection */
@@ -137,13 +137,13 @@ void vlc_CPU_init (void)
                    "cpuid\n\t" \
                    "xchgl %%ebx,%1\n\t" \
                    : "=a" (i_eax), "=r" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (0) \
                    : "cc");
 # else
 #  define cpuid(reg) \
      asm volatile ("cpuid\n\t" \
                    : "=a" (i_eax), "=b" (i_ebx), "=c" (i_ecx), "=d" (i_edx) \
-                   : "a" (reg) \
+                   : "a" (reg), "c" (0) \
                    : "cc");
 # endif
      /* Check if the OS really supports the requested instructions */
@@ -173,6 +173,7 @@ void vlc_CPU_init (void)
 
     /* the CPU supports the CPUID instruction - get its level */
     cpuid( 0x00000000 );
+    i_level = i_eax;
 
 # if defined (__i386__) && !defined (__i586__) \
   && !defined (__i686__) && !defined (__pentium4__) \
@@ -211,6 +212,25 @@ void vlc_CPU_init (void)
             i_capabilities |= VLC_CPU_SSE4_1;
         if (i_ecx & 0x00100000)
             i_capabilities |= VLC_CPU_SSE4_2;
+
+        /* AVX also needs the OS to save the YMM registers (XCR0) */
+        if ((i_ecx & 0x18000000) == 0x18000000)
+        {
+            unsigned int i_xcr0;
+
+            asm volatile (".byte 0x0f, 0x01, 0xd0\n\t" /* xgetbv */
+                          : "=a" (i_xcr0), "=d" (i_edx) : "c" (0));
+            if ((i_xcr0 & 6) == 6)
+            {
+                i_capabilities |= VLC_CPU_AVX;
+                if (i_level >= 7)
+                {
+                    cpuid( 0x00000007 );
+                    if (i_ebx & 0x00000020)
+                        i_capabilities |= VLC_CPU_AVX2;
+                }
+            }
+        }
     }
 
     /* test for additional capabilities */
@@ -294,7 +314,7 @@ void vlc_CPU_dump (vlc_object_t *obj)
     if (vlc_CPU_SSE4_2()) p += sprintf (p, "SSE4.2 ");
     if (vlc_CPU_SSE4A()) p += sprintf (p, "SSE4A ");
     if (vlc_CPU_AVX()) p += sprintf (p, "AVX ");
-    if (vlc_CPU_AVX2()) p += sprintf (p, "AVX ");
+    if (vlc_CPU_AVX2()) p += sprintf (p, "AVX2 ");
     if (vlc_CPU_3dNOW()) p += sprintf (p, "3DNow! ");
     if (vlc_CPU_XOP()) p += sprintf (p, "XOP ");
     if (vlc_CPU_FMA4()) p += sprintf (p, "FMA4 ");
@@ -0,0 +1,268 @@
+/*****************************************************************************
+ * filter_slices.c : slice-parallel execution of video filters
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_filter.h>
+#include <vlc_cpu.h>
+#include "../libvlc.h"
+
+/* Slices smaller than this are not worth a thread hand-off */
+#define SLICE_MIN_LINES 16
+/* Slices per thread, so that a preempted thread does not hold the others */
+#define SLICES_PER_THREAD 2
+
+typedef struct filter_slice_job_t filter_slice_job_t;
+
+struct filter_slice_job_t
+{
+    filter_t         *p_filter;
+    filter_slice_cb_t pf_slice;
+    void             *opaque;
+    int               i_lines;
+    int               i_align;
+
+    unsigned          i_count; /* number of slices */
+    unsigned          i_next;  /* next slice to hand out */
+    unsigned          i_done;  /* number of completed slices */
+
+    filter_slice_job_t *p_next;
+};
+
+struct filter_slices_t
+{
+    vlc_mutex_t lock;
+    vlc_cond_t  wait_work; /* workers wait for a job */
+    vlc_cond_t  wait_done; /* submitters wait for their job completion */
+
+    filter_slice_job_t  *p_first; /* jobs with slices left to hand out */
+    filter_slice_job_t **pp_last;
+    bool                 b_exit;
+
+    unsigned     i_threads;
+    vlc_thread_t threads[];
+};
+
+static vlc_mutex_t slices_lock = VLC_STATIC_MUTEX;
+
+/* Must be called with the lock held; the job must have slices left */
+static unsigned TakeSlice( filter_slices_t *p_slices, filter_slice_job_t *p_job )
+{
+    unsigned i_slice = p_job->i_next++;
+
+    if( p_job->i_next == p_job->i_count )
+    {
+        /* Unlink the job: nothing left to hand out */
+        filter_slice_job_t **pp = &p_slices->p_first;
+        while( *pp != p_job )
+            pp = &(*pp)->p_next;
+        *pp = p_job->p_next;
+        if( p_slices->pp_last == &p_job->p_next )
+            p_slices->pp_last = pp;
+    }
+    return i_slice;
+}
+
+static void RunSlice( filter_slice_job_t *p_job, unsigned i_slice )
+{
+    /* Spread the aligned line groups evenly over the slices */
+    const int i_groups = (p_job->i_lines + p_job->i_align - 1) / p_job->i_align;
+    int i_start = (int64_t)i_groups * i_slice / p_job->i_count * p_job->i_align;
+    int i_end = (int64_t)i_groups * (i_slice + 1) / p_job->i_count * p_job->i_align;
+
+    if( i_end > p_job->i_lines )
+        i_end = p_job->i_lines;
+    if( i_start < i_end )
+        p_job->pf_slice( p_job->p_filter, p_job->opaque, i_start, i_end );
+}
+
+/* Must be called with the lock held */
+static void CompleteSlice( filter_slices_t *p_slices, filter_slice_job_t *p_job )
+{
+    if( ++p_job->i_done == p_job->i_count )
+        vlc_cond_broadcast( &p_slices->wait_done );
+}
+
+static void *Thread( void *data )
+{
+    filter_slices_t *p_slices = data;
+
+    vlc_mutex_lock( &p_slices->lock );
+    for( ;; )
+    {
+        while( !p_slices->b_exit && p_slices->p_first == NULL )
+            vlc_cond_wait( &p_slices->wait_work, &p_slices->lock );
+        if( p_slices->b_exit )
+            break;
+
+        filter_slice_job_t *p_job = p_slices->p_first;
+        unsigned i_slice = TakeSlice( p_slices, p_job );
+
+        vlc_mutex_unlock( &p_slices->lock );
+        RunSlice( p_job, i_slice );
+        vlc_mutex_lock( &p_slices->lock );
+
+        CompleteSlice( p_slices, p_job );
+    }
+    vlc_mutex_unlock( &p_slices->lock );
+    return NULL;
+}
+
+static filter_slices_t *Create( vlc_object_t *p_obj )
+{
+    int i_threads = var_InheritInteger( p_obj, "filter-threads" );
+
+    if( i_threads <= 0 )
+        i_threads = vlc_GetCPUCount();
+    /* The calling thread takes its share of the slices too */
+    i_threads--;
+
+    filter_slices_t *p_slices = malloc( sizeof(*p_slices)
+                                        + i_threads * sizeof(vlc_thread_t) );
+    if( unlikely(p_slices == NULL) )
+        return NULL;
+
+    vlc_mutex_init( &p_slices->lock );
+    vlc_cond_init( &p_slices->wait_work );
+    vlc_cond_init( &p_slices->wait_done );
+    p_slices->p_first = NULL;
+    p_slices->pp_last = &p_slices->p_first;
+    p_slices->b_exit = false;
+    p_slices->i_threads = 0;
+
+    for( int i = 0; i < i_threads; i++ )
+    {
+        if( vlc_clone( &p_slices->threads[i], Thread, p_slices,
+                       VLC_THREAD_PRIORITY_VIDEO ) )
+            break;
+        p_slices->i_threads++;
+    }
+    msg_Dbg( p_obj, "using %u video filter slice threads",
+             p_slices->i_threads );
+    return p_slices;
+}
+
+static filter_slices_t *Get( filter_t *p_filter )
+{
+    libvlc_priv_t *priv = libvlc_priv( p_filter->p_libvlc );
+    filter_slices_t *p_slices;
+
+    vlc_mutex_lock( &slices_lock );
+    p_slices = priv->p_slices;
+    if( p_slices == NULL )
+        p_slices = priv->p_slices = Create( VLC_OBJECT(p_filter) );
+    vlc_mutex_unlock( &slices_lock );
+
+    if( p_slices != NULL && p_slices->i_threads == 0 )
+        return NULL;
+    return p_slices;
+}
+
+void filter_RunSlices( filter_t *p_filter, filter_slice_cb_t pf_slice,
+                       void *opaque, int i_lines, int i_align )
+{
+    if( i_align < 1 )
+        i_align = 1;
+
+    filter_slices_t *p_slices = NULL;
+    unsigned i_count = 1;
+
+    if( i_lines >= 2 * SLICE_MIN_LINES )
+        p_slices = Get( p_filter );
+    if( p_slices != NULL )
+    {
+        i_count = (p_slices->i_threads + 1) * SLICES_PER_THREAD;
+        if( i_count > (unsigned)(i_lines / SLICE_MIN_LINES) )
+            i_count = i_lines / SLICE_MIN_LINES;
+    }
+
+    if( i_count <= 1 )
+    {
+        pf_slice( p_filter, opaque, 0, i_lines );
+        return;
+    }
+
+    filter_slice_job_t job = {
+        .p_filter = p_filter,
+        .pf_slice = pf_slice,
+        .opaque = opaque,
+        .i_lines = i_lines,
+        .i_align = i_align,
+        .i_count = i_count,
+        .i_next = 0,
+        .i_done = 0,
+        .p_next = NULL,
+    };
+
+    /* The job lives on this stack: it must not be abandoned half-way */
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &p_slices->lock );
+    *p_slices->pp_last = &job;
+    p_slices->pp_last = &job.p_next;
+    vlc_cond_broadcast( &p_slices->wait_work );
+
+    /* Process our own slices rather than sleeping */
+    while( job.i_next < job.i_count )
+    {
+        unsigned i_slice = TakeSlice( p_slices, &job );
+
+        vlc_mutex_unlock( &p_slices->lock );
+        RunSlice( &job, i_slice );
+        vlc_mutex_lock( &p_slices->lock );
+
+        CompleteSlice( p_slices, &job );
+    }
+
+    while( job.i_done < job.i_count )
+        vlc_cond_wait( &p_slices->wait_done, &p_slices->lock );
+    vlc_mutex_unlock( &p_slices->lock );
+
+    vlc_restorecancel( canc );
+}
+
+void filter_SlicesDestroy( libvlc_int_t *p_libvlc )
+{
+    libvlc_priv_t *priv = libvlc_priv( p_libvlc );
+    filter_slices_t *p_slices = priv->p_slices;
+
+    if( p_slices == NULL )
+        return;
+    priv->p_slices = NULL;
+
+    vlc_mutex_lock( &p_slices->lock );
+    assert( p_slices->p_first == NULL );
+    p_slices->b_exit = true;
+    vlc_cond_broadcast( &p_slices->wait_work );
+    vlc_mutex_unlock( &p_slices->lock );
+
+    for( unsigned i = 0; i < p_slices->i_threads; i++ )
+        vlc_join( p_slices->threads[i], NULL );
+
+    vlc_cond_destroy( &p_slices->wait_done );
+    vlc_cond_destroy( &p_slices->wait_work );
+    vlc_mutex_destroy( &p_slices->lock );
+    free( p_slices );
+}
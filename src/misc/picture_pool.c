@@ -47,18 +47,43 @@ struct picture_gc_sys_t {
     void (*unlock)(picture_t *);
 
     /* */
-    atomic_bool zombie;
     int64_t tick;
+
+    /* Pool the picture was created in; it outlives the picture */
+    picture_pool_t *root;
+    /* Pool the picture is currently available from, and its index there.
+     * Protected by root->lock */
+    picture_pool_t *pool;
+    int            index;
+    bool           is_free;
 };
 
 struct picture_pool_t {
     /* */
     picture_pool_t *master;
+    picture_pool_t *root;
     int64_t        tick;
     /* */
     int            picture_count;
     picture_t      **picture;
     bool           *picture_reserved;
+
+    /* Free pictures, oldest released first. As pictures may be released
+     * from any thread, the rings, the statistics and the picture to pool
+     * assignments of a pool and of all the pools reserved from it are
+     * protected by the lock of the root pool */
+    int            *free;
+    int            free_start;
+    int            free_count;
+    int            available; /* Pictures not reserved by another pool */
+
+    picture_pool_stats_t stats;
+
+    /* Root pool only: the root pool structure and its lock remain until
+     * the last picture handed out is released */
+    vlc_mutex_t    lock;
+    int            out;     /* Pictures held outside of the pools */
+    bool           deleted; /* picture_pool_Delete() was called */
 };
 
 static void Destroy(picture_t *);
@@ -72,19 +97,73 @@ static picture_pool_t *Create(picture_pool_t *master, int picture_count)
         return NULL;
 
     pool->master = master;
+    pool->root = master ? master->root : pool;
     pool->tick = master ? master->tick : 1;
     pool->picture_count = picture_count;
     pool->picture = calloc(pool->picture_count, sizeof(*pool->picture));
     pool->picture_reserved = calloc(pool->picture_count, sizeof(*pool->picture_reserved));
-    if (!pool->picture || !pool->picture_reserved) {
+    pool->free = calloc(pool->picture_count, sizeof(*pool->free));
+    if (!pool->picture || !pool->picture_reserved || !pool->free) {
         free(pool->picture);
         free(pool->picture_reserved);
+        free(pool->free);
         free(pool);
         return NULL;
     }
+    if (!master)
+        vlc_mutex_init(&pool->lock);
+    pool->free_start = 0;
+    pool->free_count = 0;
     return pool;
 }
 
+/* Adds a picture at the end of the free ring, root->lock must be held */
+static void PushFree(picture_pool_t *pool, picture_t *picture)
+{
+    picture_gc_sys_t *gc_sys = picture->gc.p_sys;
+
+    assert(gc_sys->pool == pool);
+    if (gc_sys->is_free)
+        return;
+    assert(pool->free_count < pool->picture_count);
+    pool->free[(pool->free_start + pool->free_count) % pool->picture_count] =
+        gc_sys->index;
+    pool->free_count++;
+    gc_sys->is_free = true;
+}
+
+/* Removes the oldest picture from the free ring, root->lock must be held */
+static picture_t *PopFree(picture_pool_t *pool)
+{
+    if (pool->free_count <= 0)
+        return NULL;
+
+    picture_t *picture = pool->picture[pool->free[pool->free_start]];
+    pool->free_start = (pool->free_start + 1) % pool->picture_count;
+    pool->free_count--;
+    picture->gc.p_sys->is_free = false;
+    return picture;
+}
+
+/* Rebuilds the free ring from the reference counts, root->lock must be
+ * held */
+static void ResetFree(picture_pool_t *pool)
+{
+    pool->free_start = 0;
+    pool->free_count = 0;
+    pool->available  = 0;
+    for (int i = 0; i < pool->picture_count; i++) {
+        picture_t *picture = pool->picture[i];
+
+        if (pool->picture_reserved[i])
+            continue;
+        pool->available++;
+        picture->gc.p_sys->is_free = false;
+        if (atomic_load(&picture->gc.refcount) == 0)
+            PushFree(pool, picture);
+    }
+}
+
 picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg)
 {
     picture_pool_t *pool = Create(NULL, cfg->picture_count);
@@ -118,8 +197,11 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
         gc_sys->destroy_sys = picture->gc.p_sys;
         gc_sys->lock        = cfg->lock;
         gc_sys->unlock      = cfg->unlock;
-        atomic_init(&gc_sys->zombie, false);
         gc_sys->tick        = 0;
+        gc_sys->root        = pool;
+        gc_sys->pool        = pool;
+        gc_sys->index       = i;
+        gc_sys->is_free     = false;
 
         /* Override the garbage collector */
         assert(atomic_load(&picture->gc.refcount) == 1);
@@ -130,7 +212,9 @@ picture_pool_t *picture_pool_NewExtended(const picture_pool_configuration_t *cfg
         /* */
         pool->picture[i] = picture;
         pool->picture_reserved[i] = false;
+        PushFree(pool, picture);
     }
+    pool->available = cfg->picture_count;
     return pool;
 
 }
@@ -176,18 +260,27 @@ picture_pool_t *picture_pool_Reserve(picture_pool_t *master, int count)
     if (!pool)
         return NULL;
 
+    vlc_mutex_lock(&pool->root->lock);
     int found = 0;
     for (int i = 0; i < master->picture_count && found < count; i++) {
         if (master->picture_reserved[i])
             continue;
 
-        assert(atomic_load(&master->picture[i]->gc.refcount) == 0);
+        picture_t *picture = master->picture[i];
+        assert(atomic_load(&picture->gc.refcount) == 0);
         master->picture_reserved[i] = true;
 
-        pool->picture[found]          = master->picture[i];
+        picture->gc.p_sys->pool    = pool;
+        picture->gc.p_sys->index   = found;
+        picture->gc.p_sys->is_free = false;
+        pool->picture[found]          = picture;
         pool->picture_reserved[found] = false;
         found++;
     }
+    pool->picture_count = found;
+    ResetFree(pool);
+    ResetFree(master);
+    vlc_mutex_unlock(&pool->root->lock);
     if (found < count) {
         picture_pool_Delete(pool);
         return NULL;
@@ -197,49 +290,86 @@ picture_pool_t *picture_pool_Reserve(picture_pool_t *master, int count)
 
 void picture_pool_Delete(picture_pool_t *pool)
 {
+    picture_pool_t *root = pool->root;
+    bool last = false;
+
+    vlc_mutex_lock(&root->lock);
     for (int i = 0; i < pool->picture_count; i++) {
         picture_t *picture = pool->picture[i];
         if (pool->master) {
             for (int j = 0; j < pool->master->picture_count; j++) {
-                if (pool->master->picture[j] == picture)
+                if (pool->master->picture[j] == picture) {
                     pool->master->picture_reserved[j] = false;
+                    picture->gc.p_sys->pool    = pool->master;
+                    picture->gc.p_sys->index   = j;
+                    picture->gc.p_sys->is_free = false;
+                }
             }
         } else {
             picture_gc_sys_t *gc_sys = picture->gc.p_sys;
 
             assert(!pool->picture_reserved[i]);
 
-            /* Restore the original garbage collector */
-            if (atomic_fetch_add(&picture->gc.refcount, 1) == 0)
-            {   /* Simple case: the picture is not locked, destroy it now. */
+            if (gc_sys->is_free)
+            {   /* Simple case: the picture is not in use, restore the
+                 * original garbage collector and destroy it below. */
                 picture->gc.pf_destroy = gc_sys->destroy;
                 picture->gc.p_sys      = gc_sys->destroy_sys;
+                atomic_store(&picture->gc.refcount, 1);
                 free(gc_sys);
             }
-            else /* Intricate case: the picture is still locked and the gc
-                    cannot be modified (w/o memory synchronization). */
-                atomic_store(&gc_sys->zombie, true);
-
-            picture_Release(picture);
+            else /* Intricate case: the picture is still in use, Destroy()
+                    will restore the gc when it is released. */
+                pool->picture[i] = NULL;
         }
     }
+    if (pool->master)
+        ResetFree(pool->master);
+    else {
+        pool->deleted = true;
+        last = pool->out == 0;
+    }
+    vlc_mutex_unlock(&root->lock);
+
+    if (!pool->master)
+        for (int i = 0; i < pool->picture_count; i++)
+            if (pool->picture[i] != NULL)
+                picture_Release(pool->picture[i]);
+
+    free(pool->free);
     free(pool->picture_reserved);
     free(pool->picture);
-    free(pool);
+    if (pool->master || last) {
+        if (!pool->master)
+            vlc_mutex_destroy(&pool->lock);
+        free(pool);
+    }
 }
 
 picture_t *picture_pool_Get(picture_pool_t *pool)
 {
-    for (int i = 0; i < pool->picture_count; i++) {
-        if (pool->picture_reserved[i])
-            continue;
-
-        picture_t *picture = pool->picture[i];
-        if (atomic_load(&picture->gc.refcount) > 0)
+    vlc_mutex_lock(&pool->root->lock);
+    /* Pictures the lock callback refused are tried once, then requeued */
+    for (int tries = pool->free_count; tries > 0; tries--) {
+        picture_t *picture = PopFree(pool);
+        vlc_mutex_unlock(&pool->root->lock);
+
+        assert(atomic_load(&picture->gc.refcount) == 0);
+        int ret = Lock(picture);
+
+        vlc_mutex_lock(&pool->root->lock);
+        if (ret) {
+            pool->stats.lock_failures++;
+            PushFree(pool, picture);
             continue;
+        }
 
-        if (Lock(picture))
-            continue;
+        int used = pool->available - pool->free_count;
+        if (pool->stats.used_max < used)
+            pool->stats.used_max = used;
+        pool->stats.get_count++;
+        pool->root->out++;
+        vlc_mutex_unlock(&pool->root->lock);
 
         /* */
         picture->p_next = NULL;
@@ -247,33 +377,50 @@ picture_t *picture_pool_Get(picture_pool_t *pool)
         picture_Hold(picture);
         return picture;
     }
+    pool->stats.exhausted_count++;
+    vlc_mutex_unlock(&pool->root->lock);
     return NULL;
 }
 
+void picture_pool_GetStats(picture_pool_t *pool, picture_pool_stats_t *stats)
+{
+    vlc_mutex_lock(&pool->root->lock);
+    *stats = pool->stats;
+    vlc_mutex_unlock(&pool->root->lock);
+}
+
 void picture_pool_NonEmpty(picture_pool_t *pool, bool reset)
 {
     picture_t *old = NULL;
 
+    vlc_mutex_lock(&pool->root->lock);
     for (int i = 0; i < pool->picture_count; i++) {
         if (pool->picture_reserved[i])
             continue;
 
         picture_t *picture = pool->picture[i];
         if (reset) {
-            if (atomic_load(&picture->gc.refcount) > 0)
+            if (atomic_load(&picture->gc.refcount) > 0) {
                 Unlock(picture);
+                pool->root->out--;
+            }
             atomic_store(&picture->gc.refcount, 0);
         } else if (atomic_load(&picture->gc.refcount) == 0) {
+            vlc_mutex_unlock(&pool->root->lock);
             return;
         } else if (!old || picture->gc.p_sys->tick < old->gc.p_sys->tick) {
             old = picture;
         }
     }
     if (!reset && old) {
-        if (atomic_load(&old->gc.refcount) > 0)
+        if (atomic_load(&old->gc.refcount) > 0) {
             Unlock(old);
+            pool->root->out--;
+        }
         atomic_store(&old->gc.refcount, 0);
     }
+    ResetFree(pool);
+    vlc_mutex_unlock(&pool->root->lock);
 }
 int picture_pool_GetSize(picture_pool_t *pool)
 {
@@ -283,11 +430,29 @@ int picture_pool_GetSize(picture_pool_t *pool)
 static void Destroy(picture_t *picture)
 {
     picture_gc_sys_t *gc_sys = picture->gc.p_sys;
+    picture_pool_t *root = gc_sys->root;
+    bool zombie, last = false;
 
     Unlock(picture);
 
-    if (atomic_load(&gc_sys->zombie))
-    {   /* Picture from an already destroyed pool */
+    vlc_mutex_lock(&root->lock);
+    assert(root->out > 0);
+    root->out--;
+    zombie = root->deleted;
+    if (!zombie)
+        PushFree(gc_sys->pool, picture); /* Back to the pool */
+    else
+        last = root->out == 0;
+    vlc_mutex_unlock(&root->lock);
+
+    if (last)
+    {   /* Last picture of an already deleted pool */
+        vlc_mutex_destroy(&root->lock);
+        free(root);
+    }
+
+    if (zombie)
+    {   /* Picture from an already deleted pool */
         picture->gc.pf_destroy = gc_sys->destroy;
         picture->gc.p_sys      = gc_sys->destroy_sys;
         free(gc_sys);
@@ -0,0 +1,151 @@
+/*****************************************************************************
+ * startcode.c: Annex B start code (00 00 01) scanning
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_block_helper.h>
+#include <vlc_cpu.h>
+
+#if defined (__i386__) || defined (__x86_64__)
+# ifdef __SSE2__
+#  include <emmintrin.h>
+# endif
+# if VLC_GCC_VERSION(4, 9) || defined (__clang__)
+#  include <immintrin.h>
+#  define VLC_AVX2 __attribute__ ((__target__ ("avx2")))
+# endif
+#elif defined (__ARM_NEON__) || defined (__ARM_NEON)
+# include <arm_neon.h>
+# define SCAN_NEON 1
+#endif
+
+/* Only every third byte is read: the one where the 01 may be */
+static const uint8_t *FindScalar (const uint8_t *p, const uint8_t *end)
+{
+    for (p += 2; p < end;)
+    {
+        if (p[0] > 1)
+            p += 3;
+        else if (p[0] == 0)
+            p++;
+        else if (p[-1] == 0 && p[-2] == 0)
+            return p - 2;
+        else
+            p += 3;
+    }
+    return NULL;
+}
+
+/* The vector versions test 16 or 32 positions at once, reading two bytes
+ * past the last one; the scalar code deals with the tail. */
+#ifdef __SSE2__
+static const uint8_t *FindSSE2 (const uint8_t *p, const uint8_t *end)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    const __m128i one = _mm_set1_epi8 (1);
+
+    while (end - p >= 16 + 2)
+    {
+        __m128i a = _mm_loadu_si128 ((const __m128i *)p);
+        __m128i b = _mm_loadu_si128 ((const __m128i *)(p + 1));
+        __m128i c = _mm_loadu_si128 ((const __m128i *)(p + 2));
+        __m128i m = _mm_and_si128 (_mm_and_si128 (_mm_cmpeq_epi8 (a, zero),
+                                                  _mm_cmpeq_epi8 (b, zero)),
+                                   _mm_cmpeq_epi8 (c, one));
+        unsigned mask = _mm_movemask_epi8 (m);
+
+        if (mask)
+            return p + ctz (mask);
+        p += 16;
+    }
+    return FindScalar (p, end);
+}
+#endif
+
+#ifdef VLC_AVX2
+VLC_AVX2
+static const uint8_t *FindAVX2 (const uint8_t *p, const uint8_t *end)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    const __m256i one = _mm256_set1_epi8 (1);
+
+    while (end - p >= 32 + 2)
+    {
+        __m256i a = _mm256_loadu_si256 ((const __m256i *)p);
+        __m256i b = _mm256_loadu_si256 ((const __m256i *)(p + 1));
+        __m256i c = _mm256_loadu_si256 ((const __m256i *)(p + 2));
+        __m256i m = _mm256_and_si256 (_mm256_and_si256 (
+                                          _mm256_cmpeq_epi8 (a, zero),
+                                          _mm256_cmpeq_epi8 (b, zero)),
+                                      _mm256_cmpeq_epi8 (c, one));
+        unsigned mask = _mm256_movemask_epi8 (m);
+
+        if (mask)
+            return p + ctz (mask);
+        p += 32;
+    }
+    return FindScalar (p, end);
+}
+#endif
+
+#ifdef SCAN_NEON
+static const uint8_t *FindNEON (const uint8_t *p, const uint8_t *end)
+{
+    const uint8x16_t zero = vdupq_n_u8 (0);
+    const uint8x16_t one = vdupq_n_u8 (1);
+
+    while (end - p >= 16 + 2)
+    {
+        uint8x16_t m = vandq_u8 (vandq_u8 (vceqq_u8 (vld1q_u8 (p), zero),
+                                           vceqq_u8 (vld1q_u8 (p + 1), zero)),
+                                 vceqq_u8 (vld1q_u8 (p + 2), one));
+        uint64x2_t m64 = vreinterpretq_u64_u8 (m);
+
+        /* There is no movemask: locate the match with the scalar code */
+        if (vgetq_lane_u64 (m64, 0) | vgetq_lane_u64 (m64, 1))
+            return FindScalar (p, p + 16 + 2);
+        p += 16;
+    }
+    return FindScalar (p, end);
+}
+#endif
+
+/**
+ * Finds the first 00 00 01 sequence lying entirely within [p, end).
+ * \return a pointer to its first byte, or NULL if there is none
+ */
+const uint8_t *block_FindAnnexBStartcode (const uint8_t *p,
+                                          const uint8_t *end)
+{
+#ifdef VLC_AVX2
+    if (vlc_CPU_AVX2 ())
+        return FindAVX2 (p, end);
+#endif
+#if defined (__SSE2__)
+    return FindSSE2 (p, end);
+#elif defined (SCAN_NEON)
+    return FindNEON (p, end);
+#else
+    return FindScalar (p, end);
+#endif
+}
@@ -43,6 +43,7 @@
 #include <vlc_plugin.h>
 #include <vlc_modules.h>
 #include <vlc_fs.h>
+#include <vlc_block.h>
 #include "libvlc.h"
 #include "config/configuration.h"
 #include "modules/modules.h"
@@ -52,7 +53,15 @@ static struct
     vlc_mutex_t lock;
     module_t *head;
     unsigned usage;
-} modules = { VLC_STATIC_MUTEX, NULL, 0 };
+    block_t *caches; /**< Plugins cache files the modules point into */
+} modules = { VLC_STATIC_MUTEX, NULL, 0, NULL };
+
+/** Modules sorted by capability, then from the highest score to the lowest */
+static struct
+{
+    module_t **list;
+    size_t count;
+} caps = { NULL, 0 };
 
 /*****************************************************************************
  * Local prototypes
@@ -61,6 +70,8 @@ static struct
 static void AllocateAllPlugins (vlc_object_t *);
 #endif
 static module_t *module_InitStatic (vlc_plugin_cb);
+static void module_SortCaps (void);
+static void module_UnsortCaps (void);
 
 static void module_StoreBank (module_t *module)
 {
@@ -113,6 +124,7 @@ void module_InitBank (void)
         if (likely(module != NULL))
             module_StoreBank (module);
         config_SortConfig ();
+        module_SortCaps ();
     }
     modules.usage++;
 
@@ -133,6 +145,7 @@ void module_InitBank (void)
 void module_EndBank (bool b_plugins)
 {
     module_t *head = NULL;
+    block_t *caches = NULL;
 
     /* If plugins were _not_ loaded, then the caller still has the bank lock
      * from module_InitBank(). */
@@ -145,8 +158,11 @@ void module_EndBank (bool b_plugins)
     if (--modules.usage == 0)
     {
         config_UnsortConfig ();
+        module_UnsortCaps ();
         head = modules.head;
         modules.head = NULL;
+        caches = modules.caches;
+        modules.caches = NULL;
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -164,6 +180,7 @@ void module_EndBank (bool b_plugins)
 #endif
         vlc_module_destroy (module);
     }
+    block_ChainRelease (caches);
 }
 
 #undef module_LoadPlugins
@@ -187,6 +204,8 @@ size_t module_LoadPlugins (vlc_object_t *obj)
 #endif
         config_UnsortConfig ();
         config_SortConfig ();
+        module_UnsortCaps ();
+        module_SortCaps ();
     }
     vlc_mutex_unlock (&modules.lock);
 
@@ -244,11 +263,39 @@ module_t **module_list_get (size_t *n)
 static int modulecmp (const void *a, const void *b)
 {
     const module_t *const *ma = a, *const *mb = b;
+    int ret = strcmp (module_get_capability (*ma),
+                      module_get_capability (*mb));
+
+    if (ret)
+        return ret;
     /* Note that qsort() uses _ascending_ order,
      * so the smallest module is the one with the biggest score. */
     return (*mb)->i_score - (*ma)->i_score;
 }
 
+/**
+ * Index the modules by capability, so that lookups need not sort the bank.
+ */
+static void module_SortCaps (void)
+{
+    size_t count;
+    module_t **list = module_list_get (&count);
+
+    if (unlikely(list == NULL))
+        return;
+
+    qsort (list, count, sizeof (*list), modulecmp);
+    caps.list = list;
+    caps.count = count;
+}
+
+static void module_UnsortCaps (void)
+{
+    module_list_free (caps.list);
+    caps.list = NULL;
+    caps.count = 0;
+}
+
 /**
  * Builds a sorted list of all VLC modules with a given capability.
  * The list is sorted from the highest module score to the lowest.
@@ -259,36 +306,31 @@ static int modulecmp (const void *a, const void *b)
  */
 ssize_t module_list_cap (module_t ***restrict list, const char *cap)
 {
-    /* TODO: This is quite inefficient. List should be sorted by capability. */
-    ssize_t n = 0;
+    size_t lo = 0, hi = caps.count;
 
     assert (list != NULL);
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
+    /* Find the first module with the capability */
+    while (lo < hi)
     {
-         if (module_provides (mod, cap))
-             n++;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 n++;
+        size_t mid = (lo + hi) / 2;
+
+        if (strcmp (module_get_capability (caps.list[mid]), cap) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
 
+    size_t n = 0;
+    while (lo + n < caps.count && module_provides (caps.list[lo + n], cap))
+        n++;
+
     module_t **tab = malloc (sizeof (*tab) * n);
     *list = tab;
     if (unlikely(tab == NULL))
         return -1;
 
-    for (module_t *mod = modules.head; mod != NULL; mod = mod->next)
-    {
-         if (module_provides (mod, cap))
-             *(tab++)= mod;
-         for (module_t *subm = mod->submodule; subm != NULL; subm = subm->next)
-             if (module_provides (subm, cap))
-                 *(tab++) = subm;
-    }
-
-    assert (tab == *list + n);
-    qsort (*list, n, sizeof (*tab), modulecmp);
+    memcpy (tab, caps.list + lo, sizeof (*tab) * n);
     return n;
 }
 
@@ -375,12 +417,13 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
 {
     module_bank_t bank;
     module_cache_t *cache = NULL;
+    block_t *file = NULL;
     size_t count = 0;
 
     switch( mode )
     {
         case CACHE_USE:
-            count = CacheLoad( p_this, path, &cache );
+            count = CacheLoad( p_this, path, &cache, &file );
             break;
         case CACHE_RESET:
             CacheDelete( p_this, path );
@@ -405,14 +448,31 @@ static void AllocatePluginPath (vlc_object_t *p_this, const char *path,
     switch( mode )
     {
         case CACHE_USE:
+        {
             /* Discard unmatched cache entries */
+            bool b_stale = bank.i_cache != count;
+
             for( size_t i = 0; i < count; i++ )
             {
                 if (cache[i].p_module != NULL)
+                {
                    vlc_module_destroy (cache[i].p_module);
-                free (cache[i].path);
+                   b_stale = true;
+                }
             }
             free( cache );
+
+            /* The matched modules point into the file content */
+            if( file != NULL )
+                block_ChainAppend( &modules.caches, file );
+
+            /* Do not rewrite the cache if it had every plug-in */
+            if( !b_stale )
+            {
+                CacheFree (bank.cache, bank.i_cache);
+                break;
+            }
+        }
         case CACHE_RESET:
             CacheSave (p_this, path, bank.cache, bank.i_cache);
         case CACHE_IGNORE:
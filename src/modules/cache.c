@@ -39,6 +39,8 @@
 #include <assert.h>
 
 #include <vlc_common.h>
+#include <vlc_arrays.h>
+#include <vlc_block.h>
 #include "libvlc.h"
 
 #include <vlc_plugin.h>
@@ -57,7 +59,7 @@
 #ifdef HAVE_DYNAMIC_PLUGINS
 /* Sub-version number
  * (only used to avoid breakage in dev version when cache structure changes) */
-#define CACHE_SUBVERSION_NUM 22
+#define CACHE_SUBVERSION_NUM 23
 
 /* Cache filename */
 #define CACHE_NAME "plugins.dat"
@@ -78,8 +80,27 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
     free( path );
 }
 
+/* The whole file is loaded in memory and used in place: the strings are
+ * not copied, but referred to by their offset in the string table. */
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    const char    *strings;
+    size_t         strings_size;
+} cache_file_t;
+
+static int CacheRead (cache_file_t *file, void *buf, size_t len)
+{
+    if ((size_t)(file->end - file->p) < len)
+        return -1;
+    memcpy (buf, file->p, len);
+    file->p += len;
+    return 0;
+}
+
 #define LOAD_IMMEDIATE(a) \
-    if (fread (&(a), sizeof (char), sizeof (a), file) != sizeof (a)) \
+    if (CacheRead (file, &(a), sizeof (a))) \
         goto error
 #define LOAD_FLAG(a) \
     do { \
@@ -90,38 +111,26 @@ void CacheDelete( vlc_object_t *obj, const char *dir )
         (a) = b; \
     } while (0)
 
-static int CacheLoadString (char **p, FILE *file)
+static int CacheLoadString (char **p, cache_file_t *file)
 {
-    char *psz = NULL;
-    uint16_t size;
+    uint32_t offset;
 
-    LOAD_IMMEDIATE (size);
-    if (size > 16384)
+    LOAD_IMMEDIATE (offset);
+    if (offset >= file->strings_size)
     {
 error:
         return -1;
     }
 
-    if (size > 0)
-    {
-        psz = malloc (size+1);
-        if (unlikely(psz == NULL))
-            goto error;
-        if (fread (psz, 1, size, file) != size)
-        {
-            free (psz);
-            goto error;
-        }
-        psz[size] = '\0';
-    }
-    *p = psz;
+    /* Offset zero is the empty string, loaded as NULL */
+    *p = (offset != 0) ? (char *)file->strings + offset : NULL;
     return 0;
 }
 
 #define LOAD_STRING(a) \
     if (CacheLoadString (&(a), file)) goto error
 
-static int CacheLoadConfig (module_config_t *cfg, FILE *file)
+static int CacheLoadConfig (module_config_t *cfg, cache_file_t *file)
 {
     LOAD_IMMEDIATE (cfg->i_type);
     LOAD_IMMEDIATE (cfg->i_short);
@@ -139,6 +148,7 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
     if (IsConfigStringType (cfg->i_type))
     {
         LOAD_STRING (cfg->orig.psz);
+        /* The current value is the only string that can change */
         if (cfg->orig.psz != NULL)
             cfg->value.psz = strdup (cfg->orig.psz);
         else
@@ -151,9 +161,8 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
         for (unsigned i = 0; i < cfg->list_count; i++)
         {
             LOAD_STRING (cfg->list.psz[i]);
-            if (cfg->list.psz[i] == NULL /* NULL -> empty string */
-             && (cfg->list.psz[i] = calloc (1, 1)) == NULL)
-                goto error;
+            if (cfg->list.psz[i] == NULL) /* NULL -> empty string */
+                cfg->list.psz[i] = (char *)file->strings;
         }
     }
     else
@@ -174,9 +183,8 @@ static int CacheLoadConfig (module_config_t *cfg, FILE *file)
     for (unsigned i = 0; i < cfg->list_count; i++)
     {
         LOAD_STRING (cfg->list_text[i]);
-        if (cfg->list_text[i] == NULL /* NULL -> empty string */
-         && (cfg->list_text[i] = calloc (1, 1)) == NULL)
-            goto error;
+        if (cfg->list_text[i] == NULL) /* NULL -> empty string */
+            cfg->list_text[i] = (char *)file->strings;
     }
 
     return 0;
@@ -184,7 +192,7 @@ error:
     return -1; /* FIXME: leaks */
 }
 
-static int CacheLoadModuleConfig (module_t *module, FILE *file)
+static int CacheLoadModuleConfig (module_t *module, cache_file_t *file)
 {
     uint16_t lines;
 
@@ -196,7 +204,7 @@ static int CacheLoadModuleConfig (module_t *module, FILE *file)
     /* Allocate memory */
     if (lines)
     {
-        module->p_config = malloc (lines * sizeof (module_config_t));
+        module->p_config = calloc (lines, sizeof (module_config_t));
         if (unlikely(module->p_config == NULL))
         {
             module->confsize = 0;
@@ -216,6 +224,12 @@ error:
     return -1; /* FIXME: leaks */
 }
 
+static int CacheCompare (const void *a, const void *b)
+{
+    const module_cache_t *ca = a, *cb = b;
+
+    return strcmp (ca->path, cb->path);
+}
 
 /**
  * Loads a plugins cache file.
@@ -224,26 +238,33 @@ error:
  * will in turn be queried by AllocateAllPlugins() to see if it needs to
  * actually load the dynamically loadable module.
  * This allows us to only fully load plugins when they are actually used.
+ *
+ * The strings of the cached modules, and the paths of the cache entries,
+ * point into the file content: *blockp must outlive them.
  */
-size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
+size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r,
+                  block_t **blockp )
 {
     char *psz_filename;
-    FILE *file;
-    int i_size, i_read;
+    block_t *block;
+    int i_size;
     char p_cachestring[sizeof(CACHE_STRING)];
     size_t i_cache;
     int32_t i_marker;
+    uint32_t i_strings, i_strings_size;
 
     assert( dir != NULL );
 
     *r = NULL;
+    *blockp = NULL;
     if( asprintf( &psz_filename, "%s"DIR_SEP CACHE_NAME, dir ) == -1 )
         return 0;
 
     msg_Dbg( p_this, "loading plugins cache file %s", psz_filename );
 
-    file = vlc_fopen( psz_filename, "rb" );
-    if( !file )
+    /* This maps the file, if the OS can */
+    block = block_FilePath( psz_filename );
+    if( block == NULL )
     {
         msg_Warn( p_this, "cannot read %s (%m)",
                   psz_filename );
@@ -252,14 +273,18 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
     }
     free( psz_filename );
 
+    cache_file_t cachefile = {
+        .p = block->p_buffer,
+        .end = block->p_buffer + block->i_buffer,
+    }, *file = &cachefile;
+
     /* Check the file is a plugins cache */
     i_size = sizeof(CACHE_STRING) - 1;
-    i_read = fread( p_cachestring, 1, i_size, file );
-    if( i_read != i_size ||
+    if( CacheRead( file, p_cachestring, i_size ) ||
         memcmp( p_cachestring, CACHE_STRING, i_size ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+        block_Release( block );
         return 0;
     }
 
@@ -267,53 +292,80 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
     /* Check for distribution specific version */
     char p_distrostring[sizeof( DISTRO_VERSION )];
     i_size = sizeof( DISTRO_VERSION ) - 1;
-    i_read = fread( p_distrostring, 1, i_size, file );
-    if( i_read != i_size ||
+    if( CacheRead( file, p_distrostring, i_size ) ||
         memcmp( p_distrostring, DISTRO_VERSION, i_size ) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache" );
-        fclose( file );
+        block_Release( block );
         return 0;
     }
 #endif
 
     /* Check Sub-version number */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) || i_marker != CACHE_SUBVERSION_NUM )
+    if( CacheRead( file, &i_marker, sizeof(i_marker) ) ||
+        i_marker != CACHE_SUBVERSION_NUM )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
+        block_Release( block );
         return 0;
     }
 
     /* Check header marker */
-    i_read = fread( &i_marker, 1, sizeof(i_marker), file );
-    if( i_read != sizeof(i_marker) ||
-        i_marker != ftell( file ) - (int)sizeof(i_marker) )
+    if( CacheRead( file, &i_marker, sizeof(i_marker) ) ||
+        i_marker != (file->p - block->p_buffer) - (int)sizeof(i_marker) )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(corrupted header)" );
-        fclose( file );
+        block_Release( block );
         return 0;
     }
 
-    if (fread( &i_cache, 1, sizeof(i_cache), file ) != sizeof(i_cache) )
+    /* Locate the string table, which ends the file */
+    if( CacheRead( file, &i_strings, sizeof(i_strings) ) ||
+        CacheRead( file, &i_strings_size, sizeof(i_strings_size) ) ||
+        i_strings < (size_t)(file->p - block->p_buffer) ||
+        i_strings > block->i_buffer ||
+        i_strings_size == 0 ||
+        i_strings_size > block->i_buffer - i_strings ||
+        block->p_buffer[i_strings] != '\0' ||
+        block->p_buffer[i_strings + i_strings_size - 1] != '\0' )
+    {
+        msg_Warn( p_this, "This doesn't look like a valid plugins cache "
+                  "(corrupted header)" );
+        block_Release( block );
+        return 0;
+    }
+    file->end = block->p_buffer + i_strings;
+    file->strings = (const char *)block->p_buffer + i_strings;
+    file->strings_size = i_strings_size;
+
+    if( CacheRead( file, &i_cache, sizeof(i_cache) ) ||
+        i_cache > block->i_buffer )
     {
         msg_Warn( p_this, "This doesn't look like a valid plugins cache "
                   "(file too short)" );
-        fclose( file );
+        block_Release( block );
         return 0;
     }
 
-    module_cache_t *cache = NULL;
+    module_cache_t *cache = malloc( i_cache * sizeof (*cache) );
+    if( unlikely(cache == NULL) )
+    {
+        block_Release( block );
+        return 0;
+    }
 
-    for (size_t count = 0; count < i_cache;)
+    for (size_t count = 0; count < i_cache; count++)
     {
+        module_cache_t *entry = cache + count;
         module_t *module;
         int i_submodules;
 
         module = vlc_module_create (NULL);
+        if (unlikely(module == NULL))
+            goto error;
+        module->b_cached = true;
 
         /* Load additional infos */
         LOAD_STRING(module->psz_shortname);
@@ -348,7 +400,9 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
         while( i_submodules-- )
         {
             module_t *submodule = vlc_module_create (module);
-            free (submodule->pp_shortcuts);
+            if (unlikely(submodule == NULL))
+                goto error;
+            submodule->b_cached = true;
             LOAD_STRING(submodule->psz_shortname);
             LOAD_STRING(submodule->psz_longname);
 
@@ -367,33 +421,67 @@ size_t CacheLoad( vlc_object_t *p_this, const char *dir, module_cache_t **r )
             LOAD_IMMEDIATE(submodule->i_score);
         }
 
-        char *path;
-        struct stat st;
-
         /* Load common info */
-        LOAD_STRING(path);
-        if (path == NULL)
+        LOAD_STRING(entry->path);
+        if (entry->path == NULL)
             goto error;
-        LOAD_IMMEDIATE(st.st_mtime);
-        LOAD_IMMEDIATE(st.st_size);
-
-        CacheAdd (&cache, &count, path, &st, module);
-        free (path);
-        /* TODO: deal with errors */
+        LOAD_IMMEDIATE(entry->mtime);
+        LOAD_IMMEDIATE(entry->size);
+        entry->p_module = module;
     }
-    fclose( file );
+
+    /* Sort the entries by path for CacheFind() */
+    qsort (cache, i_cache, sizeof (*cache), CacheCompare);
 
     *r = cache;
+    *blockp = block;
     return i_cache;
 
 error:
     msg_Warn( p_this, "plugins cache not loaded (corrupted)" );
 
-    /* TODO: cleanup */
-    fclose( file );
+    /* TODO: cleanup (the modules loaded so far are leaked) */
+    free( cache );
+    block_Release( block );
     return 0;
 }
 
+/**
+ * Frees what a module loaded from the cache does not share with the cache
+ * file: the tables and the current configuration values.
+ */
+void CacheFreeModule (module_t *module)
+{
+    assert (module->b_cached);
+
+    for (size_t i = 0; i < module->confsize; i++)
+    {
+        module_config_t *cfg = module->p_config + i;
+
+        if (IsConfigStringType (cfg->i_type))
+        {
+            free (cfg->value.psz);
+            if (cfg->list_count)
+                free (cfg->list.psz);
+        }
+        else
+        if (cfg->list_count)
+            free (cfg->list.i);
+        free (cfg->list_text);
+    }
+    free (module->p_config);
+    free (module->pp_shortcuts);
+}
+
+/* The strings are gathered in a table written after all the modules */
+typedef struct
+{
+    vlc_dictionary_t index; /* offset of each string already in the table */
+    char  *table;
+    size_t size;
+    size_t alloc;
+} cache_strings_t;
+
 #define SAVE_IMMEDIATE( a ) \
     if (fwrite (&(a), sizeof(a), 1, file) != 1) \
         goto error
@@ -403,24 +491,53 @@ error:
         SAVE_IMMEDIATE(b); \
     } while (0)
 
-static int CacheSaveString (FILE *file, const char *str)
+static int CacheSaveString (FILE *file, cache_strings_t *strings,
+                            const char *str)
 {
-    uint16_t size = (str != NULL) ? strlen (str) : 0;
+    uint32_t offset = 0; /* the empty string */
 
-    SAVE_IMMEDIATE (size);
-    if (size != 0 && fwrite (str, 1, size, file) != size)
+    if (str != NULL && *str)
     {
-error:
-        return -1;
+        void *val = vlc_dictionary_value_for_key (&strings->index, str);
+
+        if (val != kVLCDictionaryNotFound)
+            offset = (uintptr_t)val;
+        else
+        {
+            size_t len = strlen (str) + 1;
+
+            if (strings->size + len > UINT32_MAX)
+                goto error;
+            if (strings->size + len > strings->alloc)
+            {
+                size_t alloc = __MAX (2 * strings->alloc, strings->size + len);
+                char *table = realloc (strings->table, alloc);
+
+                if (unlikely(table == NULL))
+                    goto error;
+                strings->table = table;
+                strings->alloc = alloc;
+            }
+            memcpy (strings->table + strings->size, str, len);
+            offset = strings->size;
+            strings->size += len;
+            vlc_dictionary_insert (&strings->index, str,
+                                   (void *)(uintptr_t)offset);
+        }
     }
+
+    SAVE_IMMEDIATE (offset);
     return 0;
+error:
+    return -1;
 }
 
 #define SAVE_STRING( a ) \
-    if (CacheSaveString (file, (a))) \
+    if (CacheSaveString (file, strings, (a))) \
         goto error
 
-static int CacheSaveConfig (FILE *file, const module_config_t *cfg)
+static int CacheSaveConfig (FILE *file, cache_strings_t *strings,
+                            const module_config_t *cfg)
 {
     SAVE_IMMEDIATE (cfg->i_type);
     SAVE_IMMEDIATE (cfg->i_short);
@@ -461,7 +578,8 @@ error:
     return -1;
 }
 
-static int CacheSaveModuleConfig (FILE *file, const module_t *module)
+static int CacheSaveModuleConfig (FILE *file, cache_strings_t *strings,
+                                  const module_t *module)
 {
     uint16_t lines = module->confsize;
 
@@ -470,7 +588,7 @@ static int CacheSaveModuleConfig (FILE *file, const module_t *module)
     SAVE_IMMEDIATE (lines);
 
     for (size_t i = 0; i < lines; i++)
-        if (CacheSaveConfig (file, module->p_config + i))
+        if (CacheSaveConfig (file, strings, module->p_config + i))
            goto error;
 
     return 0;
@@ -524,40 +642,24 @@ out:
     free (filename);
     free (tmpname);
 
+    CacheFree (entries, n);
+}
+
+/**
+ * Releases a table of cache entries built with CacheAdd().
+ */
+void CacheFree (module_cache_t *entries, size_t n)
+{
     for (size_t i = 0; i < n; i++)
         free (entries[i].path);
     free (entries);
 }
 
-static int CacheSaveSubmodule (FILE *, const module_t *);
+static int CacheSaveSubmodule (FILE *, cache_strings_t *, const module_t *);
 
-static int CacheSaveBank (FILE *file, const module_cache_t *cache,
-                          size_t i_cache)
+static int CacheSaveModules (FILE *file, cache_strings_t *strings,
+                             const module_cache_t *cache, size_t i_cache)
 {
-    uint32_t i_file_size = 0;
-
-    /* Contains version number */
-    if (fputs (CACHE_STRING, file) == EOF)
-        goto error;
-#ifdef DISTRO_VERSION
-    /* Allow binary maintaner to pass a string to detect new binary version*/
-    if (fputs( DISTRO_VERSION, file ) == EOF)
-        goto error;
-#endif
-    /* Sub-version number (to avoid breakage in the dev version when cache
-     * structure changes) */
-    i_file_size = CACHE_SUBVERSION_NUM;
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1 )
-        goto error;
-
-    /* Header marker */
-    i_file_size = ftell( file );
-    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
-        goto error;
-
-    if (fwrite( &i_cache, sizeof (i_cache), 1, file) != 1)
-        goto error;
-
     for (unsigned i = 0; i < i_cache; i++)
     {
         module_t *module = cache[i].p_module;
@@ -576,14 +678,14 @@ static int CacheSaveBank (FILE *file, const module_cache_t *cache,
         SAVE_IMMEDIATE(module->b_unloadable);
 
         /* Config stuff */
-        if (CacheSaveModuleConfig (file, module))
+        if (CacheSaveModuleConfig (file, strings, module))
             goto error;
 
         SAVE_STRING(module->domain);
 
         i_submodule = module->submodule_count;
         SAVE_IMMEDIATE( i_submodule );
-        if (CacheSaveSubmodule (file, module->submodule))
+        if (CacheSaveSubmodule (file, strings, module->submodule))
             goto error;
 
         /* Save common info */
@@ -591,20 +693,84 @@ static int CacheSaveBank (FILE *file, const module_cache_t *cache,
         SAVE_IMMEDIATE(cache[i].mtime);
         SAVE_IMMEDIATE(cache[i].size);
     }
+    return 0;
+
+error:
+    return -1;
+}
+
+static int CacheSaveBank (FILE *file, const module_cache_t *cache,
+                          size_t i_cache)
+{
+    uint32_t i_file_size = 0;
+    long i_strings_pos;
+    cache_strings_t strings;
+    uint32_t i_strings[2];
+
+    /* Offset zero is the empty string */
+    vlc_dictionary_init (&strings.index, 4096);
+    strings.table = calloc (1, 1);
+    strings.size = 1;
+    strings.alloc = 1;
+    if (unlikely(strings.table == NULL))
+        goto error;
+
+    /* Contains version number */
+    if (fputs (CACHE_STRING, file) == EOF)
+        goto error;
+#ifdef DISTRO_VERSION
+    /* Allow binary maintaner to pass a string to detect new binary version*/
+    if (fputs( DISTRO_VERSION, file ) == EOF)
+        goto error;
+#endif
+    /* Sub-version number (to avoid breakage in the dev version when cache
+     * structure changes) */
+    i_file_size = CACHE_SUBVERSION_NUM;
+    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1 )
+        goto error;
+
+    /* Header marker */
+    i_file_size = ftell( file );
+    if (fwrite (&i_file_size, sizeof (i_file_size), 1, file) != 1)
+        goto error;
+
+    /* String table offset and size, filled in at the end */
+    i_strings_pos = ftell (file);
+    i_strings[0] = i_strings[1] = 0;
+    if (fwrite (i_strings, sizeof (i_strings), 1, file) != 1)
+        goto error;
+
+    if (fwrite( &i_cache, sizeof (i_cache), 1, file) != 1)
+        goto error;
+
+    if (CacheSaveModules (file, &strings, cache, i_cache))
+        goto error;
+
+    i_strings[0] = ftell (file);
+    i_strings[1] = strings.size;
+    if (fwrite (strings.table, 1, strings.size, file) != strings.size
+     || fseek (file, i_strings_pos, SEEK_SET)
+     || fwrite (i_strings, sizeof (i_strings), 1, file) != 1)
+        goto error;
 
     if (fflush (file)) /* flush libc buffers */
         goto error;
+    vlc_dictionary_clear (&strings.index, NULL, NULL);
+    free (strings.table);
     return 0; /* success! */
 
 error:
+    vlc_dictionary_clear (&strings.index, NULL, NULL);
+    free (strings.table);
     return -1;
 }
 
-static int CacheSaveSubmodule( FILE *file, const module_t *p_module )
+static int CacheSaveSubmodule( FILE *file, cache_strings_t *strings,
+                               const module_t *p_module )
 {
     if( !p_module )
         return 0;
-    if( CacheSaveSubmodule( file, p_module->next ) )
+    if( CacheSaveSubmodule( file, strings, p_module->next ) )
         goto error;
 
     SAVE_STRING( p_module->psz_shortname );
@@ -649,28 +815,29 @@ void CacheMerge( vlc_object_t *p_this, module_t *p_cache, module_t *p_module )
     p_module->b_loaded = false;
 }
 
+static int CacheCompareKey (const void *key, const void *entry)
+{
+    const module_cache_t *cache = entry;
+
+    return strcmp (key, cache->path);
+}
+
 /**
- * Looks up a plugin file in a table of cached plugins.
+ * Looks up a plugin file in a table of cached plugins, as sorted by
+ * CacheLoad().
  */
 module_t *CacheFind (module_cache_t *cache, size_t count,
                      const char *path, const struct stat *st)
 {
-    while (count > 0)
-    {
-        if (cache->path != NULL
-         && !strcmp (cache->path, path)
-         && cache->mtime == st->st_mtime
-         && cache->size == st->st_size)
-       {
-            module_t *module = cache->p_module;
-            cache->p_module = NULL;
-            return module;
-       }
-       cache++;
-       count--;
-    }
-
-    return NULL;
+    cache = bsearch (path, cache, count, sizeof (*cache), CacheCompareKey);
+    if (cache == NULL
+     || cache->mtime != st->st_mtime
+     || cache->size != st->st_size)
+        return NULL;
+
+    module_t *module = cache->p_module;
+    cache->p_module = NULL;
+    return module;
 }
 
 /** Adds entry to the cache */
@@ -32,7 +32,7 @@ typedef struct module_cache_t module_cache_t;
 struct module_cache_t
 {
     /* Mandatory cache entry header */
-    char  *path;
+    char  *path; /* not owned by entries from CacheLoad() */
     time_t mtime;
     off_t  size;
 
@@ -78,6 +78,7 @@ struct module_t
 
     bool          b_loaded;        /* Set to true if the dll is loaded */
     bool b_unloadable;                        /**< Can we be dlclosed? */
+    bool b_cached;         /**< Strings belong to the plugins cache file */
 
     /* Callbacks */
     void *pf_activate;
@@ -122,13 +123,16 @@ void module_Unload (module_handle_t);
 /* Plugins cache */
 void   CacheMerge (vlc_object_t *, module_t *, module_t *);
 void   CacheDelete(vlc_object_t *, const char *);
-size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **);
+size_t CacheLoad  (vlc_object_t *, const char *, module_cache_t **,
+                   block_t **);
+void   CacheFreeModule (module_t *);
 
 struct stat;
 
 int CacheAdd (module_cache_t **, size_t *,
               const char *, const struct stat *, module_t *);
 void CacheSave  (vlc_object_t *, const char *, module_cache_t *, size_t);
+void CacheFree  (module_cache_t *, size_t);
 module_t *CacheFind (module_cache_t *, size_t,
                      const char *, const struct stat *);
 
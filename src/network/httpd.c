@@ -40,6 +40,8 @@
 #include <vlc_url.h>
 #include <vlc_mime.h>
 #include <vlc_block.h>
+#include <vlc_atomic.h>
+#include <vlc_cpu.h>
 #include "../libvlc.h"
 
 #include <string.h>
@@ -57,6 +59,13 @@
 #   include <winsock2.h>
 #else
 #   include <sys/socket.h>
+#   include <sys/uio.h>
+#endif
+
+#if defined( HAVE_SYS_EPOLL_H ) && defined( HAVE_SYS_EVENTFD_H )
+#   define HTTPD_EPOLL 1
+#   include <sys/epoll.h>
+#   include <sys/eventfd.h>
 #endif
 
 #if defined( _WIN32 )
@@ -66,8 +75,45 @@
 #define HTTPD_CL_BUFSIZE 10000
 #endif
 
+/* Stream data chunks referenced by one client at a time */
+#define HTTPD_CL_IOV 16
+
+/* Readiness events handled per worker wake-up */
+#define HTTPD_EPOLL_EVENTS 64
+
+/* Deferred answers are also retried this often, without a wake-up */
+#define HTTPD_DEFER_POLL (CLOCK_FREQ / 10)
+
+typedef struct httpd_stream_chunk_t httpd_stream_chunk_t;
+
 static void httpd_ClientClean( httpd_client_t *cl );
 static void httpd_AppendData( httpd_stream_t *stream, uint8_t *p_data, int i_data );
+static void httpd_StreamChunkRelease( httpd_stream_chunk_t *chunk );
+static void httpd_UrlWakeWorkers( httpd_url_t *url );
+
+#ifdef HTTPD_EPOLL
+/* Serves a share of the clients of a host. The URL callbacks still run under
+ * the host lock, but the socket I/O and TLS handshakes do not. */
+typedef struct
+{
+    httpd_host_t   *host;
+    vlc_thread_t    thread;
+
+    int             epfd;
+    int             wakefd;   /* eventfd, registered with a NULL pointer */
+    atomic_bool     b_woken;  /* a wake-up is pending or not needed */
+    atomic_bool     b_reap;   /* some clients must be closed */
+
+    unsigned        i_client;
+
+    /* clients waiting for stream data */
+    int             i_waiting;
+    httpd_client_t  **waiting;
+} httpd_worker_t;
+
+static int httpd_WorkersStart( httpd_host_t *host );
+static void httpd_WorkersStop( httpd_host_t *host );
+#endif
 
 /* each host run in his own thread */
 struct httpd_host_t
@@ -96,6 +142,12 @@ struct httpd_host_t
     int            i_client;
     httpd_client_t **client;
 
+#ifdef HTTPD_EPOLL
+    /* the host thread only accepts, the workers serve the clients */
+    unsigned        i_worker;
+    httpd_worker_t *worker;
+#endif
+
     /* TLS data */
     vlc_tls_creds_t *p_tls;
 };
@@ -116,6 +168,11 @@ struct httpd_url_t
         httpd_callback_t     cb;
         httpd_callback_sys_t *p_sys;
     } catch[HTTPD_MSG_MAX];
+
+#ifdef HTTPD_EPOLL
+    /* clients of this url waiting for data, per worker of the host */
+    atomic_uint *waiting;
+#endif
 };
 
 /* status */
@@ -151,6 +208,7 @@ struct httpd_client_t
     int     fd;
 
     bool    b_stream_mode;
+    bool    b_deferred; /* the URL callback has not answered yet */
     uint8_t i_state;
 
     mtime_t i_activity_date;
@@ -172,6 +230,27 @@ struct httpd_client_t
     httpd_message_t query;  /* client -> httpd */
     httpd_message_t answer; /* httpd -> client */
 
+    /* Stream data shared with the other clients, sent after p_buffer */
+    struct
+    {
+        httpd_stream_chunk_t *chunk;
+        const uint8_t        *p;
+        size_t                i;
+    } shared[HTTPD_CL_IOV];
+    unsigned i_shared_first;
+    unsigned i_shared;
+
+    /* Stream lag statistics (bytes) */
+    int64_t i_lag_max;
+    int64_t i_skipped;
+
+#ifdef HTTPD_EPOLL
+    httpd_worker_t *worker;
+    uint32_t        i_events; /* registered epoll interest */
+    bool            b_waiting;
+    bool            b_kill;   /* URL deleted, must be closed by the worker */
+#endif
+
     /* TLS data */
     vlc_tls_t *p_tls;
 };
@@ -195,17 +274,17 @@ static const http_status_info http_reason[] =
     { 202, "Accepted" },
     { 203, "Non-authoritative information" },
     { 204, "No content" },
-    { 205, "Reset content" },
+    { 205, "Reset content" },*/
     { 206, "Partial content" },
-    { 250, "Low on storage space" },
+  /*{ 250, "Low on storage space" },
     { 300, "Multiple choices" },*/
     { 301, "Moved permanently" },
   /*{ 302, "Moved temporarily" },
-    { 303, "See other" },
+    { 303, "See other" },*/
     { 304, "Not modified" },
-    { 305, "Use proxy" },
-    { 307, "Temporary redirect" },
-    { 400, "Bad request" },*/
+  /*{ 305, "Use proxy" },
+    { 307, "Temporary redirect" },*/
+    { 400, "Bad request" },
     { 401, "Unauthorized" },
   /*{ 402, "Payment Required" },*/
     { 403, "Forbidden" },
@@ -220,9 +299,9 @@ static const http_status_info http_reason[] =
     { 412, "Precondition failed" },
     { 413, "Request entity too large" },
     { 414, "Request-URI too large" },
-    { 415, "Unsupported media Type" },
+    { 415, "Unsupported media Type" },*/
     { 416, "Requested range not satisfiable" },
-    { 417, "Expectation failed" },
+  /*{ 417, "Expectation failed" },
     { 451, "Parameter not understood" },
     { 452, "Conference not found" },
     { 453, "Not enough bandwidth" },*/
@@ -643,13 +722,78 @@ struct httpd_stream_t
     bool        b_has_keyframes;
     int64_t     i_last_keyframe_seen_pos;
 
-    /* circular buffer */
-    int         i_buffer_size;      /* buffer size, can't be reallocated smaller */
-    uint8_t     *p_buffer;          /* buffer */
+    /* Queue of reference counted chunks, shared by all clients */
+    int         i_buffer_size;      /* bytes to keep for late clients */
+    httpd_stream_chunk_t *p_first;
+    httpd_stream_chunk_t *p_last;
     int64_t     i_buffer_pos;       /* absolute position from begining */
     int64_t     i_buffer_last_pos;  /* a new connection will start with that */
+
+    bool        b_drop_slow;        /* disconnect clients that fall behind */
+};
+
+/* Default chunk payload size; larger blocks get a chunk of their own */
+#define HTTPD_STREAM_CHUNK 65536
+
+struct httpd_stream_chunk_t
+{
+    httpd_stream_chunk_t *p_next;
+    atomic_uint i_refs;
+    int64_t     i_pos;  /* absolute position of p_data[0] */
+    size_t      i_data; /* written bytes, grows under the stream lock */
+    size_t      i_size; /* allocated bytes */
+    uint8_t     p_data[];
 };
 
+static void httpd_StreamChunkRelease( httpd_stream_chunk_t *chunk )
+{
+    if( atomic_fetch_sub( &chunk->i_refs, 1 ) == 1 )
+        free( chunk );
+}
+
+/* Must be called with the stream lock held. Points the client at up to
+ * HTTPD_CL_IOV chunks from the position *pi_offset, without copying. If that
+ * position is no longer queued, moves it up to the first chunk after it. */
+static int64_t httpd_StreamAttach( httpd_stream_t *stream, httpd_client_t *cl,
+                                   int64_t *pi_offset )
+{
+    int64_t i_offset = *pi_offset;
+    int64_t i_total = 0;
+    unsigned i = 0;
+
+    assert( cl->i_shared == 0 );
+    for( httpd_stream_chunk_t *chunk = stream->p_first;
+         chunk != NULL && i < HTTPD_CL_IOV; chunk = chunk->p_next )
+    {
+        int64_t i_end = chunk->i_pos + chunk->i_data;
+
+        if( i_end <= i_offset )
+            continue;
+
+        if( chunk->i_pos > i_offset )
+        {
+            /* Only the first chunk may start past the wanted position */
+            if( i > 0 )
+                break;
+            cl->i_skipped += chunk->i_pos - i_offset;
+            *pi_offset = i_offset = chunk->i_pos;
+        }
+
+        size_t i_skip = i_offset - chunk->i_pos;
+
+        atomic_fetch_add( &chunk->i_refs, 1 );
+        cl->shared[i].chunk = chunk;
+        cl->shared[i].p = chunk->p_data + i_skip;
+        cl->shared[i].i = chunk->i_data - i_skip;
+        i_total += cl->shared[i].i;
+        i_offset = i_end;
+        i++;
+    }
+    cl->i_shared_first = 0;
+    cl->i_shared = i;
+    return i_total;
+}
+
 static int httpd_StreamCallBack( httpd_callback_sys_t *p_sys,
                                  httpd_client_t *cl, httpd_message_t *answer,
                                  const httpd_message_t *query )
@@ -664,61 +808,69 @@ static int httpd_StreamCallBack( httpd_callback_sys_t *p_sys,
     if( answer->i_body_offset > 0 )
     {
         int64_t i_write;
-        int     i_pos;
+        int64_t i_lag;
 
 #if 0
         fprintf( stderr, "httpd_StreamCallBack i_body_offset=%lld\n",
                  answer->i_body_offset );
 #endif
 
+        vlc_mutex_lock( &stream->lock );
         if( answer->i_body_offset >= stream->i_buffer_pos )
         {
             /* fprintf( stderr, "httpd_StreamCallBack: no data\n" ); */
+            vlc_mutex_unlock( &stream->lock );
             return VLC_EGENERIC;    /* wait, no data available */
         }
         if( cl->i_keyframe_wait_to_pass >= 0 )
         {
             if( stream->i_last_keyframe_seen_pos <= cl->i_keyframe_wait_to_pass )
+            {
                 /* still waiting for the next keyframe */
+                vlc_mutex_unlock( &stream->lock );
                 return VLC_EGENERIC;
+            }
 
             /* seek to the new keyframe */
             answer->i_body_offset = stream->i_last_keyframe_seen_pos;
             cl->i_keyframe_wait_to_pass = -1;
         }
-        if( answer->i_body_offset + stream->i_buffer_size <
-            stream->i_buffer_pos )
+
+        i_lag = stream->i_buffer_pos - answer->i_body_offset;
+        if( i_lag > cl->i_lag_max )
+            cl->i_lag_max = i_lag;
+
+        if( stream->p_first == NULL ||
+            answer->i_body_offset < stream->p_first->i_pos )
         {
             /* this client isn't fast enough */
+            if( stream->b_drop_slow )
+            {
+                vlc_mutex_unlock( &stream->lock );
+                cl->i_state = HTTPD_CLIENT_DEAD;
+                return VLC_EGENERIC;
+            }
 #if 0
             fprintf( stderr, "fixing i_body_offset (old=%lld new=%lld)\n",
                      answer->i_body_offset, stream->i_buffer_last_pos );
 #endif
+            cl->i_skipped += stream->i_buffer_last_pos - answer->i_body_offset;
             answer->i_body_offset = stream->i_buffer_last_pos;
         }
 
-        i_pos   = answer->i_body_offset % stream->i_buffer_size;
-        i_write = stream->i_buffer_pos - answer->i_body_offset;
-        if( i_write > HTTPD_CL_BUFSIZE )
-        {
-            i_write = HTTPD_CL_BUFSIZE;
-        }
-        else if( i_write <= 0 )
-        {
-            return VLC_EGENERIC;    /* wait, no data available */
-        }
+        i_write = httpd_StreamAttach( stream, cl, &answer->i_body_offset );
+        vlc_mutex_unlock( &stream->lock );
 
-        /* Don't go past the end of the circular buffer */
-        i_write = __MIN( i_write, stream->i_buffer_size - i_pos );
+        if( i_write <= 0 )
+            return VLC_EGENERIC;    /* wait, no data available */
 
         /* using HTTPD_MSG_ANSWER -> data available */
         answer->i_proto  = HTTPD_PROTO_HTTP;
         answer->i_version= 0;
         answer->i_type   = HTTPD_MSG_ANSWER;
 
-        answer->i_body = i_write;
-        answer->p_body = xmalloc( i_write );
-        memcpy( answer->p_body, &stream->p_buffer[i_pos], i_write );
+        answer->i_body = 0;
+        answer->p_body = NULL;
 
         answer->i_body_offset += i_write;
 
@@ -817,7 +969,9 @@ httpd_stream_t *httpd_StreamNew( httpd_host_t *host,
     stream->i_header = 0;
     stream->p_header = NULL;
     stream->i_buffer_size = 5000000;    /* 5 Mo per stream */
-    stream->p_buffer = xmalloc( stream->i_buffer_size );
+    stream->p_first = NULL;
+    stream->p_last = NULL;
+    stream->b_drop_slow = var_InheritBool( host, "http-drop-slow" );
     /* We set to 1 to make life simpler
      * (this way i_body_offset can never be 0) */
     stream->i_buffer_pos = 1;
@@ -854,23 +1008,44 @@ int httpd_StreamHeader( httpd_stream_t *stream, uint8_t *p_data, int i_data )
 
 static void httpd_AppendData( httpd_stream_t *stream, uint8_t *p_data, int i_data )
 {
-    int i_pos = stream->i_buffer_pos % stream->i_buffer_size;
-    int i_count = i_data;
-    while( i_count > 0)
-    {
-        int i_copy;
+    httpd_stream_chunk_t *chunk = stream->p_last;
 
-        i_copy = __MIN( i_count, stream->i_buffer_size - i_pos );
+    /* Fill the last chunk: clients only ever read its bytes written so far */
+    if( chunk != NULL && chunk->i_size - chunk->i_data >= (size_t)i_data )
+    {
+        memcpy( &chunk->p_data[chunk->i_data], p_data, i_data );
+        chunk->i_data += i_data;
+    }
+    else
+    {
+        size_t i_size = __MAX( i_data, HTTPD_STREAM_CHUNK );
+
+        chunk = xmalloc( sizeof( *chunk ) + i_size );
+        chunk->p_next = NULL;
+        atomic_init( &chunk->i_refs, 1 ); /* the stream reference */
+        chunk->i_pos = stream->i_buffer_pos;
+        chunk->i_data = i_data;
+        chunk->i_size = i_size;
+        memcpy( chunk->p_data, p_data, i_data );
+
+        if( stream->p_last != NULL )
+            stream->p_last->p_next = chunk;
+        else
+            stream->p_first = chunk;
+        stream->p_last = chunk;
+    }
+    stream->i_buffer_pos += i_data;
 
-        /* Ok, we can't go past the end of our buffer */
-        memcpy( &stream->p_buffer[i_pos], p_data, i_copy );
+    /* Forget the oldest chunks, clients still sending them keep them alive */
+    while( stream->p_first != stream->p_last &&
+           stream->i_buffer_pos - stream->p_first->p_next->i_pos
+               >= stream->i_buffer_size )
+    {
+        httpd_stream_chunk_t *first = stream->p_first;
 
-        i_pos = ( i_pos + i_copy ) % stream->i_buffer_size;
-        i_count -= i_copy;
-        p_data  += i_copy;
+        stream->p_first = first->p_next;
+        httpd_StreamChunkRelease( first );
     }
-
-    stream->i_buffer_pos += i_data;
 }
 
 int httpd_StreamSend( httpd_stream_t *stream, const block_t *p_block )
@@ -893,6 +1068,8 @@ int httpd_StreamSend( httpd_stream_t *stream, const block_t *p_block )
     httpd_AppendData( stream, p_block->p_buffer, p_block->i_buffer );
 
     vlc_mutex_unlock( &stream->lock );
+
+    httpd_UrlWakeWorkers( stream->url );
     return VLC_SUCCESS;
 }
 
@@ -902,7 +1079,13 @@ void httpd_StreamDelete( httpd_stream_t *stream )
     vlc_mutex_destroy( &stream->lock );
     free( stream->psz_mime );
     free( stream->p_header );
-    free( stream->p_buffer );
+    while( stream->p_first != NULL )
+    {
+        httpd_stream_chunk_t *first = stream->p_first;
+
+        stream->p_first = first->p_next;
+        httpd_StreamChunkRelease( first );
+    }
     free( stream );
 }
 
@@ -1063,11 +1246,19 @@ static httpd_host_t *httpd_HostCreate( vlc_object_t *p_this,
     host->client   = NULL;
     host->p_tls    = p_tls;
 
+#ifdef HTTPD_EPOLL
+    if( httpd_WorkersStart( host ) )
+        goto error;
+#endif
+
     /* create the thread */
     if( vlc_clone( &host->thread, httpd_HostThread, host,
                    VLC_THREAD_PRIORITY_LOW ) )
     {
         msg_Err( p_this, "cannot spawn http host thread" );
+#ifdef HTTPD_EPOLL
+        httpd_WorkersStop( host );
+#endif
         goto error;
     }
 
@@ -1119,6 +1310,9 @@ void httpd_HostDelete( httpd_host_t *host )
 
     vlc_cancel( host->thread );
     vlc_join( host->thread, NULL );
+#ifdef HTTPD_EPOLL
+    httpd_WorkersStop( host );
+#endif
 
     msg_Dbg( host, "HTTP host removed" );
 
@@ -1177,6 +1371,11 @@ httpd_url_t *httpd_UrlNew( httpd_host_t *host, const char *psz_url,
         url->catch[i].cb = NULL;
         url->catch[i].p_sys = NULL;
     }
+#ifdef HTTPD_EPOLL
+    url->waiting = xmalloc( host->i_worker * sizeof( *url->waiting ) );
+    for( unsigned i = 0; i < host->i_worker; i++ )
+        atomic_init( &url->waiting[i], 0 );
+#endif
 
     TAB_APPEND( host->i_url, host->url, url );
     vlc_cond_signal( &host->wait );
@@ -1185,6 +1384,12 @@ httpd_url_t *httpd_UrlNew( httpd_host_t *host, const char *psz_url,
     return url;
 }
 
+/* wake up the clients whose answer was deferred */
+void httpd_UrlWake( httpd_url_t *url )
+{
+    httpd_UrlWakeWorkers( url );
+}
+
 /* register callback on a url */
 int httpd_UrlCatch( httpd_url_t *url, int i_msg, httpd_callback_t cb,
                     httpd_callback_sys_t *p_sys )
@@ -1219,12 +1424,23 @@ void httpd_UrlDelete( httpd_url_t *url )
         {
             /* TODO complete it */
             msg_Warn( host, "force closing connections" );
+#ifdef HTTPD_EPOLL
+            /* The worker may be doing I/O on it: let it close the client */
+            client->url = NULL;
+            client->b_kill = true;
+            atomic_store( &client->worker->b_reap, true );
+            eventfd_write( client->worker->wakefd, 1 );
+#else
             httpd_ClientClean( client );
             TAB_REMOVE( host->i_client, host->client, client );
             free( client );
             i--;
+#endif
         }
     }
+#ifdef HTTPD_EPOLL
+    free( url->waiting );
+#endif
     free( url );
     vlc_mutex_unlock( &host->lock );
 }
@@ -1316,6 +1532,17 @@ static void httpd_ClientInit( httpd_client_t *cl, mtime_t now )
     cl->p_buffer = xmalloc( cl->i_buffer_size );
     cl->i_keyframe_wait_to_pass = -1;
     cl->b_stream_mode = false;
+    cl->b_deferred = false;
+    cl->i_shared_first = 0;
+    cl->i_shared = 0;
+    cl->i_lag_max = 0;
+    cl->i_skipped = 0;
+#ifdef HTTPD_EPOLL
+    cl->worker = NULL;
+    cl->i_events = 0;
+    cl->b_waiting = false;
+    cl->b_kill = false;
+#endif
 
     httpd_MsgInit( &cl->query );
     httpd_MsgInit( &cl->answer );
@@ -1344,6 +1571,10 @@ static void httpd_ClientClean( httpd_client_t *cl )
     httpd_MsgClean( &cl->answer );
     httpd_MsgClean( &cl->query );
 
+    for( unsigned i = 0; i < cl->i_shared; i++ )
+        httpd_StreamChunkRelease( cl->shared[cl->i_shared_first + i].chunk );
+    cl->i_shared = 0;
+
     free( cl->p_buffer );
     cl->p_buffer = NULL;
 }
@@ -1394,6 +1625,48 @@ ssize_t httpd_NetSend (httpd_client_t *cl, const uint8_t *p, size_t i_len)
     return val;
 }
 
+/* Sends the shared stream data straight from the chunks */
+static ssize_t httpd_ClientSendShared( httpd_client_t *cl )
+{
+    ssize_t val;
+
+#ifndef _WIN32
+    if( cl->p_tls == NULL )
+    {
+        struct iovec iov[HTTPD_CL_IOV];
+
+        for( unsigned i = 0; i < cl->i_shared; i++ )
+        {
+            iov[i].iov_base = (void *)cl->shared[cl->i_shared_first + i].p;
+            iov[i].iov_len = cl->shared[cl->i_shared_first + i].i;
+        }
+        do
+            val = writev( cl->fd, iov, cl->i_shared );
+        while( val == -1 && errno == EINTR );
+    }
+    else
+#endif
+    /* TLS records are built one buffer at a time anyway */
+    val = httpd_NetSend( cl, cl->shared[cl->i_shared_first].p,
+                         cl->shared[cl->i_shared_first].i );
+
+    for( size_t i_done = val > 0 ? val : 0; i_done > 0; )
+    {
+        unsigned i = cl->i_shared_first;
+
+        if( i_done < cl->shared[i].i )
+        {
+            cl->shared[i].p += i_done;
+            cl->shared[i].i -= i_done;
+            break;
+        }
+        i_done -= cl->shared[i].i;
+        httpd_StreamChunkRelease( cl->shared[i].chunk );
+        cl->i_shared_first++;
+        cl->i_shared--;
+    }
+    return val;
+}
 
 static const struct
 {
@@ -1867,44 +2140,18 @@ static void httpd_ClientSend( httpd_client_t *cl )
         fprintf( stderr, "%s",  cl->p_buffer );*/
     }
 
-    i_len = httpd_NetSend( cl, &cl->p_buffer[cl->i_buffer],
-                           cl->i_buffer_size - cl->i_buffer );
+    const bool b_shared = cl->i_buffer >= cl->i_buffer_size
+                       && cl->i_shared > 0;
+
+    if( b_shared )
+        i_len = httpd_ClientSendShared( cl );
+    else
+        i_len = httpd_NetSend( cl, &cl->p_buffer[cl->i_buffer],
+                               cl->i_buffer_size - cl->i_buffer );
     if( i_len >= 0 )
     {
-        cl->i_buffer += i_len;
-
-        if( cl->i_buffer >= cl->i_buffer_size )
-        {
-            if( cl->answer.i_body == 0  && cl->answer.i_body_offset > 0 )
-            {
-                /* catch more body data */
-                int     i_msg = cl->query.i_type;
-                int64_t i_offset = cl->answer.i_body_offset;
-
-                httpd_MsgClean( &cl->answer );
-                cl->answer.i_body_offset = i_offset;
-
-                cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query );
-            }
-
-            if( cl->answer.i_body > 0 )
-            {
-                /* send the body data */
-                free( cl->p_buffer );
-                cl->p_buffer = cl->answer.p_body;
-                cl->i_buffer_size = cl->answer.i_body;
-                cl->i_buffer = 0;
-
-                cl->answer.i_body = 0;
-                cl->answer.p_body = NULL;
-            }
-            else
-            {
-                /* send finished */
-                cl->i_state = HTTPD_CLIENT_SEND_DONE;
-            }
-        }
+        if( !b_shared )
+            cl->i_buffer += i_len;
     }
     else
     {
@@ -1920,6 +2167,45 @@ static void httpd_ClientSend( httpd_client_t *cl )
     }
 }
 
+/* Fetches what to send next once the buffers are out. Must be called with
+ * the host lock held, as it may invoke the URL callback. */
+static void httpd_ClientSendNext( httpd_client_t *cl )
+{
+    if( cl->i_state != HTTPD_CLIENT_SENDING
+     || cl->i_buffer < cl->i_buffer_size || cl->i_shared > 0 )
+        return;
+
+    if( cl->answer.i_body == 0  && cl->answer.i_body_offset > 0 )
+    {
+        /* catch more body data */
+        int     i_msg = cl->query.i_type;
+        int64_t i_offset = cl->answer.i_body_offset;
+
+        httpd_MsgClean( &cl->answer );
+        cl->answer.i_body_offset = i_offset;
+
+        cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
+                                  &cl->answer, &cl->query );
+    }
+
+    if( cl->answer.i_body > 0 )
+    {
+        /* send the body data */
+        free( cl->p_buffer );
+        cl->p_buffer = cl->answer.p_body;
+        cl->i_buffer_size = cl->answer.i_body;
+        cl->i_buffer = 0;
+
+        cl->answer.i_body = 0;
+        cl->answer.p_body = NULL;
+    }
+    else if( cl->i_shared == 0 && cl->i_state != HTTPD_CLIENT_DEAD )
+    {
+        /* send finished */
+        cl->i_state = HTTPD_CLIENT_SEND_DONE;
+    }
+}
+
 static void httpd_ClientTlsHandshake( httpd_client_t *cl )
 {
     switch( vlc_tls_SessionHandshake( cl->p_tls, NULL, NULL ) )
@@ -1942,337 +2228,834 @@ static void httpd_ClientTlsHandshake( httpd_client_t *cl )
     }
 }
 
-static void* httpd_HostThread( void *data )
+/* Handles the client state transitions that need no I/O, invoking the URL
+ * callbacks. Must be called with the host lock held. */
+static void httpd_ClientProcess( httpd_host_t *host, httpd_client_t *cl )
 {
-    httpd_host_t *host = data;
-    int canc = vlc_savecancel();
-
-    vlc_mutex_lock( &host->lock );
-    while( host->i_ref > 0 )
+    if( cl->i_state == HTTPD_CLIENT_RECEIVE_DONE )
     {
-        struct pollfd ufd[host->nfd + host->i_client];
-        unsigned nfd;
-        for( nfd = 0; nfd < host->nfd; nfd++ )
-        {
-            ufd[nfd].fd = host->fds[nfd];
-            ufd[nfd].events = POLLIN;
-            ufd[nfd].revents = 0;
-        }
+        httpd_message_t *answer = &cl->answer;
+        httpd_message_t *query  = &cl->query;
+        int i_msg = query->i_type;
 
-        /* add all socket that should be read/write and close dead connection */
-        while( host->i_url <= 0 )
+        httpd_MsgInit( answer );
+
+        /* Handle what we received */
+        if( i_msg == HTTPD_MSG_ANSWER )
         {
-            mutex_cleanup_push( &host->lock );
-            vlc_restorecancel( canc );
-            vlc_cond_wait( &host->wait, &host->lock );
-            canc = vlc_savecancel();
-            vlc_cleanup_pop();
+            cl->url     = NULL;
+            cl->i_state = HTTPD_CLIENT_DEAD;
         }
+        else if( i_msg == HTTPD_MSG_OPTIONS )
+        {
 
-        mtime_t now = mdate();
-        bool b_low_delay = false;
+            answer->i_type   = HTTPD_MSG_ANSWER;
+            answer->i_proto  = query->i_proto;
+            answer->i_status = 200;
+            answer->i_body = 0;
+            answer->p_body = NULL;
 
-        for(int i_client = 0; i_client < host->i_client; i_client++ )
-        {
-            httpd_client_t *cl = host->client[i_client];
-            if( cl->i_ref < 0 || ( cl->i_ref == 0 &&
-                ( cl->i_state == HTTPD_CLIENT_DEAD ||
-                  ( cl->i_activity_timeout > 0 &&
-                    cl->i_activity_date+cl->i_activity_timeout < now) ) ) )
+            httpd_MsgAdd( answer, "Server", "VLC/%s", VERSION );
+            httpd_MsgAdd( answer, "Content-Length", "0" );
+
+            switch( query->i_proto )
             {
-                httpd_ClientClean( cl );
-                TAB_REMOVE( host->i_client, host->client, cl );
-                free( cl );
-                i_client--;
-                continue;
-            }
+                case HTTPD_PROTO_HTTP:
+                    answer->i_version = 1;
+                    httpd_MsgAdd( answer, "Allow",
+                                  "GET,HEAD,POST,OPTIONS" );
+                    break;
 
-            struct pollfd *pufd = ufd + nfd;
-            assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+                case HTTPD_PROTO_RTSP:
+                {
+                    const char *p;
+                    answer->i_version = 0;
+
+                    p = httpd_MsgGet( query, "Cseq" );
+                    if( p != NULL )
+                        httpd_MsgAdd( answer, "Cseq", "%s", p );
+                    p = httpd_MsgGet( query, "Timestamp" );
+                    if( p != NULL )
+                        httpd_MsgAdd( answer, "Timestamp", "%s", p );
+
+                    p = httpd_MsgGet( query, "Require" );
+                    if( p != NULL )
+                    {
+                        answer->i_status = 551;
+                        httpd_MsgAdd( query, "Unsupported", "%s", p );
+                    }
 
-            pufd->fd = cl->fd;
-            pufd->events = pufd->revents = 0;
+                    httpd_MsgAdd( answer, "Public", "DESCRIBE,SETUP,"
+                                  "TEARDOWN,PLAY,PAUSE,GET_PARAMETER" );
+                    break;
+                }
+            }
 
-            if( ( cl->i_state == HTTPD_CLIENT_RECEIVING )
-                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_IN ) )
+            cl->i_buffer = -1;  /* Force the creation of the answer in
+                                 * httpd_ClientSend */
+            cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+        else if( i_msg == HTTPD_MSG_NONE )
+        {
+            if( query->i_proto == HTTPD_PROTO_NONE )
             {
-                pufd->events = POLLIN;
+                cl->url = NULL;
+                cl->i_state = HTTPD_CLIENT_DEAD;
             }
-            else if( ( cl->i_state == HTTPD_CLIENT_SENDING )
-                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT ) )
+            else
             {
-                pufd->events = POLLOUT;
+                char *p;
+
+                /* unimplemented */
+                answer->i_proto  = query->i_proto ;
+                answer->i_type   = HTTPD_MSG_ANSWER;
+                answer->i_version= 0;
+                answer->i_status = 501;
+
+                answer->i_body = httpd_HtmlError (&p, 501, NULL);
+                answer->p_body = (uint8_t *)p;
+                httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+
+                cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                cl->i_state = HTTPD_CLIENT_SENDING;
             }
-            else if( cl->i_state == HTTPD_CLIENT_RECEIVE_DONE )
-            {
-                httpd_message_t *answer = &cl->answer;
-                httpd_message_t *query  = &cl->query;
-                int i_msg = query->i_type;
+        }
+        else
+        {
+            bool b_auth_failed = false;
 
-                httpd_MsgInit( answer );
+            /* Search the url and trigger callbacks */
+            for(int i = 0; i < host->i_url; i++ )
+            {
+                httpd_url_t *url = host->url[i];
 
-                /* Handle what we received */
-                if( i_msg == HTTPD_MSG_ANSWER )
-                {
-                    cl->url     = NULL;
-                    cl->i_state = HTTPD_CLIENT_DEAD;
-                }
-                else if( i_msg == HTTPD_MSG_OPTIONS )
+                if( !strcmp( url->psz_url, query->psz_url ) )
                 {
+                    if( url->catch[i_msg].cb )
+                    {
+                        if( answer && ( *url->psz_user || *url->psz_password ) )
+                        {
+                            /* create the headers */
+                            const char *b64 = httpd_MsgGet( query, "Authorization" ); /* BASIC id */
+                            char *user = NULL, *pass = NULL;
 
-                    answer->i_type   = HTTPD_MSG_ANSWER;
-                    answer->i_proto  = query->i_proto;
-                    answer->i_status = 200;
-                    answer->i_body = 0;
-                    answer->p_body = NULL;
+                            if( b64 != NULL
+                             && !strncasecmp( b64, "BASIC", 5 ) )
+                            {
+                                b64 += 5;
+                                while( *b64 == ' ' )
+                                    b64++;
+
+                                user = vlc_b64_decode( b64 );
+                                if (user != NULL)
+                                {
+                                    pass = strchr (user, ':');
+                                    if (pass != NULL)
+                                        *pass++ = '\0';
+                                }
+                            }
 
-                    httpd_MsgAdd( answer, "Server", "VLC/%s", VERSION );
-                    httpd_MsgAdd( answer, "Content-Length", "0" );
+                            if ((user == NULL) || (pass == NULL)
+                             || strcmp (user, url->psz_user)
+                             || strcmp (pass, url->psz_password))
+                            {
+                                httpd_MsgAdd( answer,
+                                              "WWW-Authenticate",
+                                              "Basic realm=\"VLC stream\"" );
+                                /* We fail for all url */
+                                b_auth_failed = true;
+                                free( user );
+                                break;
+                            }
 
-                    switch( query->i_proto )
-                    {
-                        case HTTPD_PROTO_HTTP:
-                            answer->i_version = 1;
-                            httpd_MsgAdd( answer, "Allow",
-                                          "GET,HEAD,POST,OPTIONS" );
-                            break;
+                            free( user );
+                        }
 
-                        case HTTPD_PROTO_RTSP:
+                        if( !url->catch[i_msg].cb( url->catch[i_msg].p_sys, cl, answer, query ) )
                         {
-                            const char *p;
-                            answer->i_version = 0;
-
-                            p = httpd_MsgGet( query, "Cseq" );
-                            if( p != NULL )
-                                httpd_MsgAdd( answer, "Cseq", "%s", p );
-                            p = httpd_MsgGet( query, "Timestamp" );
-                            if( p != NULL )
-                                httpd_MsgAdd( answer, "Timestamp", "%s", p );
-
-                            p = httpd_MsgGet( query, "Require" );
-                            if( p != NULL )
+                            if( answer->i_proto == HTTPD_PROTO_NONE )
                             {
-                                answer->i_status = 551;
-                                httpd_MsgAdd( query, "Unsupported", "%s", p );
+                                /* Raw answer from a CGI */
+                                cl->i_buffer = cl->i_buffer_size;
                             }
+                            else
+                                cl->i_buffer = -1;
 
-                            httpd_MsgAdd( answer, "Public", "DESCRIBE,SETUP,"
-                                          "TEARDOWN,PLAY,PAUSE,GET_PARAMETER" );
-                            break;
+                            /* only one url can answer */
+                            answer = NULL;
+                            if( cl->url == NULL )
+                            {
+                                cl->url = url;
+                            }
                         }
                     }
-
-                    cl->i_buffer = -1;  /* Force the creation of the answer in
-                                         * httpd_ClientSend */
-                    cl->i_state = HTTPD_CLIENT_SENDING;
                 }
-                else if( i_msg == HTTPD_MSG_NONE )
-                {
-                    if( query->i_proto == HTTPD_PROTO_NONE )
-                    {
-                        cl->url = NULL;
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    }
-                    else
-                    {
-                        char *p;
+            }
 
-                        /* unimplemented */
-                        answer->i_proto  = query->i_proto ;
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_version= 0;
-                        answer->i_status = 501;
+            if( answer )
+            {
+                char *p;
 
-                        answer->i_body = httpd_HtmlError (&p, 501, NULL);
-                        answer->p_body = (uint8_t *)p;
-                        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+                answer->i_proto  = query->i_proto;
+                answer->i_type   = HTTPD_MSG_ANSWER;
+                answer->i_version= 0;
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                        cl->i_state = HTTPD_CLIENT_SENDING;
-                    }
+                if( b_auth_failed )
+                {
+                    answer->i_status = 401;
                 }
                 else
                 {
-                    bool b_auth_failed = false;
-
-                    /* Search the url and trigger callbacks */
-                    for(int i = 0; i < host->i_url; i++ )
-                    {
-                        httpd_url_t *url = host->url[i];
-
-                        if( !strcmp( url->psz_url, query->psz_url ) )
-                        {
-                            if( url->catch[i_msg].cb )
-                            {
-                                if( answer && ( *url->psz_user || *url->psz_password ) )
-                                {
-                                    /* create the headers */
-                                    const char *b64 = httpd_MsgGet( query, "Authorization" ); /* BASIC id */
-                                    char *user = NULL, *pass = NULL;
-
-                                    if( b64 != NULL
-                                     && !strncasecmp( b64, "BASIC", 5 ) )
-                                    {
-                                        b64 += 5;
-                                        while( *b64 == ' ' )
-                                            b64++;
-
-                                        user = vlc_b64_decode( b64 );
-                                        if (user != NULL)
-                                        {
-                                            pass = strchr (user, ':');
-                                            if (pass != NULL)
-                                                *pass++ = '\0';
-                                        }
-                                    }
-
-                                    if ((user == NULL) || (pass == NULL)
-                                     || strcmp (user, url->psz_user)
-                                     || strcmp (pass, url->psz_password))
-                                    {
-                                        httpd_MsgAdd( answer,
-                                                      "WWW-Authenticate",
-                                                      "Basic realm=\"VLC stream\"" );
-                                        /* We fail for all url */
-                                        b_auth_failed = true;
-                                        free( user );
-                                        break;
-                                    }
-
-                                    free( user );
-                                }
-
-                                if( !url->catch[i_msg].cb( url->catch[i_msg].p_sys, cl, answer, query ) )
-                                {
-                                    if( answer->i_proto == HTTPD_PROTO_NONE )
-                                    {
-                                        /* Raw answer from a CGI */
-                                        cl->i_buffer = cl->i_buffer_size;
-                                    }
-                                    else
-                                        cl->i_buffer = -1;
-
-                                    /* only one url can answer */
-                                    answer = NULL;
-                                    if( cl->url == NULL )
-                                    {
-                                        cl->url = url;
-                                    }
-                                }
-                            }
-                        }
-                    }
+                    /* no url registered */
+                    answer->i_status = 404;
+                }
 
-                    if( answer )
-                    {
-                        char *p;
+                answer->i_body = httpd_HtmlError (&p,
+                                                  answer->i_status,
+                                                  query->psz_url);
+                answer->p_body = (uint8_t *)p;
 
-                        answer->i_proto  = query->i_proto;
-                        answer->i_type   = HTTPD_MSG_ANSWER;
-                        answer->i_version= 0;
+                cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
+                httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
+                httpd_MsgAdd( answer, "Content-Type", "%s", "text/html" );
+            }
 
-                        if( b_auth_failed )
-                        {
-                            answer->i_status = 401;
-                        }
-                        else
-                        {
-                            /* no url registered */
-                            answer->i_status = 404;
-                        }
+            if( cl->answer.i_type == HTTPD_MSG_NONE )
+            {
+                /* The callback will answer later, see httpd_UrlWake() */
+                cl->b_deferred = true;
+                cl->i_state = HTTPD_CLIENT_WAITING;
+            }
+            else
+                cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+    }
+    else if( cl->i_state == HTTPD_CLIENT_SEND_DONE )
+    {
+        if( !cl->b_stream_mode || cl->answer.i_body_offset == 0 )
+        {
+            const char *psz_connection = httpd_MsgGet( &cl->answer, "Connection" );
+            const char *psz_query = httpd_MsgGet( &cl->query, "Connection" );
+            bool b_connection = false;
+            bool b_keepalive = false;
+            bool b_query = false;
+
+            cl->url = NULL;
+            if( psz_connection )
+            {
+                b_connection = ( strcasecmp( psz_connection, "Close" ) == 0 );
+                b_keepalive = ( strcasecmp( psz_connection, "Keep-Alive" ) == 0 );
+            }
 
-                        answer->i_body = httpd_HtmlError (&p,
-                                                          answer->i_status,
-                                                          query->psz_url);
-                        answer->p_body = (uint8_t *)p;
+            if( psz_query )
+            {
+                b_query = ( strcasecmp( psz_query, "Close" ) == 0 );
+            }
 
-                        cl->i_buffer = -1;  /* Force the creation of the answer in httpd_ClientSend */
-                        httpd_MsgAdd( answer, "Content-Length", "%d", answer->i_body );
-                        httpd_MsgAdd( answer, "Content-Type", "%s", "text/html" );
-                    }
+            if( ( ( cl->query.i_proto == HTTPD_PROTO_HTTP ) &&
+                  ( ( cl->query.i_version == 0 && b_keepalive ) ||
+                    ( cl->query.i_version == 1 && !b_connection ) ) ) ||
+                ( ( cl->query.i_proto == HTTPD_PROTO_RTSP ) &&
+                  !b_query && !b_connection ) )
+            {
+                httpd_MsgClean( &cl->query );
+                httpd_MsgInit( &cl->query );
 
-                    cl->i_state = HTTPD_CLIENT_SENDING;
-                }
+                cl->i_buffer = 0;
+                cl->i_buffer_size = 1000;
+                free( cl->p_buffer );
+                cl->p_buffer = xmalloc( cl->i_buffer_size );
+                cl->i_state = HTTPD_CLIENT_RECEIVING;
             }
-            else if( cl->i_state == HTTPD_CLIENT_SEND_DONE )
+            else
             {
-                if( !cl->b_stream_mode || cl->answer.i_body_offset == 0 )
-                {
-                    const char *psz_connection = httpd_MsgGet( &cl->answer, "Connection" );
-                    const char *psz_query = httpd_MsgGet( &cl->query, "Connection" );
-                    bool b_connection = false;
-                    bool b_keepalive = false;
-                    bool b_query = false;
-
-                    cl->url = NULL;
-                    if( psz_connection )
-                    {
-                        b_connection = ( strcasecmp( psz_connection, "Close" ) == 0 );
-                        b_keepalive = ( strcasecmp( psz_connection, "Keep-Alive" ) == 0 );
-                    }
+                cl->i_state = HTTPD_CLIENT_DEAD;
+            }
+            httpd_MsgClean( &cl->answer );
+        }
+        else
+        {
+            int64_t i_offset = cl->answer.i_body_offset;
+            httpd_MsgClean( &cl->answer );
 
-                    if( psz_query )
-                    {
-                        b_query = ( strcasecmp( psz_query, "Close" ) == 0 );
-                    }
+            cl->answer.i_body_offset = i_offset;
+            free( cl->p_buffer );
+            cl->p_buffer = NULL;
+            cl->i_buffer = 0;
+            cl->i_buffer_size = 0;
 
-                    if( ( ( cl->query.i_proto == HTTPD_PROTO_HTTP ) &&
-                          ( ( cl->query.i_version == 0 && b_keepalive ) ||
-                            ( cl->query.i_version == 1 && !b_connection ) ) ) ||
-                        ( ( cl->query.i_proto == HTTPD_PROTO_RTSP ) &&
-                          !b_query && !b_connection ) )
-                    {
-                        httpd_MsgClean( &cl->query );
-                        httpd_MsgInit( &cl->query );
-
-                        cl->i_buffer = 0;
-                        cl->i_buffer_size = 1000;
-                        free( cl->p_buffer );
-                        cl->p_buffer = xmalloc( cl->i_buffer_size );
-                        cl->i_state = HTTPD_CLIENT_RECEIVING;
-                    }
-                    else
-                    {
-                        cl->i_state = HTTPD_CLIENT_DEAD;
-                    }
-                    httpd_MsgClean( &cl->answer );
-                }
-                else
-                {
-                    int64_t i_offset = cl->answer.i_body_offset;
-                    httpd_MsgClean( &cl->answer );
+            cl->i_state = HTTPD_CLIENT_WAITING;
+        }
+    }
+    else if( cl->i_state == HTTPD_CLIENT_WAITING )
+    {
+        int64_t i_offset = cl->answer.i_body_offset;
+        int     i_msg = cl->query.i_type;
 
-                    cl->answer.i_body_offset = i_offset;
-                    free( cl->p_buffer );
-                    cl->p_buffer = NULL;
-                    cl->i_buffer = 0;
-                    cl->i_buffer_size = 0;
+        httpd_MsgInit( &cl->answer );
+        cl->answer.i_body_offset = i_offset;
 
-                    cl->i_state = HTTPD_CLIENT_WAITING;
-                }
-            }
-            else if( cl->i_state == HTTPD_CLIENT_WAITING )
+        cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
+                                  &cl->answer, &cl->query );
+        if( cl->answer.i_type != HTTPD_MSG_NONE && cl->b_deferred )
+        {
+            /* the deferred answer is ready, send it as a whole */
+            cl->b_deferred = false;
+            cl->i_buffer = -1;
+            cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+        else if( cl->answer.i_type != HTTPD_MSG_NONE )
+        {
+            /* we have new data, so re-enter send mode */
+            cl->i_buffer      = 0;
+            cl->p_buffer      = cl->answer.p_body;
+            cl->i_buffer_size = cl->answer.i_body;
+            cl->answer.p_body = NULL;
+            cl->answer.i_body = 0;
+            cl->i_state = HTTPD_CLIENT_SENDING;
+        }
+    }
+}
+
+/* Must be called with the host lock held */
+static void httpd_ClientDestroy( httpd_host_t *host, httpd_client_t *cl )
+{
+    /* Let the callback drop what it kept for the deferred answer */
+    if( cl->b_deferred && cl->url != NULL )
+    {
+        int i_msg = cl->query.i_type;
+
+        if( cl->url->catch[i_msg].cb != NULL )
+            cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
+                                      NULL, &cl->query );
+    }
+    if( cl->b_stream_mode )
+        msg_Dbg( host, "stream client gone: lagged up to %"PRId64
+                 " bytes, skipped %"PRId64" bytes", cl->i_lag_max,
+                 cl->i_skipped );
+    httpd_ClientClean( cl );
+    TAB_REMOVE( host->i_client, host->client, cl );
+    free( cl );
+}
+
+/* Must be called with the host lock held */
+static httpd_client_t *httpd_HostAccept( httpd_host_t *host, int fd,
+                                         mtime_t now )
+{
+    fd = vlc_accept (fd, NULL, NULL, true);
+    if (fd == -1)
+        return NULL;
+    setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
+                &(int){ 1 }, sizeof(int));
+
+    vlc_tls_t *p_tls;
+
+    if( host->p_tls != NULL )
+        p_tls = vlc_tls_SessionCreate( host->p_tls, fd, NULL );
+    else
+        p_tls = NULL;
+
+    httpd_client_t *cl = httpd_ClientNew( fd, p_tls, now );
+    if( cl == NULL )
+    {
+        if( p_tls != NULL )
+            vlc_tls_SessionDelete( p_tls );
+        net_Close( fd );
+    }
+    return cl;
+}
+
+#ifdef HTTPD_EPOLL
+/*
+ * The epoll registrations are level-triggered and persistent: the interest
+ * only changes (EPOLL_CTL_MOD) when the client state does. Each readiness
+ * event moves a client by one non-blocking receive, send or TLS handshake
+ * step, which is what level-triggering expects; edge-triggering would need
+ * every step to loop until EAGAIN.
+ */
+static void httpd_UrlWakeWorkers( httpd_url_t *url )
+{
+    httpd_host_t *host = url->host;
+
+    /* Only the workers with clients waiting on this very url */
+    for( unsigned i = 0; i < host->i_worker; i++ )
+    {
+        httpd_worker_t *w = &host->worker[i];
+
+        if( atomic_load( &url->waiting[i] ) > 0
+         && !atomic_exchange( &w->b_woken, true ) )
+            eventfd_write( w->wakefd, 1 );
+    }
+}
+
+/* Lists a client as waiting for data, or unlists it.
+ * Must be called with the host lock held. */
+static void httpd_WorkerWaiting( httpd_worker_t *w, httpd_client_t *cl,
+                                 bool b_waiting )
+{
+    /* A deleted url clears cl->url, and takes its counters along */
+    atomic_uint *count = ( cl->url != NULL )
+                       ? &cl->url->waiting[w - w->host->worker] : NULL;
+
+    if( b_waiting )
+    {
+        TAB_APPEND( w->i_waiting, w->waiting, cl );
+        if( count != NULL )
+            atomic_fetch_add( count, 1 );
+    }
+    else
+    {
+        TAB_REMOVE( w->i_waiting, w->waiting, cl );
+        if( count != NULL )
+            atomic_fetch_sub( count, 1 );
+    }
+    cl->b_waiting = b_waiting;
+}
+
+/* Must be called with the host lock held */
+static void httpd_WorkerRemove( httpd_worker_t *w, httpd_client_t *cl )
+{
+    if( cl->b_waiting )
+        httpd_WorkerWaiting( w, cl, false );
+    epoll_ctl( w->epfd, EPOLL_CTL_DEL, cl->fd, NULL );
+    w->i_client--;
+    httpd_ClientDestroy( w->host, cl );
+}
+
+/* Runs the client state machine until it blocks on I/O or on stream data,
+ * and updates its epoll interest. Must be called with the host lock held. */
+static void httpd_WorkerAdvance( httpd_worker_t *w, httpd_client_t *cl )
+{
+    uint32_t i_events = 0;
+
+    for( ;; )
+    {
+        if( cl->b_kill )
+            cl->i_state = HTTPD_CLIENT_DEAD;
+
+        if( cl->i_state == HTTPD_CLIENT_DEAD )
+        {
+            httpd_WorkerRemove( w, cl );
+            return;
+        }
+
+        if( cl->i_state == HTTPD_CLIENT_RECEIVING
+         || cl->i_state == HTTPD_CLIENT_TLS_HS_IN )
+        {
+            i_events = EPOLLIN;
+            break;
+        }
+
+        if( cl->i_state == HTTPD_CLIENT_SENDING )
+        {
+            httpd_ClientSendNext( cl );
+            if( cl->i_state != HTTPD_CLIENT_SENDING )
+                continue;
+            i_events = EPOLLOUT;
+            break;
+        }
+
+        if( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT )
+        {
+            i_events = EPOLLOUT;
+            break;
+        }
+
+        if( cl->i_state == HTTPD_CLIENT_WAITING && !cl->b_waiting )
+        {
+            /* Listed before asking for data, so no wake-up can be lost */
+            httpd_WorkerWaiting( w, cl, true );
+            atomic_store( &w->b_woken, false );
+        }
+
+        httpd_ClientProcess( w->host, cl );
+        if( cl->i_state == HTTPD_CLIENT_WAITING && cl->b_waiting )
+        {
+            i_events = 0;
+            break;
+        }
+    }
+
+    if( cl->b_waiting && cl->i_state != HTTPD_CLIENT_WAITING )
+        httpd_WorkerWaiting( w, cl, false );
+
+    if( cl->i_events != i_events )
+    {
+        struct epoll_event ev = { .events = i_events, .data.ptr = cl };
+
+        if( epoll_ctl( w->epfd, EPOLL_CTL_MOD, cl->fd, &ev ) == 0 )
+            cl->i_events = i_events;
+        else
+            cl->i_state = HTTPD_CLIENT_DEAD;
+    }
+}
+
+/* Performs one I/O step for a ready client. Must be called with the host
+ * lock held; the lock is released during the I/O itself. */
+static void httpd_WorkerEvent( httpd_worker_t *w, httpd_client_t *cl,
+                               uint32_t i_events, mtime_t now )
+{
+    httpd_host_t *host = w->host;
+
+    if( i_events & (EPOLLERR|EPOLLHUP) )
+        cl->i_state = HTTPD_CLIENT_DEAD;
+    else if( !cl->b_kill )
+    {
+        /* Only this worker changes the state, the URL deletion sets b_kill */
+        cl->i_activity_date = now;
+        vlc_mutex_unlock( &host->lock );
+
+        switch( cl->i_state )
+        {
+            case HTTPD_CLIENT_RECEIVING:
+                httpd_ClientRecv( cl );
+                break;
+            case HTTPD_CLIENT_SENDING:
+                httpd_ClientSend( cl );
+                break;
+            case HTTPD_CLIENT_TLS_HS_IN:
+            case HTTPD_CLIENT_TLS_HS_OUT:
+                httpd_ClientTlsHandshake( cl );
+                break;
+        }
+
+        vlc_mutex_lock( &host->lock );
+    }
+    httpd_WorkerAdvance( w, cl );
+}
+
+/* Closes the dead and timed out clients of a worker.
+ * Must be called with the host lock held. */
+static void httpd_WorkerSweep( httpd_worker_t *w, mtime_t now )
+{
+    httpd_host_t *host = w->host;
+
+    for( int i = 0; i < host->i_client; i++ )
+    {
+        httpd_client_t *cl = host->client[i];
+
+        if( cl->worker != w )
+            continue;
+        if( cl->b_kill || cl->i_ref < 0 || ( cl->i_ref == 0 &&
+            ( cl->i_state == HTTPD_CLIENT_DEAD ||
+              ( cl->i_activity_timeout > 0 &&
+                cl->i_activity_date+cl->i_activity_timeout < now) ) ) )
+        {
+            httpd_WorkerRemove( w, cl );
+            i--;
+        }
+    }
+}
+
+static void *httpd_WorkerThread( void *data )
+{
+    httpd_worker_t *w = data;
+    httpd_host_t *host = w->host;
+    struct epoll_event ev[HTTPD_EPOLL_EVENTS];
+    mtime_t i_sweep = mdate() + CLOCK_FREQ;
+    mtime_t i_retry = 0; /* next deferred answers retry, 0 if none */
+    int canc = vlc_savecancel();
+
+    for( ;; )
+    {
+        int i_timeout = 1000;
+
+        if( i_retry > 0 )
+        {
+            mtime_t i_delay = i_retry - mdate();
+            i_timeout = ( i_delay > 0 ) ? ( i_delay + 999 ) / 1000 : 0;
+        }
+
+        vlc_restorecancel( canc );
+        int n = epoll_wait( w->epfd, ev, HTTPD_EPOLL_EVENTS, i_timeout );
+        canc = vlc_savecancel();
+
+        if( n == -1 )
+        {
+            if (errno != EINTR)
             {
-                int64_t i_offset = cl->answer.i_body_offset;
-                int     i_msg = cl->query.i_type;
+                /* Kernel on low memory or a bug: pace */
+                msg_Err( host, "polling error: %m" );
+                msleep( 100000 );
+            }
+            continue;
+        }
 
-                httpd_MsgInit( &cl->answer );
-                cl->answer.i_body_offset = i_offset;
+        bool b_wake = false;
+        mtime_t now = mdate();
 
-                cl->url->catch[i_msg].cb( cl->url->catch[i_msg].p_sys, cl,
-                                          &cl->answer, &cl->query );
-                if( cl->answer.i_type != HTTPD_MSG_NONE )
+        vlc_mutex_lock( &host->lock );
+        for( int i = 0; i < n; i++ )
+        {
+            if( ev[i].data.ptr == NULL )
+                b_wake = true;
+            else
+                httpd_WorkerEvent( w, ev[i].data.ptr, ev[i].events, now );
+        }
+
+        if( b_wake )
+        {
+            eventfd_t dummy;
+
+            eventfd_read( w->wakefd, &dummy );
+            atomic_store( &w->b_woken, w->i_waiting == 0 );
+
+            /* Advancing a client only ever unlists that very client */
+            for( int i = w->i_waiting - 1; i >= 0; i-- )
+                httpd_WorkerAdvance( w, w->waiting[i] );
+        }
+        else if( i_retry > 0 && now >= i_retry )
+        {
+            /* Let the callbacks enforce their own deadlines */
+            for( int i = w->i_waiting - 1; i >= 0; i-- )
+                if( w->waiting[i]->b_deferred )
+                    httpd_WorkerAdvance( w, w->waiting[i] );
+        }
+
+        if( i_retry == 0 || now >= i_retry )
+        {
+            i_retry = 0;
+            for( int i = 0; i < w->i_waiting; i++ )
+                if( w->waiting[i]->b_deferred )
                 {
-                    /* we have new data, so re-enter send mode */
-                    cl->i_buffer      = 0;
-                    cl->p_buffer      = cl->answer.p_body;
-                    cl->i_buffer_size = cl->answer.i_body;
-                    cl->answer.p_body = NULL;
-                    cl->answer.i_body = 0;
-                    cl->i_state = HTTPD_CLIENT_SENDING;
+                    i_retry = now + HTTPD_DEFER_POLL;
+                    break;
                 }
+        }
+
+        if( atomic_exchange( &w->b_reap, false ) || now >= i_sweep )
+        {
+            httpd_WorkerSweep( w, now );
+            i_sweep = now + CLOCK_FREQ;
+        }
+        vlc_mutex_unlock( &host->lock );
+    }
+    return NULL;
+}
+
+/* Hands a new client over to the least loaded worker.
+ * Must be called with the host lock held. */
+static void httpd_WorkerAdd( httpd_host_t *host, httpd_client_t *cl )
+{
+    httpd_worker_t *w = &host->worker[0];
+
+    for( unsigned i = 1; i < host->i_worker; i++ )
+        if( host->worker[i].i_client < w->i_client )
+            w = &host->worker[i];
+
+    struct epoll_event ev = { .data.ptr = cl };
+
+    ev.events = ( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT ) ? EPOLLOUT
+                                                           : EPOLLIN;
+    if( epoll_ctl( w->epfd, EPOLL_CTL_ADD, cl->fd, &ev ) )
+    {
+        msg_Err( host, "cannot poll client socket: %m" );
+        httpd_ClientClean( cl );
+        free( cl );
+        return;
+    }
+    cl->worker = w;
+    cl->i_events = ev.events;
+    w->i_client++;
+    TAB_APPEND( host->i_client, host->client, cl );
+}
+
+static int httpd_WorkersStart( httpd_host_t *host )
+{
+    int i_worker = var_InheritInteger( host, "http-threads" );
+
+    if( i_worker <= 0 )
+        i_worker = vlc_GetCPUCount();
+
+    host->worker = malloc( i_worker * sizeof( *host->worker ) );
+    if( unlikely(host->worker == NULL) )
+        return VLC_ENOMEM;
+
+    for( host->i_worker = 0; host->i_worker < (unsigned)i_worker;
+         host->i_worker++ )
+    {
+        httpd_worker_t *w = &host->worker[host->i_worker];
+
+        w->host = host;
+        w->epfd = epoll_create1( EPOLL_CLOEXEC );
+        if( w->epfd == -1 )
+            break;
+        w->wakefd = eventfd( 0, EFD_CLOEXEC | EFD_NONBLOCK );
+        if( w->wakefd == -1 )
+        {
+            close( w->epfd );
+            break;
+        }
+        atomic_init( &w->b_woken, true );
+        atomic_init( &w->b_reap, false );
+        w->i_client = 0;
+        w->i_waiting = 0;
+        w->waiting = NULL;
+
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+
+        if( epoll_ctl( w->epfd, EPOLL_CTL_ADD, w->wakefd, &ev )
+         || vlc_clone( &w->thread, httpd_WorkerThread, w,
+                       VLC_THREAD_PRIORITY_LOW ) )
+        {
+            close( w->wakefd );
+            close( w->epfd );
+            break;
+        }
+    }
+
+    if( host->i_worker == 0 )
+    {
+        msg_Err( host, "cannot spawn http worker threads: %m" );
+        free( host->worker );
+        return VLC_EGENERIC;
+    }
+    msg_Dbg( host, "using %u http worker threads", host->i_worker );
+    return VLC_SUCCESS;
+}
+
+static void httpd_WorkersStop( httpd_host_t *host )
+{
+    for( unsigned i = 0; i < host->i_worker; i++ )
+        vlc_cancel( host->worker[i].thread );
+
+    for( unsigned i = 0; i < host->i_worker; i++ )
+    {
+        httpd_worker_t *w = &host->worker[i];
+
+        vlc_join( w->thread, NULL );
+        free( w->waiting );
+        close( w->wakefd );
+        close( w->epfd );
+    }
+    free( host->worker );
+}
+
+static void* httpd_HostThread( void *data )
+{
+    httpd_host_t *host = data;
+    struct pollfd ufd[host->nfd];
+    int canc = vlc_savecancel();
+
+    for( unsigned i = 0; i < host->nfd; i++ )
+    {
+        ufd[i].fd = host->fds[i];
+        ufd[i].events = POLLIN;
+    }
+
+    vlc_mutex_lock( &host->lock );
+    while( host->i_ref > 0 )
+    {
+        while( host->i_url <= 0 )
+        {
+            mutex_cleanup_push( &host->lock );
+            vlc_restorecancel( canc );
+            vlc_cond_wait( &host->wait, &host->lock );
+            canc = vlc_savecancel();
+            vlc_cleanup_pop();
+        }
+        vlc_mutex_unlock( &host->lock );
+        vlc_restorecancel( canc );
+
+        int ret = poll( ufd, host->nfd, -1 );
+
+        canc = vlc_savecancel();
+        vlc_mutex_lock( &host->lock );
+        if( ret == -1 )
+        {
+            if (errno != EINTR)
+            {
+                /* Kernel on low memory or a bug: pace */
+                msg_Err( host, "polling error: %m" );
+                msleep( 100000 );
+            }
+            continue;
+        }
+
+        mtime_t now = mdate();
+
+        for( unsigned i = 0; i < host->nfd; i++ )
+        {
+            if( ufd[i].revents == 0 )
+                continue;
+
+            httpd_client_t *cl = httpd_HostAccept( host, ufd[i].fd, now );
+            if( cl != NULL )
+                httpd_WorkerAdd( host, cl );
+        }
+    }
+    vlc_mutex_unlock( &host->lock );
+    return NULL;
+}
+
+#else
+static void httpd_UrlWakeWorkers( httpd_url_t *url )
+{
+    (void) url;
+}
+
+static void* httpd_HostThread( void *data )
+{
+    httpd_host_t *host = data;
+    int canc = vlc_savecancel();
+
+    vlc_mutex_lock( &host->lock );
+    while( host->i_ref > 0 )
+    {
+        struct pollfd ufd[host->nfd + host->i_client];
+        unsigned nfd;
+        for( nfd = 0; nfd < host->nfd; nfd++ )
+        {
+            ufd[nfd].fd = host->fds[nfd];
+            ufd[nfd].events = POLLIN;
+            ufd[nfd].revents = 0;
+        }
+
+        /* add all socket that should be read/write and close dead connection */
+        while( host->i_url <= 0 )
+        {
+            mutex_cleanup_push( &host->lock );
+            vlc_restorecancel( canc );
+            vlc_cond_wait( &host->wait, &host->lock );
+            canc = vlc_savecancel();
+            vlc_cleanup_pop();
+        }
+
+        mtime_t now = mdate();
+        bool b_low_delay = false;
+
+        for(int i_client = 0; i_client < host->i_client; i_client++ )
+        {
+            httpd_client_t *cl = host->client[i_client];
+            if( cl->i_ref < 0 || ( cl->i_ref == 0 &&
+                ( cl->i_state == HTTPD_CLIENT_DEAD ||
+                  ( cl->i_activity_timeout > 0 &&
+                    cl->i_activity_date+cl->i_activity_timeout < now) ) ) )
+            {
+                httpd_ClientDestroy( host, cl );
+                i_client--;
+                continue;
             }
 
+            struct pollfd *pufd = ufd + nfd;
+            assert (pufd < ufd + (sizeof (ufd) / sizeof (ufd[0])));
+
+            pufd->fd = cl->fd;
+            pufd->events = pufd->revents = 0;
+
+            if( ( cl->i_state == HTTPD_CLIENT_RECEIVING )
+                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_IN ) )
+            {
+                pufd->events = POLLIN;
+            }
+            else if( ( cl->i_state == HTTPD_CLIENT_SENDING )
+                  || ( cl->i_state == HTTPD_CLIENT_TLS_HS_OUT ) )
+            {
+                pufd->events = POLLOUT;
+            }
+            else
+                httpd_ClientProcess( host, cl );
+
             if (pufd->events != 0)
                 nfd++;
             else
@@ -2325,6 +3108,7 @@ static void* httpd_HostThread( void *data )
             else if( cl->i_state == HTTPD_CLIENT_SENDING )
             {
                 httpd_ClientSend( cl );
+                httpd_ClientSendNext( cl );
             }
             else if( cl->i_state == HTTPD_CLIENT_TLS_HS_IN
                   || cl->i_state == HTTPD_CLIENT_TLS_HS_OUT )
@@ -2344,25 +3128,12 @@ static void* httpd_HostThread( void *data )
             if( ufd[nfd].revents == 0 )
                 continue;
 
-            /* */
-            fd = vlc_accept (fd, NULL, NULL, true);
-            if (fd == -1)
-                continue;
-            setsockopt (fd, SOL_SOCKET, SO_REUSEADDR,
-                        &(int){ 1 }, sizeof(int));
-
-            vlc_tls_t *p_tls;
-
-            if( host->p_tls != NULL )
-                p_tls = vlc_tls_SessionCreate( host->p_tls, fd, NULL );
-            else
-                p_tls = NULL;
-
-            cl = httpd_ClientNew( fd, p_tls, now );
-
-            TAB_APPEND( host->i_client, host->client, cl );
+            cl = httpd_HostAccept( host, fd, now );
+            if( cl != NULL )
+                TAB_APPEND( host->i_client, host->client, cl );
         }
     }
     vlc_mutex_unlock( &host->lock );
     return NULL;
 }
+#endif
@@ -0,0 +1,145 @@
+/*****************************************************************************
+ * block_bench.c: Micro-benchmark for block_t allocation
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+
+#define ITERATIONS 200000
+
+/* Payload sizes typical of TS packets, datagrams, audio frames and PES */
+static const size_t sizes[] = { 188, 1316, 4608, 24000, 100000 };
+
+static void print_rate (const char *name, size_t size, mtime_t duration)
+{
+    printf ("%-12s %6zu bytes: %8.1f ns/block\n", name, size,
+            (duration * 1000.) / ITERATIONS);
+}
+
+/* Allocation and release on the same thread, a few blocks in flight */
+static void bench_local (size_t size)
+{
+    block_t *pending[8] = { NULL };
+    mtime_t start = mdate ();
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        unsigned slot = i % 8;
+
+        if (pending[slot] != NULL)
+            block_Release (pending[slot]);
+        pending[slot] = block_Alloc (size);
+        assert (pending[slot] != NULL);
+        assert (pending[slot]->i_buffer == size);
+        pending[slot]->p_buffer[0] = pending[slot]->p_buffer[size - 1] = 0x47;
+    }
+    for (unsigned slot = 0; slot < 8; slot++)
+        if (pending[slot] != NULL)
+            block_Release (pending[slot]);
+
+    print_rate ("local", size, mdate () - start);
+}
+
+/* Allocation on one thread and release on another, as with the input thread
+ * feeding decoders through a block_fifo_t */
+static void *consumer (void *data)
+{
+    block_fifo_t *fifo = data;
+    block_t *block;
+
+    while ((block = block_FifoGet (fifo)) != NULL)
+        block_Release (block);
+    return NULL;
+}
+
+static void bench_handoff (size_t size)
+{
+    block_fifo_t *fifo = block_FifoNew ();
+    vlc_thread_t th;
+
+    assert (fifo != NULL);
+    if (vlc_clone (&th, consumer, fifo, VLC_THREAD_PRIORITY_LOW))
+        abort ();
+
+    mtime_t start = mdate ();
+
+    for (unsigned i = 0; i < ITERATIONS; i++)
+    {
+        block_t *block = block_Alloc (size);
+
+        assert (block != NULL);
+        block_FifoPace (fifo, 64, SIZE_MAX);
+        block_FifoPut (fifo, block);
+    }
+    block_FifoPace (fifo, 0, SIZE_MAX);
+
+    print_rate ("handoff", size, mdate () - start);
+
+    block_FifoWake (fifo);
+    vlc_join (th, NULL);
+    block_FifoRelease (fifo);
+}
+
+/* Header insertion as done by packetizers and muxers */
+static void test_prepend (void)
+{
+    block_t *block = block_Alloc (188);
+
+    assert (block != NULL);
+    memset (block->p_buffer, 0x47, 188);
+    for (unsigned i = 0; i < 16; i++)
+    {
+        block = block_Realloc (block, 14, block->i_buffer);
+        assert (block != NULL);
+        memset (block->p_buffer, i, 14);
+    }
+    assert (block->i_buffer == 188 + 16 * 14);
+    for (unsigned i = 0; i < 188; i++)
+        assert (block->p_buffer[16 * 14 + i] == 0x47);
+    assert (block->p_buffer[0] == 15);
+    block_Release (block);
+}
+
+int main (void)
+{
+    block_pool_stats_t stats;
+
+    test_prepend ();
+
+    for (unsigned i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+        bench_local (sizes[i]);
+    for (unsigned i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+        bench_handoff (sizes[i]);
+
+    block_PoolStats (&stats);
+    printf ("pool: %"PRIu64" hits, %"PRIu64" misses, %"PRIu64" drops, "
+            "%zu bytes cached\n", stats.i_hits, stats.i_misses,
+            stats.i_drops, stats.i_cached);
+    return 0;
+}
@@ -84,10 +84,41 @@ static void test_block (void)
     //assert (block == NULL);
 }
 
+static void *drain_fifo (void *data)
+{
+    block_fifo_t *fifo = data;
+
+    msleep (CLOCK_FREQ / 20);
+    block_Release (block_FifoGet (fifo));
+    return NULL;
+}
+
+/* Pacing counts the payload of the queued blocks, not their memory */
+static void test_fifo_pace (void)
+{
+    block_fifo_t *fifo = block_FifoNew ();
+    vlc_thread_t th;
+    block_t *block = block_Alloc (300);
+
+    assert (fifo != NULL && block != NULL);
+    assert (block->i_size > block->i_buffer);
+    assert (block_FifoPut (fifo, block) == 300);
+
+    block_FifoPace (fifo, SIZE_MAX, 300);
+    assert (block_FifoCount (fifo) == 1);
+
+    assert (!vlc_clone (&th, drain_fifo, fifo, VLC_THREAD_PRIORITY_LOW));
+    block_FifoPace (fifo, SIZE_MAX, 299);
+    assert (block_FifoCount (fifo) == 0);
+    vlc_join (th, NULL);
+    block_FifoRelease (fifo);
+}
+
 int main (void)
 {
     test_block_File ();
     test_block ();
+    test_fifo_pace ();
     return 0;
 }
 
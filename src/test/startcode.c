@@ -0,0 +1,121 @@
+/*****************************************************************************
+ * startcode.c: Test for the Annex B start code scanner
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_block_helper.h>
+
+static const uint8_t annexb[4] = { 0x00, 0x00, 0x01, 0xB3 };
+
+static const uint8_t *FindNaive (const uint8_t *p, const uint8_t *end)
+{
+    for (; end - p >= 3; p++)
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    return NULL;
+}
+
+/* Buffers dense in 00 and 01, at every length and alignment */
+static void test_scan (void)
+{
+    uint8_t buf[256 + 64];
+
+    for (unsigned run = 0; run < 20000; run++)
+    {
+        size_t offset = rand () % 32;
+        size_t len = rand () % 256;
+
+        for (size_t i = 0; i < sizeof (buf); i++)
+        {
+            unsigned r = rand () % 8;
+            buf[i] = r < 4 ? 0 : r < 6 ? 1 : rand ();
+        }
+
+        const uint8_t *p = buf + offset, *end = p + len;
+        assert (block_FindAnnexBStartcode (p, end) == FindNaive (p, end));
+    }
+}
+
+/* Same start codes as a flat scan, whatever the block boundaries */
+static void test_bytestream (const uint8_t *code, int len)
+{
+    uint8_t buf[4096];
+
+    for (unsigned run = 0; run < 200; run++)
+    {
+        block_bytestream_t bs;
+
+        for (size_t i = 0; i < sizeof (buf); i++)
+        {
+            unsigned r = rand () % 16;
+            buf[i] = r < 6 ? 0 : r < 9 ? 1 : r < 10 ? 0xB3 : rand ();
+        }
+
+        block_BytestreamInit (&bs);
+        for (size_t i = 0; i < sizeof (buf);)
+        {
+            size_t size = 1 + (rand () % 40);
+
+            if (size > sizeof (buf) - i)
+                size = sizeof (buf) - i;
+
+            block_t *block = block_Alloc (size);
+
+            assert (block != NULL);
+            memcpy (block->p_buffer, buf + i, size);
+            block_BytestreamPush (&bs, block);
+            i += size;
+        }
+
+        size_t offset = 0, expected = 0;
+        for (;;)
+        {
+            while (expected + len <= sizeof (buf)
+                && memcmp (buf + expected, code, len))
+                expected++;
+
+            if (block_FindStartcodeFromOffset (&bs, &offset, code, len))
+                break;
+            assert (offset == expected);
+            offset++;
+            expected++;
+        }
+        assert (expected + len > sizeof (buf));
+        block_BytestreamRelease (&bs);
+    }
+}
+
+int main (void)
+{
+    srand (42);
+    test_scan ();
+    test_bytestream (annexb, 3);
+    test_bytestream (annexb, 4);
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*****************************************************************************
+ * startcode_bench.c: Benchmark for the Annex B start code scanner
+ *****************************************************************************
+ * Copyright (C) 2026 VLC authors and VideoLAN
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/* Usage: test_startcode_bench [elementary stream file]
+ * Without a file, a synthetic H.264-like stream is used. */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#undef NDEBUG
+#include <assert.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_block_helper.h>
+
+#define SYNTHETIC_SIZE (8 << 20)
+#define BLOCK_SIZE     4096 /* bytestream blocks, as out of a demuxer */
+#define PASSES         8
+
+static const uint8_t annexb[4] = { 0x00, 0x00, 0x01, 0xB3 };
+
+static const uint8_t *FindNaive (const uint8_t *p, const uint8_t *end)
+{
+    for (; end - p >= 3; p++)
+        if (p[0] == 0 && p[1] == 0 && p[2] == 1)
+            return p;
+    return NULL;
+}
+
+/* Random bytes with emulation prevention, and a NAL unit every few KiB */
+static uint8_t *synthesize (size_t size)
+{
+    uint8_t *buf = malloc (size);
+    size_t i = 0;
+
+    assert (buf != NULL);
+    while (i < size)
+    {
+        size_t nal = 64 + (rand () % 16384);
+
+        for (unsigned j = 0; j < 4 && i < size; j++)
+            buf[i++] = (j == 3) ? 0x65 : (j == 2);
+        for (size_t j = 0; j < nal && i < size; j++)
+        {
+            uint8_t b = (rand () % 8) ? rand () : 0;
+
+            if (i >= 2 && buf[i - 1] == 0 && buf[i - 2] == 0 && b <= 3)
+                b = 3; /* emulation_prevention_three_byte */
+            buf[i++] = b;
+        }
+    }
+    return buf;
+}
+
+static void print_rate (const char *name, size_t size, unsigned count,
+                        mtime_t duration)
+{
+    printf ("%-10s %8.1f MB/s, %u start codes\n", name,
+            (double)size * PASSES / duration, count / PASSES);
+}
+
+static void bench (const uint8_t *buf, size_t size)
+{
+    unsigned count = 0, ref = 0;
+    mtime_t start;
+
+    /* Flat buffer, byte by byte */
+    start = mdate ();
+    for (unsigned pass = 0; pass < PASSES; pass++)
+        for (const uint8_t *p = buf; (p = FindNaive (p, buf + size)) != NULL;
+             p += 3)
+            ref++;
+    print_rate ("naive", size, ref, mdate () - start);
+
+    /* Flat buffer, vectorised */
+    start = mdate ();
+    for (unsigned pass = 0; pass < PASSES; pass++)
+        for (const uint8_t *p = buf;
+             (p = block_FindAnnexBStartcode (p, buf + size)) != NULL; p += 3)
+            count++;
+    print_rate ("scanner", size, count, mdate () - start);
+    assert (count == ref);
+
+    /* Chained blocks, walked and flushed as by the packetizers */
+    mtime_t duration = 0;
+
+    count = 0;
+    for (unsigned pass = 0; pass < PASSES; pass++)
+    {
+        block_bytestream_t bs;
+        size_t offset = 0;
+
+        block_BytestreamInit (&bs);
+        for (size_t i = 0; i < size; i += BLOCK_SIZE)
+        {
+            size_t len = __MIN (BLOCK_SIZE, size - i);
+            block_t *block = block_Alloc (len);
+
+            assert (block != NULL);
+            memcpy (block->p_buffer, buf + i, len);
+            block_BytestreamPush (&bs, block);
+        }
+
+        start = mdate ();
+        while (!block_FindStartcodeFromOffset (&bs, &offset, annexb, 3))
+        {
+            count++;
+            block_SkipBytes (&bs, offset);
+            block_BytestreamFlush (&bs);
+            offset = 3;
+        }
+        duration += mdate () - start;
+        block_BytestreamRelease (&bs);
+    }
+    print_rate ("bytestream", size, count, duration);
+    assert (count == ref);
+}
+
+int main (int argc, char *argv[])
+{
+    uint8_t *buf;
+    size_t size;
+
+    srand (42);
+    if (argc > 1)
+    {
+        block_t *file = block_FilePath (argv[1]);
+
+        if (file == NULL)
+        {
+            perror (argv[1]);
+            return 1;
+        }
+        size = file->i_buffer;
+        buf = malloc (size);
+        assert (buf != NULL);
+        memcpy (buf, file->p_buffer, size);
+        block_Release (file);
+    }
+    else
+    {
+        size = SYNTHETIC_SIZE;
+        buf = synthesize (size);
+    }
+
+    bench (buf, size);
+    free (buf);
+    return 0;
+}
@@ -1622,6 +1622,7 @@ void vout_SendDisplayEventMouse(vout_thread_t *vout, const vlc_mouse_t *m)
     if (vout->p->spu && spu_ProcessMouse( vout->p->spu, m, &vout->p->display.vd->source))
         return;
 
+    vlc_mutex_lock( &vout->p->filter.lock_static );
     vlc_mutex_lock( &vout->p->filter.lock );
     if (vout->p->filter.chain_static && vout->p->filter.chain_interactive) {
         if (!filter_chain_MouseFilter(vout->p->filter.chain_interactive, &tmp1, m))
@@ -1630,6 +1631,7 @@ void vout_SendDisplayEventMouse(vout_thread_t *vout, const vlc_mouse_t *m)
             m = &tmp2;
     }
     vlc_mutex_unlock( &vout->p->filter.lock );
+    vlc_mutex_unlock( &vout->p->filter.lock_static );
 
     if (vlc_mouse_HasMoved(&vout->p->mouse, m)) {
         vout_SendEventMouseMoved(vout, m->i_x, m->i_y);
@@ -1653,6 +1655,7 @@ static void DummyVoutSendDisplayEventMouse(vout_thread_t *vout, vlc_mouse_t *fal
 
     if (!vout->p) {
         p.mouse = *fallback;
+        vlc_mutex_init(&p.filter.lock_static);
         vlc_mutex_init(&p.filter.lock);
         p.filter.chain_static = NULL;
         p.filter.chain_interactive = NULL;
@@ -1662,6 +1665,7 @@ static void DummyVoutSendDisplayEventMouse(vout_thread_t *vout, vlc_mouse_t *fal
     vout_SendDisplayEventMouse(vout, m);
     if (vout->p == &p) {
         vlc_mutex_destroy(&p.filter.lock);
+        vlc_mutex_destroy(&p.filter.lock_static);
         *fallback = p.mouse;
         vout->p = NULL;
     }
@@ -25,18 +25,26 @@
 # define LIBVLC_VOUT_STATISTIC_H
 # include <vlc_atomic.h>
 
-/* NOTE: Both statistics are atomic on their own, so one might be older than
- * the other one. Currently, only one of them is updated at a time, so this
+/* NOTE: The statistics are atomic on their own, so one might be older than
+ * the other ones. Currently, only one of them is updated at a time, so this
  * is a non-issue. */
 typedef struct {
     atomic_uint displayed;
     atomic_uint lost;
+    atomic_uint late;   /* displayed after their date */
+    atomic_uint pool_gets;      /* pictures handed out by the decoder pool */
+    atomic_uint pool_exhausted; /* decoder pool requests without free picture */
+    atomic_int  pool_used_max;  /* decoder pool high-water mark */
 } vout_statistic_t;
 
 static inline void vout_statistic_Init(vout_statistic_t *stat)
 {
     atomic_init(&stat->displayed, 0);
     atomic_init(&stat->lost, 0);
+    atomic_init(&stat->late, 0);
+    atomic_init(&stat->pool_gets, 0);
+    atomic_init(&stat->pool_exhausted, 0);
+    atomic_init(&stat->pool_used_max, 0);
 }
 
 static inline void vout_statistic_Clean(vout_statistic_t *stat)
@@ -44,10 +52,21 @@ static inline void vout_statistic_Clean(vout_statistic_t *stat)
     (void) stat;
 }
 
-static inline void vout_statistic_GetReset(vout_statistic_t *stat, int *displayed, int *lost)
+static inline void vout_statistic_GetReset(vout_statistic_t *stat, int *displayed, int *lost, int *late)
 {
     *displayed = atomic_exchange(&stat->displayed, 0);
     *lost      = atomic_exchange(&stat->lost, 0);
+    *late      = atomic_exchange(&stat->late, 0);
+}
+
+/* The high-water mark is a level, it is not reset */
+static inline void vout_statistic_GetResetPool(vout_statistic_t *stat,
+                                               int *gets, int *exhausted,
+                                               int *used_max)
+{
+    *gets      = atomic_exchange(&stat->pool_gets, 0);
+    *exhausted = atomic_exchange(&stat->pool_exhausted, 0);
+    *used_max  = atomic_load(&stat->pool_used_max);
 }
 
 static inline void vout_statistic_AddDisplayed(vout_statistic_t *stat,
@@ -61,4 +80,18 @@ static inline void vout_statistic_AddLost(vout_statistic_t *stat, int lost)
     atomic_fetch_add(&stat->lost, lost);
 }
 
+static inline void vout_statistic_AddLate(vout_statistic_t *stat, int late)
+{
+    atomic_fetch_add(&stat->late, late);
+}
+
+static inline void vout_statistic_AddPool(vout_statistic_t *stat,
+                                          int gets, int exhausted,
+                                          int used_max)
+{
+    atomic_fetch_add(&stat->pool_gets, gets);
+    atomic_fetch_add(&stat->pool_exhausted, exhausted);
+    atomic_store(&stat->pool_used_max, used_max);
+}
+
 #endif
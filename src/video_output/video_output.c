@@ -130,6 +130,8 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
 
     vout->p->original = original;
     vout->p->dpb_size = cfg->dpb_size;
+    vout->p->lookahead.depth = 0;
+    vout->p->lookahead.is_running = false;
 
     vout_control_Init(&vout->p->control);
     vout_control_PushVoid(&vout->p->control, VOUT_CONTROL_INIT);
@@ -140,6 +142,7 @@ static vout_thread_t *VoutCreate(vlc_object_t *object,
 
     /* Initialize locks */
     vlc_mutex_init(&vout->p->picture_lock);
+    vlc_mutex_init(&vout->p->filter.lock_static);
     vlc_mutex_init(&vout->p->filter.lock);
     vlc_mutex_init(&vout->p->spu_lock);
 
@@ -263,6 +266,7 @@ static void VoutDestructor(vlc_object_t *object)
     vlc_mutex_destroy(&vout->p->spu_lock);
     vlc_mutex_destroy(&vout->p->picture_lock);
     vlc_mutex_destroy(&vout->p->filter.lock);
+    vlc_mutex_destroy(&vout->p->filter.lock_static);
     vout_control_Clean(&vout->p->control);
 
     /* */
@@ -286,9 +290,17 @@ void vout_ChangePause(vout_thread_t *vout, bool is_paused, mtime_t date)
     vout_control_WaitEmpty(&vout->p->control);
 }
 
-void vout_GetResetStatistic(vout_thread_t *vout, int *displayed, int *lost)
+void vout_GetResetStatistic(vout_thread_t *vout, int *displayed, int *lost,
+                            int *late)
 {
-    vout_statistic_GetReset( &vout->p->statistic, displayed, lost );
+    vout_statistic_GetReset( &vout->p->statistic, displayed, lost, late );
+}
+
+void vout_GetResetPoolStatistic(vout_thread_t *vout, int *gets,
+                                int *exhausted, int *used_max)
+{
+    vout_statistic_GetResetPool( &vout->p->statistic, gets, exhausted,
+                                 used_max );
 }
 
 void vout_Flush(vout_thread_t *vout, mtime_t date)
@@ -311,9 +323,18 @@ bool vout_IsEmpty(vout_thread_t *vout)
     if (picture)
         picture_Release(picture);
 
+    /* Pictures filtered ahead are not displayed yet either */
+    bool is_empty = !picture;
+    if (is_empty && vout->p->lookahead.is_running) {
+        vlc_mutex_lock(&vout->p->lookahead.lock);
+        is_empty = vout->p->lookahead.count == 0 &&
+                   !vout->p->lookahead.blocked && !vout->p->lookahead.busy;
+        vlc_mutex_unlock(&vout->p->lookahead.lock);
+    }
+
     vlc_mutex_unlock(&vout->p->picture_lock);
 
-    return !picture;
+    return is_empty;
 }
 
 void vout_FixLeaks( vout_thread_t *vout )
@@ -421,6 +442,13 @@ void vout_PutPicture(vout_thread_t *vout, picture_t *picture)
     picture->p_next = NULL;
     picture_fifo_Push(vout->p->decoder_fifo, picture);
 
+    if (vout->p->lookahead.is_running) {
+        vlc_mutex_lock(&vout->p->lookahead.lock);
+        vout->p->lookahead.pending = true;
+        vlc_cond_signal(&vout->p->lookahead.wait);
+        vlc_mutex_unlock(&vout->p->lookahead.lock);
+    }
+
     vlc_mutex_unlock(&vout->p->picture_lock);
 
     vout_control_Wake(&vout->p->control);
@@ -675,8 +703,10 @@ static picture_t *VoutVideoFilterStaticNewPicture(filter_t *filter)
 {
     vout_thread_t *vout = (vout_thread_t*)filter->p_owner;
 
-    vlc_assert_locked(&vout->p->filter.lock);
-    if (filter_chain_GetLength(vout->p->filter.chain_interactive) == 0)
+    vlc_assert_locked(&vout->p->filter.lock_static);
+    /* Pictures kept ready by the lookahead must not exhaust the private pool */
+    if (!vout->p->lookahead.is_running &&
+        filter_chain_GetLength(vout->p->filter.chain_interactive) == 0)
         return VoutVideoFilterInteractiveNewPicture(filter);
 
     return picture_NewFromFormat(&filter->fmt_out.video);
@@ -700,6 +730,219 @@ static int VoutVideoFilterInteractiveAllocationSetup(filter_t *filter, void *dat
     filter->p_owner             = data; /* vout */
     return VLC_SUCCESS;
 }
+/*****************************************************************************
+ * Lookahead: the static filter chain is run on a worker thread ahead of the
+ * display date, up to lookahead.depth pictures.
+ *
+ * The worker holds filter.lock_static while it pops from the decoder fifo and
+ * uses the static chain, so the vout thread must hold it too to modify them.
+ * It stops at any picture requiring a filter reconfiguration and leaves it to
+ * the vout thread.
+ *****************************************************************************/
+static void *LookaheadThread(void *object)
+{
+    vout_thread_t *vout = object;
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_mutex_lock(&sys->lookahead.lock);
+    for (;;) {
+        while (!sys->lookahead.exit &&
+               (!sys->lookahead.pending || sys->lookahead.blocked ||
+                sys->lookahead.count >= sys->lookahead.depth))
+            vlc_cond_wait(&sys->lookahead.wait, &sys->lookahead.lock);
+        if (sys->lookahead.exit)
+            break;
+        sys->lookahead.pending = false;
+        sys->lookahead.busy    = true;
+        vlc_mutex_unlock(&sys->lookahead.lock);
+
+        vlc_mutex_lock(&sys->filter.lock_static);
+        picture_t *decoded = picture_fifo_Pop(sys->decoder_fifo);
+        if (decoded &&
+            !VideoFormatIsCropArEqual(&decoded->format, &sys->filter.format)) {
+            vlc_mutex_lock(&sys->lookahead.lock);
+            sys->lookahead.blocked = decoded;
+            sys->lookahead.pending = true;
+            vlc_mutex_unlock(&sys->lookahead.lock);
+        } else if (decoded) {
+            picture_t *filtered =
+                filter_chain_VideoFilter(sys->filter.chain_static,
+                                         picture_Hold(decoded));
+            while (filtered) {
+                vout_lookahead_entry_t *entry = malloc(sizeof(*entry));
+                if (unlikely(!entry)) {
+                    picture_Release(filtered);
+                    break;
+                }
+                entry->filtered = filtered;
+                entry->decoded  = picture_Hold(decoded);
+                entry->next     = NULL;
+
+                vlc_mutex_lock(&sys->lookahead.lock);
+                *sys->lookahead.last = entry;
+                sys->lookahead.last  = &entry->next;
+                sys->lookahead.count++;
+                vlc_mutex_unlock(&sys->lookahead.lock);
+
+                filtered = filter_chain_VideoFilter(sys->filter.chain_static, NULL);
+            }
+            picture_Release(decoded);
+
+            vlc_mutex_lock(&sys->lookahead.lock);
+            sys->lookahead.pending = true;
+            vlc_mutex_unlock(&sys->lookahead.lock);
+        }
+        vlc_mutex_unlock(&sys->filter.lock_static);
+
+        if (decoded)
+            vout_control_Wake(&sys->control);
+
+        vlc_mutex_lock(&sys->lookahead.lock);
+        sys->lookahead.busy = false;
+    }
+    vlc_mutex_unlock(&sys->lookahead.lock);
+    return NULL;
+}
+
+static void ThreadLookaheadStart(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (sys->lookahead.depth == 0)
+        return;
+
+    vlc_mutex_init(&sys->lookahead.lock);
+    vlc_cond_init(&sys->lookahead.wait);
+    sys->lookahead.exit    = false;
+    sys->lookahead.pending = true;
+    sys->lookahead.busy    = false;
+    sys->lookahead.count   = 0;
+    sys->lookahead.first   = NULL;
+    sys->lookahead.last    = &sys->lookahead.first;
+    sys->lookahead.blocked = NULL;
+
+    /* Set before the worker looks at it */
+    vlc_mutex_lock(&sys->picture_lock);
+    sys->lookahead.is_running = true;
+    vlc_mutex_unlock(&sys->picture_lock);
+    if (vlc_clone(&sys->lookahead.thread, LookaheadThread, vout,
+                  VLC_THREAD_PRIORITY_VIDEO)) {
+        vlc_mutex_lock(&sys->picture_lock);
+        sys->lookahead.is_running = false;
+        vlc_mutex_unlock(&sys->picture_lock);
+        vlc_cond_destroy(&sys->lookahead.wait);
+        vlc_mutex_destroy(&sys->lookahead.lock);
+        msg_Err(vout, "cannot start the lookahead, filtering on display");
+        return;
+    }
+    msg_Dbg(vout, "filtering up to %u pictures ahead", sys->lookahead.depth);
+}
+
+static bool IsFlushed(const picture_t *picture, bool below, mtime_t date)
+{
+    return ( below && picture->date <= date) ||
+           (!below && picture->date >= date);
+}
+
+/* Drops the pictures filtered ahead whose decoded picture date is below or
+ * equal to (resp. above or equal to) date.
+ * Must be called with filter.lock_static held */
+static void ThreadLookaheadFlush(vout_thread_t *vout, bool below, mtime_t date)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_assert_locked(&sys->filter.lock_static);
+
+    vlc_mutex_lock(&sys->lookahead.lock);
+    vout_lookahead_entry_t **pp = &sys->lookahead.first;
+    while (*pp) {
+        vout_lookahead_entry_t *entry = *pp;
+
+        if (!IsFlushed(entry->decoded, below, date)) {
+            pp = &entry->next;
+            continue;
+        }
+        *pp = entry->next;
+        picture_Release(entry->filtered);
+        picture_Release(entry->decoded);
+        free(entry);
+        sys->lookahead.count--;
+    }
+    sys->lookahead.last = pp;
+    if (sys->lookahead.blocked &&
+        IsFlushed(sys->lookahead.blocked, below, date)) {
+        picture_Release(sys->lookahead.blocked);
+        sys->lookahead.blocked = NULL;
+    }
+    sys->lookahead.pending = true;
+    vlc_cond_signal(&sys->lookahead.wait);
+    vlc_mutex_unlock(&sys->lookahead.lock);
+}
+
+static void ThreadLookaheadStop(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    if (!sys->lookahead.is_running)
+        return;
+
+    vlc_mutex_lock(&sys->lookahead.lock);
+    sys->lookahead.exit = true;
+    vlc_cond_signal(&sys->lookahead.wait);
+    vlc_mutex_unlock(&sys->lookahead.lock);
+    vlc_join(sys->lookahead.thread, NULL);
+
+    vlc_mutex_lock(&sys->picture_lock);
+    sys->lookahead.is_running = false;
+    vlc_mutex_unlock(&sys->picture_lock);
+
+    vlc_mutex_lock(&sys->filter.lock_static);
+    ThreadLookaheadFlush(vout, true, INT64_MAX);
+    vlc_mutex_unlock(&sys->filter.lock_static);
+
+    vlc_cond_destroy(&sys->lookahead.wait);
+    vlc_mutex_destroy(&sys->lookahead.lock);
+}
+
+/* Must be called with filter.lock_static held */
+static void ThreadLookaheadOffsetDate(vout_thread_t *vout, mtime_t duration)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_assert_locked(&sys->filter.lock_static);
+
+    vlc_mutex_lock(&sys->lookahead.lock);
+    for (vout_lookahead_entry_t *entry = sys->lookahead.first;
+         entry != NULL; entry = entry->next) {
+        entry->filtered->date += duration;
+        /* A decoded picture shared by several entries, already displayed,
+         * or passed through unmodified, must be shifted only once */
+        if ((entry->next == NULL || entry->next->decoded != entry->decoded) &&
+            entry->decoded != sys->displayed.decoded &&
+            entry->decoded != entry->filtered)
+            entry->decoded->date += duration;
+    }
+    if (sys->lookahead.blocked)
+        sys->lookahead.blocked->date += duration;
+    vlc_mutex_unlock(&sys->lookahead.lock);
+}
+
+/* Must be called with filter.lock_static held */
+static picture_t *ThreadLookaheadPopBlocked(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    vlc_assert_locked(&sys->filter.lock_static);
+
+    vlc_mutex_lock(&sys->lookahead.lock);
+    picture_t *decoded = sys->lookahead.blocked;
+    sys->lookahead.blocked = NULL;
+    vlc_cond_signal(&sys->lookahead.wait);
+    vlc_mutex_unlock(&sys->lookahead.lock);
+
+    return decoded;
+}
+
 static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
 {
     if (vout->p->displayed.current)
@@ -710,12 +953,16 @@ static void ThreadFilterFlush(vout_thread_t *vout, bool is_locked)
         picture_Release( vout->p->displayed.next );
     vout->p->displayed.next = NULL;
 
-    if (!is_locked)
+    if (!is_locked) {
+        vlc_mutex_lock(&vout->p->filter.lock_static);
         vlc_mutex_lock(&vout->p->filter.lock);
+    }
     filter_chain_VideoFlush(vout->p->filter.chain_static);
     filter_chain_VideoFlush(vout->p->filter.chain_interactive);
-    if (!is_locked)
+    if (!is_locked) {
         vlc_mutex_unlock(&vout->p->filter.lock);
+        vlc_mutex_unlock(&vout->p->filter.lock_static);
+    }
 }
 
 typedef struct {
@@ -760,8 +1007,18 @@ static void ThreadChangeFilters(vout_thread_t *vout,
         current = next;
     }
 
-    if (!is_locked)
+    if (!is_locked) {
+        vlc_mutex_lock(&vout->p->filter.lock_static);
         vlc_mutex_lock(&vout->p->filter.lock);
+    }
+
+    /* Drop the pictures filtered with the previous configuration */
+    if (vout->p->lookahead.is_running)
+        ThreadLookaheadFlush(vout, true, INT64_MAX);
+    if (vout->p->displayed.filtered) {
+        picture_Release(vout->p->displayed.filtered);
+        vout->p->displayed.filtered = NULL;
+    }
 
     es_format_t fmt_target;
     es_format_InitFromVideo(&fmt_target, source ? source : &vout->p->filter.format);
@@ -808,39 +1065,122 @@ static void ThreadChangeFilters(vout_thread_t *vout,
         video_format_Copy(&vout->p->filter.format, source);
     }
 
-    if (!is_locked)
+    if (!is_locked) {
         vlc_mutex_unlock(&vout->p->filter.lock);
+        vlc_mutex_unlock(&vout->p->filter.lock_static);
+    }
 }
 
 
 /* */
+static bool ThreadIsPictureLate(vout_thread_t *vout, const picture_t *picture,
+                                bool is_late_dropped)
+{
+    if (!is_late_dropped || picture->b_force)
+        return false;
+
+    const mtime_t predicted = mdate() + 0; /* TODO improve */
+    const mtime_t late = predicted - picture->date;
+    if (late > VOUT_DISPLAY_LATE_THRESHOLD) {
+        msg_Warn(vout, "picture is too late to be displayed (missing %"PRId64" ms)", late/1000);
+        vout_statistic_AddLost(&vout->p->statistic, 1);
+        return true;
+    } else if (late > 0) {
+        msg_Dbg(vout, "picture might be displayed late (missing %"PRId64" ms)", late/1000);
+    }
+    return false;
+}
+
+static picture_t *ThreadLookaheadPop(vout_thread_t *vout, bool is_late_dropped,
+                                     bool *is_blocked)
+{
+    vout_thread_sys_t *sys = vout->p;
+
+    for (;;) {
+        vlc_mutex_lock(&sys->lookahead.lock);
+        vout_lookahead_entry_t *entry = sys->lookahead.first;
+        if (entry) {
+            sys->lookahead.first = entry->next;
+            if (!sys->lookahead.first)
+                sys->lookahead.last = &sys->lookahead.first;
+            sys->lookahead.count--;
+            vlc_cond_signal(&sys->lookahead.wait);
+        }
+        *is_blocked = sys->lookahead.blocked != NULL;
+        vlc_mutex_unlock(&sys->lookahead.lock);
+
+        if (!entry)
+            return NULL;
+
+        picture_t *filtered = entry->filtered;
+        picture_t *decoded  = entry->decoded;
+        free(entry);
+
+        /* A decoded picture may be the source of several filtered ones */
+        if (decoded == sys->displayed.decoded) {
+            picture_Release(decoded);
+        } else if (ThreadIsPictureLate(vout, decoded, is_late_dropped)) {
+            picture_Release(filtered);
+            picture_Release(decoded);
+            continue;
+        } else {
+            if (sys->displayed.decoded)
+                picture_Release(sys->displayed.decoded);
+
+            sys->displayed.decoded       = decoded;
+            sys->displayed.timestamp     = decoded->date;
+            sys->displayed.is_interlaced = !decoded->b_progressive;
+        }
+        return filtered;
+    }
+}
+
 static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool frame_by_frame)
 {
     bool is_late_dropped = vout->p->is_late_dropped && !vout->p->pause.is_on && !frame_by_frame;
+    const bool is_lookahead = vout->p->lookahead.is_running;
+    picture_t *picture = NULL;
+
+    if (is_lookahead && reuse && vout->p->displayed.filtered) {
+        /* The lookahead may have fed the static chain the pictures
+         * following the displayed one: show its output again rather than
+         * submitting the picture twice */
+        picture = picture_Hold(vout->p->displayed.filtered);
+        goto queue;
+    }
+
+    if (is_lookahead) {
+        bool is_blocked;
+
+        picture = ThreadLookaheadPop(vout, is_late_dropped, &is_blocked);
+        if (picture)
+            goto queue;
+        if (!is_blocked)
+            return VLC_EGENERIC;
+        /* The worker waits for the filters to be reconfigured. It may have
+         * fed the static chain since the displayed picture was: do not
+         * submit that one again */
+        reuse = false;
+    }
 
+    vlc_mutex_lock(&vout->p->filter.lock_static);
     vlc_mutex_lock(&vout->p->filter.lock);
 
-    picture_t *picture = filter_chain_VideoFilter(vout->p->filter.chain_static, NULL);
+    picture = filter_chain_VideoFilter(vout->p->filter.chain_static, NULL);
     assert(!reuse || !picture);
 
     while (!picture) {
         picture_t *decoded;
         if (reuse && vout->p->displayed.decoded) {
+            /* Only after a filter change: the static chain is a new one */
             decoded = picture_Hold(vout->p->displayed.decoded);
         } else {
-            decoded = picture_fifo_Pop(vout->p->decoder_fifo);
+            decoded = is_lookahead ? ThreadLookaheadPopBlocked(vout)
+                                   : picture_fifo_Pop(vout->p->decoder_fifo);
             if (decoded) {
-                if (is_late_dropped && !decoded->b_force) {
-                    const mtime_t predicted = mdate() + 0; /* TODO improve */
-                    const mtime_t late = predicted - decoded->date;
-                    if (late > VOUT_DISPLAY_LATE_THRESHOLD) {
-                        msg_Warn(vout, "picture is too late to be displayed (missing %"PRId64" ms)", late/1000);
-                        picture_Release(decoded);
-                        vout_statistic_AddLost(&vout->p->statistic, 1);
-                        continue;
-                    } else if (late > 0) {
-                        msg_Dbg(vout, "picture might be displayed late (missing %"PRId64" ms)", late/1000);
-                    }
+                if (ThreadIsPictureLate(vout, decoded, is_late_dropped)) {
+                    picture_Release(decoded);
+                    continue;
                 }
                 if (!VideoFormatIsCropArEqual(&decoded->format, &vout->p->filter.format))
                     ThreadChangeFilters(vout, &decoded->format, vout->p->filter.configuration, true);
@@ -862,10 +1202,20 @@ static int ThreadDisplayPreparePicture(vout_thread_t *vout, bool reuse, bool fra
     }
 
     vlc_mutex_unlock(&vout->p->filter.lock);
+    vlc_mutex_unlock(&vout->p->filter.lock_static);
 
     if (!picture)
         return VLC_EGENERIC;
 
+queue:
+    /* Without the lookahead, the displayed picture is filtered again, as
+     * it always was */
+    if (picture != vout->p->displayed.filtered) {
+        if (vout->p->displayed.filtered)
+            picture_Release(vout->p->displayed.filtered);
+        vout->p->displayed.filtered = is_lookahead ? picture_Hold(picture)
+                                                   : NULL;
+    }
     assert(!vout->p->displayed.next);
     if (!vout->p->displayed.current)
         vout->p->displayed.current = picture;
@@ -970,6 +1320,12 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
      * - blend subtitles, and in a fast access buffer
      */
     bool is_direct = vout->p->decoder_pool == vout->p->display_pool;
+    /* The lookahead does not allocate the static filters output from the
+     * decoder pool */
+    if (sys->lookahead.is_running &&
+        filter_chain_GetLength(sys->filter.chain_static) > 0 &&
+        filter_chain_GetLength(sys->filter.chain_interactive) == 0)
+        is_direct = false;
     picture_t *todisplay = filtered;
     if (do_early_spu && subpic) {
         picture_t *blent = picture_pool_Get(vout->p->private_pool);
@@ -1054,6 +1410,9 @@ static int ThreadDisplayRenderPicture(vout_thread_t *vout, bool is_forced)
 
     /* Display the direct buffer returned by vout_RenderPicture */
     vout->p->displayed.date = mdate();
+    if (!is_forced &&
+        vout->p->displayed.date > todisplay->date + VOUT_MWAIT_TOLERANCE)
+        vout_statistic_AddLate(&vout->p->statistic, 1);
     vout_display_Display(vd,
                          sys->display.filtered ? sys->display.filtered
                                                 : todisplay,
@@ -1178,9 +1537,16 @@ static void ThreadChangePause(vout_thread_t *vout, bool is_paused, mtime_t date)
             vout->p->step.timestamp += duration;
         if (vout->p->step.last > VLC_TS_INVALID)
             vout->p->step.last += duration;
+        vlc_mutex_lock(&vout->p->filter.lock_static);
         picture_fifo_OffsetDate(vout->p->decoder_fifo, duration);
+        if (vout->p->lookahead.is_running)
+            ThreadLookaheadOffsetDate(vout, duration);
+        vlc_mutex_unlock(&vout->p->filter.lock_static);
         if (vout->p->displayed.decoded)
             vout->p->displayed.decoded->date += duration;
+        if (vout->p->displayed.filtered &&
+            vout->p->displayed.filtered != vout->p->displayed.decoded)
+            vout->p->displayed.filtered->date += duration;
         spu_OffsetSubtitleDate(vout->p->spu, duration);
 
         ThreadFilterFlush(vout, false);
@@ -1197,12 +1563,16 @@ static void ThreadFlush(vout_thread_t *vout, bool below, mtime_t date)
     vout->p->step.timestamp = VLC_TS_INVALID;
     vout->p->step.last      = VLC_TS_INVALID;
 
-    ThreadFilterFlush(vout, false); /* FIXME too much */
+    vlc_mutex_lock(&vout->p->filter.lock_static);
+    vlc_mutex_lock(&vout->p->filter.lock);
+    ThreadFilterFlush(vout, true); /* FIXME too much */
+    vlc_mutex_unlock(&vout->p->filter.lock);
+    if (vout->p->lookahead.is_running)
+        ThreadLookaheadFlush(vout, below, date);
 
     picture_t *last = vout->p->displayed.decoded;
     if (last) {
-        if (( below && last->date <= date) ||
-            (!below && last->date >= date)) {
+        if (IsFlushed(last, below, date)) {
             picture_Release(last);
 
             vout->p->displayed.decoded   = NULL;
@@ -1210,8 +1580,13 @@ static void ThreadFlush(vout_thread_t *vout, bool below, mtime_t date)
             vout->p->displayed.timestamp = VLC_TS_INVALID;
         }
     }
+    if (!vout->p->displayed.decoded && vout->p->displayed.filtered) {
+        picture_Release(vout->p->displayed.filtered);
+        vout->p->displayed.filtered = NULL;
+    }
 
     picture_fifo_Flush(vout->p->decoder_fifo, date, below);
+    vlc_mutex_unlock(&vout->p->filter.lock_static);
 }
 
 static void ThreadReset(vout_thread_t *vout)
@@ -1339,6 +1714,7 @@ static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
     vout->p->displayed.current       = NULL;
     vout->p->displayed.next          = NULL;
     vout->p->displayed.decoded       = NULL;
+    vout->p->displayed.filtered      = NULL;
     vout->p->displayed.date          = VLC_TS_INVALID;
     vout->p->displayed.timestamp     = VLC_TS_INVALID;
     vout->p->displayed.is_interlaced = false;
@@ -1349,12 +1725,16 @@ static int ThreadStart(vout_thread_t *vout, const vout_display_state_t *state)
     vout->p->spu_blend_chroma        = 0;
     vout->p->spu_blend               = NULL;
 
+    ThreadLookaheadStart(vout);
+
     video_format_Print(VLC_OBJECT(vout), "original format", &vout->p->original);
     return VLC_SUCCESS;
 }
 
 static void ThreadStop(vout_thread_t *vout, vout_display_state_t *state)
 {
+    ThreadLookaheadStop(vout);
+
     if (vout->p->spu_blend)
         filter_DeleteBlend(vout->p->spu_blend);
 
@@ -1384,6 +1764,7 @@ static void ThreadInit(vout_thread_t *vout)
     vout->p->window.object    = NULL;
     vout->p->dead             = false;
     vout->p->is_late_dropped  = var_InheritBool(vout, "drop-late-frames");
+    vout->p->lookahead.depth  = var_InheritInteger(vout, "video-lookahead");
     vout->p->pause.is_on      = false;
     vout->p->pause.date       = VLC_TS_INVALID;
 
@@ -39,7 +39,14 @@ void spu_OffsetSubtitleDate( spu_t *p_spu, mtime_t i_duration );
 /**
  * This function will return and reset internal statistics.
  */
-void vout_GetResetStatistic( vout_thread_t *p_vout, int *pi_displayed, int *pi_lost );
+void vout_GetResetStatistic( vout_thread_t *p_vout, int *pi_displayed, int *pi_lost, int *pi_late );
+
+/**
+ * This function will return and reset the decoder picture pool statistics:
+ * pictures handed out, requests that found no free picture (the decoder
+ * had to wait) and the high-water mark of pictures in use.
+ */
+void vout_GetResetPoolStatistic( vout_thread_t *p_vout, int *pi_gets, int *pi_exhausted, int *pi_used_max );
 
 /**
  * This function will ensure that all ready/displayed pciture have at most
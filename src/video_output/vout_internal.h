@@ -43,6 +43,15 @@
  */
 #define VOUT_MAX_PICTURES (20)
 
+/* Picture filtered ahead of time, with the decoded picture it comes from */
+typedef struct vout_lookahead_entry_t vout_lookahead_entry_t;
+struct vout_lookahead_entry_t
+{
+    picture_t              *filtered;
+    picture_t              *decoded;
+    vout_lookahead_entry_t *next;
+};
+
 /* */
 struct vout_thread_sys_t
 {
@@ -61,6 +70,7 @@ struct vout_thread_sys_t
 
     /* Statistics */
     vout_statistic_t statistic;
+    picture_pool_stats_t pool_stats; /* decoder pool counts already added */
 
     /* Subpicture unit */
     vlc_mutex_t     spu_lock;
@@ -93,6 +103,7 @@ struct vout_thread_sys_t
         mtime_t     timestamp;
         bool        is_interlaced;
         picture_t   *decoded;
+        picture_t   *filtered;  /**< last static chain output of decoded */
         picture_t   *current;
         picture_t   *next;
     } displayed;
@@ -119,6 +130,7 @@ struct vout_thread_sys_t
 
     /* Video filter2 chain */
     struct {
+        vlc_mutex_t     lock_static; /* static chain and decoder fifo users */
         vlc_mutex_t     lock;
         char            *configuration;
         video_format_t  format;
@@ -136,6 +148,22 @@ struct vout_thread_sys_t
     picture_pool_t  *decoder_pool;
     picture_fifo_t  *decoder_fifo;
     vout_chrono_t   render;           /**< picture render time estimator */
+
+    /* Static filter chain run ahead of the display by a worker */
+    struct {
+        unsigned        depth;        /**< pictures to keep ready, 0 if off */
+        bool            is_running;
+        vlc_thread_t    thread;
+        vlc_mutex_t     lock;
+        vlc_cond_t      wait;
+        bool            exit;
+        bool            pending;      /**< the decoder fifo may be non-empty */
+        bool            busy;         /**< filtering a picture from the fifo */
+        unsigned        count;
+        vout_lookahead_entry_t *first;
+        vout_lookahead_entry_t **last;
+        picture_t       *blocked;     /**< needs a filter reconfiguration */
+    } lookahead;
 };
 
 /* TODO to move them to vlc_vout.h */
@@ -106,6 +106,20 @@ void vout_CloseWrapper(vout_thread_t *vout, vout_display_state_t *state)
 /* Minimum number of display picture */
 #define DISPLAY_PICTURE_COUNT (1)
 
+/* Adds the decoder pool activity since the last call to the statistics */
+static void PoolStatistic(vout_thread_t *vout)
+{
+    vout_thread_sys_t *sys = vout->p;
+    picture_pool_stats_t stats;
+
+    picture_pool_GetStats(sys->decoder_pool, &stats);
+    vout_statistic_AddPool(&sys->statistic,
+                           stats.get_count - sys->pool_stats.get_count,
+                           stats.exhausted_count - sys->pool_stats.exhausted_count,
+                           stats.used_max);
+    sys->pool_stats = stats;
+}
+
 static void NoDrInit(vout_thread_t *vout)
 {
     vout_thread_sys_t *sys = vout->p;
@@ -126,7 +140,8 @@ int vout_InitWrapper(vout_thread_t *vout)
     const bool allow_dr = !vd->info.has_pictures_invalid && !vd->info.is_slow && sys->display.use_dr;
     const unsigned private_picture  = 4; /* XXX 3 for filter, 1 for SPU */
     const unsigned decoder_picture  = 1 + sys->dpb_size;
-    const unsigned kept_picture     = 1; /* last displayed picture */
+    const unsigned kept_picture     = 1 + /* last displayed picture */
+                                      sys->lookahead.depth;
     const unsigned reserved_picture = DISPLAY_PICTURE_COUNT +
                                       private_picture +
                                       kept_picture;
@@ -155,6 +170,7 @@ int vout_InitWrapper(vout_thread_t *vout)
     }
     sys->private_pool = picture_pool_Reserve(sys->decoder_pool, private_picture);
     sys->display.filtered = NULL;
+    picture_pool_GetStats(sys->decoder_pool, &sys->pool_stats);
     return VLC_SUCCESS;
 }
 
@@ -166,6 +182,16 @@ void vout_EndWrapper(vout_thread_t *vout)
     vout_thread_sys_t *sys = vout->p;
 
     assert(!sys->display.filtered);
+
+    PoolStatistic(vout);
+
+    const picture_pool_stats_t *stats = &sys->pool_stats;
+    msg_Dbg(vout, "decoder pool: %d pictures, at most %d used, "
+            "%u exhausted of %u requests",
+            picture_pool_GetSize(sys->decoder_pool),
+            stats->used_max, stats->exhausted_count,
+            stats->get_count + stats->exhausted_count);
+
     if (sys->private_pool)
         picture_pool_Delete(sys->private_pool);
 
@@ -181,6 +207,9 @@ void vout_ManageWrapper(vout_thread_t *vout)
     vout_thread_sys_t *sys = vout->p;
     vout_display_t *vd = sys->display.vd;
 
+    if (sys->decoder_pool)
+        PoolStatistic(vout);
+
     bool reset_display_pool = vout_AreDisplayPicturesInvalid(vd);
     reset_display_pool |= vout_ManageDisplay(vd, !sys->display.use_dr || reset_display_pool);
 